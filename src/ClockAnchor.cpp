@@ -0,0 +1,29 @@
+#include "ClockAnchor.h"
+
+ClockAnchor::Event ClockAnchor::update(int64_t monotonicUs, int64_t utcUs){
+    int64_t offsetUs = utcUs - monotonicUs;
+    if(!_anchored.load(std::memory_order_relaxed)){
+        if(utcUs < (int64_t)MIN_VALID_UTC_TIME * 1000000){
+            return NONE;
+        }
+        _offsetUs.store(offsetUs, std::memory_order_relaxed);
+        _anchoredUs.store(monotonicUs, std::memory_order_relaxed);
+        _anchored.store(true, std::memory_order_release);
+        return ANCHORED;
+    }
+
+    int64_t differenceUs = offsetUs - _offsetUs.load(std::memory_order_relaxed);
+    if(differenceUs == 0){
+        return NONE;
+    }
+    _offsetUs.store(offsetUs, std::memory_order_relaxed);
+    if(differenceUs >= MAX_SLEW_US || differenceUs <= -MAX_SLEW_US){
+        _steps.fetch_add(1, std::memory_order_relaxed);
+        _lastStepUs.store(differenceUs, std::memory_order_relaxed);
+        return STEPPED;
+    }
+    if(differenceUs >= JITTER_US || differenceUs <= -JITTER_US){
+        _slewedUs.fetch_add(differenceUs > 0 ? differenceUs : -differenceUs, std::memory_order_relaxed);
+    }
+    return SLEWED;
+}
@@ -0,0 +1,57 @@
+#ifndef CLOCK_ANCHOR_H
+#define CLOCK_ANCHOR_H
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+
+// The mapping of the monotonic clock (Hal::micros()) to UTC. The intervalls are timed by the monotonic clock,
+// which never jumps, and only their end times are taken from UTC through this mapping.
+// update() compares both clocks: the first valid UTC time anchors the mapping, a small difference is followed
+// like a slew of the system time and a difference of MAX_SLEW_US or more is a step, which moves the mapping at once.
+// The calls of update() must not overlap, the mapping and the statistics can be read by every task.
+class ClockAnchor
+{
+public:
+	// A UTC time before 2021 is not set yet, e.g. the board is started before the NTP sync.
+	const static time_t MIN_VALID_UTC_TIME = 1609459200;
+	// A larger difference between the clocks is a step.
+	const static int64_t MAX_SLEW_US = 1000000;
+	// A smaller difference is the jitter of reading both clocks, it is followed but not counted as slew.
+	const static int64_t JITTER_US = 1000;
+
+	enum Event
+	{
+		NONE,						// Not anchored or no difference
+		ANCHORED,					// The first valid UTC time is known
+		SLEWED,						// The difference was followed
+		STEPPED						// The UTC time jumped
+	};
+
+	//**** user functions
+	// Compare the monotonic time with the UTC time, both in micro seconds.
+	Event update(int64_t monotonicUs, int64_t utcUs);
+	// True, if a valid UTC time was seen.
+	bool isAnchored() const { return _anchored.load(std::memory_order_acquire); }
+	// Convert the times, only valid if isAnchored().
+	int64_t toUtcUs(int64_t monotonicUs) const { return monotonicUs + _offsetUs.load(std::memory_order_relaxed); }
+	int64_t toMonotonicUs(int64_t utcUs) const { return utcUs - _offsetUs.load(std::memory_order_relaxed); }
+
+	//**** statistics
+	// The monotonic time when the mapping was anchored, 0 if not anchored.
+	int64_t anchoredUs() const { return _anchoredUs.load(std::memory_order_relaxed); }
+	// Number of steps and the size of the last step, positive if the UTC time jumped forward.
+	unsigned long steps() const { return _steps.load(std::memory_order_relaxed); }
+	int64_t lastStepUs() const { return _lastStepUs.load(std::memory_order_relaxed); }
+	// The sum of the followed slews without the jitter, the amount of both directions.
+	int64_t slewedUs() const { return _slewedUs.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> _offsetUs{0};								// UTC - monotonic time
+	std::atomic<bool> _anchored{false};
+	std::atomic<int64_t> _anchoredUs{0};
+	std::atomic<unsigned long> _steps{0};
+	std::atomic<int64_t> _lastStepUs{0};
+	std::atomic<int64_t> _slewedUs{0};
+};
+
+#endif
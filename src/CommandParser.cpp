@@ -0,0 +1,291 @@
+#include <string.h>
+#include "CommandParser.h"
+#include "ImpulseMeter.h"
+
+// Remove a trailing CR, e.g. from messages with Windows line ends.
+static std::string_view trimLine(std::string_view line){
+    if(!line.empty() && line.back() == '\r'){
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+// Parse the report policy after its mode, see parseInstallCounter().
+static CommandParser::Result parseReportPolicy(Tokenizer& tokenizer, std::string_view mode, ReportPolicy::Config& config){
+    std::string_view token;
+    uint32_t value;
+
+    if(mode == "ALWAYS"){
+        config.mode = ReportPolicy::REPORT_ALWAYS;
+        return CommandParser::OK;
+    }else if(mode == "CHANGE"){
+        config.mode = ReportPolicy::REPORT_ON_CHANGE;
+    }else if(mode == "DEADBAND"){
+        config.mode = ReportPolicy::REPORT_DEADBAND;
+        if(!tokenizer.next(token)){
+            return CommandParser::MISSING_FIELD;
+        }
+        config.relative = !token.empty() && token.back() == '%';
+        if(config.relative){
+            token.remove_suffix(1);
+        }
+        if(!CommandParser::parseUInt(token, config.threshold)){
+            return CommandParser::BAD_REPORT_POLICY;
+        }
+    }else if(mode == "HEARTBEAT"){
+        config.mode = ReportPolicy::REPORT_HEARTBEAT;
+    }else{
+        return CommandParser::BAD_REPORT_POLICY;
+    }
+
+    if(tokenizer.next(token)){
+        if(!CommandParser::parseUInt(token, value) || value > ReportPolicy::MAX_SILENCE_IN_SEC){
+            return CommandParser::BAD_REPORT_POLICY;
+        }
+        config.maxSilenceInSec = value;
+    }
+    // A heartbeat without max. silence would never publish.
+    if(config.mode == ReportPolicy::REPORT_HEARTBEAT && config.maxSilenceInSec == 0){
+        return CommandParser::BAD_REPORT_POLICY;
+    }
+    return CommandParser::OK;
+}
+
+CommandParser::Result CommandParser::parseInstallCounter(std::string_view message, CounterConfig& config){
+    Tokenizer tokenizer(trimLine(message), '\t');
+    std::string_view token;
+    uint32_t value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, value) || value >= MAX_COUNTERS){
+        return BAD_COUNTER_ID;
+    }
+    config.counterId = value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    // The source name is used as MQTT topic, so the wildcards are not allowed.
+    if(token.empty() || token.size() > CounterConfig::MAX_SOURCE_NAME_LEN || token.find_first_of("+#") != std::string_view::npos){
+        return BAD_SOURCE_NAME;
+    }
+    memcpy(config.sourceName, token.data(), token.size());
+    config.sourceName[token.size()] = 0;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, value)){
+        return BAD_INTERVALL;
+    }
+    config.timerIntervallInSec = value;
+
+    config.sourceType = config.counterId < MAX_GPIO_COUNTERS ? GPIO_INTERRUPT_SOURCE : EXPANDER_SOURCE;
+    if(tokenizer.next(token)){
+        char name[12] = {};
+        if(token.size() >= sizeof(name)){
+            return BAD_BACKEND;
+        }
+        memcpy(name, token.data(), token.size());
+        if(!ImpulseSource::typeFromName(name, config.sourceType)){
+            return BAD_BACKEND;
+        }
+        // The GPIO backends can´t count the inputs of a expander and the other way round.
+        if((config.sourceType == EXPANDER_SOURCE) != (config.counterId >= MAX_GPIO_COUNTERS)){
+            return BAD_BACKEND;
+        }
+    }
+
+    config.report = {ReportPolicy::REPORT_ALWAYS, false, 0, 0};
+    if(tokenizer.next(token)){
+        Result result = parseReportPolicy(tokenizer, token, config.report);
+        if(result != OK){
+            return result;
+        }
+    }
+
+    if(tokenizer.next(token)){
+        return TOO_MANY_FIELDS;
+    }
+    return OK;
+}
+
+CommandParser::Result CommandParser::parseInstallCounters(std::string_view message, CounterConfig* configs, size_t maxConfigs, size_t& count, size_t& errorLine){
+    Tokenizer lines(message, '\n');
+    std::string_view line;
+    count = 0;
+    errorLine = 0;
+    bool usedIds[MAX_COUNTERS] = {};
+    size_t lineNumber = 0;
+    while (lines.next(line))
+    {
+        lineNumber++;
+        if(trimLine(line).empty()){
+            continue;
+        }
+
+        errorLine = lineNumber;
+        if(count >= maxConfigs){
+            return TOO_MANY_COUNTERS;
+        }
+        Result result = parseInstallCounter(line, configs[count]);
+        if(result != OK){
+            return result;
+        }
+        if(usedIds[configs[count].counterId]){
+            return DUPLICATE_COUNTER_ID;
+        }
+        usedIds[configs[count].counterId] = true;
+        count++;
+    }
+
+    errorLine = 0;
+    return OK;
+}
+
+size_t CommandParser::installCounterLine(std::string_view message, size_t index){
+    Tokenizer lines(message, '\n');
+    std::string_view line;
+    size_t lineNumber = 0;
+    while (lines.next(line))
+    {
+        lineNumber++;
+        if(!trimLine(line).empty() && index-- == 0){
+            break;
+        }
+    }
+    return lineNumber;
+}
+
+CommandParser::Result CommandParser::parseLiveRate(std::string_view message, uint8_t& counterId, uint32_t& changePercent){
+    Tokenizer tokenizer(trimLine(message), '\t');
+    std::string_view token;
+    uint32_t value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, value) || value >= MAX_COUNTERS){
+        return BAD_COUNTER_ID;
+    }
+    counterId = value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, value) || value > 100){
+        return BAD_RATE_CHANGE;
+    }
+    changePercent = value;
+
+    if(tokenizer.next(token)){
+        return TOO_MANY_FIELDS;
+    }
+    return OK;
+}
+
+CommandParser::Result CommandParser::parseStormGuard(std::string_view message, uint8_t& counterId, StormGuard::Config& config){
+    Tokenizer tokenizer(trimLine(message), '\t');
+    std::string_view token;
+    uint32_t value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, value) || value >= MAX_COUNTERS){
+        return BAD_COUNTER_ID;
+    }
+    counterId = value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, config.minSpacingUs)){
+        return BAD_STORM_GUARD;
+    }
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, config.maxInterruptsPerSec)){
+        return BAD_STORM_GUARD;
+    }
+
+    if(tokenizer.next(token)){
+        return TOO_MANY_FIELDS;
+    }
+    return OK;
+}
+
+CommandParser::Result CommandParser::parseRollup(std::string_view message, uint8_t& counterId, Rollup::LevelConfig* levels, size_t& count){
+    Tokenizer tokenizer(trimLine(message), '\t');
+    std::string_view token;
+    uint32_t value;
+
+    if(!tokenizer.next(token)){
+        return MISSING_FIELD;
+    }
+    if(!parseUInt(token, value) || value >= MAX_COUNTERS){
+        return BAD_COUNTER_ID;
+    }
+    counterId = value;
+
+    count = 0;
+    while (tokenizer.next(token))
+    {
+        if(count == Rollup::MAX_LEVELS){
+            return TOO_MANY_FIELDS;
+        }
+        bool retain = !token.empty() && token.back() == 'R';
+        if(retain){
+            token.remove_suffix(1);
+        }
+        if(!parseUInt(token, value) || value == 0 || value > Rollup::MAX_PERIOD_IN_SEC){
+            return BAD_ROLLUP_PERIOD;
+        }
+        levels[count++] = {value, retain};
+    }
+    return OK;
+}
+
+bool CommandParser::parseUInt(std::string_view text, uint32_t& value){
+    if(text.empty() || text.size() > 10){
+        return false;
+    }
+
+    uint64_t result = 0;
+    for (char c : text)
+    {
+        if(c < '0' || c > '9'){
+            return false;
+        }
+        result = result * 10 + (c - '0');
+    }
+    if(result > UINT32_MAX){
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+const char* CommandParser::resultText(Result result){
+    switch (result)
+    {
+    case OK:                    return "OK";
+    case MISSING_FIELD:         return "Missing field";
+    case TOO_MANY_FIELDS:       return "Too many fields";
+    case BAD_COUNTER_ID:        return "Wrong CounterId";
+    case BAD_SOURCE_NAME:       return "Wrong SourceName";
+    case BAD_INTERVALL:         return "Wrong intervall";
+    case BAD_BACKEND:           return "Unknown counting backend";
+    case TOO_MANY_COUNTERS:     return "Too many counters";
+    case DUPLICATE_COUNTER_ID:  return "CounterId is used twice";
+    case BAD_RATE_CHANGE:       return "Wrong rate change";
+    case BAD_STORM_GUARD:       return "Wrong debounce time or interrupt rate";
+    case BAD_ROLLUP_PERIOD:     return "Wrong rollup period";
+    case BAD_REPORT_POLICY:     return "Wrong report policy";
+    default:                    return "Unknown error";
+    }
+}
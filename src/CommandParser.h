@@ -0,0 +1,106 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+#include "ImpulseSource.h"
+#include "Rollup.h"
+#include "ReportPolicy.h"
+
+// Split a text into tokens without copying or allocating memory.
+class Tokenizer
+{
+public:
+	Tokenizer(std::string_view text, char delim) : _rest(text), _delim(delim), _end(text.empty()) {}
+
+	// Get the next token. Returns false if there is no more token.
+	bool next(std::string_view& token)
+	{
+		if (_end)
+		{
+			return false;
+		}
+		size_t pos = _rest.find(_delim);
+		if (pos == std::string_view::npos)
+		{
+			token = _rest;
+			_rest = std::string_view();
+			_end = true;
+		}
+		else
+		{
+			token = _rest.substr(0, pos);
+			_rest.remove_prefix(pos + 1);
+		}
+		return true;
+	}
+
+private:
+	std::string_view _rest;											// The text after the last token
+	char _delim;													// The separator of the tokens
+	bool _end;														// True, if the last token was returned
+};
+
+// The configuration of a counter from a InstallCounter message.
+struct CounterConfig
+{
+	const static size_t MAX_SOURCE_NAME_LEN = 31;
+
+	uint8_t counterId;												// The CounterId, see counterPin()
+	uint32_t timerIntervallInSec;									// The intervall of the collection
+	ImpulseSourceType sourceType;									// The counting backend
+	char sourceName[MAX_SOURCE_NAME_LEN + 1];						// The name of the impulse source, also the MQTT topic
+	ReportPolicy::Config report;									// Which intervalls are published
+};
+
+// Parse and validate the commands which are received over MQTT. No function allocates memory.
+class CommandParser
+{
+public:
+	enum Result
+	{
+		OK,
+		MISSING_FIELD,
+		TOO_MANY_FIELDS,
+		BAD_COUNTER_ID,
+		BAD_SOURCE_NAME,
+		BAD_INTERVALL,
+		BAD_BACKEND,
+		TOO_MANY_COUNTERS,
+		DUPLICATE_COUNTER_ID,
+		BAD_RATE_CHANGE,
+		BAD_STORM_GUARD,
+		BAD_ROLLUP_PERIOD,
+		BAD_REPORT_POLICY
+	};
+
+	// The longest InstallCounter message which parseInstallCounter() accepts, with its line end. All fields have their
+	// max. length: ID, SourceName, intervall, backend, "DEADBAND" with a relative threshold and maxSilence.
+	const static size_t MAX_INSTALL_COUNTER_LEN = 10 + 1 + CounterConfig::MAX_SOURCE_NAME_LEN + 1 + 10 + 1 + 11 + 1 + 8 + 1 + 11 + 1 + 10 + 2;
+
+	// Parse a InstallCounter message: ID, SourceName, intervall and optional the counting backend ("GPIO", "PCNT" or "EXPANDER")
+	// separated by TAB. The counters after the GPIO counters are inputs of the ExpanderBanks and must use "EXPANDER".
+	// After the backend follows optional the report policy: "ALWAYS" (default), "CHANGE" [maxSilence],
+	// "DEADBAND" threshold [maxSilence] with a trailing '%' for a threshold in percent or "HEARTBEAT" maxSilence,
+	// maxSilence in seconds.
+	static Result parseInstallCounter(std::string_view message, CounterConfig& config);
+	// Parse a bulk InstallCounter message with one InstallCounter message per line.
+	// All lines are validated, errorLine is the 1 based number of the first wrong line.
+	static Result parseInstallCounters(std::string_view message, CounterConfig* configs, size_t maxConfigs, size_t& count, size_t& errorLine);
+	// The 1 based line number of the config with the index from parseInstallCounters(), the empty lines are skipped there.
+	static size_t installCounterLine(std::string_view message, size_t index);
+	// Parse a LiveRate message: ID and the change of the rate in percent which is published, 0 to stop, separated by TAB.
+	static Result parseLiveRate(std::string_view message, uint8_t& counterId, uint32_t& changePercent);
+	// Parse a StormGuard message: ID, min. impulse spacing in us and max. interrupts per second separated by TAB.
+	// 0 disables the debouncing or the storm detection.
+	static Result parseStormGuard(std::string_view message, uint8_t& counterId, StormGuard::Config& config);
+	// Parse a Rollup message: ID and up to Rollup::MAX_LEVELS periods in seconds separated by TAB. A period with a
+	// trailing 'R' is published retained. Without period the rollups of the counter are removed.
+	static Result parseRollup(std::string_view message, uint8_t& counterId, Rollup::LevelConfig* levels, size_t& count);
+	// Parse a decimal number without sign.
+	static bool parseUInt(std::string_view text, uint32_t& value);
+	// The description of a result.
+	static const char* resultText(Result result);
+};
+
+#endif
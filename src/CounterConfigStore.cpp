@@ -0,0 +1,61 @@
+#include <string.h>
+#include "CounterConfigStore.h"
+#include "Journal.h"
+
+bool CounterConfigStore::begin(JournalStorage* storage){
+    _storage = storage;
+    _count = 0;
+    _added = 0;
+    _changed = false;
+    _writes = 0;
+    if(_storage == NULL){
+        return false;
+    }
+
+    Header& header = _blob.header;
+    if(!_storage->readData(0, &header, sizeof(header)) || header.magic != MAGIC || header.version != VERSION || header.count > MAX_COUNTERS
+        || !_storage->readData(sizeof(header), _blob.entries, header.count * sizeof(Entry))
+        || header.crc != Journal::crc32(_blob.entries, header.count * sizeof(Entry))){
+        return true;
+    }
+    _count = header.count;
+    _added = _count;
+    return true;
+}
+
+bool CounterConfigStore::add(const Entry& entry){
+    if(_added >= MAX_COUNTERS){
+        return false;
+    }
+    // Compared with the stored entry before it is overwritten, so a unchanged configuration is not written again.
+    if(_added >= _count || memcmp(&_blob.entries[_added], &entry, sizeof(entry)) != 0){
+        _changed = true;
+        _blob.entries[_added] = entry;
+    }
+    _added++;
+    return true;
+}
+
+bool CounterConfigStore::save(){
+    if(_storage == NULL){
+        return false;
+    }
+    if(!_changed && _added == _count){
+        return true;
+    }
+
+    // Header and entries in one write, a interrupted write leaves a wrong CRC.
+    Header& header = _blob.header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.count = _added;
+    header.crc = Journal::crc32(_blob.entries, _added * sizeof(Entry));
+    if(!_storage->writeData(0, &_blob, sizeof(header) + _added * sizeof(Entry))){
+        // _changed stays set, so the next save() writes again.
+        return false;
+    }
+    _count = _added;
+    _changed = false;
+    _writes++;
+    return true;
+}
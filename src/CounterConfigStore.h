@@ -0,0 +1,75 @@
+#ifndef COUNTER_CONFIG_STORE_H
+#define COUNTER_CONFIG_STORE_H
+#include <stdint.h>
+#include <stddef.h>
+#include "CommandParser.h"
+#include "ImpulseMeter.h"
+#include "JournalStorage.h"
+#include "Rollup.h"
+#include "StormGuard.h"
+
+// The installed counters with their backend options, stored as one versioned blob with CRC in the data area of the storage.
+// The MeterNode restores them at boot, so the impulses are counted before the WiFi and the MQTT connection are up.
+// A blob with a other version or a wrong CRC is ignored, then the controller installs the counters like before.
+class CounterConfigStore
+{
+public:
+	// 2: the counters have a report policy, the live rate and the rollup levels.
+	const static uint16_t VERSION = 2;
+
+	// The stored configuration of one counter.
+	struct Entry
+	{
+		CounterConfig counter;										// The parsed InstallCounter line
+		StormGuard::Config stormGuard;								// The debouncing and storm protection of the GPIO backend
+		uint32_t liveRateChangePercent;								// The LiveRate message, 0 if not used
+		uint8_t rollupLevels;										// Number of used rollups
+		Rollup::LevelConfig rollups[Rollup::MAX_LEVELS];			// The levels of the Rollup message
+	};
+
+	//**** user functions
+	// Read the stored counters. Returns false if the storage is NULL, a missing or wrong blob gives no entries.
+	bool begin(JournalStorage* storage);
+	// Start a new configuration, then add() the entries and save() them. The stored entries are overwritten.
+	void clear() { _added = 0; }
+	// Add a entry to the new configuration. The entry is compared byte by byte, so the caller must clear the padding
+	// and the unused chars of the names. Returns false if there are already MAX_COUNTERS entries.
+	bool add(const Entry& entry);
+	// Store the added entries, if they are not equal to the stored entries. Returns false if the write failed.
+	bool save();
+
+	// Number of stored counters.
+	size_t count() const { return _count; }
+	// The stored entry, valid until clear() is called.
+	const Entry& entry(size_t index) const { return _blob.entries[index]; }
+	// Number of written blobs since begin().
+	unsigned long writes() const { return _writes; }
+
+private:
+	const static uint32_t MAGIC = 0x43464743;						// "CGFC"
+
+	struct Header
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t count;
+		uint32_t crc;												// CRC32 of the entries
+	};
+
+	// The header and the entries as they are written, so no copy of the configuration is needed on the stack.
+	struct Blob
+	{
+		Header header;
+		Entry entries[MAX_COUNTERS];
+	};
+	static_assert(offsetof(Blob, entries) == sizeof(Header), "The entries must follow the header");
+
+	JournalStorage* _storage = NULL;
+	Blob _blob;
+	size_t _count = 0;												// The stored entries
+	size_t _added = 0;												// The entries of the new configuration
+	bool _changed = false;											// The added entries are not stored
+	unsigned long _writes = 0;
+};
+
+#endif
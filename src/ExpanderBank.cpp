@@ -0,0 +1,195 @@
+#include <string.h>
+#include "ExpanderBank.h"
+
+ExpanderBank::~ExpanderBank(){
+    end();
+}
+
+bool ExpanderBank::begin(uint8_t index, ExpanderBus* bus, uint8_t device, uint8_t interruptPin){
+    end();
+    if(index >= MAX_BANKS || bus == NULL){
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_banksMutex);
+        if(_banks[index] != NULL || (_interruptPin != 0xFF && _interruptPin != interruptPin)){
+            return false;
+        }
+    }
+
+    // All pins are inputs with interrupt on change against the last level, IODIRA..GPPUB in one burst.
+    const uint8_t config[] = {
+        0xFF, 0xFF,                                 // IODIR
+        0x00, 0x00,                                 // IPOL
+        0xFF, 0xFF,                                 // GPINTEN
+        0x00, 0x00,                                 // DEFVAL
+        0x00, 0x00,                                 // INTCON
+        IOCON_MIRROR | IOCON_ODR, IOCON_MIRROR | IOCON_ODR,
+        0x00, 0x00                                  // GPPU, the inputs have external resistors like the GPIO inputs
+    };
+    uint8_t regs[6];
+    _bus = bus;
+    _device = device;
+    if(!_bus->writeRegisters(_device, REG_IODIRA, config, sizeof(config)) || !_bus->readRegisters(_device, REG_INTFA, regs, sizeof(regs))){
+        return false;
+    }
+    // The read removes a pending interrupt, the levels are the start for the first edges.
+    _levels = regs[4] | regs[5] << 8;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        clear(i);
+    }
+    _reads = 0;
+    _failedReads = 0;
+    _maxReadUs = 0;
+
+    std::lock_guard<std::mutex> lock(_banksMutex);
+    if(!_readTaskCreated){
+        _readTaskCreated = _retryTimer.begin(_onRetryTimer, NULL, "ExpanderRetry") && _readTask.begin(_onReadNotified, NULL, "ExpanderBank");
+        if(!_readTaskCreated){
+            return false;
+        }
+    }
+    _index = index;
+    _banks[_index] = this;
+    if(_interruptPin == 0xFF){
+        _interruptPin = interruptPin;
+        Hal::pinModeInputPullup(_interruptPin);
+        Hal::attachFallingInterrupt(_interruptPin, _onInterrupt);
+    }
+    return true;
+}
+
+void ExpanderBank::end(){
+    if(_index == MAX_BANKS){
+        return;
+    }
+
+    // The read task uses the banks without the banks mutex, so wait until it is done.
+    std::lock_guard<std::mutex> readLock(_readMutex);
+    std::lock_guard<std::mutex> lock(_banksMutex);
+    const uint8_t disabled[] = {0x00, 0x00};
+    _bus->writeRegisters(_device, REG_GPINTENA, disabled, sizeof(disabled));
+    _banks[_index] = NULL;
+    _index = MAX_BANKS;
+    for (uint8_t i = 0; i < MAX_BANKS; i++)
+    {
+        if(_banks[i] != NULL){
+            return;
+        }
+    }
+    Hal::detachInterrupt(_interruptPin);
+    _interruptPin = 0xFF;
+}
+
+bool ExpanderBank::read(){
+    uint8_t regs[6];
+    uint32_t startUs = (uint32_t)Hal::micros();
+    // INTF, INTCAP and GPIO of both ports in one burst, reading INTCAP or GPIO removes the interrupt.
+    if(!_bus->readRegisters(_device, REG_INTFA, regs, sizeof(regs))){
+        _failedReads = _failedReads + 1;
+        return false;
+    }
+    uint32_t nowUs = (uint32_t)Hal::micros();
+    if(nowUs - startUs > _maxReadUs){
+        _maxReadUs = nowUs - startUs;
+    }
+    _reads = _reads + 1;
+
+    uint16_t levels = regs[4] | regs[5] << 8;
+    Edges edges = decode(_levels, regs[0] | regs[1] << 8, regs[2] | regs[3] << 8, levels);
+    _levels = levels;
+    _count(edges.atCapture, nowUs);
+    _count(edges.afterCapture, nowUs);
+    return true;
+}
+
+void ExpanderBank::clear(uint8_t channel){
+    _impulse[channel].store(0, std::memory_order_relaxed);
+    _firstImpulseUs[channel] = 0;
+}
+
+ExpanderBank::Edges ExpanderBank::decode(uint16_t lastLevels, uint16_t flags, uint16_t captured, uint16_t levels){
+    Edges edges;
+    // A flagged channel changed since the last read. It has a rising edge, if it was low or if it is high again
+    // at the capture, also if the impulse already ended at the capture.
+    edges.atCapture = flags & (~lastLevels | captured);
+    // The capture is only valid for the flagged channels, the other channels had their last level.
+    uint16_t reference = (captured & flags) | (lastLevels & ~flags);
+    edges.afterCapture = levels & ~reference;
+    return edges;
+}
+
+ExpanderBank* ExpanderBank::bank(uint8_t index){
+    if(index >= MAX_BANKS){
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(_banksMutex);
+    return _banks[index];
+}
+
+ExpanderBank* ExpanderBank::bankOfPin(uint8_t pin){
+    if(pin < FIRST_PIN || pin >= FIRST_PIN + MAX_BANKS * CHANNELS){
+        return NULL;
+    }
+    return bank((pin - FIRST_PIN) / CHANNELS);
+}
+
+void ExpanderBank::_count(uint16_t edges, uint32_t nowUs){
+    for (; edges != 0; edges &= edges - 1)
+    {
+        int channel = __builtin_ctz(edges);
+        _impulse[channel].fetch_add(1, std::memory_order_relaxed);
+        if(_firstImpulseUs[channel] == 0){
+            // 0 means no impulse, so a impulse at 0 us is stored as 1 us.
+            _firstImpulseUs[channel] = nowUs != 0 ? nowUs : 1;
+        }
+    }
+}
+
+void IRAM_ATTR ExpanderBank::_onInterrupt(){
+    _interrupts = _interrupts + 1;
+    // The bus can´t be used in a ISR, the read task reads the banks.
+    _readTask.notifyFromIsr();
+}
+
+void ExpanderBank::_onReadNotified(void* /*arg*/){
+    std::lock_guard<std::mutex> readLock(_readMutex);
+    ExpanderBank* banks[MAX_BANKS];
+    uint8_t interruptPin;
+    {
+        // The banks can´t be removed while the _readMutex is held, so the bus is read without the banks mutex.
+        std::lock_guard<std::mutex> lock(_banksMutex);
+        memcpy(banks, _banks, sizeof(banks));
+        interruptPin = _interruptPin;
+    }
+
+    bool failed = false;
+    for (uint8_t i = 0; i < MAX_BANKS; i++)
+    {
+        if(banks[i] != NULL && !banks[i]->read()){
+            failed = true;
+        }
+    }
+    // A bank which got a edge after its read holds the line low, so there is no falling edge.
+    if(interruptPin != 0xFF && !Hal::readPin(interruptPin)){
+        if(failed){
+            _retryTimer.start(RETRY_DELAY_US);
+        }else{
+            _readTask.notify();
+        }
+    }
+}
+
+void ExpanderBank::_onRetryTimer(void* /*arg*/){
+    _readTask.notify();
+}
+
+ExpanderBank* ExpanderBank::_banks[ExpanderBank::MAX_BANKS] = {};
+uint8_t ExpanderBank::_interruptPin = 0xFF;
+volatile unsigned long ExpanderBank::_interrupts = 0;
+NotifiedTask ExpanderBank::_readTask;
+OneShotTimer ExpanderBank::_retryTimer;
+bool ExpanderBank::_readTaskCreated = false;
+std::mutex ExpanderBank::_banksMutex;
+std::mutex ExpanderBank::_readMutex;
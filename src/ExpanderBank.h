@@ -0,0 +1,121 @@
+#ifndef EXPANDER_BANK_H
+#define EXPANDER_BANK_H
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include "Hal.h"
+#include "ExpanderBus.h"
+
+// Count the rising edges of the 16 inputs of a MCP23017 (I2C) or MCP23S17 (SPI) I/O expander. The INTA and INTB
+// outputs of every expander are mirrored and open drain, so the expanders of all banks share one interrupt line.
+// A falling edge of the line wakes the read task, which reads the interrupt flags, the captured and the current
+// levels of every bank with one burst of 6 bytes and decodes the rising edges of all 16 inputs at once with bit operations.
+// The ISR only notifies the task, the bus transactions run without the banks mutex, so bank() doesn´t wait for the bus.
+// The channels of the banks get the virtual pins FIRST_PIN + bank * CHANNELS + channel, which are given to the
+// ExpanderImpulseSource. The banks are created at the start and live until the end of the program.
+// A impulse must be longer than the time from the interrupt until the read is done, shorter impulses may be lost.
+class ExpanderBank
+{
+public:
+	const static uint8_t CHANNELS = 16;
+	// The MCP23017 has 8 addresses.
+	const static uint8_t MAX_BANKS = 8;
+	// The virtual pin of the first channel of the first bank, higher than every GPIO pin.
+	const static uint8_t FIRST_PIN = 64;
+	// Read again after this time, if a read failed and the interrupt line is still low.
+	const static int64_t RETRY_DELAY_US = 1000;
+
+	// The registers of the expander with IOCON.BANK = 0, the A and B register of a port follow each other.
+	enum Register : uint8_t
+	{
+		REG_IODIRA = 0x00,
+		REG_GPINTENA = 0x04,
+		REG_IOCON = 0x0A,
+		REG_INTFA = 0x0E,
+		REG_INTCAPA = 0x10,
+		REG_GPIOA = 0x12
+	};
+	// IOCON bits: mirror INTA and INTB, open drain interrupt output.
+	const static uint8_t IOCON_MIRROR = 0x40;
+	const static uint8_t IOCON_ODR = 0x04;
+
+	// The rising edges of the channels between two reads, bit n is channel n.
+	struct Edges
+	{
+		uint16_t atCapture;					// Edges until the expander captured the levels at the interrupt
+		uint16_t afterCapture;				// Edges after the capture until the read
+	};
+
+	//**** ctors / destructor
+	~ExpanderBank();
+
+	//**** user functions
+	// Configure the expander with the device address on the bus and add it as bank with the index. All banks must use
+	// the same interrupt pin. Returns false if the index is used or too large, or if the expander doesn´t answer.
+	bool begin(uint8_t index, ExpanderBus* bus, uint8_t device, uint8_t interruptPin);
+	// Remove the bank, the channels don´t count anymore.
+	void end();
+	// Read the registers and count the rising edges, called by the read task.
+	bool read();
+	// Return the impulses of the channel since the last call of take() or clear().
+	unsigned long take(uint8_t channel) { return _impulse[channel].exchange(0, std::memory_order_relaxed); }
+	// Remove the impulses and the time of the first impulse of the channel.
+	void clear(uint8_t channel);
+	// Hal::micros() of the read with the first impulse of the channel since clear(), 0 if there is none.
+	uint32_t firstImpulseUs(uint8_t channel) const { return _firstImpulseUs[channel]; }
+
+	//**** statistics
+	unsigned long reads() const { return _reads; }
+	unsigned long failedReads() const { return _failedReads; }
+	// The longest read in micro seconds.
+	uint32_t maxReadUs() const { return _maxReadUs; }
+	// Number of falling edges of the shared interrupt line.
+	static unsigned long interrupts() { return _interrupts; }
+
+	//**** helper functions
+	// Decode the rising edges from the levels of the last read and the registers INTF, INTCAP and GPIO.
+	static Edges decode(uint16_t lastLevels, uint16_t flags, uint16_t captured, uint16_t levels);
+	// The virtual pin of a channel, the channels of all banks are counted one after the other.
+	static uint8_t pin(uint16_t channel) { return (uint8_t)(FIRST_PIN + channel); }
+	// The installed bank with the index, NULL if there is none.
+	static ExpanderBank* bank(uint8_t index);
+	// The installed bank of a virtual pin, NULL if the pin has no installed bank.
+	static ExpanderBank* bankOfPin(uint8_t pin);
+	static uint8_t channelOfPin(uint8_t pin) { return (pin - FIRST_PIN) % CHANNELS; }
+
+private:
+	ExpanderBus* _bus = NULL;
+	uint8_t _device = 0;											// The address of the expander on the bus
+	uint8_t _index = MAX_BANKS;										// The index of this bank, MAX_BANKS if not installed
+	uint16_t _levels = 0;											// The levels of the last read, only used by the read task
+	std::atomic<unsigned long> _impulse[CHANNELS] = {};				// Impulses since the last take(), incremented by the read task
+	volatile uint32_t _firstImpulseUs[CHANNELS] = {};				// Only changed by the read task and clear()
+	volatile unsigned long _reads = 0;								// Only changed by the read task
+	volatile unsigned long _failedReads = 0;
+	volatile uint32_t _maxReadUs = 0;
+
+	// Count a edge of every channel with a bit in edges.
+	void _count(uint16_t edges, uint32_t nowUs);
+
+	// Interrupt of the shared interrupt line.
+	static void IRAM_ATTR _onInterrupt();
+	// Read all banks and read again, if the interrupt line is still low. Runs in the read task.
+	static void _onReadNotified(void* arg);
+	// Wake the read task after a failed read.
+	static void _onRetryTimer(void* arg);
+
+	static ExpanderBank* _banks[MAX_BANKS];
+	// The shared interrupt line, 0xFF if no bank is installed.
+	static uint8_t _interruptPin;
+	static volatile unsigned long _interrupts;
+	static NotifiedTask _readTask;
+	static OneShotTimer _retryTimer;
+	static bool _readTaskCreated;
+	// Protect the bank list while a bank is added or removed.
+	static std::mutex _banksMutex;
+	// Held by the read task while it reads the banks, so end() waits until its bank is not used anymore.
+	// Lock it before the _banksMutex.
+	static std::mutex _readMutex;
+};
+
+#endif
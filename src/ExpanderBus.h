@@ -0,0 +1,20 @@
+#ifndef EXPANDER_BUS_H
+#define EXPANDER_BUS_H
+#include <stdint.h>
+#include <stddef.h>
+
+// The bus of the I/O expanders of the ExpanderBank, e.g. I2C for the MCP23017 or SPI for the MCP23S17.
+// The register address increments with every byte, so a burst reads or writes following registers.
+// The functions are called by one task at a time and may block until the transfer is done.
+class ExpanderBus
+{
+public:
+	virtual ~ExpanderBus() {}
+
+	// Write len bytes into the registers of the device starting at reg. Returns false if the device doesn´t answer.
+	virtual bool writeRegisters(uint8_t device, uint8_t reg, const uint8_t* data, size_t len) = 0;
+	// Read len bytes from the registers of the device starting at reg. Returns false if the device doesn´t answer.
+	virtual bool readRegisters(uint8_t device, uint8_t reg, uint8_t* data, size_t len) = 0;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#include "ExpanderImpulseSource.h"
+
+bool ExpanderImpulseSource::begin(uint8_t pin){
+    _bank = ExpanderBank::bankOfPin(pin);
+    if(_bank == NULL){
+        return false;
+    }
+    _channel = ExpanderBank::channelOfPin(pin);
+    _bank->clear(_channel);
+    _endImpulses = 0;
+    return true;
+}
+
+void ExpanderImpulseSource::end(){
+    if(_bank != NULL){
+        _endImpulses += _bank->take(_channel);
+        _bank = NULL;
+    }
+}
+
+unsigned long ExpanderImpulseSource::take(){
+    if(_bank == NULL){
+        unsigned long impulse = _endImpulses;
+        _endImpulses = 0;
+        return impulse;
+    }
+    return _bank->take(_channel);
+}
@@ -0,0 +1,24 @@
+#ifndef EXPANDER_IMPULSE_SOURCE_H
+#define EXPANDER_IMPULSE_SOURCE_H
+#include "ImpulseSource.h"
+#include "ExpanderBank.h"
+
+// Count the rising edges of a channel of a ExpanderBank. The pin is the virtual pin of the channel, see ExpanderBank::pin().
+// The bank reads all channels, so this source only takes the impulses of its channel.
+class ExpanderImpulseSource : public ImpulseSource
+{
+public:
+	//**** ImpulseSource functions
+	bool begin(uint8_t pin) override;
+	void end() override;
+	unsigned long take() override;
+	ImpulseSourceType type() const override { return EXPANDER_SOURCE; }
+	uint32_t firstImpulseUs() const override { return _bank != NULL ? _bank->firstImpulseUs(_channel) : 0; }
+
+private:
+	ExpanderBank* _bank = NULL;										// The bank of the channel, NULL if not installed
+	uint8_t _channel = 0;											// The channel of the bank
+	unsigned long _endImpulses = 0;									// The impulses of the channel at end()
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "GpioImpulseSource.h"
+
+GpioImpulseSource::~GpioImpulseSource(){
+    end();
+}
+
+bool GpioImpulseSource::begin(uint8_t pin){
+    end();
+    _pin = pin;
+    if (!Hal::supportsInterrupt(_pin) || isReserved(_pin)){
+        return false;
+    }
+
+    int slot = _slots.allocate();
+    if(slot == SlotAllocator<MAX_PORT_COUNT>::NO_SLOT){
+        return false;
+    }
+
+    if(!_samplerTimerCreated){
+        _samplerTimerCreated = _samplerTimer.begin(_onSamplerTimer, NULL, "GpioSampler") && _stormTask.begin(_onStormNotified, NULL, "GpioStorm");
+    }
+
+    Hal::pinModeInputPulldown(_pin);
+    _guard.begin(_guard.config());
+    _impulse = 0;
+    _interrupts = 0;
+    _maxIsrCycles = 0;
+    _firstImpulseUs = 0;
+    _slot = slot;
+    _instances[_slot] = this;
+    Hal::attachRisingInterrupt(_pin, _isrCallbacks[_slot]);
+    return true;
+}
+
+void GpioImpulseSource::end(){
+    if(_slot != SlotAllocator<MAX_PORT_COUNT>::NO_SLOT){
+        std::lock_guard<std::mutex> lock(_samplerMutex);
+        Hal::detachInterrupt(_pin);
+        _instances[_slot] = NULL;
+        _slots.release(_slot);
+        _slot = SlotAllocator<MAX_PORT_COUNT>::NO_SLOT;
+    }
+}
+
+unsigned long GpioImpulseSource::take(){
+    return _impulse.exchange(0, std::memory_order_relaxed);
+}
+
+bool GpioImpulseSource::enableTimestamps(bool enable){
+    _timestampsEnabled.store(enable, std::memory_order_relaxed);
+    return true;
+}
+
+bool GpioImpulseSource::setStormGuard(const StormGuard::Config& config){
+    std::lock_guard<std::mutex> lock(_samplerMutex);
+    if(_slot != SlotAllocator<MAX_PORT_COUNT>::NO_SLOT){
+        // Stop the ISR while the guard is changed.
+        Hal::disableInterruptFromIsr(_pin);
+        _guard.begin(config);
+        Hal::enableInterrupt(_pin);
+    }else{
+        _guard.begin(config);
+    }
+    return true;
+}
+
+void IRAM_ATTR GpioImpulseSource::_countImpulse(uint32_t nowUs){
+    _impulse.fetch_add(1, std::memory_order_relaxed);
+    _sequence++;
+    if(_firstImpulseUs == 0){
+        // 0 means no impulse, so a impulse at 0 us is stored as 1 us.
+        _firstImpulseUs = nowUs != 0 ? nowUs : 1;
+    }
+    if(_timestampsEnabled.load(std::memory_order_relaxed)){
+        PulseTimestamp pulse;
+        pulse.timeUs = nowUs;
+        pulse.sequence = _sequence;
+        _timestamps.push(pulse);
+    }
+}
+
+template <size_t SLOT>
+void IRAM_ATTR GpioImpulseSource::_isrExt(){
+    uint32_t startCycles = Hal::cycleCount();
+    GpioImpulseSource* instance = _instances[SLOT];
+    uint32_t nowUs = (uint32_t)Hal::micros();
+    switch (instance->_guard.onInterrupt(nowUs))
+    {
+    case StormGuard::COUNT:
+        instance->_countImpulse(nowUs);
+        break;
+    case StormGuard::STORM:
+        Hal::disableInterruptFromIsr(instance->_pin);
+        _stormTask.notifyFromIsr();
+        break;
+    default:
+        break;
+    }
+
+    instance->_interrupts = instance->_interrupts + 1;
+    uint32_t cycles = Hal::cycleCount() - startCycles;
+    if(cycles > instance->_maxIsrCycles){
+        instance->_maxIsrCycles = cycles;
+    }
+}
+
+void GpioImpulseSource::_onSamplerTimer(void* /*arg*/){
+    bool sampling = false;
+    {
+        std::lock_guard<std::mutex> lock(_samplerMutex);
+        uint32_t nowUs = (uint32_t)Hal::micros();
+        for (int i = 0; i < MAX_PORT_COUNT; i++)
+        {
+            GpioImpulseSource* instance = _instances[i];
+            if(instance == NULL || !instance->_guard.isSampling()){
+                continue;
+            }
+
+            if(instance->_guard.onSample(Hal::readPin(instance->_pin), nowUs)){
+                instance->_countImpulse(nowUs);
+            }
+            if(instance->_guard.canRearm(nowUs)){
+                Hal::enableInterrupt(instance->_pin);
+            }else{
+                sampling = true;
+            }
+        }
+    }
+
+    if(sampling){
+        _samplerTimer.start(StormGuard::SAMPLE_PERIOD_US);
+    }
+}
+
+void GpioImpulseSource::_onStormNotified(void* /*arg*/){
+    _samplerTimer.start(StormGuard::SAMPLE_PERIOD_US);
+}
+
+template <size_t... SLOTS>
+constexpr std::array<Hal::callback_isr_t, sizeof...(SLOTS)> GpioImpulseSource::_makeIsrCallbacks(std::index_sequence<SLOTS...>){
+    return {{ &GpioImpulseSource::_isrExt<SLOTS>... }};
+}
+
+GpioImpulseSource * GpioImpulseSource::_instances[GpioImpulseSource::MAX_PORT_COUNT] = {};
+const std::array<Hal::callback_isr_t, GpioImpulseSource::MAX_PORT_COUNT> GpioImpulseSource::_isrCallbacks = _makeIsrCallbacks(std::make_index_sequence<GpioImpulseSource::MAX_PORT_COUNT>());
+SlotAllocator<GpioImpulseSource::MAX_PORT_COUNT> GpioImpulseSource::_slots;
+OneShotTimer GpioImpulseSource::_samplerTimer;
+NotifiedTask GpioImpulseSource::_stormTask;
+bool GpioImpulseSource::_samplerTimerCreated = false;
+std::mutex GpioImpulseSource::_samplerMutex;
@@ -0,0 +1,83 @@
+#ifndef GPIO_IMPULSE_SOURCE_H
+#define GPIO_IMPULSE_SOURCE_H
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include "Hal.h"
+#include "ImpulseSource.h"
+#include "SlotAllocator.h"
+#include "SpscQueue.h"
+
+// Count the rising edges of a GPIO pin with a CPU interrupt. The StormGuard debounces the impulses and
+// switches to sampling the pin with a timer, if the interrupt fires too often.
+class GpioImpulseSource : public ImpulseSource
+{
+public:
+	//**** ctors / destructor
+	~GpioImpulseSource();
+
+	//**** ImpulseSource functions
+	bool begin(uint8_t pin) override;
+	void end() override;
+	unsigned long take() override;
+	ImpulseSourceType type() const override { return GPIO_INTERRUPT_SOURCE; }
+	bool enableTimestamps(bool enable) override;
+	bool takeTimestamp(PulseTimestamp& pulse) override { return _timestamps.pop(pulse); }
+	bool setStormGuard(const StormGuard::Config& config) override;
+	const StormGuard* stormGuard() const override { return &_guard; }
+	unsigned long interrupts() const override { return _interrupts; }
+	uint32_t maxIsrCycles() const override { return _maxIsrCycles; }
+	uint32_t firstImpulseUs() const override { return _firstImpulseUs; }
+
+private:
+	const static int MAX_PORT_COUNT = 30;
+	// Time stamps which can wait for takeTimestamp(), must be a power of two. If the queue is full, the time stamps are lost.
+	const static size_t TIMESTAMP_QUEUE_SIZE = 32;
+
+	uint8_t _pin;													// Pin from wich the impulses will be get from.
+	int _slot = SlotAllocator<MAX_PORT_COUNT>::NO_SLOT;				// The ISR slot of this instance, NO_SLOT if the ISR is not enabled
+    std::atomic<unsigned long> _impulse{0};	    					// Impulse recived since begin() or the last take(), only incremented by the ISR
+	std::atomic<bool> _timestampsEnabled{false};					// True, if the ISR stores the time stamps
+	uint32_t _sequence = 0;											// Number of the last impulse, only changed by the ISR
+	SpscQueue<PulseTimestamp, TIMESTAMP_QUEUE_SIZE> _timestamps;	// Filled by the ISR, emptied by takeTimestamp()
+	StormGuard _guard;												// Used by the ISR or the sampler timer
+	volatile unsigned long _interrupts = 0;							// Only changed by the ISR
+	volatile uint32_t _maxIsrCycles = 0;							// Only changed by the ISR
+	volatile uint32_t _firstImpulseUs = 0;							// Only changed by the ISR
+
+	// Count a impulse, called by the ISR or the sampler timer.
+	void IRAM_ATTR _countImpulse(uint32_t nowUs);
+
+	// ISR function can´t be a member function, therfor use this static extended functions.
+	// There is one instantiation for every slot, it calls the instance of the slot without any check,
+	// because the slot is only released after the interrupt is detached.
+	template <size_t SLOT>
+	static void _isrExt();
+	// Create the table with the static extended ISR functions.
+	template <size_t... SLOTS>
+	static constexpr std::array<Hal::callback_isr_t, sizeof...(SLOTS)> _makeIsrCallbacks(std::index_sequence<SLOTS...>);
+
+	// A array with the installed instances of this class which is called by the static extended ISR function.
+	static GpioImpulseSource * _instances[MAX_PORT_COUNT];
+	// A array with the static extended ISR functions.
+	static const std::array<Hal::callback_isr_t, MAX_PORT_COUNT> _isrCallbacks;
+	// The free slots of _instances.
+	static SlotAllocator<MAX_PORT_COUNT> _slots;
+
+	//**** sampler timer functions
+	// Sample the pins of the instances with a interrupt storm and enable their interrupt again, when the storm is over.
+	static void _onSamplerTimer(void* arg);
+	// Start the sampler timer after a ISR detected a storm, the timer can´t be started in the ISR.
+	static void _onStormNotified(void* arg);
+	// The one shot timer which samples the pins, it runs only while a instance samples.
+	static OneShotTimer _samplerTimer;
+	// Notified by the ISR to start the sampler timer.
+	static NotifiedTask _stormTask;
+	// True, if the sampler timer and the storm task are created.
+	static bool _samplerTimerCreated;
+	// Protect the instances against the sampler timer while a instance is removed.
+	static std::mutex _samplerMutex;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef HAL_H
+#define HAL_H
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Thin hardware abstraction layer for the parts of the ESP32 which are used by the counting and publishing code.
+// The ESP32 implementation is in esp32/HalEsp32.cpp, the Linux implementation for the native build is in native/HalLinux.cpp.
+
+#ifdef ARDUINO
+#include <esp_attr.h>
+#else
+#define IRAM_ATTR
+#endif
+
+class Hal
+{
+public:
+    typedef void(*callback_isr_t)();
+
+	//**** GPIO / interrupt functions
+	// Configure the pin as input with pull down.
+	static void pinModeInputPulldown(uint8_t pin);
+	// Configure the pin as input with pull up, e.g. for a open drain interrupt line.
+	static void pinModeInputPullup(uint8_t pin);
+	// Check if the GPIO supports a interrupt
+	static bool supportsInterrupt(uint8_t pin);
+	// Call the ISR on every rising edge of the pin.
+	static void attachRisingInterrupt(uint8_t pin, callback_isr_t isr);
+	// Call the ISR on every falling edge of the pin.
+	static void attachFallingInterrupt(uint8_t pin, callback_isr_t isr);
+	// Remove the ISR of the pin.
+	static void detachInterrupt(uint8_t pin);
+	// Disable the interrupt of the pin, but keep the ISR. Can be called from the ISR.
+	static void IRAM_ATTR disableInterruptFromIsr(uint8_t pin);
+	// Enable the interrupt again after disableInterruptFromIsr().
+	static void enableInterrupt(uint8_t pin);
+	// Read the level of the pin.
+	static bool readPin(uint8_t pin);
+
+	//**** clock functions
+	// Milli seconds since boot.
+	static unsigned long millis();
+	// Micro seconds since boot. Can be called from a ISR.
+	static int64_t IRAM_ATTR micros();
+	// The current time in UTC.
+	static time_t utcTime();
+	// The current time in UTC in ms since 1970.
+	static int64_t utcTimeMs();
+	// The current time in UTC in micro seconds since 1970.
+	static int64_t utcTimeUs();
+	// The cycle counter of the CPU, e.g. to measure the duration of a ISR. The native build counts nano seconds.
+	static uint32_t IRAM_ATTR cycleCount();
+	// The boot time in UTC.
+	static time_t bootTime();
+
+	//**** serial functions
+	// Write the buffer and a line end to the serial console.
+	static void serialWriteLine(const char* buff, size_t len);
+
+	//**** event functions
+	// Wake up the task which waits in waitForEvent(). Can be called from any task, but not from a ISR.
+	static void notifyEvent();
+	// Sleep until notifyEvent() is called or the timeout in ms elapsed. Only the main task may wait.
+	static void waitForEvent(unsigned long timeoutMs);
+
+	//**** system functions
+	static void restart();
+	// Free heap in bytes and the largest block which can be allocated, 0 if not known.
+	static size_t freeHeap();
+	static size_t largestFreeBlock();
+
+#ifndef ARDUINO
+	//**** simulation functions, only available in the native build
+	// Simulate the level of the pin, calls the attached ISR if the level rises or falls like the edge of the ISR
+	// and the interrupt is enabled.
+	static void simulatePinLevel(uint8_t pin, bool level);
+	// Replace the clock by a simulated clock which starts at utcTime and only moves with advanceClock().
+	// Must be called before any timer is created, e.g. for a replay of recorded impulses far faster than real time.
+	static void simulateClock(time_t utcTime);
+	// Move the simulated clock to untilUs micro seconds since boot. The due timers are called in the order of their
+	// deadlines by the calling thread, the clock is set to the deadline of each timer before its callback.
+	static void advanceClock(int64_t untilUs);
+	// Move the simulated clock forward by the time of a blocking call, e.g. a bus transfer inside a timer callback.
+	// The due timers are not called, they follow with the next advanceClock().
+	static void spendTime(int64_t us);
+	// Set the simulated UTC time forward or backward by deltaSec like a NTP update, the time since boot is not changed.
+	static void stepUtcTime(int64_t deltaSec);
+#endif
+};
+
+// A one shot timer which calls the callback in a task, not in a ISR.
+class OneShotTimer
+{
+public:
+	typedef void(*callback_timer_t)(void* arg);
+
+	//**** ctors / destructor
+	~OneShotTimer();
+
+	//**** user functions
+	// Create the timer. Returns false if the timer can´t be created.
+	bool begin(callback_timer_t callback, void* arg, const char* name);
+	// Start or restart the timer, the callback is called after the delay. Must not be called from a ISR,
+	// a ISR can start the timer with a NotifiedTask.
+	void start(int64_t delayUs);
+	// Stop the timer.
+	void stop();
+
+private:
+	void* _handle = NULL;											// The platform specific timer
+};
+
+// A task which calls the callback after every notification, e.g. to move work out of a ISR. Notifications which
+// arrive while the callback runs are merged into one more call. The native build calls the callback like a timer
+// with a delay of 0, so it also runs deterministic on the simulated clock.
+class NotifiedTask
+{
+public:
+	typedef void(*callback_task_t)(void* arg);
+
+	//**** ctors / destructor
+	~NotifiedTask();
+
+	//**** user functions
+	// Create the task. Returns false if the task can´t be created.
+	bool begin(callback_task_t callback, void* arg, const char* name);
+	// Wake up the task from a ISR.
+	void IRAM_ATTR notifyFromIsr();
+	// Wake up the task from a other task.
+	void notify();
+
+private:
+	void* _handle = NULL;											// The platform specific task
+};
+
+#endif
@@ -1,202 +1,356 @@
+#include <string.h>
 #include "ImpulseMeter.h"
 
 ImpulseMeter::~ImpulseMeter(){
-    _disableInterrupt();
+    std::lock_guard<std::mutex> lock(_metersMutex);
+    if(_source != NULL && _meters[_counterId] == this){
+        _meters[_counterId] = NULL;
+    }
+    _removeSource();
 }
 
 
-void ImpulseMeter::begin(uint8_t counterId, unsigned int timerIntervallInSec, char const sourceName[], callback_timerIntervallElapsed_t callbackTimerIntervallElapsed, Logger* logger){
+void ImpulseMeter::begin(uint8_t counterId, unsigned int timerIntervallInSec, char const sourceName[], ImpulseSourceType sourceType, callback_timerIntervallElapsed_t callbackTimerIntervallElapsed, Logger* logger){
+    ImpulseSource* source = NULL;
+    // A other CounterId has a other pin, so it needs a new source too.
+    if(_source == NULL || _source->type() != sourceType || counterId != _counterId){
+        source = ImpulseSource::create(sourceType);
+        if(source == NULL){
+            logger->printError("CounterId: %02d; The counting backend is not available. Source: %s\n", counterId, sourceName);
+        }
+    }
+    begin(counterId, timerIntervallInSec, sourceName, source, callbackTimerIntervallElapsed, logger);
+}
+
+void ImpulseMeter::begin(uint8_t counterId, unsigned int timerIntervallInSec, char const sourceName[], ImpulseSource* source, callback_timerIntervallElapsed_t callbackTimerIntervallElapsed, Logger* logger){
     _logger = logger;
-    if(counterId >= 0 && counterId <= MAX_COUNTERS){
-        _timerIntervallInSec = timerIntervallInSec;
-        _sourceName = sourceName;
+    if(counterId < MAX_COUNTERS){
+        strncpy(_sourceName, sourceName, MAX_SOURCE_NAME_LEN);
+        _sourceName[MAX_SOURCE_NAME_LEN] = 0;
         _callbackTimerIntervallElapsed = callbackTimerIntervallElapsed;
 
-        if(_isrInstalled == false){
-            _pulses_pin = gpioPins[counterId];
-            pinMode(_pulses_pin, INPUT_PULLDOWN);
-            _calcFirstCallbackTime();
-            _enableInterrupt();
+        if(source != NULL && source != _source){
+            {
+                std::lock_guard<std::mutex> lock(_metersMutex);
+                if(_source == NULL){
+                    _counterId = counterId;
+                    _pulses_pin = counterPin(counterId);
+                    _timerIntervallInSec = _roundIntervall(timerIntervallInSec);
+                    int64_t nowUs = Hal::micros();
+                    _clock.update(nowUs, Hal::utcTimeUs());
+                    _calcFirstCallbackTime(nowUs);
+                }
+                else{
+                    // Keep the impulses of the old source for the current intervall. It is stopped before, so no
+                    // impulse is counted after take().
+                    _source->end();
+                    _carriedImpulses += _source->take();
+                    _removeSource();
+                    if(counterId != _counterId){
+                        if(_meters[_counterId] == this){
+                            _meters[_counterId] = NULL;
+                        }
+                        _counterId = counterId;
+                        _pulses_pin = counterPin(counterId);
+                    }
+                    _setIntervall(timerIntervallInSec);
+                }
+
+                _source = source;
+                if(!_source->begin(_pulses_pin)){
+                    _removeSource();
+                }
+                _meters[_counterId] = _source != NULL ? this : NULL;
+            }
+            _startIntervallTimer();
         }
-    #ifdef IMPULSE_METER_DEBUG    
-        if(_isrInstalled){
-            _logger->printMessage("Pin: %02d; Source: %s; Intervall in sec: %d; NextCallbackTime: %s\n", _pulses_pin, _sourceName.c_str(), _timerIntervallInSec, FormatTime(_nextCallbackTime));
+        else if(_source != NULL){
+            bool changed;
+            {
+                // The intervall timer task reads the intervall and the deadline.
+                std::lock_guard<std::mutex> lock(_metersMutex);
+                changed = _setIntervall(timerIntervallInSec);
+            }
+            if(changed){
+                _startIntervallTimer();
+            }
         }
-        else
+        if(LOGGER_MIN_LEVEL <= LOG_LEVEL_DEBUG && _source != NULL){
+            time_t nextCallbackTime;
+            {
+                // The intervall timer task may already close the first intervall.
+                std::lock_guard<std::mutex> lock(_metersMutex);
+                nextCallbackTime = _nextCallbackTime;
+            }
+            char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+            LOGGER_DEBUG(_logger, "Pin: %02d; Source: %s; Intervall in sec: %d; NextCallbackTime: %s\n", _pulses_pin, _sourceName, _timerIntervallInSec, IsoTimeFormatter::render(nextCallbackTime, timeBuff));
+        }
+        if(_source == NULL)
         {
-            _logger->printError("Pin: %02d is not supported. Source: %s\n", _pulses_pin, _sourceName.c_str());
+            _logger->printError("Pin: %02d is not supported. Source: %s\n", _pulses_pin, _sourceName);
         }
-    #endif
     }
     else{
-        _logger->printError("CounterId: %02d is not supported. Source: %s\n", counterId, _sourceName.c_str());
+        _logger->printError("CounterId: %02d is not supported. Source: %s\n", counterId, sourceName);
+        delete source;
     }
 }
 
-void ImpulseMeter::update(){
-    while (!_impulseQueue.empty()) {
-        ImpulseContainer container = _impulseQueue.front();
-        _impulseQueue.pop();
-
-        if(_callbackTimerIntervallElapsed != NULL){
-            ImpulseMeterStatus impulseMeterStatus;
-            impulseMeterStatus.impulse = container.impulse;
-            impulseMeterStatus.sourceName = _sourceName.c_str();
-            impulseMeterStatus.utcTime = container.utcTime;
-            impulseMeterStatus.timerIntervallInSec = _timerIntervallInSec;
-            _callbackTimerIntervallElapsed(impulseMeterStatus);
+size_t ImpulseMeter::update(){
+    unsigned long overflows = _impulseQueue.overflows();
+    if(overflows != _reportedOverflows){
+        _logger->printError("Pin: %02d; Source: %s; %lu intervalls lost, queue is full\n", _pulses_pin, _sourceName, overflows - _reportedOverflows);
+        _reportedOverflows = overflows;
+    }
+
+    size_t closed = 0;
+    ImpulseContainer container;
+    while (_impulseQueue.pop(container)) {
+        if(container.utcTime == 0 && !_clock.isAnchored()){
+            // Keep it until the UTC time is known, if there is no space the last intervall gets longer.
+            if(_unanchoredCount < MAX_UNANCHORED_INTERVALLS){
+                _unanchored[_unanchoredCount++] = container;
+            }else{
+                _unanchored[_unanchoredCount - 1].impulse += container.impulse;
+                _unanchored[_unanchoredCount - 1].monotonicEndUs = container.monotonicEndUs;
+            }
+            continue;
         }
+        closed += _deliverUnanchored();
+        _deliver(container);
+        closed++;
+    }
+    if(_clock.isAnchored()){
+        closed += _deliverUnanchored();
+    }
+    return closed;
+}
+
+size_t ImpulseMeter::_deliverUnanchored(){
+    size_t count = _unanchoredCount;
+    for (size_t i = 0; i < count; i++)
+    {
+        _deliver(_unanchored[i]);
+    }
+    _unanchoredCount = 0;
+    return count;
+}
+
+void ImpulseMeter::_deliver(const ImpulseContainer& container){
+    if(_callbackTimerIntervallElapsed == NULL){
+        return;
+    }
+
+    ImpulseMeterStatus impulseMeterStatus;
+    impulseMeterStatus.impulse = container.impulse;
+    impulseMeterStatus.sourceName = _sourceName;
+    impulseMeterStatus.utcTime = container.utcTime;
+    if(impulseMeterStatus.utcTime == 0){
+        // Closed before the UTC time was known, the end gets the UTC time now.
+        impulseMeterStatus.utcTime = (time_t)((_clock.toUtcUs(container.monotonicEndUs) + 500000) / 1000000);
+        _restampedIntervalls++;
     }
+    impulseMeterStatus.timerIntervallInSec = _timerIntervallInSec;
+    impulseMeterStatus.counterId = _counterId;
+    impulseMeterStatus.monotonicEndUs = container.monotonicEndUs;
+    _callbackTimerIntervallElapsed(impulseMeterStatus);
 }
 
-void ImpulseMeter::_calcFirstCallbackTime(){
-    time_t utcTime = DateTime.getTime();
-#ifdef IMPULSE_METER_DEBUG    
-    _logger->printMessage("Current UTC time: %s\n",FormatTime(utcTime));
-#endif
-   	struct tm* startTime = gmtime(&utcTime);
-    if (_timerIntervallInSec < 10)
+unsigned int ImpulseMeter::_roundIntervall(unsigned int timerIntervallInSec){
+    if (timerIntervallInSec < 10)
 	{
 		// Ist kleiner als 10 Sekunden dann minimum 10 Sekunden einstellen
-		_timerIntervallInSec = 10;
-		startTime->tm_sec /= 10;
-		startTime->tm_sec *= 10;
+		timerIntervallInSec = 10;
 	}
-	else if (_timerIntervallInSec < 60)
+	else if (timerIntervallInSec < 60)
 	{
 		// Ist kleiner als 1 Minunte, dann auf 10 Sekunden runden
-		if (_timerIntervallInSec % 10 > 0)
+		if (timerIntervallInSec % 10 > 0)
 		{
-			_timerIntervallInSec /= 10;
-			_timerIntervallInSec *= 10; // Auf 10 sekunden schritte runden
+			timerIntervallInSec /= 10;
+			timerIntervallInSec *= 10; // Auf 10 sekunden schritte runden
 		}
-		startTime->tm_sec = startTime->tm_sec / _timerIntervallInSec * _timerIntervallInSec;
 	}
-	else
+	else if (timerIntervallInSec % 60 > 0)
 	{
-		// Groesser als 60 Sekunden
-		if (_timerIntervallInSec % 60 > 0)
-		{
-			// Ist groesser als 1 Minunte, dann auf 60 Sekunden runden.
-			_timerIntervallInSec /= 60;
-			_timerIntervallInSec *= 60;
-		}
-		startTime->tm_sec = 0;
-		startTime->tm_min = startTime->tm_min / 10 * 10;
+		// Ist groesser als 1 Minunte, dann auf 60 Sekunden runden.
+		timerIntervallInSec /= 60;
+		timerIntervallInSec *= 60;
 	}
+    return timerIntervallInSec;
+}
+
+bool ImpulseMeter::_setIntervall(unsigned int timerIntervallInSec){
+    timerIntervallInSec = _roundIntervall(timerIntervallInSec);
+    if(timerIntervallInSec == _timerIntervallInSec){
+        return false;
+    }
+    // The counted impulses stay in the current intervall, which ends at the next end of the new grid.
+    _timerIntervallInSec = timerIntervallInSec;
+    _calcFirstCallbackTime(Hal::micros());
+    return true;
+}
+
+void ImpulseMeter::_calcFirstCallbackTime(int64_t nowUs){
+    if (!_clock.isAnchored())
+    {
+        // The intervalls are timed by the monotonic clock until the UTC time is set, they get their end time later.
+        _nextCallbackTime = 0;
+        _nextCallbackUs = nowUs + (int64_t)_timerIntervallInSec * 1000000;
+        LOGGER_DEBUG(_logger, "Pin: %02d; Wait for the time to align the intervalls\n", _pulses_pin);
+        return;
+    }
+
+    time_t utcTime = (time_t)(_clock.toUtcUs(nowUs) / 1000000);
+    char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+    LOGGER_DEBUG(_logger, "Current UTC time: %s\n",IsoTimeFormatter::render(utcTime, timeBuff));
+    // The start of the intervall in seconds since 1970, the UTC time has no leap seconds.
+    time_t startTime;
+    if (_timerIntervallInSec == 10)
+    {
+        startTime = utcTime - utcTime % 10;
+    }
+    else if (_timerIntervallInSec < 60)
+    {
+        startTime = utcTime - utcTime % 60 + utcTime % 60 / _timerIntervallInSec * _timerIntervallInSec;
+    }
+    else
+    {
+		// Auf 10 Minuten abrunden
+		startTime = utcTime - utcTime % 600;
+    }
 
-   	_nextCallbackTime = mktime(startTime) + _timerIntervallInSec;
-#ifdef IMPULSE_METER_DEBUG    
-    _logger->printMessage("Pin: %02d; First Callback Time: %s\n",_pulses_pin, FormatTime(_nextCallbackTime));
-#endif
+   	_nextCallbackTime = startTime + _timerIntervallInSec;
+    if (_nextCallbackTime <= utcTime)
+    {
+        // The intervall is shorter than the rounding to 10 minutes, so take the next end on the same grid.
+        _nextCallbackTime += ((utcTime - _nextCallbackTime) / _timerIntervallInSec + 1) * _timerIntervallInSec;
+    }
+    _nextCallbackUs = _clock.toMonotonicUs((int64_t)_nextCallbackTime * 1000000);
+    LOGGER_DEBUG(_logger, "Pin: %02d; First Callback Time: %s\n",_pulses_pin, IsoTimeFormatter::render(_nextCallbackTime, timeBuff));
 }
 
-void ImpulseMeter::_calcNextCallbackTime()
+void ImpulseMeter::_calcNextCallbackTime(int64_t nowUs)
 {
-	time_t dif = DateTime.getTime() - _nextCallbackTime;
-	if(dif > _timerIntervallInSec)
+    int64_t intervallUs = (int64_t)_timerIntervallInSec * 1000000;
+	int64_t difUs = nowUs - _nextCallbackUs;
+	int64_t skipped = 0;
+	if(difUs > intervallUs)
 	{
-		_nextCallbackTime = _nextCallbackTime + dif / _timerIntervallInSec * _timerIntervallInSec + _timerIntervallInSec;
+		skipped = difUs / intervallUs;
+		_skippedIntervalls.fetch_add((unsigned long)skipped, std::memory_order_relaxed);
 	}
-    else
+
+    if(_nextCallbackTime == 0)
     {
-    	_nextCallbackTime = _nextCallbackTime + _timerIntervallInSec;
+        _nextCallbackUs += (skipped + 1) * intervallUs;
+        LOGGER_DEBUG(_logger, "Pin: %02d; Next callback in %lld ms\n",_pulses_pin, (long long)((_nextCallbackUs - nowUs) / 1000));
+        return;
     }
 
-#ifdef IMPULSE_METER_DEBUG    
-    _logger->printMessage("Pin: %02d; Next callback time: %s\n",_pulses_pin, FormatTime(_nextCallbackTime));
-#endif
+    _nextCallbackTime = _nextCallbackTime + (time_t)(skipped + 1) * _timerIntervallInSec;
+    time_t utcTime = (time_t)(_clock.toUtcUs(nowUs) / 1000000);
+    if(utcTime >= _nextCallbackTime)
+    {
+        // The UTC time jumped forward over the next end, so the next intervall ends at the next end of the grid.
+        // After a jump back the next end stays, the intervall is longer and the end times never repeat.
+        time_t phase = _nextCallbackTime % _timerIntervallInSec;
+        _nextCallbackTime = utcTime - (utcTime - phase) % _timerIntervallInSec + _timerIntervallInSec;
+    }
+    _nextCallbackUs = _clock.toMonotonicUs((int64_t)_nextCallbackTime * 1000000);
+
+    char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+    LOGGER_DEBUG(_logger, "Pin: %02d; Next callback time: %s\n",_pulses_pin, IsoTimeFormatter::render(_nextCallbackTime, timeBuff));
+}
+
+void ImpulseMeter::_removeSource(){
+    if(_source != NULL){
+        _source->end();
+        delete _source;
+        _source = NULL;
+    }
 }
 
-void ImpulseMeter::_isrCallback(){
-    if(DateTime.getTime() > _nextCallbackTime){
-        _calcNextCallbackTime();
-        ImpulseContainer container;
-        container.impulse = _impulse;
-        container.utcTime = _nextCallbackTime;
-        _impulseQueue.push(container);
-        _impulse = 0;
+void ImpulseMeter::_closeIntervall(int64_t nowUs){
+    if(nowUs - _nextCallbackUs >= 1000000){
+        _lateIntervalls.fetch_add(1, std::memory_order_relaxed);
     }
 
-    _impulse++;
+    ImpulseContainer container;
+    container.impulse = _source->take() + _carriedImpulses;
+    container.utcTime = _nextCallbackTime;
+    container.monotonicEndUs = _nextCallbackUs;
+    _carriedImpulses = 0;
+    _impulseQueue.push(container);
+    _calcNextCallbackTime(nowUs);
 }
 
-bool ImpulseMeter::_supportsInterrupt()
-{
-    return (digitalPinToInterrupt(_pulses_pin) != NOT_AN_INTERRUPT);
+void ImpulseMeter::onIntervallClosed(callback_intervallClosed_t callback, void* arg){
+    _intervallClosedArg.store(arg);
+    _intervallClosedCallback.store(callback);
 }
 
-void ImpulseMeter::_enableInterrupt()
-{
-    _isrInstalled = false;
+void ImpulseMeter::_onIntervallTimer(void* /*arg*/){
+    bool closed = false;
+    {
+        std::lock_guard<std::mutex> lock(_metersMutex);
+        // Use the same time for all instances, so all intervalls with the same end time are closed together.
+        int64_t nowUs = Hal::micros();
+        _clock.update(nowUs, Hal::utcTimeUs());
+        for (uint8_t i = 0; i < MAX_COUNTERS; i++)
+        {
+            ImpulseMeter* meter = _meters[i];
+            if(meter == NULL){
+                continue;
+            }
+            if(meter->_nextCallbackTime == 0 && _clock.isAnchored()){
+                // The open intervall ends at the first end on the grid of the UTC time.
+                meter->_calcFirstCallbackTime(nowUs);
+            }
+            if(nowUs >= meter->_nextCallbackUs){
+                meter->_closeIntervall(nowUs);
+                closed = true;
+            }
+        }
+    }
 
-    if (!_supportsInterrupt()){
-#ifdef IMPULSE_METER_DEBUG 
-    _logger->printMessage("PIN %d is not supported\n", _pulses_pin);
-#endif       
-        return;        
+    callback_intervallClosed_t callback = _intervallClosedCallback.load();
+    if(closed && callback != NULL){
+        callback(_intervallClosedArg.load());
     }
+    _startIntervallTimer();
+}
 
-    for (uint8_t i = 0; i < MAX_PORT_COUNT; i++)
-    {
-        if(_instances[i] == NULL){
-            _instances[i] = this;
-            attachInterrupt(digitalPinToInterrupt(_pulses_pin), _isrCallbacks[i], RISING);
-            #ifdef IMPULSE_METER_DEBUG 
-                _logger->printMessage("PIN %d is installed to instance %d\n", _pulses_pin, i);
-            #endif       
-            _isrInstalled = true;
-            break;
+void ImpulseMeter::_startIntervallTimer(){
+    std::lock_guard<std::mutex> lock(_metersMutex);
+    if(_intervallTimerCreated == false){
+        _intervallTimerCreated = _intervallTimer.begin(_onIntervallTimer, NULL, "ImpulseMeter");
+        if(_intervallTimerCreated == false){
+            return;
         }
     }
 
-#ifdef IMPULSE_METER_DEBUG 
-    if(_isrInstalled == false) _logger->printMessage("PIN %d is not setup because there is no free ISR function\n", _pulses_pin);
-#endif       
-
-}
+    // The clocks are compared at least every MAX_TIMER_DELAY_US.
+    int64_t nowUs = Hal::micros();
+    int64_t delayUs = MAX_TIMER_DELAY_US;
+    for (uint8_t i = 0; i < MAX_COUNTERS; i++)
+    {
+        ImpulseMeter* meter = _meters[i];
+        if(meter != NULL){
+            int64_t meterDelayUs = meter->_nextCallbackUs - nowUs;
+            if(meterDelayUs < delayUs){
+                delayUs = meterDelayUs;
+            }
+        }
+    }
 
-void ImpulseMeter::_disableInterrupt()
-{
-    detachInterrupt(digitalPinToInterrupt(_pulses_pin));
-    _isrInstalled = false;
+    _intervallTimer.start(delayUs);
 }
 
-#define ISR_CALLBACK(x) if (ImpulseMeter::_instances [x] != NULL) ImpulseMeter::_instances [x]->_isrCallback();
-
-ImpulseMeter * ImpulseMeter::_instances[ImpulseMeter::MAX_PORT_COUNT] = {NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL};
-void ImpulseMeter::_isrExt0 () {ISR_CALLBACK(0)} 
-void ImpulseMeter::_isrExt1 () {ISR_CALLBACK(1)}
-void ImpulseMeter::_isrExt2 () {ISR_CALLBACK(2)}
-void ImpulseMeter::_isrExt3 () {ISR_CALLBACK(3)}
-void ImpulseMeter::_isrExt4 () {ISR_CALLBACK(4)}
-void ImpulseMeter::_isrExt5 () {ISR_CALLBACK(5)}
-void ImpulseMeter::_isrExt6 () {ISR_CALLBACK(6)}
-void ImpulseMeter::_isrExt7 () {ISR_CALLBACK(7)}
-void ImpulseMeter::_isrExt8 () {ISR_CALLBACK(8)}
-void ImpulseMeter::_isrExt9 () {ISR_CALLBACK(9)}
-void ImpulseMeter::_isrExt10 () {ISR_CALLBACK(10)}
-void ImpulseMeter::_isrExt11 () {ISR_CALLBACK(11)}
-void ImpulseMeter::_isrExt12 () {ISR_CALLBACK(12)}
-void ImpulseMeter::_isrExt13 () {ISR_CALLBACK(13)}
-void ImpulseMeter::_isrExt14 () {ISR_CALLBACK(14)}
-void ImpulseMeter::_isrExt15 () {ISR_CALLBACK(15)}
-void ImpulseMeter::_isrExt16 () {ISR_CALLBACK(16)}
-void ImpulseMeter::_isrExt17 () {ISR_CALLBACK(17)}
-void ImpulseMeter::_isrExt18 () {ISR_CALLBACK(18)}
-void ImpulseMeter::_isrExt19 () {ISR_CALLBACK(19)}
-void ImpulseMeter::_isrExt20 () {ISR_CALLBACK(20)}
-void ImpulseMeter::_isrExt21 () {ISR_CALLBACK(21)}
-void ImpulseMeter::_isrExt22 () {ISR_CALLBACK(22)}
-void ImpulseMeter::_isrExt23 () {ISR_CALLBACK(23)}
-void ImpulseMeter::_isrExt24 () {ISR_CALLBACK(24)}
-void ImpulseMeter::_isrExt25 () {ISR_CALLBACK(25)}
-void ImpulseMeter::_isrExt26 () {ISR_CALLBACK(26)}
-void ImpulseMeter::_isrExt27 () {ISR_CALLBACK(27)}
-void ImpulseMeter::_isrExt28 () {ISR_CALLBACK(28)}
-void ImpulseMeter::_isrExt29 () {ISR_CALLBACK(29)}
-
-ImpulseMeter::callback_isr_t ImpulseMeter::_isrCallbacks[ImpulseMeter::MAX_PORT_COUNT] 
-    = {ImpulseMeter::_isrExt0, ImpulseMeter::_isrExt1, ImpulseMeter::_isrExt2, ImpulseMeter::_isrExt3, ImpulseMeter::_isrExt4, ImpulseMeter::_isrExt5, ImpulseMeter::_isrExt6, ImpulseMeter::_isrExt7, ImpulseMeter::_isrExt8, ImpulseMeter::_isrExt9
-     , ImpulseMeter::_isrExt10, ImpulseMeter::_isrExt11, ImpulseMeter::_isrExt12, ImpulseMeter::_isrExt13, ImpulseMeter::_isrExt14, ImpulseMeter::_isrExt15, ImpulseMeter::_isrExt16, ImpulseMeter::_isrExt17, ImpulseMeter::_isrExt18, ImpulseMeter::_isrExt19
-     , ImpulseMeter::_isrExt20, ImpulseMeter::_isrExt21, ImpulseMeter::_isrExt22, ImpulseMeter::_isrExt23, ImpulseMeter::_isrExt24, ImpulseMeter::_isrExt25, ImpulseMeter::_isrExt26, ImpulseMeter::_isrExt27, ImpulseMeter::_isrExt28, ImpulseMeter::_isrExt29};
\ No newline at end of file
+OneShotTimer ImpulseMeter::_intervallTimer;
+ClockAnchor ImpulseMeter::_clock;
+bool ImpulseMeter::_intervallTimerCreated = false;
+ImpulseMeter* ImpulseMeter::_meters[MAX_COUNTERS] = {};
+std::mutex ImpulseMeter::_metersMutex;
+std::atomic<ImpulseMeter::callback_intervallClosed_t> ImpulseMeter::_intervallClosedCallback(NULL);
+std::atomic<void*> ImpulseMeter::_intervallClosedArg(NULL);
\ No newline at end of file
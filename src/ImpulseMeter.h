@@ -1,11 +1,14 @@
 #ifndef IMPULSE_METER_H
 #define IMPULSE_METER_H
-#include <Arduino.h>
-#include <queue>
+#include <atomic>
+#include <mutex>
+#include "Hal.h"
 #include <MyDateTime.h>
+#include "ClockAnchor.h"
 #include "Logger.h"
-
-//#define IMPULSE_METER_DEBUG
+#include "SpscQueue.h"
+#include "ImpulseSource.h"
+#include "ExpanderBank.h"
 
 // Status of the impulse meter.
 struct ImpulseMeterStatus
@@ -14,105 +17,162 @@ struct ImpulseMeterStatus
 	unsigned long impulse;				// The collected impulses
 	const char*  sourceName;			// The name of the impulse source
 	unsigned int timerIntervallInSec;	// The intervall of the collection
+	uint8_t counterId;					// The CounterId of the meter, MAX_COUNTERS if not known
+	int64_t monotonicEndUs;				// Hal::micros() at the end of the intervall, 0 if not known
 };
 
+// Number of ExpanderBanks with 16 counters each, e.g. build with -DEXPANDER_BANKS=2. Their counters get the CounterIds
+// after the GPIO counters. MAX_COUNTERS is part of the stored totals and counter configuration, so they start empty
+// after a change of EXPANDER_BANKS.
+#ifndef EXPANDER_BANKS
+#define EXPANDER_BANKS 0
+#endif
+static_assert(EXPANDER_BANKS < ExpanderBank::MAX_BANKS + 1, "EXPANDER_BANKS must be 0..8");
+
 // The mapping of the CounterId to the GPIO Pin. The Index is the CounterID and the value is the GPIO Pin.
-const static int MAX_COUNTERS = 20;
-const static int gpioPins[MAX_COUNTERS] = {2, 12, 5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27, 34, 35, 36, 39};
+const static int MAX_GPIO_COUNTERS = 20;
+const static int MAX_COUNTERS = MAX_GPIO_COUNTERS + EXPANDER_BANKS * ExpanderBank::CHANNELS;
+const static int gpioPins[MAX_GPIO_COUNTERS] = {2, 12, 5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27, 34, 35, 36, 39};
+// The pin of a counter, the counters after the GPIO counters have the virtual pins of the ExpanderBanks.
+inline uint8_t counterPin(uint8_t counterId) { return counterId < MAX_GPIO_COUNTERS ? gpioPins[counterId] : ExpanderBank::pin(counterId - MAX_GPIO_COUNTERS); }
 
 // Collect impulses from a GPIO Pin for a specific time intervall and give the collect impulses and 
 // the end time of the collection back to a callback function. After that starts a new collection of impulses.
+// The intervalls are timed by the monotonic clock, the UTC end times come from the ClockAnchor. Until the UTC time
+// is known, the intervalls are closed on the monotonic clock and kept, update() gives them with the UTC time of their
+// end to the callback when the clock is anchored. A step of the UTC time doesn´t change the length of the intervall
+// which is open. After a step forward the next intervall ends at the next intervall boundary, after a step back the next
+// intervall lasts until the UTC time reaches its end, so the end times never repeat.
 class ImpulseMeter
 {
 public:
 	typedef void(*callback_timerIntervallElapsed_t)(ImpulseMeterStatus impulseMeterStatus);
+	typedef void(*callback_intervallClosed_t)(void* arg);
+	// A longer source name is cut, it is stored in the instance.
+	const static size_t MAX_SOURCE_NAME_LEN = 31;
 
 	//**** ctors / destructor
     ~ImpulseMeter();
 
 	//**** user functions
-	// Setup the instance
-	void begin(uint8_t counterId, unsigned int timerIntervallInSec, char const sourceName[], callback_timerIntervallElapsed_t callbackTimerIntervallElapsed, Logger* logger);
-	// Check if the  callback function should be called and if necessary call it with the collected impules.
-	// update should be called in the loop() function of main.c													
-	void update();													
+	// Setup the instance. The impulses are counted by a source of the given type.
+	// If the instance is already installed with a other source type, the source is replaced.
+	void begin(uint8_t counterId, unsigned int timerIntervallInSec, char const sourceName[], ImpulseSourceType sourceType, callback_timerIntervallElapsed_t callbackTimerIntervallElapsed, Logger* logger);
+	// Setup the instance with a source which is created by the caller, e.g. a channel of a ImpulseMeterBank.
+	// The instance takes the ownership of the source. If source is NULL, the current source is kept.
+	void begin(uint8_t counterId, unsigned int timerIntervallInSec, char const sourceName[], ImpulseSource* source, callback_timerIntervallElapsed_t callbackTimerIntervallElapsed, Logger* logger);
+	// Call the callback function for every closed intervall with the collected impules.
+	// The intervalls are closed by a timer at the intervall boundary, also if no impulse was received.
+	// update should be called in the loop() function of main.c. Returns the number of closed intervalls.
+	size_t update();
+	// True, if the impulses are counted.
+	bool isInstalled() const { return _source != NULL; }													
+	// The name of the impulse source, also the MQTT topic.
+	const char* sourceName() const { return _sourceName; }
+	// Store the time stamp of every impulse. Returns false if the source can´t do this.
+	bool enableTimestamps(bool enable) { return _source != NULL && _source->enableTimestamps(enable); }
+	// Take the oldest time stamp. Returns false if there is no time stamp.
+	bool takeTimestamp(PulseTimestamp& pulse) { return _source != NULL && _source->takeTimestamp(pulse); }
+	// Set the debouncing and the interrupt storm protection. Returns false if the source has no interrupt.
+	bool setStormGuard(const StormGuard::Config& config) { return _source != NULL && _source->setStormGuard(config); }
+	// The interrupt storm protection, NULL if the source has no interrupt.
+	const StormGuard* stormGuard() const { return _source != NULL ? _source->stormGuard() : NULL; }
+	// The GPIO pin of the counter.
+	uint8_t pin() const { return _pulses_pin; }
+	// The intervall after the rounding to 10 seconds or to minutes.
+	unsigned int timerIntervallInSec() const { return _timerIntervallInSec; }
+	// The source which counts the impulses, NULL if not installed.
+	const ImpulseSource* source() const { return _source; }
+
+	//**** metrics
+	// The max. number of closed intervalls which waited for update().
+	size_t queueHighWater() const { return _impulseQueue.highWater(); }
+	// Number of closed intervalls which are lost, because the queue was full.
+	unsigned long queueOverflows() const { return _impulseQueue.overflows(); }
+	// Number of intervalls which are closed one second or more after their end.
+	unsigned long lateIntervalls() const { return _lateIntervalls.load(std::memory_order_relaxed); }
+	// Number of intervalls which are skipped, because the timer was too late.
+	unsigned long skippedIntervalls() const { return _skippedIntervalls.load(std::memory_order_relaxed); }
+	// Number of intervalls which are closed before the UTC time was known and got their UTC end time later.
+	unsigned long restampedIntervalls() const { return _restampedIntervalls; }
+	// The mapping of the monotonic clock to UTC, which is used by all instances.
+	static const ClockAnchor& clock() { return _clock; }
+	// The callback is called by the intervall timer task after intervalls are closed, so update() can be called without polling.
+	// It must not block and must not call functions of the ImpulseMeter.
+	static void onIntervallClosed(callback_intervallClosed_t callback, void* arg);
 
 private:
-	const static int MAX_PORT_COUNT = 30;
-    typedef void(*callback_isr_t)();
+	// Number of closed intervalls which can wait for the update() call. Must be a power of two.
+	const static size_t IMPULSE_QUEUE_SIZE = 16;
+	// Intervalls which can wait for the UTC time. If more are closed, the last one is extended.
+	const static size_t MAX_UNANCHORED_INTERVALLS = 32;
 	// Store the impulses and time of a given time intervall.
 	struct ImpulseContainer
 	{
-		time_t utcTime;						// The end time in UTC of the collected impulses
+		time_t utcTime;						// The end time in UTC of the collected impulses, 0 if the UTC time was not known
 		unsigned long impulse;				// The collected impulses
+		int64_t monotonicEndUs;				// The end time on the monotonic clock
 	};
 
+	uint8_t _counterId;												// The CounterId of this instance
 	uint8_t _pulses_pin;											// Pin from wich the impulses will be get from.
-    bool _isrInstalled;                                             // True, if the ISR is enabled
-    volatile unsigned long _impulse;		    					// Impulse recived since start or last call of the timer intervall elapsed callback function
-	time_t _nextCallbackTime;										// Time to call the timer intervall elapsed callback
+	ImpulseSource* _source = NULL;										// Count the impulses of the pin, NULL if not installed
+	unsigned long _carriedImpulses = 0;								// Impulses of a replaced source for the current intervall
+	time_t _nextCallbackTime;										// Time to call the timer intervall elapsed callback, 0 if the UTC time is not known
+	int64_t _nextCallbackUs;										// The same time on the monotonic clock
     unsigned int _timerIntervallInSec;                              // The intervall to call the timer intervall elapsed callback function
-    String _sourceName;                                             // The name of this impulse source
-	std::queue<ImpulseContainer> _impulseQueue;
+    char _sourceName[MAX_SOURCE_NAME_LEN + 1];                      // The name of this impulse source, the pointer of the status
+	SpscQueue<ImpulseContainer, IMPULSE_QUEUE_SIZE> _impulseQueue;	// Filled by the intervall timer, emptied by update()
+	unsigned long _reportedOverflows = 0;							// Queue overflows which are already logged
+	std::atomic<unsigned long> _lateIntervalls{0};					// Only changed by the intervall timer
+	std::atomic<unsigned long> _skippedIntervalls{0};				// Only changed by the intervall timer
+	ImpulseContainer _unanchored[MAX_UNANCHORED_INTERVALLS];		// Closed intervalls which wait for the UTC time, only used by update()
+	size_t _unanchoredCount = 0;
+	unsigned long _restampedIntervalls = 0;
 
 	Logger* _logger;
 
 	//functions
-	// Check if the GPIO supports a interrupt
-	bool _supportsInterrupt();
-	// Calculate the next callback time with the current time and the timer intervall.
-	void _calcNextCallbackTime();
-	// Calculate the first callback time with the current time and the timer intervall.
-	void _calcFirstCallbackTime();
+	// Remove the source and stop counting.
+	void _removeSource();
+	// Calculate the next callback time with the monotonic time and the timer intervall.
+	void _calcNextCallbackTime(int64_t nowUs);
+	// Calculate the first callback time with the monotonic time and the timer intervall.
+	void _calcFirstCallbackTime(int64_t nowUs);
+	// Round the intervall to the grid of the callback times: min. 10 seconds, 10 second steps below a minute, else full minutes.
+	static unsigned int _roundIntervall(unsigned int timerIntervallInSec);
+	// Set a new intervall of a counting meter and calculate its next callback time. Returns false if the rounded
+	// intervall is not changed. Call it with the locked _metersMutex.
+	bool _setIntervall(unsigned int timerIntervallInSec);
+	// Take the impulses of the current intervall and put them with the intervall end time into the queue.
+	void _closeIntervall(int64_t nowUs);
+	// Give a closed intervall to the callback function.
+	void _deliver(const ImpulseContainer& container);
+	size_t _deliverUnanchored();
 
-	//**** interrupt functions
-	// Enable interrupt if pin allow it
-	void _enableInterrupt();
-	// Disable interrupt
-	void _disableInterrupt();
-
-	// Callback for the ISR.
-    void _isrCallback();
     // Callback of the client of this instance.
     callback_timerIntervallElapsed_t _callbackTimerIntervallElapsed;
 
-	// ISR function can´t be a member function, therfor use this static extended functions.
-	// The static extended ISR functions.
-	static void _isrExt0();
-	static void _isrExt1();
-	static void _isrExt2();
-	static void _isrExt3();
-	static void _isrExt4();
-	static void _isrExt5();
-	static void _isrExt6();
-	static void _isrExt7();
-	static void _isrExt8();
-	static void _isrExt9();
-	static void _isrExt10();
-	static void _isrExt11();
-	static void _isrExt12();
-	static void _isrExt13();
-	static void _isrExt14();
-	static void _isrExt15();
-	static void _isrExt16();
-	static void _isrExt17();
-	static void _isrExt18();
-	static void _isrExt19();
-	static void _isrExt20();
-	static void _isrExt21();
-	static void _isrExt22();
-	static void _isrExt23();
-	static void _isrExt24();
-	static void _isrExt25();
-	static void _isrExt26();
-	static void _isrExt27();
-	static void _isrExt28();
-	static void _isrExt29();
-
-	// A array with the installed instances of this class which is called by the static extended ISR function.
-	static ImpulseMeter * _instances[MAX_PORT_COUNT];
-	// A array with the static extended ISR functions.
-	static callback_isr_t _isrCallbacks[MAX_PORT_COUNT];
+	//**** intervall timer functions
+	// Callback of the intervall timer. Close the intervalls of all instances which ends at or before the current time.
+	static void _onIntervallTimer(void* arg);
+	// Start the intervall timer so that it fires at the next intervall end of all instances.
+	static void _startIntervallTimer();
+	// The longest time in micro seconds the timer sleeps, so a changed system time is detected in time.
+	const static int64_t MAX_TIMER_DELAY_US = 1000000;
+	// Map the monotonic clock to UTC, only updated by the intervall timer or with _metersMutex.
+	static ClockAnchor _clock;
+	// The one shot timer which closes the intervalls.
+	static OneShotTimer _intervallTimer;
+	// True, if the intervall timer is created.
+	static bool _intervallTimerCreated;
+	// The installed instances, the index is the CounterId.
+	static ImpulseMeter* _meters[MAX_COUNTERS];
+	// Protect _meters and the sources against the intervall timer while a instance is changed.
+	static std::mutex _metersMutex;
+	// Called after intervalls are closed, NULL if not used.
+	static std::atomic<callback_intervallClosed_t> _intervallClosedCallback;
+	static std::atomic<void*> _intervallClosedArg;
 };
 
 #endif 
\ No newline at end of file
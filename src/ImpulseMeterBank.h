@@ -0,0 +1,77 @@
+#ifndef IMPULSE_METER_BANK_H
+#define IMPULSE_METER_BANK_H
+#include <array>
+#include <atomic>
+#include <utility>
+#include "Hal.h"
+#include "ImpulseSource.h"
+
+// Count the rising edges of a fixed set of GPIO pins. The pins are given at compile time, so every pin has its own
+// ISR which increments the counter of its channel directly, without a instance pointer or a slot table.
+// Use it for installations where the pins never change, e.g.:
+//   typedef ImpulseMeterBank<2, 12, 5> MyBank;
+//   impulseMeter->begin(0, 60, "Power", MyBank::createSource(0), callback, &logger);
+template <uint8_t... PINS>
+class ImpulseMeterBank
+{
+public:
+	const static size_t SIZE = sizeof...(PINS);
+
+	// Create a source for one channel of the bank. The pin of the channel must be given to begin() of the source.
+	static ImpulseSource* createSource(size_t channel) { return channel < SIZE ? new Channel(channel) : NULL; }
+	// The pin of a channel.
+	static uint8_t pin(size_t channel) { return PIN_TABLE[channel]; }
+
+private:
+	// The ImpulseSource of one channel.
+	class Channel : public ImpulseSource
+	{
+	public:
+		explicit Channel(size_t channel) : _channel(channel) {}
+		~Channel() { end(); }
+
+		bool begin(uint8_t pin) override
+		{
+			end();
+			if (pin != PIN_TABLE[_channel] || !Hal::supportsInterrupt(pin) || isReserved(pin))
+			{
+				return false;
+			}
+			Hal::pinModeInputPulldown(pin);
+			_impulse[_channel] = 0;
+			Hal::attachRisingInterrupt(pin, _makeIsrs(std::make_index_sequence<SIZE>())[_channel]);
+			_installed = true;
+			return true;
+		}
+
+		void end() override
+		{
+			if (_installed)
+			{
+				Hal::detachInterrupt(PIN_TABLE[_channel]);
+				_installed = false;
+			}
+		}
+
+		unsigned long take() override { return _impulse[_channel].exchange(0, std::memory_order_relaxed); }
+		ImpulseSourceType type() const override { return BANK_SOURCE; }
+
+	private:
+		const size_t _channel;										// The channel of the bank
+		bool _installed = false;									// True, if the ISR is attached
+	};
+
+	// The ISR of a channel.
+	template <size_t CHANNEL>
+	static void IRAM_ATTR _isr() { _impulse[CHANNEL].fetch_add(1, std::memory_order_relaxed); }
+
+	// Create the table with the ISR of every channel.
+	template <size_t... CHANNELS>
+	static constexpr std::array<Hal::callback_isr_t, SIZE> _makeIsrs(std::index_sequence<CHANNELS...>) { return {{ &_isr<CHANNELS>... }}; }
+
+	static constexpr uint8_t PIN_TABLE[SIZE] = {PINS...};
+	// Impulse recived since begin() or the last take() of every channel, only incremented by the ISRs.
+	inline static std::atomic<unsigned long> _impulse[SIZE] = {};
+};
+
+#endif
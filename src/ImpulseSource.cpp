@@ -0,0 +1,45 @@
+#include <string.h>
+#include "ImpulseSource.h"
+#include "GpioImpulseSource.h"
+#include "ExpanderImpulseSource.h"
+#ifdef ARDUINO
+#include "PcntImpulseSource.h"
+#endif
+
+ImpulseSource* ImpulseSource::create(ImpulseSourceType type){
+    switch (type)
+    {
+    case PCNT_SOURCE:
+#ifdef ARDUINO
+        return new PcntImpulseSource();
+#else
+        // The native build has no PCNT hardware.
+        return NULL;
+#endif
+    case GPIO_INTERRUPT_SOURCE:
+        return new GpioImpulseSource();
+    case EXPANDER_SOURCE:
+        return new ExpanderImpulseSource();
+    default:
+        // A ImpulseMeterBank source must be created by the bank.
+        return NULL;
+    }
+}
+
+std::atomic<uint64_t> ImpulseSource::_reservedPins{0};
+
+bool ImpulseSource::typeFromName(const char* name, ImpulseSourceType& type){
+    if(strcmp(name, "GPIO") == 0){
+        type = GPIO_INTERRUPT_SOURCE;
+        return true;
+    }
+    if(strcmp(name, "PCNT") == 0){
+        type = PCNT_SOURCE;
+        return true;
+    }
+    if(strcmp(name, "EXPANDER") == 0){
+        type = EXPANDER_SOURCE;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef IMPULSE_SOURCE_H
+#define IMPULSE_SOURCE_H
+#include <stdint.h>
+#include <atomic>
+#include "StormGuard.h"
+
+// The available ways to count the impulses of a GPIO pin.
+enum ImpulseSourceType
+{
+	GPIO_INTERRUPT_SOURCE,		// Count every rising edge with a CPU interrupt
+	PCNT_SOURCE,				// Count the rising edges with the pulse counter hardware (PCNT) of the ESP32
+	BANK_SOURCE,				// Count with a channel of a ImpulseMeterBank, the pins are fixed at compile time
+	EXPANDER_SOURCE				// Count with a channel of a ExpanderBank, a input of a I/O expander
+};
+
+// The time stamp of a impulse.
+struct PulseTimestamp
+{
+	uint32_t timeUs;					// Hal::micros() when the impulse was counted, wraps around after 71 minutes
+	uint32_t sequence;					// Number of the impulse, so lost time stamps can be detected
+};
+
+// Count the impulses of one GPIO pin. The ImpulseMeter takes the counted impulses at the end of every intervall.
+class ImpulseSource
+{
+public:
+	virtual ~ImpulseSource(){}
+
+	// Start to count the impulses of the pin. Returns false if the pin can´t be used by this source.
+	virtual bool begin(uint8_t pin) = 0;
+	// Stop counting. The impulses counted before are kept for the next take().
+	virtual void end() = 0;
+	// Return the impulses since begin() or the last call of take(), also after end().
+	virtual unsigned long take() = 0;
+	// The type of this source.
+	virtual ImpulseSourceType type() const = 0;
+	// Store the time stamp of every impulse. Returns false if the source can´t do this.
+	virtual bool enableTimestamps(bool /*enable*/) { return false; }
+	// Take the oldest time stamp. Returns false if there is no time stamp.
+	virtual bool takeTimestamp(PulseTimestamp& /*pulse*/) { return false; }
+	// Set the debouncing and the interrupt storm protection. Returns false if the source has no interrupt.
+	virtual bool setStormGuard(const StormGuard::Config& /*config*/) { return false; }
+	// The interrupt storm protection, NULL if the source has no interrupt.
+	virtual const StormGuard* stormGuard() const { return NULL; }
+	// Number of interrupts since begin(), also the ignored ones. 0 if the source has no interrupt.
+	virtual unsigned long interrupts() const { return 0; }
+	// The longest run of the ISR in CPU cycles.
+	virtual uint32_t maxIsrCycles() const { return 0; }
+	// Hal::micros() of the first counted impulse since begin(), 0 if there is none or the source doesn´t know it.
+	virtual uint32_t firstImpulseUs() const { return 0; }
+
+	// Create a new source of the given type. Returns NULL if the type is not available.
+	static ImpulseSource* create(ImpulseSourceType type);
+	// Get the type by name ("GPIO", "PCNT" or "EXPANDER"). Returns false if the name is unknown.
+	static bool typeFromName(const char* name, ImpulseSourceType& type);
+	// Reserve a GPIO pin for a other use, e.g. the bus of the ExpanderBanks, so no source can count it.
+	static void reservePin(uint8_t pin) { if (pin < 64) _reservedPins.fetch_or(1ULL << pin, std::memory_order_relaxed); }
+	static bool isReserved(uint8_t pin) { return pin < 64 && (_reservedPins.load(std::memory_order_relaxed) & (1ULL << pin)) != 0; }
+
+private:
+	// Bit n is GPIO pin n.
+	static std::atomic<uint64_t> _reservedPins;
+};
+
+#endif
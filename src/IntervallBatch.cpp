@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include <MyDateTime.h>
+#include "IntervallBatch.h"
+#include "Hal.h"
+
+void IntervallBatch::begin(MqttPort* mqttClient, const char* topic, size_t maxPayloadSize, unsigned long flushDeadlineMs, Metrics* metrics){
+    flush();
+    _mqttClient = mqttClient;
+    _metrics = metrics;
+    strncpy(_topic, topic, MqttPort::MAX_TOPIC_LEN);
+    _topic[MqttPort::MAX_TOPIC_LEN] = 0;
+    _maxPayloadSize = maxPayloadSize < MAX_PAYLOAD_SIZE ? maxPayloadSize : MAX_PAYLOAD_SIZE;
+    _flushDeadlineMs = flushDeadlineMs;
+}
+
+void IntervallBatch::setPacked(bool packed){
+    flush();
+    _packed = packed;
+}
+
+void IntervallBatch::add(const ImpulseMeterStatus& status){
+    if(_records > 0 && status.utcTime != _utcTime){
+        flush();
+    }
+
+    if(_packed){
+        if(_records > 0 && !_encoder.fits(status, _maxPayloadSize - 1)){
+            flush();
+        }
+        if(_records == 0){
+            _utcTime = status.utcTime;
+            _firstRecordTime = Hal::millis();
+            _encoder.begin(PackedEncoder::TYPE_INTERVALLS, _utcTime);
+        }
+        if(_encoder.addIntervall(status)){
+            _records++;
+        }
+        return;
+    }
+
+    char line[MAX_LINE_SIZE];
+    int lineLen = _formatLine(status, line, sizeof(line));
+    if(lineLen < 0){
+        return;
+    }
+
+    if(_records > 0 && _payloadLen + lineLen >= _maxPayloadSize){
+        flush();
+    }
+
+    if(_records == 0){
+        _utcTime = status.utcTime;
+        _firstRecordTime = Hal::millis();
+        _timeFormatter.format(_utcTime, _payload);
+        _payloadLen = strlen(_payload);
+    }
+
+    // The first record is always added, the buffer has space for it also if maxPayloadSize is smaller.
+    if(_records == 0 || _payloadLen + lineLen < _maxPayloadSize){
+        memcpy(_payload + _payloadLen, line, lineLen + 1);
+        _payloadLen += lineLen;
+        _records++;
+    }
+}
+
+bool IntervallBatch::isDue() const{
+    return _records > 0 && Hal::millis() - _firstRecordTime >= _flushDeadlineMs;
+}
+
+bool IntervallBatch::flush(){
+    bool published = true;
+    if(_records > 0){
+        if(_packed){
+            _encoder.encode(_payload, sizeof(_payload));
+        }
+        published = _mqttClient != NULL && _mqttClient->publish(_topic, _payload, false);
+        if(_metrics != NULL){
+            _metrics->recordPublish(published, _utcTime);
+        }
+    }
+    _records = 0;
+    _payloadLen = 0;
+    return published;
+}
+
+bool IntervallBatch::fits(const ImpulseMeterStatus& status) const{
+    if(_records == 0){
+        return true;
+    }
+    if(_packed){
+        return status.utcTime == _utcTime && _encoder.fits(status, _maxPayloadSize - 1);
+    }
+    char line[MAX_LINE_SIZE];
+    int lineLen = _formatLine(status, line, sizeof(line));
+    return status.utcTime == _utcTime && lineLen >= 0 && _payloadLen + lineLen < _maxPayloadSize;
+}
+
+int IntervallBatch::_formatLine(const ImpulseMeterStatus& status, char* line, size_t size){
+    int lineLen = snprintf(line, size, "\n%s\t%u\t%lu", status.sourceName, status.timerIntervallInSec, status.impulse);
+    if(lineLen < 0 || (size_t)lineLen >= size){
+        return -1;
+    }
+    return lineLen;
+}
@@ -0,0 +1,61 @@
+#ifndef INTERVALL_BATCH_H
+#define INTERVALL_BATCH_H
+#include "ImpulseMeter.h"
+#include "MqttPort.h"
+#include "IsoTimeFormatter.h"
+#include "Metrics.h"
+#include "PackedFormat.h"
+
+// Collect the closed intervalls of all counters which end at the same time and publish them in one MQTT message.
+// The payload has the end time in the first line and one line per counter:
+//   2021-01-01T10:00:00Z
+//   <SourceName>\t<intervall in sec>\t<impulses>
+//   ...
+// With the packed encoding the payload is a TYPE_INTERVALLS message of the PackedEncoder with the end time as base time.
+class IntervallBatch
+{
+public:
+	// The largest payload which can be configured.
+	const static size_t MAX_PAYLOAD_SIZE = 1024;
+
+	//**** user functions
+	// Setup the batch, a longer topic than MqttPort::MAX_TOPIC_LEN is cut.
+	// The batch is published to the topic when a record with a other end time is added,
+	// when the payload would exceed maxPayloadSize or when flushDeadlineMs are elapsed since the first record was added.
+	// Every publish is counted in metrics, if it is not NULL.
+	void begin(MqttPort* mqttClient, const char* topic, size_t maxPayloadSize, unsigned long flushDeadlineMs, Metrics* metrics = NULL);
+	// Select the packed encoding or the text. The records in the batch are published before.
+	void setPacked(bool packed);
+	// Add the record of a closed intervall.
+	void add(const ImpulseMeterStatus& status);
+	// True if the batch has records and its flush deadline is reached, the caller publishes it with flush().
+	bool isDue() const;
+	// Publish the batch now. Returns false if the publish failed, the batch is cleared anyway.
+	bool flush();
+	// Check if the record can be added without publishing the batch before.
+	bool fits(const ImpulseMeterStatus& status) const;
+	// Number of records in the batch.
+	size_t records() const { return _records; }
+
+private:
+	MqttPort* _mqttClient = NULL;
+	Metrics* _metrics = NULL;
+	char _topic[MqttPort::MAX_TOPIC_LEN + 1] = "";					// The topic of the batches
+	size_t _maxPayloadSize = MAX_PAYLOAD_SIZE;						// Publish before the payload gets larger
+	unsigned long _flushDeadlineMs = 0;								// Publish this time after the first record was added
+	char _payload[MAX_PAYLOAD_SIZE];								// The payload of the batch
+	size_t _payloadLen = 0;											// Used bytes of _payload
+	size_t _records = 0;											// Number of records in _payload
+	time_t _utcTime = 0;											// The end time of the records in the batch
+	unsigned long _firstRecordTime = 0;								// Time in ms of the first record in the batch
+	IsoTimeFormatter _timeFormatter;								// Format the end time of the batches
+	bool _packed = false;											// Encode the batch with _encoder instead of the text in _payload
+	PackedEncoder _encoder;											// The packed batch
+
+	// Format the line of a record. Returns the length of the line or -1 if the record is too long.
+	static int _formatLine(const ImpulseMeterStatus& status, char* line, size_t size);
+	// The longest line of a record.
+	const static size_t MAX_LINE_SIZE = 80;
+};
+
+#endif
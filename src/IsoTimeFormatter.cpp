@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <string.h>
+#include "IsoTimeFormatter.h"
+
+// Write value with the given number of digits, e.g. 7 with 2 digits is "07".
+static void writeDigits(char* buff, unsigned int value, int digits){
+    for (int i = digits - 1; i >= 0; i--)
+    {
+        buff[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+char* IsoTimeFormatter::format(time_t utcTime, char* buff){
+    int64_t time = utcTime;
+    if(time < _hourStart || time >= _hourStart + 3600){
+        _hourStart = _renderPrefix(time, _prefix);
+    }
+    memcpy(buff, _prefix, PREFIX_LEN);
+    _renderMinutes(time - _hourStart, buff + PREFIX_LEN);
+    return buff;
+}
+
+char* IsoTimeFormatter::render(time_t utcTime, char* buff){
+    int64_t hourStart = _renderPrefix(utcTime, buff);
+    _renderMinutes((int64_t)utcTime - hourStart, buff + PREFIX_LEN);
+    return buff;
+}
+
+int64_t IsoTimeFormatter::_renderPrefix(int64_t utcTime, char* prefix){
+    int64_t days = utcTime / 86400;
+    int64_t secondsOfDay = utcTime % 86400;
+    if(secondsOfDay < 0){
+        secondsOfDay += 86400;
+        days--;
+    }
+    int hour = secondsOfDay / 3600;
+
+    // Convert the days since 1970-01-01 into year, month and day (proleptic gregorian calendar).
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned int dayOfEra = z - era * 146097;
+    unsigned int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned int monthIndex = (5 * dayOfYear + 2) / 153;
+    unsigned int day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    unsigned int month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    if(year >= 0 && year <= 9999){
+        writeDigits(prefix, year, 4);
+    }else{
+        // Not representable with 4 digits.
+        memcpy(prefix, "????", 4);
+    }
+    prefix[4] = '-';
+    writeDigits(prefix + 5, month, 2);
+    prefix[7] = '-';
+    writeDigits(prefix + 8, day, 2);
+    prefix[10] = 'T';
+    writeDigits(prefix + 11, hour, 2);
+    prefix[13] = ':';
+    return utcTime - (secondsOfDay % 3600);
+}
+
+void IsoTimeFormatter::_renderMinutes(int64_t secondsOfHour, char* buff){
+    writeDigits(buff, secondsOfHour / 60, 2);
+    buff[2] = ':';
+    writeDigits(buff + 3, secondsOfHour % 60, 2);
+    buff[5] = 'Z';
+    buff[6] = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef ISO_TIME_FORMATTER_H
+#define ISO_TIME_FORMATTER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Format a UTC time as ISO 8601 ("2021-01-31T23:59:50Z") into a buffer of the caller, without heap and without gmtime.
+// format() keeps the date and hour of the last call, so for times in the same hour only minutes and seconds are written.
+// A instance must not be used by different tasks at the same time, render() can be used from everywhere.
+class IsoTimeFormatter
+{
+public:
+	// Size of the buffer for one time, including the terminating 0.
+	const static size_t BUFFER_SIZE = 21;
+
+	// Format the time into buff with the cached date and hour. Returns buff.
+	char* format(time_t utcTime, char* buff);
+	// Format the time into buff without cache. Returns buff.
+	static char* render(time_t utcTime, char* buff);
+
+private:
+	const static size_t PREFIX_LEN = 14;							// "YYYY-MM-DDTHH:"
+	int64_t _hourStart = INT64_MIN;									// Start of the cached hour in seconds since 1970
+	char _prefix[PREFIX_LEN];										// The cached date and hour
+
+	// Write the date and hour of the time into prefix, returns the start of the hour.
+	static int64_t _renderPrefix(int64_t utcTime, char* prefix);
+	// Write minutes and seconds of the hour and the 'Z'.
+	static void _renderMinutes(int64_t secondsOfHour, char* buff);
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <stddef.h>
+#include <string.h>
+#include "Journal.h"
+#include "Hal.h"
+
+static_assert(sizeof(Journal::Record) == 64, "The records of the journal have 64 bytes");
+
+bool Journal::begin(SegmentStorage* storage){
+    _storage = storage;
+    _headSeq = 1;
+    _ackSeq = 1;
+    _lost = 0;
+    _unsynced = false;
+    if(_storage == NULL){
+        return false;
+    }
+    _segments = _storage->segments();
+    _recordsPerSegment = _storage->segmentSize() / sizeof(Record);
+    if(_segments < 2 || _recordsPerSegment == 0){
+        _storage = NULL;
+        return false;
+    }
+
+    // The segment with the newest first record has the head, its records follow without a gap.
+    uint32_t newestSeq = 0;
+    Record record;
+    for (uint32_t segment = 0; segment < _segments; segment++)
+    {
+        if(_storage->read(segment, 0, &record, sizeof(Record)) && record.seq != 0 && _segment(record.seq) == segment
+            && _offset(record.seq) == 0 && record.crc == _recordCrc(record) && record.seq > newestSeq){
+            newestSeq = record.seq;
+        }
+    }
+    if(newestSeq != 0){
+        _headSeq = newestSeq + 1;
+        while (_offset(_headSeq) != 0 && _readRecord(_headSeq, record))
+        {
+            _headSeq++;
+        }
+        // The segments before the newest one have the older records, the first segment which doesn´t fit ends the ring.
+        _ackSeq = newestSeq;
+        for (uint32_t i = 1; i < _segments && _ackSeq > _recordsPerSegment && _readRecord(_ackSeq - _recordsPerSegment, record); i++)
+        {
+            _ackSeq -= _recordsPerSegment;
+        }
+    }
+
+    Cursor cursor;
+    if(_storage->readCursor(&cursor, sizeof(cursor)) && cursor.magic == CURSOR_MAGIC && cursor.crc == crc32(&cursor, offsetof(Cursor, crc))){
+        if(cursor.ackSeq > _ackSeq && cursor.ackSeq <= _headSeq){
+            _ackSeq = cursor.ackSeq;
+        }
+    }
+    _storedAckSeq = _ackSeq;
+    _cursorStoreTime = Hal::millis();
+    _syncTime = _cursorStoreTime;
+    return true;
+}
+
+bool Journal::append(const ImpulseMeterStatus& status){
+    if(_storage == NULL){
+        return false;
+    }
+
+    if(_offset(_headSeq) == 0){
+        // The oldest segment gets the next records.
+        if(!_storage->clearSegment(_segment(_headSeq))){
+            return false;
+        }
+        _dropOverwritten();
+    }
+
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.seq = _headSeq;
+    record.utcTime = status.utcTime;
+    record.impulse = status.impulse;
+    record.timerIntervallInSec = status.timerIntervallInSec;
+    record.counterId = status.counterId < MAX_COUNTERS ? status.counterId : MAX_COUNTERS;
+    strncpy(record.sourceName, status.sourceName, sizeof(record.sourceName) - 1);
+    record.crc = _recordCrc(record);
+
+    if(!_storage->write(_segment(_headSeq), _offset(_headSeq), &record, sizeof(Record))){
+        return false;
+    }
+    _headSeq++;
+    _unsynced = true;
+    return true;
+}
+
+bool Journal::read(uint32_t seq, Record& record){
+    if(_storage == NULL || seq < _ackSeq || seq >= _headSeq){
+        return false;
+    }
+    return _readRecord(seq, record);
+}
+
+void Journal::ack(uint32_t seq){
+    if(seq > _ackSeq && seq <= _headSeq){
+        _ackSeq = seq;
+    }
+}
+
+void Journal::sync(bool force){
+    if(_storage == NULL || !_unsynced){
+        return;
+    }
+    if(!force && Hal::millis() - _syncTime < SYNC_PERIOD){
+        return;
+    }
+    if(_storage->sync()){
+        _unsynced = false;
+        _syncTime = Hal::millis();
+    }
+}
+
+void Journal::storeCursor(bool force){
+    if(force){
+        sync(true);
+    }
+    if(_storage == NULL || _ackSeq == _storedAckSeq){
+        return;
+    }
+    if(!force && Hal::millis() - _cursorStoreTime < CURSOR_PERIOD){
+        return;
+    }
+
+    Cursor cursor;
+    cursor.magic = CURSOR_MAGIC;
+    cursor.ackSeq = _ackSeq;
+    cursor.crc = crc32(&cursor, offsetof(Cursor, crc));
+    if(_storage->writeCursor(&cursor, sizeof(cursor))){
+        _storedAckSeq = _ackSeq;
+        _cursorStoreTime = Hal::millis();
+    }
+}
+
+ImpulseMeterStatus Journal::toStatus(const Record& record){
+    ImpulseMeterStatus status;
+    status.utcTime = record.utcTime;
+    status.impulse = record.impulse;
+    status.sourceName = record.sourceName;
+    status.timerIntervallInSec = record.timerIntervallInSec;
+    status.counterId = record.counterId < MAX_COUNTERS ? record.counterId : MAX_COUNTERS;
+    status.monotonicEndUs = 0;
+    return status;
+}
+
+bool Journal::_readRecord(uint32_t seq, Record& record){
+    return _storage->read(_segment(seq), _offset(seq), &record, sizeof(Record)) && record.seq == seq && record.crc == _recordCrc(record);
+}
+
+void Journal::_dropOverwritten(){
+    // The head is the first record of the cleared segment, the segments before it are kept.
+    uint32_t kept = capacity();
+    if(_headSeq - _ackSeq > kept){
+        _lost += _headSeq - kept - _ackSeq;
+        _ackSeq = _headSeq - kept;
+    }
+}
+
+uint32_t Journal::crc32(const void* data, size_t len){
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t Journal::_recordCrc(Record record){
+    record.crc = 0;
+    return crc32(&record, sizeof(record));
+}
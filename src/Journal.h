@@ -0,0 +1,96 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <stdint.h>
+#include "ImpulseMeter.h"
+#include "SegmentStorage.h"
+
+// Append only journal of the closed intervalls in a ring of segments with fixed size records.
+// Every record gets a sequence number. The records from the ack cursor up to the head are not published yet.
+// The records are appended to the current segment, when it is full the oldest segment is cleared and gets the next
+// records, so the storage is never written in place. The appended records are synced at most every SYNC_PERIOD.
+// The ack cursor is stored separately and at most every CURSOR_PERIOD, so after a crash some records
+// can be published twice, but no record is lost as long as the ring does not overflow.
+class Journal
+{
+public:
+	// A record in the storage.
+	struct Record
+	{
+		uint32_t seq;								// Sequence number, 0 is not used
+		uint32_t crc;								// CRC32 of the record with crc = 0
+		int64_t utcTime;							// The end time in UTC of the collected impulses
+		uint32_t impulse;							// The collected impulses
+		uint32_t timerIntervallInSec;				// The intervall of the collection
+		uint8_t counterId;							// The CounterId of the meter, MAX_COUNTERS if not known
+		uint8_t reserved[7];						// 0, keeps the record at 64 bytes
+		char sourceName[32];						// The name of the impulse source
+	};
+
+	//**** user functions
+	// Open the journal in the storage, which must have at least 2 segments with space for a record.
+	// Reads the first record of every segment and the newest segment to find the head and reads the ack cursor.
+	bool begin(SegmentStorage* storage);
+	// Append the record of a closed intervall. Clears the oldest segment if the ring is full.
+	bool append(const ImpulseMeterStatus& status);
+	// Read the record with the sequence number seq. Returns false if it is not in the journal.
+	bool read(uint32_t seq, Record& record);
+	// All records before seq are published.
+	void ack(uint32_t seq);
+	// Sync the appended records, if the last sync is SYNC_PERIOD ago or force is true.
+	void sync(bool force);
+	// Store the ack cursor, if it is changed and the last store is CURSOR_PERIOD ago or force is true.
+	// With force the appended records are synced too.
+	void storeCursor(bool force);
+
+	// The first record which is not published.
+	uint32_t ackSeq() const { return _ackSeq; }
+	// The sequence number of the next appended record.
+	uint32_t headSeq() const { return _headSeq; }
+	// Number of records which are not published.
+	uint32_t pending() const { return _headSeq - _ackSeq; }
+	// Number of not published records which are overwritten because the ring was full.
+	unsigned long lost() const { return _lost; }
+	// Number of records which are kept at least, the records of all segments but the one which is cleared next.
+	uint32_t capacity() const { return (_segments - 1) * _recordsPerSegment; }
+
+	// Convert a record into the status of the ImpulseMeter. The sourceName points into the record.
+	static ImpulseMeterStatus toStatus(const Record& record);
+	// The CRC32 (IEEE 802.3) of the data, also used by other stored structures.
+	static uint32_t crc32(const void* data, size_t len);
+
+private:
+	const static unsigned long CURSOR_PERIOD = 60 * 1000;			// 1 minute
+	const static unsigned long SYNC_PERIOD = 10 * 1000;				// 10 seconds, the shortest intervall
+	const static uint32_t CURSOR_MAGIC = 0x4A524E32;				// "JRN2"
+
+	// The stored ack cursor.
+	struct Cursor
+	{
+		uint32_t magic;
+		uint32_t ackSeq;
+		uint32_t crc;
+	};
+
+	SegmentStorage* _storage = NULL;
+	uint32_t _segments = 0;
+	uint32_t _recordsPerSegment = 0;
+	uint32_t _headSeq = 1;											// Sequence number of the next record
+	uint32_t _ackSeq = 1;											// First record which is not published
+	uint32_t _storedAckSeq = 1;										// The ack cursor in the storage
+	unsigned long _cursorStoreTime = 0;								// Time in ms of the last cursor store
+	bool _unsynced = false;											// True, if records are appended after the last sync
+	unsigned long _syncTime = 0;									// Time in ms of the last sync
+	unsigned long _lost = 0;
+
+	// The segment and the offset of the record.
+	uint32_t _segment(uint32_t seq) const { return (seq - 1) / _recordsPerSegment % _segments; }
+	uint32_t _offset(uint32_t seq) const { return (seq - 1) % _recordsPerSegment * sizeof(Record); }
+	// Read the record and check it. Returns false if it is not the record with the sequence number seq.
+	bool _readRecord(uint32_t seq, Record& record);
+	// Forget the not published records of the segment which is cleared for the head.
+	void _dropOverwritten();
+
+	static uint32_t _recordCrc(Record record);
+};
+
+#endif
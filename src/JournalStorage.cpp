@@ -0,0 +1,73 @@
+#include <unistd.h>
+#include "JournalStorage.h"
+
+FileJournalStorage::~FileJournalStorage(){
+    end();
+}
+
+bool FileJournalStorage::begin(const char* dataPath, const char* cursorPath, bool sync){
+    end();
+    _cursorPath = cursorPath;
+    _sync = sync;
+    _data = _open(dataPath);
+    return _data != NULL;
+}
+
+void FileJournalStorage::end(){
+    if(_data != NULL){
+        fclose(_data);
+        _data = NULL;
+    }
+}
+
+bool FileJournalStorage::readData(uint32_t offset, void* buff, size_t len){
+    if(_data == NULL || fseek(_data, offset, SEEK_SET) != 0){
+        return false;
+    }
+    return fread(buff, 1, len, _data) == len;
+}
+
+bool FileJournalStorage::writeData(uint32_t offset, const void* buff, size_t len){
+    if(_data == NULL || fseek(_data, offset, SEEK_SET) != 0){
+        return false;
+    }
+    if(fwrite(buff, 1, len, _data) != len){
+        return false;
+    }
+    return _flush(_data);
+}
+
+bool FileJournalStorage::readCursor(void* buff, size_t len){
+    FILE* file = fopen(_cursorPath.c_str(), "rb");
+    if(file == NULL){
+        return false;
+    }
+    bool ok = fread(buff, 1, len, file) == len;
+    fclose(file);
+    return ok;
+}
+
+bool FileJournalStorage::writeCursor(const void* buff, size_t len){
+    FILE* file = fopen(_cursorPath.c_str(), "wb");
+    if(file == NULL){
+        return false;
+    }
+    bool ok = fwrite(buff, 1, len, file) == len && _flush(file);
+    fclose(file);
+    return ok;
+}
+
+FILE* FileJournalStorage::_open(const char* path){
+    FILE* file = fopen(path, "r+b");
+    if(file == NULL){
+        file = fopen(path, "w+b");
+    }
+    return file;
+}
+
+bool FileJournalStorage::_flush(FILE* file){
+    if(fflush(file) != 0){
+        return false;
+    }
+    return !_sync || fsync(fileno(file)) == 0;
+}
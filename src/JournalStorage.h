@@ -0,0 +1,54 @@
+#ifndef JOURNAL_STORAGE_H
+#define JOURNAL_STORAGE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+// A storage with a data area and a small cursor area, e.g. for the totals and the counter configuration.
+class JournalStorage
+{
+public:
+	virtual ~JournalStorage(){}
+
+	// Read len bytes at offset of the data area. Returns false if the data does not exist.
+	virtual bool readData(uint32_t offset, void* buff, size_t len) = 0;
+	// Write len bytes at offset of the data area.
+	virtual bool writeData(uint32_t offset, const void* buff, size_t len) = 0;
+	// Read the cursor. Returns false if there is no cursor.
+	virtual bool readCursor(void* buff, size_t len) = 0;
+	// Replace the cursor.
+	virtual bool writeCursor(const void* buff, size_t len) = 0;
+};
+
+// JournalStorage in two files. Used with LittleFS on the ESP32 (mounted to the VFS, e.g. /littlefs/...)
+// and with normal files in the native build.
+class FileJournalStorage : public JournalStorage
+{
+public:
+	//**** ctors / destructor
+	~FileJournalStorage();
+
+	//**** user functions
+	// Open or create the files. If sync is true, every write is synced to the storage.
+	bool begin(const char* dataPath, const char* cursorPath, bool sync);
+	void end();
+
+	//**** JournalStorage functions
+	bool readData(uint32_t offset, void* buff, size_t len) override;
+	bool writeData(uint32_t offset, const void* buff, size_t len) override;
+	bool readCursor(void* buff, size_t len) override;
+	bool writeCursor(const void* buff, size_t len) override;
+
+private:
+	FILE* _data = NULL;												// The open data file
+	std::string _cursorPath;										// The cursor file is written as a whole
+	bool _sync = false;												// Sync every write
+
+	// Open the file for read and write, create it if it does not exist.
+	static FILE* _open(const char* path);
+	// Flush and optional sync the file.
+	bool _flush(FILE* file);
+};
+
+#endif
@@ -1,58 +1,74 @@
 #include <stdio.h>
 #include "Logger.h"
+#include "Hal.h"
 
-void Logger::begin(char *myName, EspMQTTClient *mqttClient){
+void Logger::begin(char *myName, MqttPort *mqttClient){
     if(myName == NULL || mqttClient == NULL){
         return;
     }
 
     _mqttClient = mqttClient;
-    _errorTopic += myName;
-    _messageTopic += myName;
+    snprintf(_errorTopic, sizeof(_errorTopic), "%s%s", ERROR_TOPIC_PREFIX, myName);
+    snprintf(_messageTopic, sizeof(_messageTopic), "%s%s", MESSAGE_TOPIC_PREFIX, myName);
 }
 
-size_t Logger::printError(const char *format, ...){
-    char loc_buf[100];
-    char * temp = loc_buf;
-    va_list arg;
-    va_start(arg, format);
-    int len = vsnprintf(loc_buf, sizeof(loc_buf), format, arg);
-    va_end(arg);
-    if(len < 0 || len >= sizeof(loc_buf)) {
+size_t Logger::_print(LogLevel level, const char *format, va_list arg){
+    Record record;
+    record.level = level;
+    int len = vsnprintf(record.text, sizeof(record.text), format, arg);
+    if(len < 0) {
         return 0;
     };
+    if((size_t)len > MAX_MESSAGE_LEN){
+        _truncated.fetch_add(1, std::memory_order_relaxed);
+        len = MAX_MESSAGE_LEN;
+    }
+    // The line end is added by the output.
+    if(len > 0 && record.text[len - 1] == '\n'){
+        len--;
+        record.text[len] = 0;
+    }
+    record.len = len;
 
-    Serial.write((uint8_t*)temp, len);
-    Serial.println();
-    errorToMqtt(temp, len);
+    if(!_records.push(record)){
+        return 0;
+    }
     return len;
 }
 
-size_t Logger::printMessage(const char *format, ...){
-    char loc_buf[100];
-    char * temp = loc_buf;
-    va_list arg;
-    va_start(arg, format);
-    int len = vsnprintf(loc_buf, sizeof(loc_buf), format, arg);
-    va_end(arg);
-    if(len < 0 || len >= sizeof(loc_buf)) {
-        return 0;
-    };
+void Logger::loop(){
+    bool toMqtt = _mqttClient != NULL && _mqttClient->isConnected();
+    LogLevel batchLevel = LOG_LEVEL_NONE;
+    size_t batchLen = 0;
+    Record record;
+    while (_records.pop(record))
+    {
+        Hal::serialWriteLine(record.text, record.len);
+        if(!toMqtt){
+            continue;
+        }
 
-    Serial.write((uint8_t*)temp, len);
-    Serial.println();
-    messageToMqtt(temp, len);
-    return len;
-}
+        // Records of the same level are published together, one record per line.
+        bool isError = record.level == LOG_LEVEL_ERROR;
+        bool batchIsError = batchLevel == LOG_LEVEL_ERROR;
+        if(batchLen > 0 && (isError != batchIsError || batchLen + 1 + record.len >= sizeof(_mqttBatch))){
+            _publishBatch(batchLevel);
+            batchLen = 0;
+        }
+        if(batchLen > 0){
+            _mqttBatch[batchLen++] = '\n';
+        }
+        memcpy(_mqttBatch + batchLen, record.text, record.len);
+        batchLen += record.len;
+        _mqttBatch[batchLen] = 0;
+        batchLevel = record.level;
+    }
 
-void Logger::messageToMqtt(char *buff, size_t len){
-    if(_mqttClient != NULL && _mqttClient->isConnected()){
-        _mqttClient->publish(_messageTopic.c_str(), buff);
+    if(batchLen > 0){
+        _publishBatch(batchLevel);
     }
 }
 
-void Logger::errorToMqtt(char *buff, size_t len){
-    if(_mqttClient != NULL && _mqttClient->isConnected()){
-        _mqttClient->publish(_errorTopic.c_str(), buff);
-    }
-}
\ No newline at end of file
+void Logger::_publishBatch(LogLevel level){
+    _mqttClient->publish(level == LOG_LEVEL_ERROR ? _errorTopic : _messageTopic, _mqttBatch);
+}
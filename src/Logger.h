@@ -1,28 +1,104 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 #include <string.h>
-#include <EspMQTTClient.h>
+#include <stdarg.h>
+#include <atomic>
+#include "MqttPort.h"
+#include "MpscQueue.h"
 
 using namespace std;
 
 #define ERROR_TOPIC_PREFIX "Error/"
 #define MESSAGE_TOPIC_PREFIX "Info/"
 
-class Logger
+// The level of a log message.
+enum LogLevel
 {
-private:
-    EspMQTTClient *_mqttClient = NULL;
-    string _errorTopic = ERROR_TOPIC_PREFIX;
-    string _messageTopic = MESSAGE_TOPIC_PREFIX;
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_NONE
+};
+
+// Messages below this level are removed at compile time, e.g. build with -DLOGGER_MIN_LEVEL=LOG_LEVEL_DEBUG
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL LOG_LEVEL_INFO
+#endif
 
-    void messageToMqtt(char *buff, size_t len);
-    void errorToMqtt(char *buff, size_t len);
+// Log a debug message with logger->printDebug(). The arguments are not evaluated, if the debug messages are removed.
+#define LOGGER_DEBUG(logger, ...) do { if constexpr (LOGGER_MIN_LEVEL <= LOG_LEVEL_DEBUG) { (logger)->printDebug(__VA_ARGS__); } } while (0)
 
+// Format the messages into a ring of preallocated records and write them to Serial and MQTT in loop().
+// The print functions never block on Serial or MQTT, take no lock and don´t allocate memory, so they can be called
+// from any task. Messages are truncated to MAX_MESSAGE_LEN and dropped if the ring is full, both is counted.
+class Logger
+{
 public:
+    const static size_t MAX_MESSAGE_LEN = 127;
+
     void begin(){_mqttClient = NULL;}
-    void begin(char *myName, EspMQTTClient *mqttClient);
-    size_t printError(const char *format, ...);
-    size_t printMessage(const char *format, ...);
+    void begin(char *myName, MqttPort *mqttClient);
+    // Write the messages to Serial and MQTT. loop should be called in the loop() function of main.c
+    void loop();
+
+    size_t printError(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if constexpr (LOGGER_MIN_LEVEL > LOG_LEVEL_ERROR) return 0;
+        va_list arg;
+        va_start(arg, format);
+        size_t len = _print(LOG_LEVEL_ERROR, format, arg);
+        va_end(arg);
+        return len;
+    }
+
+    size_t printMessage(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if constexpr (LOGGER_MIN_LEVEL > LOG_LEVEL_INFO) return 0;
+        va_list arg;
+        va_start(arg, format);
+        size_t len = _print(LOG_LEVEL_INFO, format, arg);
+        va_end(arg);
+        return len;
+    }
+
+    size_t printDebug(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if constexpr (LOGGER_MIN_LEVEL > LOG_LEVEL_DEBUG) return 0;
+        va_list arg;
+        va_start(arg, format);
+        size_t len = _print(LOG_LEVEL_DEBUG, format, arg);
+        va_end(arg);
+        return len;
+    }
+
+    // Number of messages which are dropped because the ring was full.
+    unsigned long dropped() const { return _records.overflows(); }
+    // Number of messages which are truncated to MAX_MESSAGE_LEN.
+    unsigned long truncated() const { return _truncated.load(std::memory_order_relaxed); }
+
+private:
+    const static size_t RECORD_COUNT = 16;                      // Records in the ring, must be a power of two
+    const static size_t MAX_TOPIC_LEN = 40;
+    const static size_t MQTT_BATCH_SIZE = 512;                  // Max. payload of one MQTT message with some records
+
+    // A formatted message.
+    struct Record
+    {
+        LogLevel level;
+        uint8_t len;
+        char text[MAX_MESSAGE_LEN + 1];
+    };
+
+    MqttPort *_mqttClient = NULL;
+    char _errorTopic[MAX_TOPIC_LEN] = ERROR_TOPIC_PREFIX;
+    char _messageTopic[MAX_TOPIC_LEN] = MESSAGE_TOPIC_PREFIX;
+    MpscQueue<Record, RECORD_COUNT> _records;                   // Filled by the print functions of all tasks, emptied by loop()
+    std::atomic<unsigned long> _truncated{0};
+    char _mqttBatch[MQTT_BATCH_SIZE];                           // The payload of the records for one MQTT message
+
+    size_t _print(LogLevel level, const char *format, va_list arg);
+    // Publish the collected records of the level.
+    void _publishBatch(LogLevel level);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,1018 @@
+#include <stdio.h>
+#include <string.h>
+#include <MyDateTime.h>
+#include "MeterNode.h"
+#include "Hal.h"
+
+using namespace std;
+
+void MeterNode::begin(const char* myName, MqttPort* mqttClient, Logger* logger){
+    snprintf(_myName, sizeof(_myName), "%s", myName);
+    snprintf(_statusTopic, sizeof(_statusTopic), "Status/%s", _myName);
+    snprintf(_totalsTopic, sizeof(_totalsTopic), "Totals/%s", _myName);
+    snprintf(_metricsTopic, sizeof(_metricsTopic), "Metrics/%s", _myName);
+    snprintf(_readyTopic, sizeof(_readyTopic), "Ready/%s", _myName);
+    snprintf(_installResultTopic, sizeof(_installResultTopic), "InstallResult/%s", _myName);
+    snprintf(_encodingTopic, sizeof(_encodingTopic), "Encoding/%s", _myName);
+    snprintf(_impulsesTopic, sizeof(_impulsesTopic), "Impulses/%s", _myName);
+    _mqttClient = mqttClient;
+    _logger = logger;
+    _impulsesOverAll = 0;
+    unsigned long now = Hal::millis();
+    _readyJob = _scheduler.add(_readyJobExt, this, PUBLISH_READY_PERIOD, now);
+    _readyRequestJob = _scheduler.add(_readyRequestJobExt, this, 0, now);
+    _restartJob = _scheduler.add(_restartJobExt, this, 0, now);
+    _heartbeatJob = _scheduler.add(_heartbeatJobExt, this, HEARTBEAT_PERIOD, now);
+    // The update job is triggered when a intervall is closed, the period is needed for the journal replay and the batch deadline.
+    _updateJob = _scheduler.add(_updateJobExt, this, IMPULSE_METER_UPDATE_PERIOD, now);
+    _liveRateJob = _scheduler.add(_liveRateJobExt, this, LIVE_RATE_PERIOD, now);
+    _metricsJob = _scheduler.add(_metricsJobExt, this, DEFAULT_METRICS_PERIOD_IN_SEC * 1000UL, now, DEFAULT_METRICS_PERIOD_IN_SEC * 1000UL);
+    ImpulseMeter::onIntervallClosed(_onIntervallClosed, this);
+    for (size_t i = 0; i < MAX_COUNTERS; i++)
+    {
+      _liveRates[i].changePercent = 0;
+      _stormStates[i].config = {0, StormGuard::DEFAULT_MAX_INTERRUPTS_PER_SEC};
+      _stormStates[i].reportedStorms = 0;
+      _stormStates[i].sampling = false;
+      memset(&_installedConfigs[i], 0, sizeof(_installedConfigs[i]));
+    }
+    // Clear the array with the impulse meters.
+    _impulseMeters.fill(NULL);
+    _publishMode = PUBLISH_SINGLE;
+    _encoding = ENCODING_TEXT;
+    _ramJournal.begin(&_ramStorage);
+    setJournal(NULL);
+    _totals = NULL;
+    _configStore = NULL;
+    _restoredCounters = 0;
+    _countersArmedUs = 0;
+    _firstImpulseUs = 0;
+    _reportedLostRecords = 0;
+    _instance = this;
+}
+
+void MeterNode::setupMqttSubscriber(){
+  if(_mqttClient->isConnected()){
+    _subscribe("InstallCounter", [this](const char* message) { installCounter(message); });
+    _subscribe("InstallCounters", [this](const char* message) { installCounters(message); });
+    _subscribe("Restart", [this](const char* /*message*/) { _restart(); });
+    _subscribe("GetStatus", [this](const char* /*message*/) { publishStatus(); });
+    _subscribe("PublishMode", [this](const char* message) { publishModeMessage(message); });
+    _subscribe("Encoding", [this](const char* message) { encodingMessage(message); });
+    _subscribe("LiveRate", [this](const char* message) { liveRateMessage(message); });
+    _subscribe("MetricsPeriod", [this](const char* message) { metricsPeriodMessage(message); });
+    _subscribe("StormGuard", [this](const char* message) { stormGuardMessage(message); });
+    _subscribe("Rollup", [this](const char* message) { rollupMessage(message); });
+  }
+}
+
+void MeterNode::_subscribe(const char* command, MqttPort::message_handler_t handler){
+  char topic[TOPIC_SIZE];
+  snprintf(topic, sizeof(topic), "%s/%s", _myName, command);
+  if(!_mqttClient->subscribe(topic, handler)){
+    _logger->printError("Failed to subscribe %s\n", topic);
+  }
+}
+
+unsigned long MeterNode::loop(){
+  int64_t startTime = Hal::micros();
+  unsigned long waitMs = _scheduler.run(Hal::millis());
+  _metrics.recordLoop(Hal::micros() - startTime);
+  return waitMs;
+}
+
+void MeterNode::_readyJobExt(void* arg){
+  MeterNode* node = (MeterNode*)arg;
+  if (node->getInstalledCounters() == 0){
+    // Publish Ready over MQTT, because no counter is installed.
+    node->publishReady();
+  }
+}
+
+void MeterNode::_readyRequestJobExt(void* arg){
+  ((MeterNode*)arg)->publishReady();
+}
+
+void MeterNode::_restartJobExt(void* arg){
+  ((MeterNode*)arg)->_restart();
+}
+
+void MeterNode::_heartbeatJobExt(void* arg){
+  // Publish the status over MQTT as a heartbeat
+  ((MeterNode*)arg)->publishStatus();
+}
+
+void MeterNode::_updateJobExt(void* arg){
+  ((MeterNode*)arg)->_update();
+}
+
+void MeterNode::_liveRateJobExt(void* arg){
+  ((MeterNode*)arg)->_updateLiveRates();
+}
+
+void MeterNode::_metricsJobExt(void* arg){
+  ((MeterNode*)arg)->publishMetrics();
+}
+
+void MeterNode::_onIntervallClosed(void* arg){
+  MeterNode* node = (MeterNode*)arg;
+  node->_scheduler.trigger(node->_updateJob);
+  Hal::notifyEvent();
+}
+
+void MeterNode::_update(){
+  _retryRollups();
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    if(_impulseMeters[i] != NULL){
+      if(_impulseMeters[i]->update() > 0){
+        _liveRates[i].estimator.startIntervall();
+      }
+      _reportStorms(i);
+    }
+  }
+  _reportClock();
+  _replayJournal();
+  if(_totals != NULL && !_totals->checkpoint(false)){
+    _logger->printError("Failed to write the totals checkpoint\n");
+  }
+}
+
+void MeterNode::_reportClock(){
+  const ClockAnchor& clock = ImpulseMeter::clock();
+  if(!_clockAnchorReported && clock.isAnchored()){
+    _clockAnchorReported = true;
+    _logger->printMessage("UTC time is known %lu ms after boot\n", (unsigned long)(clock.anchoredUs() / 1000));
+  }
+  unsigned long steps = clock.steps();
+  if(steps != _reportedClockSteps){
+    _logger->printError("Clock step of %lld ms, %lu steps since boot\n", (long long)(clock.lastStepUs() / 1000), steps);
+    _reportedClockSteps = steps;
+  }
+}
+
+void MeterNode::_updateLiveRates(){
+  uint32_t nowUs = (uint32_t)Hal::micros();
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    LiveRate& liveRate = _liveRates[i];
+    if(liveRate.changePercent == 0 || _impulseMeters[i] == NULL){
+      continue;
+    }
+
+    PulseTimestamp pulse;
+    while (_impulseMeters[i]->takeTimestamp(pulse))
+    {
+      liveRate.estimator.add(pulse);
+    }
+
+    float rate = liveRate.estimator.rate(nowUs);
+    float change = rate - liveRate.publishedRate;
+    if(change < 0){
+      change = -change;
+    }
+    // Publish also the change to and from 0.
+    if(change * 100 <= liveRate.publishedRate * liveRate.changePercent && (rate == 0) == (liveRate.publishedRate == 0)){
+      continue;
+    }
+
+    char topic[48];
+    char payload[48];
+    snprintf(topic, sizeof(topic), "Rate/%s", _impulseMeters[i]->sourceName());
+    snprintf(payload, sizeof(payload), "%.1f\t%.1f\t%.1f", rate, liveRate.estimator.minRate(), liveRate.estimator.maxRate());
+    if(_mqttClient->publish(topic, payload)){
+      liveRate.publishedRate = rate;
+    }
+  }
+}
+
+void MeterNode::_reportStorms(size_t counterId){
+  const StormGuard* guard = _impulseMeters[counterId]->stormGuard();
+  if(guard == NULL){
+    return;
+  }
+
+  StormState& state = _stormStates[counterId];
+  unsigned long storms = guard->storms();
+  bool sampling = guard->isSampling();
+  if(storms != state.reportedStorms){
+    _logger->printError("Pin: %02d; Source: %s; Interrupt storm, the pin is sampled. Storms: %lu; Glitches: %lu\n",
+      _impulseMeters[counterId]->pin(), _impulseMeters[counterId]->sourceName(), storms, guard->glitches());
+    state.reportedStorms = storms;
+  }else if(state.sampling && !sampling){
+    _logger->printMessage("Pin: %02d; Source: %s; Interrupt storm is over, the interrupt is enabled again\n",
+      _impulseMeters[counterId]->pin(), _impulseMeters[counterId]->sourceName());
+  }
+  state.sampling = sampling;
+}
+
+void MeterNode::stormGuardMessage(const char* message){
+  uint8_t counterId;
+  StormGuard::Config config;
+  CommandParser::Result result = CommandParser::parseStormGuard(message, counterId, config);
+  if(result != CommandParser::OK){
+    _logger->printError("Wrong StormGuard message: '%s'::  %s", message, CommandParser::resultText(result));
+    return;
+  }
+
+  _stormStates[counterId].config = config;
+  ImpulseMeter* impulseMeter = _impulseMeters[counterId];
+  if(impulseMeter != NULL && !impulseMeter->setStormGuard(config)){
+    _logger->printError("CounterId: %u has no interrupt for the StormGuard\n", counterId);
+    return;
+  }
+  _storeCounterConfigs();
+  _logger->printMessage("StormGuard counterId: %u min. spacing: %u us max. interrupts: %u/s\n", counterId, (unsigned int)config.minSpacingUs, (unsigned int)config.maxInterruptsPerSec);
+}
+
+void MeterNode::rollupMessage(const char* message){
+  uint8_t counterId;
+  Rollup::LevelConfig levels[Rollup::MAX_LEVELS];
+  size_t count;
+  CommandParser::Result result = CommandParser::parseRollup(message, counterId, levels, count);
+  if(result != CommandParser::OK){
+    _logger->printError("Wrong Rollup message: '%s'::  %s", message, CommandParser::resultText(result));
+    return;
+  }
+
+  ImpulseMeter* impulseMeter = _impulseMeters[counterId];
+  if(impulseMeter == NULL){
+    _logger->printError("CounterId: %u is not installed for the rollup\n", counterId);
+    return;
+  }
+  if(_setRollup(counterId, levels, count)){
+    _storeCounterConfigs();
+    _logger->printMessage("Rollup counterId: %u levels: %u\n", counterId, (unsigned int)count);
+  }
+}
+
+bool MeterNode::_setRollup(uint8_t counterId, const Rollup::LevelConfig* levels, size_t count){
+  // The current rollups are kept if the levels are wrong.
+  Rollup rollup;
+  uint32_t intervallInSec = _impulseMeters[counterId]->timerIntervallInSec();
+  if(!rollup.begin(levels, count, intervallInSec)){
+    _logger->printError("CounterId: %u the rollup periods must be multiples of the intervall %u\n", counterId, intervallInSec);
+    return false;
+  }
+  _rollups[counterId] = rollup;
+  return true;
+}
+
+void MeterNode::liveRateMessage(const char* message){
+  uint8_t counterId;
+  uint32_t changePercent;
+  CommandParser::Result result = CommandParser::parseLiveRate(message, counterId, changePercent);
+  if(result != CommandParser::OK){
+    _logger->printError("Wrong LiveRate message: '%s'::  %s", message, CommandParser::resultText(result));
+    return;
+  }
+
+  if(_setLiveRate(counterId, changePercent)){
+    _storeCounterConfigs();
+    _logger->printMessage("LiveRate counterId: %u change: %u%%\n", counterId, changePercent);
+  }
+}
+
+bool MeterNode::_setLiveRate(uint8_t counterId, uint32_t changePercent){
+  LiveRate& liveRate = _liveRates[counterId];
+  ImpulseMeter* impulseMeter = _impulseMeters[counterId];
+  if(impulseMeter == NULL || !impulseMeter->enableTimestamps(changePercent > 0)){
+    _logger->printError("CounterId: %u has no time stamps for the live rate\n", counterId);
+    liveRate.changePercent = 0;
+    return false;
+  }
+
+  if(liveRate.changePercent == 0){
+    liveRate.estimator.reset();
+    liveRate.publishedRate = 0;
+  }
+  liveRate.changePercent = changePercent;
+  return true;
+}
+
+void MeterNode::setPublishMode(PublishMode mode, unsigned long flushDeadlineMs, size_t maxPayloadSize){
+  _flushBatch();
+  _publishMode = mode;
+  if(_publishMode == PUBLISH_BATCH){
+    _batch.begin(_mqttClient, _impulsesTopic, maxPayloadSize, flushDeadlineMs, &_metrics);
+  }
+}
+
+void MeterNode::publishModeMessage(const char* message){
+  Tokenizer tokenizer(message, '\t');
+  std::string_view mode;
+  std::string_view token;
+  uint32_t flushDeadlineMs = 0;
+  uint32_t maxPayloadSize = IntervallBatch::MAX_PAYLOAD_SIZE;
+  if(!tokenizer.next(mode)
+    || (tokenizer.next(token) && !CommandParser::parseUInt(token, flushDeadlineMs))
+    || (tokenizer.next(token) && !CommandParser::parseUInt(token, maxPayloadSize))
+    || tokenizer.next(token)){
+    _logger->printError("Wrong PublishMode message: '%s'", message);
+  }else if(mode == "SINGLE"){
+    setPublishMode(PUBLISH_SINGLE);
+    _logger->printMessage("PublishMode SINGLE\n");
+  }else if(mode == "BATCH"){
+    setPublishMode(PUBLISH_BATCH, flushDeadlineMs, maxPayloadSize);
+    _logger->printMessage("PublishMode BATCH; Deadline: %u ms; Max. payload: %u\n", (unsigned int)flushDeadlineMs, (unsigned int)maxPayloadSize);
+  }else{
+    _logger->printError("Unknown PublishMode: '%s'", message);
+  }
+}
+
+void MeterNode::setEncoding(Encoding encoding){
+  _encoding = encoding;
+  _flushBatch();
+  _batch.setPacked(_encoding == ENCODING_PACKED);
+}
+
+void MeterNode::encodingMessage(const char* message){
+  Tokenizer tokenizer(message, '\t');
+  std::string_view encoding;
+  std::string_view token;
+  uint32_t version = PackedEncoder::VERSION;
+  if(!tokenizer.next(encoding)
+    || (tokenizer.next(token) && !CommandParser::parseUInt(token, version))
+    || tokenizer.next(token)){
+    _logger->printError("Wrong Encoding message: '%s'", message);
+    return;
+  }else if(encoding == "TEXT"){
+    setEncoding(ENCODING_TEXT);
+  }else if(encoding == "PACKED" && version >= 1){
+    // Version 1 is the only version yet, a consumer with a higher version also decodes it.
+    setEncoding(ENCODING_PACKED);
+  }else{
+    _logger->printError("Unknown Encoding: '%s'", message);
+    return;
+  }
+
+  char payload[16];
+  if(_encoding == ENCODING_PACKED){
+    snprintf(payload, sizeof(payload), "PACKED\t%u", (unsigned int)PackedEncoder::VERSION);
+  }else{
+    strcpy(payload, "TEXT");
+  }
+  _logger->printMessage("Encoding %s\n", payload);
+  _mqttClient->publish(_encodingTopic, payload, true);
+}
+
+void MeterNode::setJournal(Journal* journal){
+  // The open batch has records of the other journal.
+  _batch.flush();
+  _journal = journal != NULL ? journal : &_ramJournal;
+  _reportedLostRecords = _journal->lost();
+  // The records of the other journal are not acked by the sent messages.
+  SentRecords sent;
+  while (_sent.pop(sent))
+  {
+  }
+  _replaySeq = _journal->ackSeq();
+  _batchedSeq = _replaySeq;
+}
+
+void MeterNode::setTotals(MeterTotals* totals){
+  _totals = totals;
+  if(_totals != NULL && _totals->restoredTime() != 0){
+    char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+    _logger->printMessage("Totals restored: %llu impulses from %s\n", (unsigned long long)_totals->restoredOverAll(), IsoTimeFormatter::render(_totals->restoredTime(), timeBuff));
+  }
+}
+
+void MeterNode::setConfigStore(CounterConfigStore* configStore){
+  _configStore = configStore;
+  if(_configStore == NULL){
+    return;
+  }
+
+  for (size_t i = 0; i < _configStore->count(); i++)
+  {
+    const CounterConfigStore::Entry& entry = _configStore->entry(i);
+    if(entry.counter.counterId >= MAX_COUNTERS){
+      continue;
+    }
+    _stormStates[entry.counter.counterId].config = entry.stormGuard;
+    if(!_installCounter(entry.counter)){
+      continue;
+    }
+    _restoredCounters++;
+    if(entry.rollupLevels > 0){
+      _setRollup(entry.counter.counterId, entry.rollups, entry.rollupLevels);
+    }
+    if(entry.liveRateChangePercent > 0){
+      _setLiveRate(entry.counter.counterId, entry.liveRateChangePercent);
+    }
+  }
+  if(_restoredCounters > 0){
+    _logger->printMessage("Counters restored: %u; armed %lu ms after boot\n", (unsigned int)_restoredCounters, (unsigned long)(_countersArmedUs / 1000));
+  }
+}
+
+int MeterNode::getInstalledCounters(){
+  int counters = 0;
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    if(_impulseMeters[i] != NULL){
+      counters++;
+    }
+  }
+
+  return counters;
+}
+
+void MeterNode::installCounter(const char* message){
+  CounterConfig config;
+  CommandParser::Result result = CommandParser::parseInstallCounter(message, config);
+  if(result != CommandParser::OK){
+    _logger->printError("Failed to install the counter: '%s'::  %s", message, CommandParser::resultText(result));
+    return;
+  }
+  if(_installCounter(config)){
+    _storeCounterConfigs();
+  }
+}
+
+void MeterNode::installCounters(const char* message){
+  size_t count;
+  size_t errorLine;
+  char summary[64];
+  CommandParser::Result result = CommandParser::parseInstallCounters(message, _counterConfigs, MAX_COUNTERS, count, errorLine);
+  if(result != CommandParser::OK){
+    // Nothing is installed if one line is wrong.
+    snprintf(summary, sizeof(summary), "ERROR\t%u\t%s", (unsigned int)errorLine, CommandParser::resultText(result));
+  }else{
+    size_t errorIndex;
+    const char* reason = _installCounters(count, errorIndex);
+    if(reason != NULL){
+      errorLine = CommandParser::installCounterLine(message, errorIndex);
+      snprintf(summary, sizeof(summary), "ERROR\t%u\t%s", (unsigned int)errorLine, reason);
+    }else{
+      snprintf(summary, sizeof(summary), "OK\t%u\t0", (unsigned int)count);
+      _storeCounterConfigs();
+    }
+  }
+
+  _mqttClient->publish(_installResultTopic, summary);
+}
+
+const char* MeterNode::_installCounters(size_t count, size_t& errorIndex){
+  // Count the new meters first, so the pool can´t run out in the middle of the message.
+  size_t freeMeters = _meterPool.capacity() - _meterPool.used();
+  for (size_t i = 0; i < count; i++)
+  {
+    if(_impulseMeters[_counterConfigs[i].counterId] != NULL){
+      continue;
+    }
+    if(freeMeters == 0){
+      errorIndex = i;
+      return "No free meter";
+    }
+    freeMeters--;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint8_t counterId = _counterConfigs[i].counterId;
+    CounterConfig previous;
+    if(_impulseMeters[counterId] != NULL && _impulseMeters[counterId]->isInstalled()){
+      previous = _installedConfigs[counterId];
+    }else{
+      // No source name, the counter is removed by the rollback.
+      memset(&previous, 0, sizeof(previous));
+      previous.counterId = counterId;
+    }
+    bool installed = _installCounter(_counterConfigs[i]);
+    // The installed line is in _installedConfigs, so the parsed line keeps the previous configuration for the rollback.
+    _counterConfigs[i] = previous;
+    if(!installed){
+      errorIndex = i;
+      for (size_t j = i + 1; j > 0; j--)
+      {
+        _restoreCounter(_counterConfigs[j - 1]);
+      }
+      return "Counter can´t be installed";
+    }
+  }
+  return NULL;
+}
+
+void MeterNode::_restoreCounter(const CounterConfig& previous){
+  if(previous.sourceName[0] != 0){
+    _installCounter(previous);
+    return;
+  }
+
+  // The counter was not installed before.
+  uint8_t counterId = previous.counterId;
+  _meterPool.destroy(_impulseMeters[counterId]);
+  _impulseMeters[counterId] = NULL;
+  memset(&_installedConfigs[counterId], 0, sizeof(_installedConfigs[counterId]));
+}
+
+bool MeterNode::_installCounter(const CounterConfig& config){
+  ImpulseMeter* impulseMeter = _impulseMeters[config.counterId];
+  CounterConfig& installed = _installedConfigs[config.counterId];
+  if(impulseMeter != NULL && impulseMeter->isInstalled() && installed.timerIntervallInSec == config.timerIntervallInSec
+    && installed.sourceType == config.sourceType && strcmp(installed.sourceName, config.sourceName) == 0){
+    // Unchanged, e.g. the controller installs the restored counters again. A new report policy doesn´t restart the counting.
+    if(!ReportPolicy::sameConfig(installed.report, config.report)){
+      _setReportPolicy(config);
+    }
+    return true;
+  }
+
+  if(impulseMeter != NULL){
+    bool wasInstalled = impulseMeter->isInstalled();
+    CounterConfig previous = installed;
+    impulseMeter->begin(config.counterId, config.timerIntervallInSec, config.sourceName, config.sourceType, _plotImpulsesExt, _logger);
+    if(!impulseMeter->isInstalled()){
+      _logger->printError("CounterId: %u can´t be updated to SourceName: %s\n", config.counterId, config.sourceName);
+      if(wasInstalled){
+        // The previous source counts again, a failed begin of it removes the meter in this call.
+        _installCounter(previous);
+      }else{
+        _meterPool.destroy(impulseMeter);
+        _impulseMeters[config.counterId] = NULL;
+        memset(&installed, 0, sizeof(installed));
+      }
+      return false;
+    }
+    _logger->printMessage("Update counterId: %u SourceName: %s timerIntervall %u\n", config.counterId, config.sourceName, (unsigned int)config.timerIntervallInSec);
+  }else{
+    impulseMeter = _meterPool.create();
+    if(impulseMeter == NULL){
+      _logger->printError("CounterId: %u can´t be added, all %u meters are used\n", config.counterId, (unsigned int)_meterPool.capacity());
+      return false;
+    }
+    impulseMeter->begin(config.counterId, config.timerIntervallInSec, config.sourceName, config.sourceType, _plotImpulsesExt, _logger);
+    if(!impulseMeter->isInstalled()){
+      // Give the meter back, so wrong messages don´t use up the pool.
+      _meterPool.destroy(impulseMeter);
+      return false;
+    }
+    _impulseMeters[config.counterId] = impulseMeter;
+    _logger->printMessage("Add counterId: %u SourceName: %s timerIntervall %u\n", config.counterId, config.sourceName, (unsigned int)config.timerIntervallInSec);
+  }
+  // Cleared, so the stored configuration can be compared byte by byte.
+  memset(&installed, 0, sizeof(installed));
+  installed.counterId = config.counterId;
+  installed.timerIntervallInSec = config.timerIntervallInSec;
+  installed.sourceType = config.sourceType;
+  snprintf(installed.sourceName, sizeof(installed.sourceName), "%s", config.sourceName);
+  _setReportPolicy(config);
+  if(_countersArmedUs == 0){
+    _countersArmedUs = Hal::micros();
+  }
+
+  // A new source has the default StormGuard and no time stamps, therefor set them again.
+  StormState& stormState = _stormStates[config.counterId];
+  impulseMeter->setStormGuard(stormState.config);
+  const StormGuard* guard = impulseMeter->stormGuard();
+  stormState.reportedStorms = guard != NULL ? guard->storms() : 0;
+  stormState.sampling = false;
+
+  Rollup& rollup = _rollups[config.counterId];
+  if(rollup.levels() > 0 && !rollup.setBaseIntervall(impulseMeter->timerIntervallInSec())){
+    _logger->printError("CounterId: %u rollups removed, the periods are no multiples of the intervall %u\n", config.counterId, impulseMeter->timerIntervallInSec());
+  }
+
+  LiveRate& liveRate = _liveRates[config.counterId];
+  if(liveRate.changePercent > 0){
+    liveRate.estimator.reset();
+    if(!impulseMeter->enableTimestamps(true)){
+      liveRate.changePercent = 0;
+    }
+  }
+  return true;
+}
+
+void MeterNode::_setReportPolicy(const CounterConfig& config){
+  CounterConfig& installed = _installedConfigs[config.counterId];
+  installed.report.mode = config.report.mode;
+  installed.report.relative = config.report.relative;
+  installed.report.threshold = config.report.threshold;
+  installed.report.maxSilenceInSec = config.report.maxSilenceInSec;
+  _reports[config.counterId].begin(installed.report);
+}
+
+void MeterNode::setMetricsPeriod(uint32_t periodInSec){
+  _scheduler.setPeriod(_metricsJob, periodInSec * 1000UL, Hal::millis());
+}
+
+void MeterNode::metricsPeriodMessage(const char* message){
+  uint32_t periodInSec;
+  if(!CommandParser::parseUInt(message, periodInSec) || periodInSec > 24 * 3600){
+    _logger->printError("Wrong MetricsPeriod message: '%s'", message);
+    return;
+  }
+  setMetricsPeriod(periodInSec);
+  _logger->printMessage("MetricsPeriod: %u s\n", (unsigned int)periodInSec);
+}
+
+void MeterNode::publishMetrics(){
+  const char* topic = _metricsTopic;
+  char payload[MAX_METRICS_PAYLOAD_SIZE];
+  int len = snprintf(payload, sizeof(payload), "N\t%u\t%u\t%lu\t%lu\nP\t%lu\t%lu\t%lu\t%lu\nL",
+    (unsigned int)Hal::freeHeap(), (unsigned int)Hal::largestFreeBlock(), _logger->dropped(), _logger->truncated(),
+    _metrics.published(), _metrics.failed(), _metrics.maxLatencyMs(), _metrics.averageLatencyMs());
+  for (size_t i = 0; i < Metrics::LOOP_BUCKETS; i++)
+  {
+    len += snprintf(payload + len, sizeof(payload) - len, "\t%lu", _metrics.loopBucket(i));
+  }
+
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    ImpulseMeter* impulseMeter = _impulseMeters[i];
+    if(impulseMeter == NULL){
+      continue;
+    }
+
+    const ImpulseSource* source = impulseMeter->source();
+    char line[112];
+    int lineLen = snprintf(line, sizeof(line), "\nC\t%u\t%lu\t%u\t%u\t%lu\t%lu\t%lu\t%lu", (unsigned int)i,
+      source != NULL ? source->interrupts() : 0, source != NULL ? (unsigned int)source->maxIsrCycles() : 0,
+      (unsigned int)impulseMeter->queueHighWater(), impulseMeter->queueOverflows(), impulseMeter->lateIntervalls(), impulseMeter->skippedIntervalls(),
+      _reports[i].coalesced());
+    _appendMetricsLine(topic, payload, len, line, lineLen);
+  }
+
+  char line[96];
+  int lineLen;
+  for (uint8_t i = 0; i < ExpanderBank::MAX_BANKS; i++)
+  {
+    const ExpanderBank* bank = ExpanderBank::bank(i);
+    if(bank != NULL){
+      lineLen = snprintf(line, sizeof(line), "\nX\t%u\t%lu\t%lu\t%lu\t%lu", (unsigned int)i, ExpanderBank::interrupts(), bank->reads(), bank->failedReads(), (unsigned long)bank->maxReadUs());
+      _appendMetricsLine(topic, payload, len, line, lineLen);
+    }
+  }
+
+  lineLen = snprintf(line, sizeof(line), "\nB\t%lu\t%lu\t%u", (unsigned long)(_countersArmedUs / 1000), (unsigned long)(_firstImpulseUs / 1000), (unsigned int)_restoredCounters);
+  _appendMetricsLine(topic, payload, len, line, lineLen);
+
+  const ClockAnchor& clock = ImpulseMeter::clock();
+  unsigned long restamped = 0;
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    if(_impulseMeters[i] != NULL){
+      restamped += _impulseMeters[i]->restampedIntervalls();
+    }
+  }
+  lineLen = snprintf(line, sizeof(line), "\nT\t%lu\t%lu\t%lld\t%lld\t%lu", (unsigned long)(clock.anchoredUs() / 1000), clock.steps(),
+    (long long)(clock.lastStepUs() / 1000), (long long)(clock.slewedUs() / 1000), restamped);
+  _appendMetricsLine(topic, payload, len, line, lineLen);
+  _mqttClient->publish(topic, payload);
+}
+
+void MeterNode::_appendMetricsLine(const char* topic, char* payload, int& len, const char* line, int lineLen){
+  if(len + lineLen >= (int)MAX_METRICS_PAYLOAD_SIZE){
+    // Continue without the leading line end in the next message.
+    _mqttClient->publish(topic, payload);
+    memcpy(payload, line + 1, lineLen);
+    len = lineLen - 1;
+  }else{
+    memcpy(payload + len, line, lineLen + 1);
+    len += lineLen;
+  }
+}
+
+void MeterNode::publishReady(){
+  _mqttClient->publish(_readyTopic, "", true);
+  _scheduler.postpone(_readyJob, Hal::millis(), PUBLISH_READY_PERIOD);
+}
+
+void MeterNode::requestReady(){
+  _scheduler.trigger(_readyRequestJob);
+  Hal::notifyEvent();
+}
+
+void MeterNode::requestRestart(){
+  _scheduler.trigger(_restartJob);
+  Hal::notifyEvent();
+}
+
+void MeterNode::publishStatus(){
+  int counters = getInstalledCounters();
+  char buff[160];
+  int len = 0;
+  if(_encoding == ENCODING_PACKED){
+    _packedEncoder.begin(PackedEncoder::TYPE_STATUS, Hal::utcTime());
+    _packedEncoder.addValue(Hal::bootTime());
+    _packedEncoder.addValue(counters);
+    _packedEncoder.addValue(_impulsesOverAll);
+    if(_totals != NULL){
+      _packedEncoder.addValue(_totals->overAll());
+      _packedEncoder.addValue(_totals->restoredOverAll());
+      _packedEncoder.addValue(_totals->restoredTime());
+    }
+    _packedEncoder.encode(buff, sizeof(buff));
+  }else{
+    char nowBuff[IsoTimeFormatter::BUFFER_SIZE];
+    char bootBuff[IsoTimeFormatter::BUFFER_SIZE];
+    len = snprintf(buff, sizeof(buff), "%s\t%s\t%d\t%lu", _timeFormatter.format(Hal::utcTime(), nowBuff), IsoTimeFormatter::render(Hal::bootTime(), bootBuff), counters, _impulsesOverAll);
+  }
+  if(_encoding == ENCODING_TEXT && _totals != NULL){
+    char restoredBuff[IsoTimeFormatter::BUFFER_SIZE] = "-";
+    if(_totals->restoredTime() != 0){
+      IsoTimeFormatter::render(_totals->restoredTime(), restoredBuff);
+    }
+    snprintf(buff + len, sizeof(buff) - len, "\t%llu\t%llu\t%s", (unsigned long long)_totals->overAll(), (unsigned long long)_totals->restoredOverAll(), restoredBuff);
+  }
+  _mqttClient->publish(_statusTopic, buff);
+
+  if(_totals == NULL || counters == 0){
+    return;
+  }
+  // Max. MAX_COUNTERS counters with "ID<TAB>total<LF>", the total has max. 20 digits.
+  char payload[MAX_COUNTERS * 24 + 1];
+  len = 0;
+  if(_encoding == ENCODING_PACKED){
+    _packedEncoder.begin(PackedEncoder::TYPE_TOTALS, Hal::utcTime());
+  }
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    if(_impulseMeters[i] == NULL){
+      continue;
+    }
+    if(_encoding == ENCODING_PACKED){
+      _packedEncoder.addValue(i);
+      _packedEncoder.addValue(_totals->total(i));
+    }else{
+      len += snprintf(payload + len, sizeof(payload) - len, "%s%u\t%llu", len > 0 ? "\n" : "", (unsigned int)i, (unsigned long long)_totals->total(i));
+    }
+  }
+  if(_encoding == ENCODING_PACKED){
+    _packedEncoder.encode(payload, sizeof(payload));
+  }
+  _mqttClient->publish(_totalsTopic, payload);
+}
+
+void MeterNode::_plotImpulses(ImpulseMeterStatus status)
+{
+  _impulsesOverAll += status.impulse;
+  if(_firstImpulseUs == 0 && status.impulse > 0){
+    _recordFirstImpulse();
+  }
+  if(_totals != NULL){
+    _totals->add(status.counterId, status.impulse);
+  }
+  if(_publishMode == PUBLISH_SINGLE){
+    char nowBuff[IsoTimeFormatter::BUFFER_SIZE];
+    char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+    _logger->printMessage("%s - Source: %s; Intervall in sec: %d; Time: %s; Impulses: %lu\n", _timeFormatter.format(Hal::utcTime(), nowBuff), status.sourceName, status.timerIntervallInSec, _timeFormatter.format(status.utcTime, timeBuff), status.impulse);
+  }
+
+  _publishRollups(status);
+  ImpulseMeterStatus record = status;
+  if(status.counterId < MAX_COUNTERS && !_reports[status.counterId].add(status, record)){
+    // Coalesced into the next record of the counter.
+    return;
+  }
+  _publishRecord(record);
+}
+
+void MeterNode::_publishRecord(const ImpulseMeterStatus& record){
+  if(_journal->append(record)){
+    // Published by _replayJournal()
+    return;
+  }
+
+  if(_publishMode == PUBLISH_BATCH){
+    _batch.add(record);
+  }else{
+    _publishSingle(record);
+  }
+}
+
+void MeterNode::flushReports(){
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    ImpulseMeterStatus record;
+    if(_reports[i].flush(record)){
+      _publishRecord(record);
+    }
+  }
+}
+
+bool MeterNode::_hasStartTime(const ImpulseMeterStatus& status) const {
+  return status.counterId < MAX_COUNTERS && _installedConfigs[status.counterId].report.mode != ReportPolicy::REPORT_ALWAYS;
+}
+
+bool MeterNode::_publishSingle(const ImpulseMeterStatus& status){
+  char payload[64];
+  if(_encoding == ENCODING_PACKED){
+    _packedEncoder.begin(PackedEncoder::TYPE_INTERVALLS, status.utcTime);
+    _packedEncoder.addIntervall(status);
+    _packedEncoder.encode(payload, sizeof(payload));
+  }else{
+    char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+    int len = snprintf(payload, sizeof(payload),"%s\t%lu", _timeFormatter.format(status.utcTime, timeBuff), status.impulse);
+    if(_hasStartTime(status)){
+      // A record of a counter with a report policy can contain coalesced intervalls, so its start is published too.
+      snprintf(payload + len, sizeof(payload) - len, "\t%s", IsoTimeFormatter::render(status.utcTime - status.timerIntervallInSec, timeBuff));
+    }
+  }
+  bool published = _mqttClient->publish(status.sourceName, payload, false);
+  _metrics.recordPublish(published, status.utcTime);
+  return published;
+}
+
+void MeterNode::_publishRollups(const ImpulseMeterStatus& status){
+  if(status.counterId >= MAX_COUNTERS || _rollups[status.counterId].levels() == 0){
+    return;
+  }
+
+  Rollup& rollup = _rollups[status.counterId];
+  Rollup::Record closed[Rollup::MAX_CLOSED];
+  size_t count = rollup.add(status.utcTime, status.impulse, closed);
+  for (size_t i = 0; i < count; i++)
+  {
+    const Rollup::LevelConfig& level = rollup.levelConfig(closed[i].level);
+    RollupMessage message;
+    char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+    snprintf(message.topic, sizeof(message.topic), "%s/%u", status.sourceName, (unsigned int)level.periodInSec);
+    snprintf(message.payload, sizeof(message.payload), "%s\t%lu", IsoTimeFormatter::render(closed[i].utcTime, timeBuff), closed[i].impulse);
+    message.retain = level.retain;
+    _publishRollup(message);
+  }
+}
+
+void MeterNode::_publishRollup(const RollupMessage& message){
+  // The kept rollups are published first, so the order stays.
+  if(_rollupRetries.empty() && _mqttClient->publish(message.topic, message.payload, message.retain)){
+    return;
+  }
+  if(!_rollupRetries.push(message)){
+    _logger->printError("Rollup %s lost, %u rollups wait for the MQTT connection\n", message.topic, (unsigned int)_rollupRetries.size());
+  }
+}
+
+void MeterNode::_retryRollups(){
+  RollupMessage* message;
+  while ((message = _rollupRetries.front()) != NULL && _mqttClient->publish(message->topic, message->payload, message->retain))
+  {
+    _rollupRetries.drop();
+  }
+}
+
+void MeterNode::_restart(){
+  flushReports();
+  _journal->storeCursor(true);
+  if(_totals != NULL){
+    _totals->checkpoint(true);
+  }
+  // The shutdown handler of the board doesn´t write the checkpoint again.
+  _restarting.store(true, std::memory_order_release);
+  Hal::restart();
+}
+
+void MeterNode::_storeCounterConfigs(){
+  if(_configStore == NULL){
+    return;
+  }
+
+  // One entry at a time, the store serializes them into its own buffer.
+  CounterConfigStore::Entry entry;
+  _configStore->clear();
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    if(_impulseMeters[i] != NULL && _impulseMeters[i]->isInstalled()){
+      memset(&entry, 0, sizeof(entry));
+      entry.counter = _installedConfigs[i];
+      entry.stormGuard = _stormStates[i].config;
+      entry.liveRateChangePercent = _liveRates[i].changePercent;
+      const Rollup& rollup = _rollups[i];
+      entry.rollupLevels = rollup.levels();
+      for (size_t level = 0; level < rollup.levels(); level++)
+      {
+        // Field by field, so the padding stays cleared.
+        entry.rollups[level].periodInSec = rollup.levelConfig(level).periodInSec;
+        entry.rollups[level].retain = rollup.levelConfig(level).retain;
+      }
+      _configStore->add(entry);
+    }
+  }
+  if(!_configStore->save()){
+    _logger->printError("Failed to store the counter configuration\n");
+  }
+}
+
+void MeterNode::_recordFirstImpulse(){
+  // The GPIO sources know the time of their first impulse, the other sources only have the intervall.
+  uint32_t firstUs = 0;
+  for (size_t i = 0; i < MAX_COUNTERS; i++)
+  {
+    const ImpulseSource* source = _impulseMeters[i] != NULL ? _impulseMeters[i]->source() : NULL;
+    uint32_t sourceUs = source != NULL ? source->firstImpulseUs() : 0;
+    if(sourceUs != 0 && (firstUs == 0 || sourceUs < firstUs)){
+      firstUs = sourceUs;
+    }
+  }
+  _firstImpulseUs = firstUs != 0 ? firstUs : Hal::micros();
+  _logger->printMessage("First impulse counted %lu ms after boot, counters armed after %lu ms\n", (unsigned long)(_firstImpulseUs / 1000), (unsigned long)(_countersArmedUs / 1000));
+}
+
+void MeterNode::_replayJournal(){
+  if(_journal->lost() != _reportedLostRecords){
+    _logger->printError("%lu journal records lost, the journal is full\n", _journal->lost() - _reportedLostRecords);
+    _reportedLostRecords = _journal->lost();
+  }
+
+  // The records of all meters are synced together, also while they can´t be published.
+  _journal->sync(false);
+  _ackDelivered();
+  if(!_mqttClient->isConnected()){
+    return;
+  }
+
+  // The records before the ack cursor may be dropped, because the ring was full.
+  if((int32_t)(_replaySeq - _journal->ackSeq()) < 0){
+    _replaySeq = _journal->ackSeq();
+  }
+  // The records in the open batch are already read.
+  uint32_t startSeq = _batch.records() > 0 ? _batchedSeq : _replaySeq;
+  uint32_t pending = _journal->headSeq() - startSeq;
+  uint32_t endSeq = startSeq + (pending < REPLAY_RECORDS_PER_UPDATE ? pending : REPLAY_RECORDS_PER_UPDATE);
+  Journal::Record record;
+  if(_publishMode == PUBLISH_BATCH){
+    // The batch only gets records of the journal, so the records are sent with their batch. The batch is kept over
+    // the updates until it is full, a record with a other end time is added or its flush deadline is reached.
+    for (uint32_t seq = startSeq; seq < endSeq && _sent.size() + 1 < SENT_QUEUE_SIZE; seq++)
+    {
+      // A unreadable record is skipped.
+      if(!_journal->read(seq, record)){
+        continue;
+      }
+      ImpulseMeterStatus status = Journal::toStatus(record);
+      if(!_batch.fits(status) && !_flushBatch()){
+        break;
+      }
+      _batch.add(status);
+      _batchedSeq = seq + 1;
+    }
+    if(_batch.isDue() && _sent.size() < SENT_QUEUE_SIZE){
+      _flushBatch();
+    }
+  }else{
+    for (uint32_t seq = startSeq; seq < endSeq && _sent.size() < SENT_QUEUE_SIZE; seq++)
+    {
+      if(_journal->read(seq, record) && !_publishSingle(Journal::toStatus(record))){
+        // Try it again in the next update.
+        break;
+      }
+      _recordsSent(seq + 1);
+    }
+  }
+
+  // A port without queue has delivered the messages already.
+  _ackDelivered();
+  _journal->storeCursor(false);
+}
+
+bool MeterNode::_flushBatch(){
+  bool hasRecords = _batch.records() > 0 && (int32_t)(_batchedSeq - _replaySeq) > 0;
+  // A batch which is not published is built again in the next update.
+  bool published = _batch.flush();
+  if(published && hasRecords){
+    _recordsSent(_batchedSeq);
+  }
+  return published;
+}
+
+void MeterNode::_recordsSent(uint32_t endSeq){
+  _sent.push({_mqttClient->lastTicket(), endSeq});
+  _replaySeq = endSeq;
+}
+
+void MeterNode::_ackDelivered(){
+  SentRecords* sent;
+  while ((sent = _sent.front()) != NULL)
+  {
+    MqttPort::Delivery delivery = _mqttClient->delivery(sent->ticket);
+    if(delivery == MqttPort::PENDING){
+      return;
+    }
+    if(delivery == MqttPort::REJECTED){
+      // Publish the records again from the first one which is not acked. The records of the messages after the
+      // rejected one may be published twice.
+      _logger->printError("MQTT message with journal records rejected, they are published again\n");
+      // The open batch is published too, its records are read again.
+      _batch.flush();
+      SentRecords dropped;
+      while (_sent.pop(dropped))
+      {
+      }
+      _replaySeq = _journal->ackSeq();
+      return;
+    }
+    _journal->ack(sent->endSeq);
+    _sent.drop();
+  }
+}
+
+void MeterNode::_plotImpulsesExt(ImpulseMeterStatus status){
+  if(_instance != NULL){
+    _instance->_plotImpulses(status);
+  }
+}
+
+MeterNode* MeterNode::_instance = NULL;
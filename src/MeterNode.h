@@ -0,0 +1,342 @@
+#ifndef METER_NODE_H
+#define METER_NODE_H
+#include <array>
+#include <atomic>
+#include "CommandParser.h"
+#include "CounterConfigStore.h"
+#include "ImpulseMeter.h"
+#include "IntervallBatch.h"
+#include "Journal.h"
+#include "Logger.h"
+#include "MeterTotals.h"
+#include "Metrics.h"
+#include "MqttPort.h"
+#include "ObjectPool.h"
+#include "RateEstimator.h"
+#include "ReportPolicy.h"
+#include "Rollup.h"
+#include "Scheduler.h"
+#include "SpscQueue.h"
+
+// Number of ImpulseMeters in the pool of the MeterNode, the max. number of installed counters. Every meter needs
+// about 1.3 KB of static memory, so with ExpanderBanks it may be smaller than MAX_COUNTERS, e.g. build with -DMETER_POOL_SIZE=40
+#ifndef METER_POOL_SIZE
+#define METER_POOL_SIZE MAX_COUNTERS
+#endif
+static_assert(METER_POOL_SIZE > 0 && METER_POOL_SIZE <= MAX_COUNTERS && METER_POOL_SIZE < 127, "METER_POOL_SIZE must be 1..MAX_COUNTERS and below 127");
+static_assert(CounterConfig::MAX_SOURCE_NAME_LEN <= ImpulseMeter::MAX_SOURCE_NAME_LEN, "The meters must store the source names");
+
+// The MQTT interface of a node: install the counters, publish the collected impulses,
+// the status and the ready message. Only depends on the MqttPort and the Hal, so it runs
+// on the ESP32 and in the native build.
+// The meters, their names and the topics of the node have a fixed size, which is allocated with the node. After begin()
+// the node allocates no heap memory, also not when counters are installed again, so the heap can´t get fragmented.
+class MeterNode
+{
+public:
+	// How the closed intervalls are published.
+	enum PublishMode
+	{
+		PUBLISH_SINGLE,			// One message per counter to the topic <SourceName>
+		PUBLISH_BATCH			// One message for all counters with the same intervall end to the topic Impulses/<myName>
+	};
+
+	// The encoding of the intervalls, the status and the totals.
+	enum Encoding
+	{
+		ENCODING_TEXT,			// TAB separated text with ISO times
+		ENCODING_PACKED			// Base64 text of the PackedEncoder messages
+	};
+
+	//**** user functions
+	// Setup the node. myName is used in the topics of this node, a longer name than MAX_NAME_LEN is cut.
+	void begin(const char* myName, MqttPort* mqttClient, Logger* logger);
+	// Subscribe the topics of this node, call it after the MQTT connection is established.
+	void setupMqttSubscriber();
+	// Publish the status and ready messages and the collected impulses if they are due.
+	// loop should be called in the loop() function of main.c. Returns the time in ms until the next job is due,
+	// the caller can sleep this time with Hal::waitForEvent(), it is woken up when a intervall is closed.
+	unsigned long loop();
+
+	// Select how the closed intervalls are published. In PUBLISH_BATCH mode the batch is published after flushDeadlineMs
+	// or when the payload would get larger than maxPayloadSize.
+	void setPublishMode(PublishMode mode, unsigned long flushDeadlineMs = 0, size_t maxPayloadSize = IntervallBatch::MAX_PAYLOAD_SIZE);
+	// Set the publish mode with a message: "SINGLE" or "BATCH" with optional flush deadline in ms and max payload size separated by TAB
+	void publishModeMessage(const char* message);
+	// Select the encoding of the intervalls, the status and the totals. The rollups, the metrics and the log stay text.
+	void setEncoding(Encoding encoding);
+	// Negotiate the encoding with a message: "TEXT" or "PACKED" with the highest version the consumer decodes separated by TAB.
+	// The node selects the highest version it knows and publishes the selected encoding retained to Encoding/<myName>:
+	// "TEXT" or "PACKED<TAB><version>".
+	void encodingMessage(const char* message);
+
+	// Store every closed intervall in the journal before it is published. The records are acked when the MqttPort
+	// delivered their message, the records which can´t be published, e.g. while the MQTT connection is lost, are published
+	// later from the journal. Without journal (NULL) the records wait in a small journal in RAM.
+	void setJournal(Journal* journal);
+	// Keep the cumulative impulses of every counter in totals, which are restored after a restart.
+	// A checkpoint is written after the intervalls are published and before a restart.
+	void setTotals(MeterTotals* totals);
+	// Store the installed counters with their StormGuard in the store and install the stored counters now, so the impulses
+	// are counted from the boot on. Call it in setup() before the WiFi is started. An InstallCounter message with the
+	// installed configuration changes nothing, so the counting goes on when the controller installs the counters again.
+	void setConfigStore(CounterConfigStore* configStore);
+
+	// Install a counter to get the impulses.
+	// The message has a ID, SourceName, a intervall and optional the counting backend ("GPIO" or "PCNT") separated by TAB.
+	// After the backend can follow the report policy, see CommandParser::parseInstallCounter(). A counter with a other
+	// policy than "ALWAYS" publishes only some intervalls, the others are coalesced into the next record, which then is
+	// longer than the intervall. Its text payload has the start time as third field: "<end time><TAB><impulses><TAB><start time>".
+	// A new policy of a installed counter doesn´t restart the counting.
+	void installCounter(const char* message);
+	// Install many counters with one message, one InstallCounter message per line.
+	// If one line is wrong, there is no free meter for it or its source can´t be installed, no counter is changed.
+	// The result is published to InstallResult/<myName>: "OK<TAB>installed<TAB>0" or "ERROR<TAB>line<TAB>reason"
+	void installCounters(const char* message);
+	// Publish the live rate of a counter in impulses per hour to Rate/<SourceName> when it changes.
+	// The message has the ID and the change in percent which is published, 0 to stop, separated by TAB.
+	// The payload is the rate and the min. and max. rate of the current intervall separated by TAB.
+	// Only counters with the GPIO backend have the time stamps of the impulses for the rate.
+	void liveRateMessage(const char* message);
+	// Set the debouncing and the interrupt storm protection of a counter with the GPIO backend.
+	// The message has the ID, the min. impulse spacing in us and the max. interrupts per second separated by TAB.
+	// If a interrupt storm is detected, the pin is sampled until the rate is normal again and a error is logged.
+	void stormGuardMessage(const char* message);
+	// Sum the intervalls of a counter into longer, epoch aligned intervalls, e.g. for 15 minute, hourly and daily totals.
+	// The message has the ID and up to 4 periods in seconds separated by TAB, the periods must be multiples of the intervall
+	// of the counter. A period with a trailing 'R' is published retained. Without period the rollups are removed.
+	// Every level is published to <SourceName>/<period> like a intervall: "<end time><TAB><impulses>".
+	// The levels are not stored in the journal.
+	void rollupMessage(const char* message);
+	// Publish the metrics to Metrics/<myName> every periodInSec, 0 to stop.
+	void setMetricsPeriod(uint32_t periodInSec);
+	// Set the metrics period with a message, the period in seconds.
+	void metricsPeriodMessage(const char* message);
+	// Publish the metrics of the node and the counters to Metrics/<myName>. The payload has one line per group
+	// of metrics, the first field is the name of the group. The values are separated by TAB:
+	//   N  <free heap>  <largest free block>  <dropped log messages>  <truncated log messages>
+	//   P  <published>  <failed>  <max. latency ms>  <average latency ms>
+	//   L  <loop runs < 1 ms>  < 2 ms  < 5 ms  < 10 ms  < 50 ms  < 100 ms  < 500 ms  >= 500 ms
+	//   C  <CounterId>  <interrupts>  <max. ISR cycles>  <queue high water>  <queue overflows>  <late intervalls>  <skipped intervalls>
+	//      <coalesced intervalls>
+	//   X  <bank>  <interrupts of the shared line>  <reads>  <failed reads>  <max. read us>
+	//      One line per ExpanderBank, see EXPANDER_BANKS.
+	//   B  <ms from boot until the first counter was installed>  <ms from boot until the first counted impulse>  <restored counters>
+	//      The times are 0 until the event happened. The time of the first impulse is exact for the GPIO backend,
+	//      for the other backends it is the time when the first intervall with impulses was published.
+	//   T  <ms from boot until the UTC time was known>  <clock steps>  <last step ms>  <slewed ms>  <intervalls stamped after the sync>
+	//      The intervalls are timed by the monotonic clock, the UTC time only gives their end times, see ClockAnchor.
+	// If the payload gets too large, the C lines are continued in the next message.
+	void publishMetrics();
+	// Publish the "Ready" message, the controller then sends the InstallCounter messages.
+	void publishReady();
+	// Publish the "Ready" message in the next loop() call. Can be called from any task, e.g. when the MQTT connection is established.
+	void requestReady();
+	// Publish the coalesced intervalls of the report policies, or store them in the journal, called before a restart.
+	void flushReports();
+	// Write the coalesced intervalls, the journal cursor and the totals and restart the board in the next loop() call.
+	// Can be called from any task, e.g. if the time is not valid after the MQTT connection is established.
+	void requestRestart();
+	// True after the node started the restart, then the journal cursor and the totals are already written.
+	bool isRestarting() const { return _restarting.load(std::memory_order_acquire); }
+	// Publish the current time, boot time, number of counters and all impulses since boot to Status/<myName>.
+	// With totals the total impulses, the restored impulses and the time of the restored checkpoint follow, and
+	// the total of every installed counter is published to Totals/<myName>, one "<CounterId><TAB><total>" per line.
+	// With ENCODING_PACKED the payloads are the TYPE_STATUS and TYPE_TOTALS messages of the PackedEncoder.
+	void publishStatus();
+	// Number of installed counters.
+	int getInstalledCounters();
+	// All impulses since boot.
+	unsigned long impulsesOverAll() const { return _impulsesOverAll; }
+
+	// Upper limits of the messages which one loop() publishes, for the queue of a MqttPort like the MqttHandoff:
+	// a intervall and a closed level of every rollup of every counter, the status with the totals, the metrics and the replies.
+	constexpr static size_t maxLoopMessages()
+	{
+		return MAX_COUNTERS * (1 + Rollup::MAX_LEVELS) + 2 + MAX_METRICS_MESSAGES + 3;
+	}
+	// The sum of the topic and payload lengths of these messages.
+	constexpr static size_t maxLoopLen()
+	{
+		return MAX_COUNTERS * (CounterConfig::MAX_SOURCE_NAME_LEN + MAX_RECORD_PAYLOAD_LEN)
+			+ MAX_COUNTERS * Rollup::MAX_LEVELS * (sizeof(RollupMessage::topic) + sizeof(RollupMessage::payload))
+			+ 2 * TOPIC_SIZE + MAX_STATUS_PAYLOAD_SIZE + MAX_COUNTERS * 24
+			+ MAX_METRICS_MESSAGES * (TOPIC_SIZE + MAX_METRICS_PAYLOAD_SIZE) + 3 * (TOPIC_SIZE + 64);
+	}
+
+private:
+	const static unsigned long PUBLISH_READY_PERIOD = 5 * 1000;			// 5 Sec.
+	const static unsigned long HEARTBEAT_PERIOD = 60 * 1000;			// 1 minute
+	const static unsigned long IMPULSE_METER_UPDATE_PERIOD = 1 * 1000;	// 1 Sec
+	const static uint32_t REPLAY_RECORDS_PER_UPDATE = 100;				// Max. records published from the journal per update
+	const static unsigned long LIVE_RATE_PERIOD = 500;					// 0,5 Sec.
+	const static uint32_t DEFAULT_METRICS_PERIOD_IN_SEC = 300;			// 5 minutes
+	const static size_t MAX_METRICS_PAYLOAD_SIZE = 512;
+	// The metrics messages with a line for every counter and bank and the other lines.
+	const static size_t MAX_METRICS_MESSAGES = (MAX_COUNTERS + EXPANDER_BANKS + 4) * 112 / MAX_METRICS_PAYLOAD_SIZE + 1;
+	const static size_t MAX_STATUS_PAYLOAD_SIZE = 160;
+	const static size_t MAX_RECORD_PAYLOAD_LEN = 63;					// A single intervall
+	// The journal in RAM, if no journal is set, keeps the records of some intervalls until they are delivered.
+	const static uint32_t RAM_JOURNAL_SEGMENTS = 4;
+	const static uint32_t RAM_JOURNAL_RECORDS = METER_POOL_SIZE;		// Per segment
+	const static size_t SENT_QUEUE_SIZE = 128;						// Must be a power of two
+	const static size_t ROLLUP_RETRY_SIZE = 32;						// Must be a power of two
+	// The longest name of the node, so the topics with a prefix and a command fit into MqttPort::MAX_TOPIC_LEN.
+	const static size_t MAX_NAME_LEN = 31;
+	const static size_t TOPIC_SIZE = MqttPort::MAX_TOPIC_LEN + 1;
+
+	// A closed rollup level.
+	struct RollupMessage
+	{
+		char topic[CounterConfig::MAX_SOURCE_NAME_LEN + 12];		// <SourceName>/<period>
+		char payload[40];
+		bool retain;
+	};
+
+	// Journal records which are published in a message of the MqttPort.
+	struct SentRecords
+	{
+		uint32_t ticket;											// The ticket of the message, see MqttPort::lastTicket()
+		uint32_t endSeq;											// The records before are acked when the message is delivered
+	};
+
+	// The live rate of a counter.
+	struct LiveRate
+	{
+		uint32_t changePercent;										// Publish if the rate changed more, 0 if not used
+		float publishedRate;										// The last published rate
+		RateEstimator estimator;
+	};
+
+	char _myName[MAX_NAME_LEN + 1];									// The name of this node
+	// The topics of the published messages, built in begin().
+	char _statusTopic[TOPIC_SIZE];									// Status/<myName>
+	char _totalsTopic[TOPIC_SIZE];									// Totals/<myName>
+	char _metricsTopic[TOPIC_SIZE];									// Metrics/<myName>
+	char _readyTopic[TOPIC_SIZE];									// Ready/<myName>
+	char _installResultTopic[TOPIC_SIZE];							// InstallResult/<myName>
+	char _encodingTopic[TOPIC_SIZE];								// Encoding/<myName>
+	char _impulsesTopic[TOPIC_SIZE];								// Impulses/<myName>
+	MqttPort* _mqttClient;
+	Logger* _logger;
+	std::array<ImpulseMeter*, MAX_COUNTERS> _impulseMeters;			// The installed meters, the index is the CounterId
+	ObjectPool<ImpulseMeter, METER_POOL_SIZE> _meterPool;			// The storage of the meters
+	unsigned long _impulsesOverAll;									// All impulses since boot
+	Scheduler _scheduler;											// Run the jobs of the node
+	int _readyJob;													// Publish Ready while no counter is installed
+	int _readyRequestJob;											// Publish Ready, triggered by requestReady()
+	int _restartJob;												// Restart the board, triggered by requestRestart()
+	int _heartbeatJob;												// Publish the status
+	int _updateJob;													// Publish the closed intervalls, triggered by the intervall timer
+	int _liveRateJob;												// Publish the live rates
+	int _metricsJob;												// Publish the metrics
+	Metrics _metrics;
+	LiveRate _liveRates[MAX_COUNTERS];								// The index is the CounterId
+
+	// The interrupt storm protection of a counter.
+	struct StormState
+	{
+		StormGuard::Config config;									// Set again if the source is changed
+		unsigned long reportedStorms;								// Storms which are already logged
+		bool sampling;												// The last logged state
+	};
+	StormState _stormStates[MAX_COUNTERS];							// The index is the CounterId
+	Rollup _rollups[MAX_COUNTERS];									// The index is the CounterId
+	ReportPolicy _reports[MAX_COUNTERS];							// The index is the CounterId
+	PublishMode _publishMode;
+	Encoding _encoding;
+	PackedEncoder _packedEncoder;									// Encode the single intervalls, the status and the totals
+	IsoTimeFormatter _timeFormatter;								// Format the times of the published intervalls
+	IntervallBatch _batch;											// Collect the intervalls in PUBLISH_BATCH mode
+	Journal* _journal;												// Store the intervalls until they are delivered, the flash journal or _ramJournal
+	RamSegmentStorage<RAM_JOURNAL_SEGMENTS, RAM_JOURNAL_RECORDS * sizeof(Journal::Record)> _ramStorage;
+	Journal _ramJournal;											// Used if no journal is set
+	uint32_t _replaySeq;											// The next record of the journal which is published
+	uint32_t _batchedSeq;											// The record of the journal after the records in _batch
+	SpscQueue<SentRecords, SENT_QUEUE_SIZE> _sent;					// The published records which wait for the delivery
+	SpscQueue<RollupMessage, ROLLUP_RETRY_SIZE> _rollupRetries;		// The rollups which are not published yet
+	MeterTotals* _totals;											// The cumulative impulses, NULL if not used
+	CounterConfigStore* _configStore;								// The stored counters, NULL if not used
+	CounterConfig _installedConfigs[MAX_COUNTERS];					// The configuration of the installed meters, the index is the CounterId
+	size_t _restoredCounters;										// Counters which are installed from the _configStore
+	int64_t _countersArmedUs;										// Hal::micros() when the first counter was installed, 0 before
+	int64_t _firstImpulseUs;										// Hal::micros() of the first counted impulse, 0 before
+	bool _clockAnchorReported = false;
+	std::atomic<bool> _restarting{false};							// Set by _restart(), read by the shutdown handler
+	unsigned long _reportedClockSteps = 0;
+	unsigned long _reportedLostRecords;								// Lost journal records which are already logged
+
+	CounterConfig _counterConfigs[MAX_COUNTERS];					// The parsed lines of a bulk InstallCounter message, then the configs for the rollback
+
+	// Install the parsed lines of a bulk message in _counterConfigs. If one line fails, all lines are rolled back.
+	// Returns NULL or the reason of the failure, errorIndex is the index of the failed line in _counterConfigs.
+	const char* _installCounters(size_t count, size_t& errorIndex);
+	// Install the previous configuration of a counter again, a counter without source name is removed.
+	void _restoreCounter(const CounterConfig& previous);
+	// Install or update the counter. Returns false if the counter can´t count, then a updated counter keeps its previous
+	// configuration and a new counter is not added.
+	bool _installCounter(const CounterConfig& config);
+	// Publish the impulses of a closed intervall.
+	void _plotImpulses(ImpulseMeterStatus status);
+	// Store the record in the journal or publish it.
+	void _publishRecord(const ImpulseMeterStatus& record);
+	// Publish the impulses of a intervall to the topic <SourceName>.
+	bool _publishSingle(const ImpulseMeterStatus& status);
+	// True if the text payload of the record has the start time, because its counter has a report policy.
+	bool _hasStartTime(const ImpulseMeterStatus& status) const;
+	// Set the report policy of a installed counter.
+	void _setReportPolicy(const CounterConfig& config);
+	// Set the rollup levels of a installed counter. Returns false and keeps the current levels if they don´t fit the intervall.
+	bool _setRollup(uint8_t counterId, const Rollup::LevelConfig* levels, size_t count);
+	// Set the live rate of a counter. Returns false and disables it if the counter has no time stamps.
+	bool _setLiveRate(uint8_t counterId, uint32_t changePercent);
+	// Add the intervall to the rollups of the counter and publish the closed levels.
+	void _publishRollups(const ImpulseMeterStatus& status);
+	// Publish the closed level of a rollup, or keep it for the next update if it can´t be published now.
+	void _publishRollup(const RollupMessage& message);
+	// Publish the kept rollups.
+	void _retryRollups();
+	// Publish the not published records of the journal.
+	void _replayJournal();
+	// Publish the batch in PUBLISH_BATCH mode, its journal records are sent if it is published.
+	bool _flushBatch();
+	// The records up to endSeq are published with the last message of the port.
+	void _recordsSent(uint32_t endSeq);
+	// Ack the records of the delivered messages. After a rejected message the records are published again.
+	void _ackDelivered();
+	// Flush the report policies, store the journal cursor and the totals and restart the board.
+	void _restart();
+	// Store the configuration of the installed counters in the _configStore.
+	void _storeCounterConfigs();
+	// Take the time of the first counted impulse, called with the first intervall which has impulses.
+	void _recordFirstImpulse();
+	// Subscribe the topic <myName>/<command>.
+	void _subscribe(const char* command, MqttPort::message_handler_t handler);
+	// Log when the UTC time gets known and every clock step.
+	void _reportClock();
+	// Append a line to the metrics payload, a full payload is published before and the line starts the next one.
+	void _appendMetricsLine(const char* topic, char* payload, int& len, const char* line, int lineLen);
+
+	//**** scheduler jobs, arg is the MeterNode
+	static void _readyJobExt(void* arg);
+	static void _readyRequestJobExt(void* arg);
+	static void _restartJobExt(void* arg);
+	static void _heartbeatJobExt(void* arg);
+	static void _updateJobExt(void* arg);
+	static void _liveRateJobExt(void* arg);
+	static void _metricsJobExt(void* arg);
+	// Called by the intervall timer task, triggers the update job and wakes up the main task.
+	static void _onIntervallClosed(void* arg);
+	// Update the impulse meters, publish the closed intervalls and the journal.
+	void _update();
+	// Estimate the live rates with the time stamps and publish the changed rates.
+	void _updateLiveRates();
+	// Log the interrupt storms and the end of them.
+	void _reportStorms(size_t counterId);
+
+	// The ImpulseMeter callback can´t be a member function, therfor use this static function and instance.
+	static void _plotImpulsesExt(ImpulseMeterStatus status);
+	static MeterNode* _instance;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <string.h>
+#include "MeterTotals.h"
+#include "Hal.h"
+#include "Journal.h"
+
+bool MeterTotals::begin(JournalStorage* storage, uint32_t slots, uint32_t minPeriodInSec){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _storage = storage;
+    _slots = slots;
+    _minPeriodMs = minPeriodInSec * 1000UL;
+    memset(&_current, 0, sizeof(_current));
+    _current.seq = 1;
+    _changed = false;
+    _writes = 0;
+    _restoredOverAll = 0;
+    _restoredTime = 0;
+    if(_storage == NULL || _slots == 0){
+        return false;
+    }
+
+    // The newest valid checkpoint wins, a checkpoint which was written during a power fail has a wrong CRC.
+    Checkpoint checkpoint;
+    for (uint32_t i = 0; i < _slots; i++)
+    {
+        if(_storage->readData(i * sizeof(Checkpoint), &checkpoint, sizeof(Checkpoint)) && checkpoint.seq != 0 && checkpoint.seq % _slots == i
+            && checkpoint.crc == _checkpointCrc(checkpoint) && checkpoint.seq >= _current.seq){
+            _current = checkpoint;
+            _current.seq = checkpoint.seq + 1;
+            _restoredTime = checkpoint.utcTime;
+        }
+    }
+    for (int i = 0; i < MAX_COUNTERS; i++)
+    {
+        _restoredOverAll += _current.totals[i];
+    }
+    _checkpointTime = Hal::millis();
+    return true;
+}
+
+void MeterTotals::add(uint8_t counterId, unsigned long impulse){
+    if(counterId >= MAX_COUNTERS || impulse == 0){
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _current.totals[counterId] += impulse;
+    _changed = true;
+}
+
+bool MeterTotals::checkpoint(bool force){
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_storage == NULL || !_changed || (!force && Hal::millis() - _checkpointTime < _minPeriodMs)){
+        return true;
+    }
+
+    Checkpoint checkpoint = _current;
+    checkpoint.utcTime = Hal::utcTime();
+    checkpoint.crc = _checkpointCrc(checkpoint);
+    // The time is also set if the write fails, so a broken storage is not written in every loop.
+    _checkpointTime = Hal::millis();
+    if(!_storage->writeData((checkpoint.seq % _slots) * sizeof(Checkpoint), &checkpoint, sizeof(Checkpoint))){
+        return false;
+    }
+    _current.seq++;
+    _changed = false;
+    _writes++;
+    return true;
+}
+
+uint64_t MeterTotals::total(uint8_t counterId){
+    std::lock_guard<std::mutex> lock(_mutex);
+    return counterId < MAX_COUNTERS ? _current.totals[counterId] : 0;
+}
+
+uint64_t MeterTotals::overAll(){
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t overAll = 0;
+    for (int i = 0; i < MAX_COUNTERS; i++)
+    {
+        overAll += _current.totals[i];
+    }
+    return overAll;
+}
+
+uint32_t MeterTotals::_checkpointCrc(Checkpoint checkpoint){
+    checkpoint.crc = 0;
+    return Journal::crc32(&checkpoint, sizeof(checkpoint));
+}
@@ -0,0 +1,64 @@
+#ifndef METER_TOTALS_H
+#define METER_TOTALS_H
+#include <stdint.h>
+#include <mutex>
+#include "ImpulseMeter.h"
+#include "JournalStorage.h"
+
+// The cumulative impulses of every counter, which survive a restart. The totals are written as checkpoint into a ring
+// of slots in the data area of the storage. Every checkpoint goes into the next slot, so the writes are spread over all
+// slots, and the newest checkpoint with a valid CRC is restored by begin(). A checkpoint is only written if the totals
+// changed and the last checkpoint is minPeriodInSec ago, or if it is forced, e.g. before a restart.
+// The impulses of the open intervalls and the impulses after the last checkpoint are lost by a power fail.
+// All functions are thread-safe, so a checkpoint can be forced from any task.
+class MeterTotals
+{
+public:
+	const static uint32_t DEFAULT_SLOTS = 8;
+	const static uint32_t DEFAULT_MIN_PERIOD_IN_SEC = 15 * 60;
+
+	// A checkpoint in a slot of the storage.
+	struct Checkpoint
+	{
+		uint32_t seq;								// Sequence number, 0 is not used
+		uint32_t crc;								// CRC32 of the checkpoint with crc = 0
+		int64_t utcTime;							// The time of the checkpoint
+		uint64_t totals[MAX_COUNTERS];				// The impulses of every counter, the index is the CounterId
+	};
+
+	//**** user functions
+	// Open the ring with the given number of slots in the storage and restore the newest checkpoint.
+	bool begin(JournalStorage* storage, uint32_t slots, uint32_t minPeriodInSec);
+	// Add the impulses of a closed intervall.
+	void add(uint8_t counterId, unsigned long impulse);
+	// Write a checkpoint, if the totals changed and the last checkpoint is minPeriodInSec ago or force is true.
+	// Returns false if the write failed.
+	bool checkpoint(bool force);
+
+	// The total of a counter, including the restored total.
+	uint64_t total(uint8_t counterId);
+	// The total of all counters, including the restored totals.
+	uint64_t overAll();
+	// The total of all counters of the restored checkpoint.
+	uint64_t restoredOverAll() const { return _restoredOverAll; }
+	// The time of the restored checkpoint, 0 if nothing was restored.
+	time_t restoredTime() const { return _restoredTime; }
+	// Number of written checkpoints since begin().
+	unsigned long writes() const { return _writes; }
+
+private:
+	JournalStorage* _storage = NULL;
+	uint32_t _slots = 0;											// Number of slots in the ring
+	unsigned long _minPeriodMs = 0;
+	Checkpoint _current;											// The current totals, seq is the sequence number of the next checkpoint
+	bool _changed = false;											// True, if the totals changed since the last checkpoint
+	unsigned long _checkpointTime = 0;								// Time in ms of the last checkpoint
+	unsigned long _writes = 0;
+	uint64_t _restoredOverAll = 0;
+	time_t _restoredTime = 0;
+	std::mutex _mutex;												// Protect the totals against a checkpoint of a other task
+
+	static uint32_t _checkpointCrc(Checkpoint checkpoint);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "Metrics.h"
+#include "Hal.h"
+
+// Upper limits of the loop buckets in ms.
+static const unsigned long LOOP_BUCKET_LIMITS_MS[Metrics::LOOP_BUCKETS - 1] = {1, 2, 5, 10, 50, 100, 500};
+
+void Metrics::recordLoop(int64_t durationUs){
+    size_t bucket = 0;
+    while (bucket < LOOP_BUCKETS - 1 && durationUs >= (int64_t)LOOP_BUCKET_LIMITS_MS[bucket] * 1000)
+    {
+        bucket++;
+    }
+    _loopBuckets[bucket]++;
+}
+
+void Metrics::recordPublish(bool published, time_t intervallEnd){
+    if(!published){
+        _failed++;
+        return;
+    }
+
+    _published++;
+    int64_t latencyMs = Hal::utcTimeMs() - (int64_t)intervallEnd * 1000;
+    if(latencyMs < 0){
+        latencyMs = 0;
+    }
+    _latencySumMs += latencyMs;
+    if(latencyMs > (int64_t)_maxLatencyMs){
+        _maxLatencyMs = latencyMs;
+    }
+}
+
+unsigned long Metrics::loopBucketLimitMs(size_t bucket){
+    return bucket < LOOP_BUCKETS - 1 ? LOOP_BUCKET_LIMITS_MS[bucket] : 0;
+}
@@ -0,0 +1,39 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Runtime metrics of the node for the capacity planning: the publish results and latency and the duration of
+// the loop() runs. The functions only increment counters or compare a maximum, so they can be used in hot paths.
+// The metrics of the counters are kept by the ImpulseMeter and its source, the MeterNode publishes all together.
+// All functions must be called by the same task.
+class Metrics
+{
+public:
+	const static size_t LOOP_BUCKETS = 8;
+
+	// Count a run of loop() in the histogram.
+	void recordLoop(int64_t durationUs);
+	// Count a publish of the intervalls which end at intervallEnd.
+	void recordPublish(bool published, time_t intervallEnd);
+
+	// Number of loop() runs in the bucket. The upper limit of the bucket is loopBucketLimitMs(), the last bucket has all longer runs.
+	unsigned long loopBucket(size_t bucket) const { return bucket < LOOP_BUCKETS ? _loopBuckets[bucket] : 0; }
+	static unsigned long loopBucketLimitMs(size_t bucket);
+	// Number of successful and failed publishes.
+	unsigned long published() const { return _published; }
+	unsigned long failed() const { return _failed; }
+	// The max. and average time in ms from the intervall end to the successful publish.
+	unsigned long maxLatencyMs() const { return _maxLatencyMs; }
+	unsigned long averageLatencyMs() const { return _published > 0 ? _latencySumMs / _published : 0; }
+
+private:
+	unsigned long _loopBuckets[LOOP_BUCKETS] = {};
+	unsigned long _published = 0;
+	unsigned long _failed = 0;
+	unsigned long _maxLatencyMs = 0;
+	uint64_t _latencySumMs = 0;
+};
+
+#endif
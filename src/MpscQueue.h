@@ -0,0 +1,111 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// A fixed size ring buffer for many producers and one consumer, without a lock.
+// Every cell has a sequence number, which tells the producers and the consumer if the cell is free or filled.
+// A producer reserves a cell by moving the head with compare and swap, so the producers never wait for each other.
+// A cell which is reserved but not yet filled stops pop() until the producer finished it.
+// All storage is part of the object, so push() and pop() never allocate memory. Not for ISRs.
+template <typename T, size_t CAPACITY>
+class MpscQueue
+{
+	static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+	MpscQueue()
+	{
+		for (size_t i = 0; i < CAPACITY; i++)
+		{
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	//**** producer functions, can be called from many tasks
+	// Add a item to the queue. Returns false and counts a overflow if the queue is full.
+	bool push(const T& item)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true)
+		{
+			cell = &_cells[head & MASK];
+			intptr_t diff = (intptr_t)cell->sequence.load(std::memory_order_acquire) - (intptr_t)head;
+			if (diff == 0)
+			{
+				// The cell is free, reserve it.
+				if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// The cell still has the item of the last round.
+				_overflows.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			else
+			{
+				// A other producer took the cell.
+				head = _head.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->item = item;
+		cell->sequence.store(head + 1, std::memory_order_release);
+
+		size_t used = head + 1 - _tail.load(std::memory_order_relaxed);
+		size_t highWater = _highWater.load(std::memory_order_relaxed);
+		while (used > highWater && !_highWater.compare_exchange_weak(highWater, used, std::memory_order_relaxed))
+		{
+		}
+		return true;
+	}
+
+	//**** consumer functions
+	// Take the oldest item from the queue. Returns false if the queue is empty or the oldest item is not finished.
+	bool pop(T& item)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		Cell& cell = _cells[tail & MASK];
+		if (cell.sequence.load(std::memory_order_acquire) != tail + 1)
+		{
+			return false;
+		}
+
+		item = cell.item;
+		// Free the cell for the next round.
+		cell.sequence.store(tail + CAPACITY, std::memory_order_release);
+		_tail.store(tail + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	//**** status functions, can be called from all sides
+	bool empty() const { return size() == 0; }
+	size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+	constexpr size_t capacity() const { return CAPACITY; }
+	// Number of items which are rejected by push() because the queue was full.
+	unsigned long overflows() const { return _overflows.load(std::memory_order_relaxed); }
+	// The maximum number of items which was stored at the same time.
+	size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+	const static size_t MASK = CAPACITY - 1;
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;				// The head which may fill the cell, + 1 when it is filled
+		T item;
+	};
+
+	Cell _cells[CAPACITY];
+	std::atomic<size_t> _head{0};					// Next cell to reserve, changed by the producers
+	std::atomic<size_t> _tail{0};					// Next cell to read, only changed by the consumer
+	std::atomic<unsigned long> _overflows{0};		// Rejected items
+	std::atomic<size_t> _highWater{0};				// Maximum fill level
+};
+
+#endif
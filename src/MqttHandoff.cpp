@@ -0,0 +1,148 @@
+#include <string.h>
+#include "MqttHandoff.h"
+
+bool MqttHandoff::publish(const char* topic, const char* payload, bool retain){
+    // Don´t fill the ring while the connection is lost, the journal keeps the records until it is back.
+    size_t topicLen = strlen(topic);
+    size_t payloadLen = strlen(payload);
+    if(!isConnected() || topicLen > MAX_TOPIC_LEN || payloadLen > MAX_PAYLOAD_LEN){
+        return false;
+    }
+
+    uint8_t* entry = _outbound.reserve(sizeof(OutboundHeader) + topicLen + payloadLen + 2);
+    if(entry == NULL){
+        return false;
+    }
+    OutboundHeader* message = (OutboundHeader*)entry;
+    message->queuedTime = Hal::millis();
+    message->ticket = ++_lastTicket;
+    message->topicLen = topicLen;
+    message->retain = retain;
+    char* text = (char*)(message + 1);
+    memcpy(text, topic, topicLen + 1);
+    memcpy(text + topicLen + 1, payload, payloadLen + 1);
+    _outbound.commit();
+    return true;
+}
+
+MqttPort::Delivery MqttHandoff::delivery(uint32_t ticket){
+    if((int32_t)(_doneTicket.load(std::memory_order_acquire) - ticket) < 0){
+        return PENDING;
+    }
+
+    unsigned long rejected = _rejected.load(std::memory_order_acquire);
+    unsigned long first = rejected > REJECTED_HISTORY ? rejected - REJECTED_HISTORY : 0;
+    for (unsigned long i = first; i < rejected; i++)
+    {
+        if(_rejectedTickets[i % REJECTED_HISTORY].load(std::memory_order_relaxed) == ticket){
+            return REJECTED;
+        }
+    }
+    // The history doesn´t reach back to the ticket, so it may be rejected. The network task may replace the
+    // oldest ticket at the same time, but only with a newer one.
+    if(rejected >= REJECTED_HISTORY && (int32_t)(ticket - _rejectedTickets[first % REJECTED_HISTORY].load(std::memory_order_relaxed)) < 0){
+        return REJECTED;
+    }
+    return DELIVERED;
+}
+
+void MqttHandoff::dispatch(){
+    // The handlers get the message in the queue, a copy of it would need MAX_PAYLOAD_LEN of the stack.
+    InboundMessage* message;
+    while ((message = _inbound.front()) != NULL)
+    {
+        if(message->subscription >= 0 && message->subscription < _subscriptionCount.load(std::memory_order_acquire)){
+            _subscriptions[message->subscription].handler(message->message);
+        }
+        _inbound.drop();
+    }
+}
+
+bool MqttHandoff::subscribe(const char* topic, message_handler_t handler){
+    if(_port == NULL || strlen(topic) > MAX_TOPIC_LEN){
+        return false;
+    }
+
+    // After a reconnect the topics are subscribed again, the handler of a known topic is kept,
+    // because the counting task may call it at the same time.
+    int count = _subscriptionCount.load(std::memory_order_relaxed);
+    int index = 0;
+    while (index < count && strcmp(_subscriptions[index].topic, topic) != 0)
+    {
+        index++;
+    }
+    if(index == count){
+        if(count >= MAX_SUBSCRIPTIONS){
+            return false;
+        }
+        strcpy(_subscriptions[index].topic, topic);
+        _subscriptions[index].handler = handler;
+        _subscriptionCount.store(count + 1, std::memory_order_release);
+    }
+
+    return _port->subscribe(topic, [this, index](const char* message) { _receive(index, message); });
+}
+
+void MqttHandoff::forward(){
+    if(_port == NULL){
+        return;
+    }
+
+    uint8_t* entry;
+    size_t len;
+    while ((entry = _outbound.front(len)) != NULL)
+    {
+        const OutboundHeader* message = (const OutboundHeader*)entry;
+        const char* topic = (const char*)(message + 1);
+        const char* payload = topic + message->topicLen + 1;
+        if(_port->publish(topic, payload, message->retain)){
+            unsigned long delayMs = (uint32_t)Hal::millis() - message->queuedTime;
+            if(delayMs > _maxPublishDelayMs.load(std::memory_order_relaxed)){
+                _maxPublishDelayMs.store(delayMs, std::memory_order_relaxed);
+            }
+        }else if(!_port->isConnected()){
+            // Try it again when the connection is back.
+            return;
+        }else{
+            // The client refuses the message, e.g. because it is larger than its packet buffer. It would be
+            // refused again, so it is dropped and the sender can see it with delivery().
+            unsigned long rejected = _rejected.load(std::memory_order_relaxed);
+            _rejectedTickets[rejected % REJECTED_HISTORY].store(message->ticket, std::memory_order_relaxed);
+            _rejected.store(rejected + 1, std::memory_order_release);
+        }
+        _doneTicket.store(message->ticket, std::memory_order_release);
+        _outbound.drop();
+    }
+}
+
+MqttHandoff::Stats MqttHandoff::stats() const{
+    Stats stats;
+    stats.outboundDepth = _outbound.size();
+    stats.outboundHighWater = _outbound.highWater();
+    stats.outboundOverflows = _outbound.overflows();
+    stats.outboundRejected = _rejected.load(std::memory_order_relaxed);
+    stats.maxPublishDelayMs = _maxPublishDelayMs.load(std::memory_order_relaxed);
+    stats.inboundDepth = _inbound.size();
+    stats.inboundHighWater = _inbound.highWater();
+    stats.inboundOverflows = _inbound.overflows();
+    stats.inboundTooLong = _inboundTooLong.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MqttHandoff::_receive(int subscription, const char* message){
+    size_t len = strlen(message);
+    if(len > MAX_PAYLOAD_LEN){
+        _inboundTooLong.store(_inboundTooLong.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if(_logger != NULL){
+            _logger->printError("Dropped message on %s: %u chars, max. %u chars\n", _subscriptions[subscription].topic, (unsigned int)len, (unsigned int)MAX_PAYLOAD_LEN);
+        }
+        return;
+    }
+
+    InboundMessage inbound;
+    inbound.subscription = subscription;
+    memcpy(inbound.message, message, len + 1);
+    if(_inbound.push(inbound)){
+        Hal::notifyEvent();
+    }
+}
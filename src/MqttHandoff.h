@@ -0,0 +1,156 @@
+#ifndef MQTT_HANDOFF_H
+#define MQTT_HANDOFF_H
+#include <atomic>
+#include "Hal.h"
+#include "Logger.h"
+#include "MqttPort.h"
+#include "SpscByteRing.h"
+#include "SpscQueue.h"
+
+// Size of the outbound ring in bytes, a power of two. It must hold the messages of one loop() of the MeterNode,
+// which is checked in main.cpp, e.g. build with -DMQTT_OUTBOUND_BUFFER_SIZE=65536 for ExpanderBanks.
+#ifndef MQTT_OUTBOUND_BUFFER_SIZE
+#define MQTT_OUTBOUND_BUFFER_SIZE 32768
+#endif
+
+// The longest payload in both directions. It must hold the largest command, e.g. a bulk InstallCounters message with
+// all counters, which is checked in main.cpp, e.g. build with -DMQTT_MAX_PAYLOAD_LEN=8191 for ExpanderBanks.
+#ifndef MQTT_MAX_PAYLOAD_LEN
+#define MQTT_MAX_PAYLOAD_LEN 2047
+#endif
+
+// Measure the longest time of one loop run of a task, e.g. a mqttClient.loop() which blocks while the
+// connection is established. start() and stop() are called by the task, max() can be called by every task.
+class StallMeter
+{
+public:
+	void start() { _startTime = Hal::millis(); }
+	void stop()
+	{
+		unsigned long duration = Hal::millis() - _startTime;
+		if (duration > _max.load(std::memory_order_relaxed))
+		{
+			_max.store(duration, std::memory_order_relaxed);
+		}
+	}
+	// The longest time in ms between start() and stop().
+	unsigned long max() const { return _max.load(std::memory_order_relaxed); }
+
+private:
+	unsigned long _startTime = 0;
+	std::atomic<unsigned long> _max{0};
+};
+
+// Connect the counting task with the network task, so a blocked MQTT client doesn´t delay the counting.
+// The counting task uses the MqttPort functions of this class: publish() copies the message into a lock-free
+// ring and returns at once, the network task publishes the queued messages with the real port in forward().
+// The ring stores the messages with their real length, so many short messages fit into it.
+// Received messages are copied into a queue, their handlers are called by the counting task in dispatch(). A received
+// message which is longer than MAX_PAYLOAD_LEN is dropped, counted and logged, a truncated command could be valid.
+// A message which can´t be published while the connection is lost is kept in the ring until it is back. A message
+// which the client refuses while it is connected, is dropped and counted. Every queued message has a ticket, so the
+// counting task knows with delivery() when it is given to the client, e.g. to ack the journal.
+class MqttHandoff : public MqttPort
+{
+public:
+	const static size_t MAX_PAYLOAD_LEN = MQTT_MAX_PAYLOAD_LEN;
+	const static int MAX_SUBSCRIPTIONS = 12;
+
+	// The state of both queues.
+	struct Stats
+	{
+		size_t outboundDepth;						// Messages which wait for the network task
+		size_t outboundHighWater;
+		unsigned long outboundOverflows;			// Messages which are rejected by publish()
+		unsigned long outboundRejected;				// Messages which are refused by the client while it was connected
+		unsigned long maxPublishDelayMs;			// Longest time a message waited in the queue
+		size_t inboundDepth;						// Received messages which wait for the counting task
+		size_t inboundHighWater;
+		unsigned long inboundOverflows;				// Received messages which are dropped
+		unsigned long inboundTooLong;				// Received messages which are dropped, because they are longer than MAX_PAYLOAD_LEN
+	};
+
+	//**** user functions
+	// Setup the handoff for the real port, the logger gets the dropped received messages.
+	void begin(MqttPort* port, Logger* logger = NULL)
+	{
+		_port = port;
+		_logger = logger;
+	}
+
+	//**** counting task functions
+	bool isConnected() override { return _port != NULL && _port->isConnected(); }
+	// Queue the message. Returns false if it is too long, the connection is lost or the ring is full.
+	bool publish(const char* topic, const char* payload, bool retain = false) override;
+	uint32_t lastTicket() override { return _lastTicket; }
+	Delivery delivery(uint32_t ticket) override;
+	// Call the handlers of the received messages.
+	void dispatch();
+	// True if messages wait for the network task.
+	bool pending() const { return !_outbound.empty(); }
+
+	//**** network task functions
+	// Subscribe the topic at the real port, the handler is called in dispatch(). Must be called by the network task.
+	// Returns false if the topic is too long or MAX_SUBSCRIPTIONS topics are subscribed.
+	bool subscribe(const char* topic, message_handler_t handler) override;
+	// Publish the queued messages with the real port. Stops while the connection is lost.
+	void forward();
+
+	Stats stats() const;
+
+	//**** sizes
+	const static size_t OUTBOUND_BUFFER_SIZE = MQTT_OUTBOUND_BUFFER_SIZE;
+	// The bytes in the outbound ring for count messages, whose topics and payloads have together len chars.
+	constexpr static size_t outboundSize(size_t count, size_t len)
+	{
+		// Every message can have 3 bytes of alignment, and the rest of the buffer before a wrap is skipped.
+		return count * (OutboundRing::entrySize(sizeof(OutboundHeader) + 2)) + len + 3 * count
+			+ OutboundRing::entrySize(sizeof(OutboundHeader) + MAX_TOPIC_LEN + MAX_PAYLOAD_LEN + 2);
+	}
+
+private:
+	const static size_t INBOUND_QUEUE_SIZE = 4;						// Must be a power of two
+	const static size_t REJECTED_HISTORY = 8;						// The tickets of the last rejected messages
+
+	typedef SpscByteRing<OUTBOUND_BUFFER_SIZE> OutboundRing;
+
+	// The outbound message in the ring, followed by the topic and the payload with their terminating 0.
+	// Only 4 byte fields, the entries of the ring are 4 byte aligned.
+	struct OutboundHeader
+	{
+		uint32_t queuedTime;										// Time in ms of publish()
+		uint32_t ticket;
+		uint16_t topicLen;
+		bool retain;
+	};
+
+	struct InboundMessage
+	{
+		int subscription;											// Index into _subscriptions
+		char message[MAX_PAYLOAD_LEN + 1];
+	};
+
+	struct Subscription
+	{
+		char topic[MAX_TOPIC_LEN + 1];
+		message_handler_t handler;
+	};
+
+	MqttPort* _port = NULL;
+	Logger* _logger = NULL;
+	OutboundRing _outbound;											// Filled by the counting task, emptied by the network task
+	SpscQueue<InboundMessage, INBOUND_QUEUE_SIZE> _inbound;			// Filled by the network task, emptied by the counting task
+	Subscription _subscriptions[MAX_SUBSCRIPTIONS];					// Written only before _subscriptionCount is increased
+	std::atomic<int> _subscriptionCount{0};
+	std::atomic<unsigned long> _maxPublishDelayMs{0};
+	std::atomic<unsigned long> _inboundTooLong{0};					// Written by the network task
+	uint32_t _lastTicket = 0;										// Ticket of the last queued message, only used by the counting task
+	std::atomic<uint32_t> _doneTicket{0};							// Ticket of the last message which left the ring
+	std::atomic<uint32_t> _rejectedTickets[REJECTED_HISTORY] = {};	// Ring of the last rejected tickets
+	std::atomic<unsigned long> _rejected{0};						// Rejected messages, the next index into _rejectedTickets
+
+	// Copy a received message into the inbound queue and wake up the counting task.
+	void _receive(int subscription, const char* message);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MQTT_PORT_H
+#define MQTT_PORT_H
+#include <stdint.h>
+#include <functional>
+
+// The functions of the MQTT client which are used by the Logger and the MeterNode.
+// The ESP32 implementation is EspMqttPort, the native build uses LinuxMqttPort.
+class MqttPort
+{
+public:
+	typedef std::function<void(const char* message)> message_handler_t;
+	// The longest topic, the topics are built in buffers of MAX_TOPIC_LEN + 1 chars.
+	const static size_t MAX_TOPIC_LEN = 63;
+
+	virtual ~MqttPort(){}
+
+	// The state of a published message.
+	enum Delivery
+	{
+		DELIVERED,			// Given to the MQTT client
+		PENDING,			// Still in the queue of the port
+		REJECTED			// Refused by the MQTT client while it was connected, the message is dropped
+	};
+
+	virtual bool isConnected() = 0;
+	virtual bool publish(const char* topic, const char* payload, bool retain = false) = 0;
+	virtual bool subscribe(const char* topic, message_handler_t handler) = 0;
+	// A port with a queue, e.g. the MqttHandoff, returns true from publish() when the message is queued and delivers it
+	// later. Every queued message gets the next ticket, this is the ticket of the last one. A port without queue
+	// delivers the message in publish() and returns 0.
+	virtual uint32_t lastTicket() { return 0; }
+	// The state of the message with the ticket from lastTicket().
+	virtual Delivery delivery(uint32_t /*ticket*/) { return DELIVERED; }
+};
+
+#endif
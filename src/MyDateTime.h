@@ -1,7 +1,9 @@
 #ifndef MyDateTime_h
 #define MyDateTime_h
 
+#ifdef ARDUINO
 #include <ESPDateTime.h>
-constexpr static const char* MyISO8601 = "%FT%TZ";
-#define FormatTime(x) (DateTimeParts::from(x).format(MyISO8601).c_str())
+#endif
+// Times are formatted with IsoTimeFormatter, which needs no heap and no ESPDateTime.
+#include "IsoTimeFormatter.h"
 #endif
\ No newline at end of file
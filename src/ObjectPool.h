@@ -0,0 +1,67 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include "SlotAllocator.h"
+
+// A fixed number of objects in static storage, so objects which are created and destroyed for the whole life
+// of the device never allocate heap memory and can´t fragment it. create() and destroy() run in constant time.
+// Not thread safe, create and destroy the objects from the same task.
+template <typename T, size_t SIZE>
+class ObjectPool
+{
+public:
+	ObjectPool() {}
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	// Construct a value initialized object in a free slot. Returns NULL if all slots are used.
+	T* create()
+	{
+		int slot = _slots.allocate();
+		if (slot == SlotAllocator<SIZE>::NO_SLOT)
+		{
+			return NULL;
+		}
+		return new (&_storage[slot]) T();
+	}
+
+	// Destroy the object and give its slot back. Returns false and ignores NULL, objects of other pools and objects
+	// which are already destroyed, so a object is never destructed twice.
+	bool destroy(T* object)
+	{
+		int slot = _slotOf(object);
+		if (slot < 0 || !_slots.isAllocated(slot))
+		{
+			return false;
+		}
+		object->~T();
+		_slots.release(slot);
+		return true;
+	}
+
+	// Number of created objects.
+	size_t used() const { return _slots.used(); }
+	// The max. number of objects.
+	static size_t capacity() { return SIZE; }
+
+private:
+	SlotAllocator<SIZE> _slots;
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage[SIZE];
+
+	// The slot of the object, -1 if it is not in the storage of this pool.
+	int _slotOf(const T* object) const
+	{
+		const uint8_t* address = (const uint8_t*)object;
+		const uint8_t* first = (const uint8_t*)&_storage[0];
+		if (object == NULL || address < first || address >= first + sizeof(_storage) || (address - first) % sizeof(_storage[0]) != 0)
+		{
+			return -1;
+		}
+		return (int)((address - first) / sizeof(_storage[0]));
+	}
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include <string.h>
+#include "PackedFormat.h"
+
+namespace
+{
+    const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const size_t HEADER_SIZE = 2;
+
+    // The value of a base64 char, -1 if it is not a base64 char.
+    int base64Value(char c){
+        if(c >= 'A' && c <= 'Z') return c - 'A';
+        if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if(c >= '0' && c <= '9') return c - '0' + 52;
+        if(c == '+') return 62;
+        if(c == '/') return 63;
+        return -1;
+    }
+
+    uint8_t counterIndex(uint8_t counterId){
+        return counterId < MAX_COUNTERS ? counterId : MAX_COUNTERS;
+    }
+}
+
+//**** PackedEncoder
+
+void PackedEncoder::begin(Type type, time_t baseTime){
+    _buff[0] = VERSION;
+    _buff[1] = type;
+    _len = HEADER_SIZE;
+    _len += writeVarint((uint64_t)baseTime, _buff + _len);
+    _records = 0;
+    _lastTime = baseTime;
+    memset(_lastImpulse, 0, sizeof(_lastImpulse));
+}
+
+bool PackedEncoder::addIntervall(const ImpulseMeterStatus& status){
+    uint8_t record[MAX_INTERVALL_SIZE];
+    size_t recordLen = _encodeIntervall(status, record);
+    if(_len + recordLen > MAX_BINARY_SIZE){
+        return false;
+    }
+
+    memcpy(_buff + _len, record, recordLen);
+    _len += recordLen;
+    _records++;
+    _lastTime = status.utcTime;
+    _lastImpulse[counterIndex(status.counterId)] = status.impulse;
+    return true;
+}
+
+bool PackedEncoder::addValue(uint64_t value){
+    uint8_t varint[10];
+    size_t varintLen = writeVarint(value, varint);
+    if(_len + varintLen > MAX_BINARY_SIZE){
+        return false;
+    }
+
+    memcpy(_buff + _len, varint, varintLen);
+    _len += varintLen;
+    _records++;
+    return true;
+}
+
+bool PackedEncoder::fits(const ImpulseMeterStatus& status, size_t maxEncodedSize) const{
+    uint8_t record[MAX_INTERVALL_SIZE];
+    size_t len = _len + _encodeIntervall(status, record);
+    return len <= MAX_BINARY_SIZE && encodedSize(len) <= maxEncodedSize;
+}
+
+int PackedEncoder::encode(char* buff, size_t size) const{
+    size_t textLen = encodedSize(_len);
+    if(textLen >= size){
+        return -1;
+    }
+
+    char* out = buff;
+    for (size_t i = 0; i < _len; i += 3)
+    {
+        uint32_t bits = (uint32_t)_buff[i] << 16;
+        if(i + 1 < _len) bits |= (uint32_t)_buff[i + 1] << 8;
+        if(i + 2 < _len) bits |= _buff[i + 2];
+        *out++ = BASE64_CHARS[(bits >> 18) & 0x3F];
+        *out++ = BASE64_CHARS[(bits >> 12) & 0x3F];
+        *out++ = i + 1 < _len ? BASE64_CHARS[(bits >> 6) & 0x3F] : '=';
+        *out++ = i + 2 < _len ? BASE64_CHARS[bits & 0x3F] : '=';
+    }
+    *out = 0;
+    return textLen;
+}
+
+size_t PackedEncoder::writeVarint(uint64_t value, uint8_t* buff){
+    size_t len = 0;
+    while (value >= 0x80)
+    {
+        buff[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buff[len++] = (uint8_t)value;
+    return len;
+}
+
+size_t PackedEncoder::_encodeIntervall(const ImpulseMeterStatus& status, uint8_t* buff) const{
+    uint8_t index = counterIndex(status.counterId);
+    size_t len = writeVarint(index < MAX_COUNTERS ? index : UNKNOWN_COUNTER_ID, buff);
+    len += writeVarint(zigzag((int64_t)status.utcTime - (int64_t)_lastTime), buff + len);
+    len += writeVarint(status.timerIntervallInSec, buff + len);
+    len += writeVarint(zigzag((int64_t)status.impulse - (int64_t)_lastImpulse[index]), buff + len);
+    return len;
+}
+
+//**** PackedDecoder
+
+bool PackedDecoder::begin(const char* text){
+    _len = 0;
+    _pos = 0;
+    _error = true;
+    size_t textLen = strlen(text);
+    if(textLen % 4 != 0){
+        return false;
+    }
+
+    for (size_t i = 0; i < textLen; i += 4)
+    {
+        int values[4];
+        int padding = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            values[j] = base64Value(text[i + j]);
+            // Only the last two chars of the text may be padding.
+            if(text[i + j] == '=' && i + 4 == textLen && j >= 2 && (j == 3 || text[i + 3] == '=')){
+                values[j] = 0;
+                padding++;
+            }else if(values[j] < 0){
+                return false;
+            }
+        }
+        if(_len + 3 - padding > sizeof(_buff)){
+            return false;
+        }
+        uint32_t bits = (uint32_t)values[0] << 18 | (uint32_t)values[1] << 12 | (uint32_t)values[2] << 6 | values[3];
+        _buff[_len++] = (uint8_t)(bits >> 16);
+        if(padding < 2) _buff[_len++] = (uint8_t)(bits >> 8);
+        if(padding < 1) _buff[_len++] = (uint8_t)bits;
+    }
+
+    uint64_t baseTime;
+    if(_len < HEADER_SIZE || _buff[0] != PackedEncoder::VERSION || _buff[1] < PackedEncoder::TYPE_INTERVALLS || _buff[1] > PackedEncoder::TYPE_TOTALS){
+        return false;
+    }
+    _type = (PackedEncoder::Type)_buff[1];
+    _pos = HEADER_SIZE;
+    _error = false;
+    if(!_readVarint(baseTime)){
+        _error = true;
+        return false;
+    }
+    _baseTime = (time_t)baseTime;
+    _lastTime = _baseTime;
+    memset(_lastImpulse, 0, sizeof(_lastImpulse));
+    return true;
+}
+
+bool PackedDecoder::next(Intervall& intervall){
+    if(_error || _type != PackedEncoder::TYPE_INTERVALLS || _pos >= _len){
+        return false;
+    }
+
+    uint64_t counterId, timeDelta, timerIntervall, impulseDelta;
+    if(!_readVarint(counterId) || !_readVarint(timeDelta) || !_readVarint(timerIntervall) || !_readVarint(impulseDelta)
+        || counterId > PackedEncoder::UNKNOWN_COUNTER_ID){
+        _error = true;
+        return false;
+    }
+    intervall.counterId = (uint8_t)counterId;
+    intervall.utcTime = (time_t)(_lastTime + PackedEncoder::unzigzag(timeDelta));
+    intervall.timerIntervallInSec = (uint32_t)timerIntervall;
+    intervall.impulse = (unsigned long)(_lastImpulse[counterId] + PackedEncoder::unzigzag(impulseDelta));
+    _lastTime = intervall.utcTime;
+    _lastImpulse[counterId] = intervall.impulse;
+    return true;
+}
+
+bool PackedDecoder::next(uint64_t& value){
+    if(_error || _type == PackedEncoder::TYPE_INTERVALLS || _pos >= _len){
+        return false;
+    }
+    if(!_readVarint(value)){
+        _error = true;
+        return false;
+    }
+    return true;
+}
+
+bool PackedDecoder::_readVarint(uint64_t& value){
+    value = 0;
+    for (int shift = 0; shift < 64 && _pos < _len; shift += 7)
+    {
+        uint8_t b = _buff[_pos++];
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if((b & 0x80) == 0){
+            return true;
+        }
+    }
+    return false;
+}
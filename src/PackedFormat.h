@@ -0,0 +1,117 @@
+#ifndef PACKED_FORMAT_H
+#define PACKED_FORMAT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "ImpulseMeter.h"
+
+// The compact encoding of the published intervalls, the status and the totals. A message is a versioned binary
+// layout, transported as base64 text (RFC 4648 with padding), because the MQTT path of the node carries C strings.
+// Layout of version 1, all numbers are LEB128 varints, signed numbers are zigzag encoded:
+//   byte     version (1)
+//   byte     type, see Type
+//   varint   base time, seconds since 1970 UTC
+//   TYPE_INTERVALLS, one record per closed intervall:
+//     varint   CounterId, 255 if not known (the topic names the source)
+//     svarint  end time - end time of the record before (the first record refers to the base time)
+//     varint   intervall in sec
+//     svarint  impulses - impulses of the record before with the same CounterId (the first refers to 0)
+//   TYPE_STATUS, the base time is the current time:
+//     varint   boot time, number of counters, impulses since boot and optional total, restored total and restored time
+//   TYPE_TOTALS: pairs of varint CounterId and varint total
+// So a intervall needs about 5 bytes instead of 20 bytes for the ISO time and the text of the impulses.
+class PackedEncoder
+{
+public:
+	const static uint8_t VERSION = 1;
+	// The binary size of a message, the base64 text has 4 / 3 of it and fits into a MQTT payload of 1023 chars.
+	const static size_t MAX_BINARY_SIZE = 765;
+	// The longest encoded intervall record.
+	const static size_t MAX_INTERVALL_SIZE = 2 + 10 + 5 + 10;
+	// The CounterId on the wire of a record without known CounterId. It doesn´t depend on MAX_COUNTERS of the build,
+	// so the consumers decode the messages of every node.
+	const static uint8_t UNKNOWN_COUNTER_ID = 0xFF;
+
+	enum Type : uint8_t
+	{
+		TYPE_INTERVALLS = 1,
+		TYPE_STATUS = 2,
+		TYPE_TOTALS = 3
+	};
+
+	//**** user functions
+	// Start a new message.
+	void begin(Type type, time_t baseTime);
+	// Add the record of a closed intervall to a TYPE_INTERVALLS message. Returns false if the message is full.
+	bool addIntervall(const ImpulseMeterStatus& status);
+	// Add a number to a TYPE_STATUS or TYPE_TOTALS message. Returns false if the message is full.
+	bool addValue(uint64_t value);
+	// Check if the record can be added with the encoded message not longer than maxEncodedSize chars.
+	bool fits(const ImpulseMeterStatus& status, size_t maxEncodedSize) const;
+	// Write the message as base64 text with a terminating 0 into buff. Returns the length of the text or -1 if buff is too small.
+	int encode(char* buff, size_t size) const;
+
+	// Number of records and values since begin().
+	size_t records() const { return _records; }
+	size_t binarySize() const { return _len; }
+	static size_t encodedSize(size_t binarySize) { return (binarySize + 2) / 3 * 4; }
+
+	//**** helper functions, also used by the PackedDecoder
+	// Write the varint into buff, which must have space for 10 bytes. Returns the number of bytes.
+	static size_t writeVarint(uint64_t value, uint8_t* buff);
+	static uint64_t zigzag(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+	static int64_t unzigzag(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+private:
+	uint8_t _buff[MAX_BINARY_SIZE];
+	size_t _len = 0;
+	size_t _records = 0;
+	time_t _lastTime = 0;											// End time of the last intervall record
+	unsigned long _lastImpulse[MAX_COUNTERS + 1];					// Impulses of the last record per CounterId, the last is for unknown ids
+
+	// Encode the intervall record into buff. Returns the number of bytes.
+	size_t _encodeIntervall(const ImpulseMeterStatus& status, uint8_t* buff) const;
+};
+
+static_assert(MAX_COUNTERS < PackedEncoder::UNKNOWN_COUNTER_ID, "The CounterIds must be below the unknown CounterId");
+
+// Decode a message of the PackedEncoder, the reference for the consumers of the node.
+class PackedDecoder
+{
+public:
+	// A decoded intervall record.
+	struct Intervall
+	{
+		uint8_t counterId;											// PackedEncoder::UNKNOWN_COUNTER_ID if not known
+		time_t utcTime;
+		uint32_t timerIntervallInSec;
+		unsigned long impulse;
+	};
+
+	//**** user functions
+	// Decode the base64 text and read the header. Returns false if the text or the version is wrong.
+	bool begin(const char* text);
+	// Read the next record of a TYPE_INTERVALLS message. Returns false at the end or if the message is broken.
+	bool next(Intervall& intervall);
+	// Read the next number of a TYPE_STATUS or TYPE_TOTALS message.
+	bool next(uint64_t& value);
+
+	PackedEncoder::Type type() const { return _type; }
+	time_t baseTime() const { return _baseTime; }
+	// True if the message is broken, e.g. a varint is cut off.
+	bool error() const { return _error; }
+
+private:
+	uint8_t _buff[PackedEncoder::MAX_BINARY_SIZE];
+	size_t _len = 0;
+	size_t _pos = 0;
+	bool _error = false;
+	PackedEncoder::Type _type = PackedEncoder::TYPE_INTERVALLS;
+	time_t _baseTime = 0;
+	time_t _lastTime = 0;
+	unsigned long _lastImpulse[PackedEncoder::UNKNOWN_COUNTER_ID + 1];	// The index is the CounterId on the wire
+
+	bool _readVarint(uint64_t& value);
+};
+
+#endif
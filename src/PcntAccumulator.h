@@ -0,0 +1,69 @@
+#ifndef PCNT_ACCUMULATOR_H
+#define PCNT_ACCUMULATOR_H
+#include <atomic>
+#include <stdint.h>
+
+// Extend the 16 bit counter of a PCNT unit to a 64 bit total.
+// The hardware resets the counter to 0 when it reaches the limit and the PCNT interrupt calls onLimit().
+// This class has no hardware dependency, the counter register is read by the function given to total() or take().
+// total() must be called at least once while the counter runs from 0 to the limit, otherwise a reset with a pending
+// interrupt can´t be detected.
+class PcntAccumulator
+{
+public:
+	explicit PcntAccumulator(int16_t limit) : _limit(limit) {}
+
+	// Called by the PCNT interrupt after the counter reached the limit.
+	void onLimit() { _limitEvents.fetch_add(1, std::memory_order_release); }
+
+	// Reset the total to 0. The hardware counter must be cleared at the same time.
+	void clear()
+	{
+		_limitEvents.store(0, std::memory_order_relaxed);
+		_lastTotal = 0;
+		_takenTotal = 0;
+	}
+
+	// The impulses since clear() or the last call of take(), the counter value is returned by readCounter().
+	// Must not be called from different tasks at the same time.
+	template <typename READ_COUNTER>
+	unsigned long take(READ_COUNTER readCounter)
+	{
+		uint64_t current = total(readCounter);
+		unsigned long impulse = (unsigned long)(current - _takenTotal);
+		_takenTotal = current;
+		return impulse;
+	}
+
+	// Calculate the total with the counter value returned by readCounter().
+	// Must not be called from different tasks at the same time.
+	template <typename READ_COUNTER>
+	uint64_t total(READ_COUNTER readCounter)
+	{
+		uint32_t limitEvents;
+		int16_t counter;
+		// Read again if a limit interrupt was handled during the read of the counter.
+		do
+		{
+			limitEvents = _limitEvents.load(std::memory_order_acquire);
+			counter = readCounter();
+		} while (limitEvents != _limitEvents.load(std::memory_order_acquire));
+
+		uint64_t total = (uint64_t)limitEvents * _limit + counter;
+		if (total < _lastTotal)
+		{
+			// The hardware has reset the counter, but the interrupt is not handled yet.
+			total += _limit;
+		}
+		_lastTotal = total;
+		return total;
+	}
+
+private:
+	const int16_t _limit;					// Counter value at which the hardware resets the counter
+	std::atomic<uint32_t> _limitEvents{0};	// Number of limit interrupts since clear()
+	uint64_t _lastTotal = 0;				// The last calculated total
+	uint64_t _takenTotal = 0;				// The total at the last call of take()
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "PcntImpulseSource.h"
+
+PcntImpulseSource::PcntImpulseSource() : _unit(PCNT_UNIT_0), _installed(false), _accumulator(COUNTER_LIMIT){
+}
+
+PcntImpulseSource::~PcntImpulseSource(){
+    end();
+}
+
+bool PcntImpulseSource::begin(uint8_t pin){
+    end();
+    if(isReserved(pin)){
+        return false;
+    }
+
+    int unit = 0;
+    while (unit < PCNT_UNIT_MAX && _unitUsed[unit])
+    {
+        unit++;
+    }
+    if(unit == PCNT_UNIT_MAX){
+        return false;
+    }
+    _unit = (pcnt_unit_t)unit;
+
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = _unit;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DIS;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = COUNTER_LIMIT;
+    config.counter_l_lim = 0;
+    if(pcnt_unit_config(&config) != ESP_OK){
+        return false;
+    }
+    // pcnt_unit_config enables the pull up, the meters need the pull down like the GPIO interrupt source.
+    Hal::pinModeInputPulldown(pin);
+
+    pcnt_set_filter_value(_unit, GLITCH_FILTER_APB_CYCLES);
+    pcnt_filter_enable(_unit);
+
+    if(_isrServiceInstalled == false){
+        if(pcnt_isr_service_install(0) != ESP_OK){
+            return false;
+        }
+        _isrServiceInstalled = true;
+    }
+    pcnt_isr_handler_add(_unit, _onLimit, this);
+    pcnt_event_enable(_unit, PCNT_EVT_H_LIM);
+
+    pcnt_counter_pause(_unit);
+    pcnt_counter_clear(_unit);
+    _accumulator.clear();
+    _endImpulses = 0;
+    pcnt_intr_enable(_unit);
+    pcnt_counter_resume(_unit);
+
+    _unitUsed[_unit] = true;
+    _installed = true;
+    return true;
+}
+
+void PcntImpulseSource::end(){
+    if(_installed){
+        pcnt_counter_pause(_unit);
+        // The unit is used by the next source, so its impulses are taken now.
+        _endImpulses += _accumulator.take([this]() { return _readCounter(); });
+        pcnt_event_disable(_unit, PCNT_EVT_H_LIM);
+        pcnt_intr_disable(_unit);
+        pcnt_isr_handler_remove(_unit);
+        _unitUsed[_unit] = false;
+        _installed = false;
+    }
+}
+
+unsigned long PcntImpulseSource::take(){
+    if(_installed == false){
+        unsigned long impulse = _endImpulses;
+        _endImpulses = 0;
+        return impulse;
+    }
+
+    return _accumulator.take([this]() { return _readCounter(); });
+}
+
+int16_t PcntImpulseSource::_readCounter(){
+    int16_t counter = 0;
+    pcnt_get_counter_value(_unit, &counter);
+    return counter;
+}
+
+void IRAM_ATTR PcntImpulseSource::_onLimit(void* arg){
+    static_cast<PcntImpulseSource*>(arg)->_accumulator.onLimit();
+}
+
+bool PcntImpulseSource::_unitUsed[PCNT_UNIT_MAX] = {};
+bool PcntImpulseSource::_isrServiceInstalled = false;
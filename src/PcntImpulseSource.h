@@ -0,0 +1,46 @@
+#ifndef PCNT_IMPULSE_SOURCE_H
+#define PCNT_IMPULSE_SOURCE_H
+#include <driver/pcnt.h>
+#include "Hal.h"
+#include "ImpulseSource.h"
+#include "PcntAccumulator.h"
+
+// Count the rising edges of a GPIO pin with a pulse counter unit (PCNT) of the ESP32.
+// The impulses are counted by the hardware, the CPU is only interrupted when the 16 bit counter reaches its limit.
+// Short glitches on the pin are removed by the glitch filter of the PCNT unit.
+class PcntImpulseSource : public ImpulseSource
+{
+public:
+	//**** ctors / destructor
+	PcntImpulseSource();
+	~PcntImpulseSource();
+
+	//**** ImpulseSource functions
+	bool begin(uint8_t pin) override;
+	void end() override;
+	unsigned long take() override;
+	ImpulseSourceType type() const override { return PCNT_SOURCE; }
+
+private:
+	// The counter is reset and the limit interrupt is raised at this value, the max. of the 16 bit counter.
+	const static int16_t COUNTER_LIMIT = 32767;
+	// Impulses shorter than this number of APB clock cycles (80 MHz) are ignored. Max. is 1023.
+	const static uint16_t GLITCH_FILTER_APB_CYCLES = 1000;
+
+	pcnt_unit_t _unit;												// The used PCNT unit
+	bool _installed;												// True, if the PCNT unit is configured
+	PcntAccumulator _accumulator;									// Extend the hardware counter to 64 bit
+	unsigned long _endImpulses = 0;									// The impulses of the unit at end()
+
+	// Read the current value of the hardware counter.
+	int16_t _readCounter();
+	// Interrupt of the PCNT unit, called when the counter reached the limit.
+	static void IRAM_ATTR _onLimit(void* arg);
+
+	// True for every PCNT unit which is used by a instance.
+	static bool _unitUsed[PCNT_UNIT_MAX];
+	// True, if the PCNT ISR service is installed.
+	static bool _isrServiceInstalled;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "RateEstimator.h"
+
+void RateEstimator::reset(){
+    _hasPulse = false;
+    _periodUs = 0;
+    startIntervall();
+}
+
+void RateEstimator::add(const PulseTimestamp& pulse){
+    if(_hasPulse){
+        uint32_t impulses = pulse.sequence - _lastPulse.sequence;
+        uint32_t durationUs = pulse.timeUs - _lastPulse.timeUs;
+        if(impulses == 0){
+            return;
+        }
+
+        float periodUs = (float)durationUs / impulses;
+        if(durationUs > MAX_PERIOD_US){
+            // Start again after a long pause, the pause is not a period of the meter.
+            _periodUs = 0;
+        }else if(_periodUs == 0){
+            _periodUs = periodUs;
+        }else{
+            _periodUs += SMOOTHING * (periodUs - _periodUs);
+        }
+        if(periodUs > 0 && _periodUs > 0){
+            _updateMinMax(US_PER_HOUR / periodUs);
+        }
+    }
+
+    _lastPulse = pulse;
+    _hasPulse = true;
+}
+
+float RateEstimator::rate(uint32_t nowUs){
+    if(!_hasPulse || _periodUs <= 0){
+        return 0;
+    }
+
+    uint32_t sinceLastPulseUs = nowUs - _lastPulse.timeUs;
+    if(sinceLastPulseUs > MAX_PERIOD_US){
+        _updateMinMax(0);
+        return 0;
+    }
+
+    // The next impulse is late, so the rate is at most one impulse in the time since the last one.
+    float periodUs = sinceLastPulseUs > _periodUs ? sinceLastPulseUs : _periodUs;
+    float rate = US_PER_HOUR / periodUs;
+    _updateMinMax(rate);
+    return rate;
+}
+
+void RateEstimator::startIntervall(){
+    _hasMinMax = false;
+    _minRate = 0;
+    _maxRate = 0;
+}
+
+void RateEstimator::_updateMinMax(float rate){
+    if(!_hasMinMax){
+        _minRate = rate;
+        _maxRate = rate;
+        _hasMinMax = true;
+    }else if(rate < _minRate){
+        _minRate = rate;
+    }else if(rate > _maxRate){
+        _maxRate = rate;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef RATE_ESTIMATOR_H
+#define RATE_ESTIMATOR_H
+#include <stdint.h>
+#include "ImpulseSource.h"
+
+// Estimate the instantaneous impulse rate from the time stamps of the impulses, e.g. the power of a meter with
+// 1 impulse per Wh is the rate in impulses per hour. The period between the impulses is smoothed, the rate falls
+// if the next impulse is later than the smoothed period. Also the min. and max. rate since startIntervall() is kept.
+// The time stamps are micro seconds and may wrap around, only their differences are used.
+class RateEstimator
+{
+public:
+	// Forget all impulses, e.g. if the source is changed.
+	void reset();
+	// Add the time stamp of a impulse. Lost time stamps are detected by the sequence of the impulse.
+	void add(const PulseTimestamp& pulse);
+	// The smoothed rate in impulses per hour at time nowUs, 0 before the second impulse or if the last impulse is too old.
+	// After a pause of the meter the rate starts again with the second impulse.
+	float rate(uint32_t nowUs);
+	// Start a new intervall for minRate() and maxRate().
+	void startIntervall();
+	// The min. and max. rate since startIntervall(), 0 if there is no rate.
+	float minRate() const { return _hasMinMax ? _minRate : 0; }
+	float maxRate() const { return _hasMinMax ? _maxRate : 0; }
+
+private:
+	// Weight of a new period in the smoothed period.
+	constexpr static float SMOOTHING = 0.25f;
+	// The rate is 0 if there was no impulse for this time.
+	const static uint32_t MAX_PERIOD_US = 15 * 60 * 1000000UL;	// 15 minutes
+	constexpr static float US_PER_HOUR = 3600.0f * 1000000.0f;
+
+	bool _hasPulse = false;											// True, if _lastPulse is valid
+	PulseTimestamp _lastPulse;
+	float _periodUs = 0;											// The smoothed period, 0 if unknown
+	bool _hasMinMax = false;										// True, if _minRate and _maxRate are valid
+	float _minRate = 0;
+	float _maxRate = 0;
+
+	void _updateMinMax(float rate);
+};
+
+#endif
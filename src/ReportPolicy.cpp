@@ -0,0 +1,71 @@
+#include "ReportPolicy.h"
+
+void ReportPolicy::begin(const Config& config){
+    _config = config;
+    _hasReference = false;
+}
+
+bool ReportPolicy::add(const ImpulseMeterStatus& status, ImpulseMeterStatus& record){
+    if(_hasReference && _coalesce(status)){
+        if(_pendingIntervalls == 0){
+            _pending = status;
+            _pending.impulse = 0;
+            _pendingStartTime = status.utcTime - status.timerIntervallInSec;
+        }
+        _pending.impulse += status.impulse;
+        _pending.utcTime = status.utcTime;
+        _pending.monotonicEndUs = status.monotonicEndUs;
+        _pendingIntervalls++;
+        _coalesced++;
+        return false;
+    }
+
+    record = status;
+    _takePending(record);
+    _hasReference = true;
+    _reference = status.impulse;
+    return true;
+}
+
+bool ReportPolicy::flush(ImpulseMeterStatus& record){
+    if(_pendingIntervalls == 0){
+        return false;
+    }
+    record = _pending;
+    record.impulse = 0;
+    _takePending(record);
+    return true;
+}
+
+bool ReportPolicy::sameConfig(const Config& a, const Config& b){
+    return a.mode == b.mode && a.relative == b.relative && a.threshold == b.threshold && a.maxSilenceInSec == b.maxSilenceInSec;
+}
+
+bool ReportPolicy::_coalesce(const ImpulseMeterStatus& status) const {
+    if(_config.maxSilenceInSec > 0 && status.utcTime - _lastRecordTime >= (time_t)_config.maxSilenceInSec){
+        return false;
+    }
+
+    unsigned long difference = status.impulse > _reference ? status.impulse - _reference : _reference - status.impulse;
+    switch (_config.mode)
+    {
+    case REPORT_ON_CHANGE:
+        return difference == 0;
+    case REPORT_DEADBAND:
+        // A change from 0 is always published in percent.
+        return _config.relative ? (uint64_t)difference * 100 <= (uint64_t)_reference * _config.threshold : difference <= _config.threshold;
+    case REPORT_HEARTBEAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void ReportPolicy::_takePending(ImpulseMeterStatus& record){
+    if(_pendingIntervalls > 0){
+        record.impulse += _pending.impulse;
+        record.timerIntervallInSec = (unsigned int)(record.utcTime - _pendingStartTime);
+        _pendingIntervalls = 0;
+    }
+    _lastRecordTime = record.utcTime;
+}
@@ -0,0 +1,65 @@
+#ifndef REPORT_POLICY_H
+#define REPORT_POLICY_H
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "ImpulseMeter.h"
+
+// Decide which closed intervalls of a counter are published, so idle and steady meters don´t publish every intervall
+// (report by exception). A intervall which is not published is coalesced into the next published record: its impulses
+// are added and the record starts at the start of the first coalesced intervall, so no impulse is lost and the records
+// of a counter follow each other without gaps. The first intervall after begin() is always published.
+// A published record has the end time of its last intervall and the time from its start to its end as intervall.
+class ReportPolicy
+{
+public:
+	// The longest time without a record.
+	const static uint32_t MAX_SILENCE_IN_SEC = 7 * 24 * 3600;
+
+	enum Mode : uint8_t
+	{
+		REPORT_ALWAYS,				// Publish every intervall
+		REPORT_ON_CHANGE,			// Publish if the impulses differ from the last published intervall
+		REPORT_DEADBAND,			// Publish if the impulses differ more than the threshold from the last published intervall
+		REPORT_HEARTBEAT			// Publish only after maxSilenceInSec
+	};
+
+	struct Config
+	{
+		Mode mode;
+		bool relative;				// The threshold is in percent of the impulses of the last published intervall
+		uint32_t threshold;			// The max. difference of a coalesced intervall, only REPORT_DEADBAND
+		uint32_t maxSilenceInSec;	// Publish at the latest this time after the end of the last record, 0 for no heartbeat
+	};
+
+	//**** user functions
+	// Set the policy. The coalesced intervalls are kept and the next intervall is published.
+	void begin(const Config& config);
+	// Add a closed intervall of the counter. Returns true if the intervall is published, then record has the intervall
+	// with the coalesced intervalls before it. Returns false if the intervall is coalesced into the next record.
+	bool add(const ImpulseMeterStatus& status, ImpulseMeterStatus& record);
+	// Take the coalesced intervalls as record, e.g. before a restart. Returns false if no intervall is coalesced.
+	bool flush(ImpulseMeterStatus& record);
+
+	const Config& config() const { return _config; }
+	// Number of intervalls which are coalesced into a other record.
+	unsigned long coalesced() const { return _coalesced; }
+	static bool sameConfig(const Config& a, const Config& b);
+
+private:
+	Config _config = {REPORT_ALWAYS, false, 0, 0};
+	bool _hasReference = false;										// False until a intervall is published after begin()
+	unsigned long _reference = 0;									// The impulses of the last published intervall
+	time_t _lastRecordTime = 0;										// The end time of the last record
+	ImpulseMeterStatus _pending;									// The sum of the coalesced intervalls with the end of the last one
+	time_t _pendingStartTime = 0;									// The start of the first coalesced intervall
+	size_t _pendingIntervalls = 0;
+	unsigned long _coalesced = 0;
+
+	// True if the intervall is coalesced.
+	bool _coalesce(const ImpulseMeterStatus& status) const;
+	// Add the coalesced intervalls to the record and start a new record.
+	void _takePending(ImpulseMeterStatus& record);
+};
+
+#endif
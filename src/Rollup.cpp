@@ -0,0 +1,57 @@
+#include "Rollup.h"
+
+bool Rollup::begin(const LevelConfig* levels, size_t count, uint32_t baseIntervallInSec){
+    _count = 0;
+    if(count > MAX_LEVELS){
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        _levels[i].config = levels[i];
+        _levels[i].end = 0;
+        _levels[i].impulse = 0;
+    }
+    _count = count;
+    return setBaseIntervall(baseIntervallInSec);
+}
+
+bool Rollup::setBaseIntervall(uint32_t baseIntervallInSec){
+    for (size_t i = 0; i < _count; i++)
+    {
+        uint32_t period = _levels[i].config.periodInSec;
+        if(baseIntervallInSec == 0 || period <= baseIntervallInSec || period % baseIntervallInSec != 0 || period > MAX_PERIOD_IN_SEC){
+            _count = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Rollup::add(time_t utcTime, unsigned long impulse, Record* closed){
+    size_t closedCount = 0;
+    for (size_t i = 0; i < _count; i++)
+    {
+        Level& level = _levels[i];
+        time_t end = levelEnd(utcTime, level.config.periodInSec);
+        if(level.end != 0 && level.end != end){
+            // The last base intervall is missing or the clock was set.
+            closed[closedCount++] = {(uint8_t)i, level.end, level.impulse};
+            level.impulse = 0;
+        }
+
+        level.end = end;
+        level.impulse += impulse;
+        if(utcTime == end){
+            closed[closedCount++] = {(uint8_t)i, level.end, level.impulse};
+            level.end = 0;
+            level.impulse = 0;
+        }
+    }
+    return closedCount;
+}
+
+time_t Rollup::levelEnd(time_t utcTime, uint32_t periodInSec){
+    time_t rest = utcTime % periodInSec;
+    return rest == 0 ? utcTime : utcTime - rest + periodInSec;
+}
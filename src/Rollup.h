@@ -0,0 +1,64 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Sum the closed intervalls of a counter into longer intervalls, e.g. 10 second intervalls into 15 minute, hourly and daily totals.
+// The levels are aligned to the epoch, so a level with 3600 seconds ends at every full hour UTC. A base intervall belongs to
+// the level intervall which contains its end. If the last base intervall of a level intervall is missing, the level intervall
+// is closed by the next base intervall after it. Every level has a constant size, the times are only integer arithmetic.
+class Rollup
+{
+public:
+	const static size_t MAX_LEVELS = 4;
+	const static uint32_t MAX_PERIOD_IN_SEC = 7 * 24 * 3600;
+	// Max. number of level intervalls which are closed by one add() call.
+	const static size_t MAX_CLOSED = 2 * MAX_LEVELS;
+
+	struct LevelConfig
+	{
+		uint32_t periodInSec;				// The length of the level intervall, a multiple of the base intervall
+		bool retain;						// Publish the level intervalls as retained MQTT messages
+	};
+
+	// A closed level intervall.
+	struct Record
+	{
+		uint8_t level;						// The index of the level
+		time_t utcTime;						// The end time in UTC
+		unsigned long impulse;				// The impulses of the base intervalls
+	};
+
+	//**** user functions
+	// Set the levels and forget the open level intervalls. Returns false and removes all levels
+	// if a period is not a multiple of the base intervall or too long.
+	bool begin(const LevelConfig* levels, size_t count, uint32_t baseIntervallInSec);
+	// Check the levels against a new base intervall. Returns false and removes all levels if a period doesn´t fit.
+	bool setBaseIntervall(uint32_t baseIntervallInSec);
+	// Remove all levels.
+	void end() { _count = 0; }
+	// Add a closed base intervall with its end time. The closed level intervalls are written into closed,
+	// which must have space for MAX_CLOSED records. Returns the number of closed level intervalls.
+	size_t add(time_t utcTime, unsigned long impulse, Record* closed);
+
+	size_t levels() const { return _count; }
+	const LevelConfig& levelConfig(size_t level) const { return _levels[level].config; }
+	// The impulses of the open intervall of the level.
+	unsigned long openImpulse(size_t level) const { return _levels[level].impulse; }
+	// The end of the level intervall which contains utcTime as end of a base intervall.
+	static time_t levelEnd(time_t utcTime, uint32_t periodInSec);
+
+private:
+	struct Level
+	{
+		LevelConfig config;
+		time_t end;							// The end of the open intervall, 0 if there is no open intervall
+		unsigned long impulse;				// The impulses of the open intervall
+	};
+
+	Level _levels[MAX_LEVELS];
+	size_t _count = 0;
+};
+
+#endif
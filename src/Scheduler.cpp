@@ -0,0 +1,62 @@
+#include "Scheduler.h"
+
+int Scheduler::add(job_t job, void* arg, unsigned long periodMs, unsigned long nowMs, unsigned long firstDelayMs){
+    if(_jobCount >= MAX_JOBS){
+        return NO_JOB;
+    }
+
+    Job& newJob = _jobs[_jobCount];
+    newJob.job = job;
+    newJob.arg = arg;
+    newJob.periodMs = periodMs;
+    newJob.deadline = nowMs + firstDelayMs;
+    return _jobCount++;
+}
+
+void Scheduler::trigger(int id){
+    if(id >= 0 && id < MAX_JOBS){
+        _triggered.fetch_or(1UL << id, std::memory_order_release);
+    }
+}
+
+void Scheduler::postpone(int id, unsigned long nowMs, unsigned long delayMs){
+    if(id >= 0 && id < _jobCount){
+        _jobs[id].deadline = nowMs + delayMs;
+    }
+}
+
+void Scheduler::setPeriod(int id, unsigned long periodMs, unsigned long nowMs){
+    if(id >= 0 && id < _jobCount){
+        _jobs[id].periodMs = periodMs;
+        _jobs[id].deadline = nowMs + periodMs;
+    }
+}
+
+unsigned long Scheduler::run(unsigned long nowMs){
+    uint32_t triggered = _triggered.exchange(0, std::memory_order_acquire);
+    unsigned long waitMs = NO_DEADLINE;
+    for (int i = 0; i < _jobCount; i++)
+    {
+        Job& job = _jobs[i];
+        // Compare the difference, so the wrap around of millis() after 49 days is no problem.
+        bool due = (triggered & (1UL << i)) != 0 || (job.periodMs > 0 && (long)(nowMs - job.deadline) >= 0);
+        if(due){
+            // The job can postpone itself, therefor set the deadline before it runs.
+            job.deadline = nowMs + job.periodMs;
+            job.job(job.arg);
+        }
+
+        if(job.periodMs > 0){
+            long leftMs = (long)(job.deadline - nowMs);
+            unsigned long jobWaitMs = leftMs > 0 ? leftMs : 0;
+            if(jobWaitMs < waitMs){
+                waitMs = jobWaitMs;
+            }
+        }
+    }
+
+    if(_triggered.load(std::memory_order_relaxed) != 0){
+        waitMs = 0;
+    }
+    return waitMs;
+}
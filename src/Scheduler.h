@@ -0,0 +1,48 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+// Run jobs periodic at their deadline or when they are triggered by a event, e.g. a closed intervall.
+// The scheduler gets the time from the caller and has no own thread, so it runs on the ESP32 and on the host.
+// add(), postpone() and run() must be called by the same task, trigger() can be called from any task.
+class Scheduler
+{
+public:
+	typedef void(*job_t)(void* arg);
+
+	const static int MAX_JOBS = 8;
+	const static int NO_JOB = -1;
+	// Returned by run() if no job has a deadline.
+	const static unsigned long NO_DEADLINE = (unsigned long)-1;
+
+	//**** user functions
+	// Add a job which runs every periodMs, the first time firstDelayMs after nowMs. A job with periodMs 0 runs only
+	// if it is triggered. Returns the id of the job or NO_JOB if there are already MAX_JOBS.
+	int add(job_t job, void* arg, unsigned long periodMs, unsigned long nowMs, unsigned long firstDelayMs = 0);
+	// Run the job at the next run() call.
+	void trigger(int id);
+	// Run the job next at nowMs + delayMs.
+	void postpone(int id, unsigned long nowMs, unsigned long delayMs);
+	// Change the period of the job, the next run is at nowMs + periodMs. A period of 0 stops the periodic runs.
+	void setPeriod(int id, unsigned long periodMs, unsigned long nowMs);
+	// Run all triggered jobs and all jobs whose deadline is reached. Returns the time in ms until the next
+	// deadline, 0 if a job was triggered while running or NO_DEADLINE.
+	unsigned long run(unsigned long nowMs);
+
+private:
+	struct Job
+	{
+		job_t job;
+		void* arg;
+		unsigned long periodMs;										// 0 if the job only runs when it is triggered
+		unsigned long deadline;										// Next run in ms
+	};
+
+	Job _jobs[MAX_JOBS];
+	int _jobCount = 0;
+	std::atomic<uint32_t> _triggered{0};							// One bit per triggered job
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include <unistd.h>
+#include "SegmentStorage.h"
+
+FileSegmentStorage::~FileSegmentStorage(){
+    end();
+}
+
+bool FileSegmentStorage::begin(const char* prefix, uint32_t segments, uint32_t segmentSize, bool sync){
+    end();
+    _prefix = prefix;
+    _segments = segments;
+    _segmentSize = segmentSize;
+    _sync = sync;
+    return _segments > 0 && _segmentSize > 0;
+}
+
+void FileSegmentStorage::end(){
+    sync();
+    _close(_writeSegment);
+    _close(_readSegment);
+}
+
+bool FileSegmentStorage::clearSegment(uint32_t segment){
+    if(segment >= _segments){
+        return false;
+    }
+    // The data of the last segment is synced, before a other segment is written.
+    sync();
+    _close(_writeSegment);
+    _close(segment);
+    _writeFile = fopen(_path(segment).c_str(), "w+b");
+    if(_writeFile == NULL){
+        return false;
+    }
+    _writeSegment = segment;
+    return true;
+}
+
+bool FileSegmentStorage::write(uint32_t segment, uint32_t offset, const void* buff, size_t len){
+    if(segment >= _segments || offset + len > _segmentSize){
+        return false;
+    }
+    if(segment != _writeSegment){
+        // The segment is appended after a restart.
+        sync();
+        _close(_writeSegment);
+        _close(segment);
+        _writeFile = fopen(_path(segment).c_str(), "r+b");
+        if(_writeFile == NULL){
+            return false;
+        }
+        _writeSegment = segment;
+    }
+    if(fseek(_writeFile, offset, SEEK_SET) != 0 || fwrite(buff, 1, len, _writeFile) != len){
+        return false;
+    }
+    _unsynced = true;
+    return true;
+}
+
+bool FileSegmentStorage::read(uint32_t segment, uint32_t offset, void* buff, size_t len){
+    if(segment >= _segments || offset + len > _segmentSize){
+        return false;
+    }
+    FILE* file = _writeFile;
+    if(segment != _writeSegment){
+        if(segment != _readSegment){
+            _close(_readSegment);
+            _readFile = fopen(_path(segment).c_str(), "rb");
+            if(_readFile == NULL){
+                return false;
+            }
+            _readSegment = segment;
+        }
+        file = _readFile;
+    }
+    // The seek between the writes and the reads of the same file is needed.
+    return fseek(file, offset, SEEK_SET) == 0 && fread(buff, 1, len, file) == len;
+}
+
+bool FileSegmentStorage::sync(){
+    if(!_unsynced || _writeFile == NULL){
+        return true;
+    }
+    if(!_flush(_writeFile)){
+        return false;
+    }
+    _unsynced = false;
+    return true;
+}
+
+bool FileSegmentStorage::readCursor(void* buff, size_t len){
+    FILE* file = fopen((_prefix + ".ack").c_str(), "rb");
+    if(file == NULL){
+        return false;
+    }
+    bool ok = fread(buff, 1, len, file) == len;
+    fclose(file);
+    return ok;
+}
+
+bool FileSegmentStorage::writeCursor(const void* buff, size_t len){
+    FILE* file = fopen((_prefix + ".ack").c_str(), "wb");
+    if(file == NULL){
+        return false;
+    }
+    bool ok = fwrite(buff, 1, len, file) == len && _flush(file);
+    fclose(file);
+    return ok;
+}
+
+std::string FileSegmentStorage::_path(uint32_t segment) const {
+    return _prefix + "." + std::to_string(segment);
+}
+
+void FileSegmentStorage::_close(uint32_t segment){
+    if(segment == NO_SEGMENT){
+        return;
+    }
+    if(segment == _writeSegment){
+        fclose(_writeFile);
+        _writeFile = NULL;
+        _writeSegment = NO_SEGMENT;
+        _unsynced = false;
+    }
+    if(segment == _readSegment){
+        fclose(_readFile);
+        _readFile = NULL;
+        _readSegment = NO_SEGMENT;
+    }
+}
+
+bool FileSegmentStorage::_flush(FILE* file){
+    if(fflush(file) != 0){
+        return false;
+    }
+    return !_sync || fsync(fileno(file)) == 0;
+}
@@ -0,0 +1,148 @@
+#ifndef SEGMENT_STORAGE_H
+#define SEGMENT_STORAGE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+// The storage of the Journal: a ring of segments of the same size and a small cursor area.
+// A segment is cleared before it is written again and then only appended, so the flash is never rewritten in place.
+// The writes may stay in a cache until sync() is called, so many records need one sync.
+class SegmentStorage
+{
+public:
+	virtual ~SegmentStorage(){}
+
+	// Number of segments.
+	virtual uint32_t segments() const = 0;
+	// Size of every segment in bytes.
+	virtual uint32_t segmentSize() const = 0;
+	// Remove the data of the segment, then it is written again from offset 0.
+	virtual bool clearSegment(uint32_t segment) = 0;
+	// Write len bytes at offset of the segment. The offsets of a segment are written in ascending order after clearSegment().
+	virtual bool write(uint32_t segment, uint32_t offset, const void* buff, size_t len) = 0;
+	// Read len bytes at offset of the segment, also if they are not synced. Returns false if the data does not exist.
+	virtual bool read(uint32_t segment, uint32_t offset, void* buff, size_t len) = 0;
+	// Make the written data durable.
+	virtual bool sync() = 0;
+	// Read the cursor. Returns false if there is no cursor.
+	virtual bool readCursor(void* buff, size_t len) = 0;
+	// Replace the cursor, it is durable when the function returns.
+	virtual bool writeCursor(const void* buff, size_t len) = 0;
+};
+
+// SegmentStorage with one file per segment and a cursor file: <prefix>.0 ... <prefix>.<segments - 1> and <prefix>.ack.
+// Used with LittleFS on the ESP32 (mounted to the VFS, e.g. /littlefs/...) and with normal files in the native build.
+// The written segment is kept open, so appending a record only copies it into the cache of the file.
+class FileSegmentStorage : public SegmentStorage
+{
+public:
+	//**** ctors / destructor
+	~FileSegmentStorage();
+
+	//**** user functions
+	// Open the storage, the files are created when they are written. If sync is false, sync() only flushes the files
+	// to the operating system, e.g. for tests.
+	bool begin(const char* prefix, uint32_t segments, uint32_t segmentSize, bool sync);
+	void end();
+
+	//**** SegmentStorage functions
+	uint32_t segments() const override { return _segments; }
+	uint32_t segmentSize() const override { return _segmentSize; }
+	bool clearSegment(uint32_t segment) override;
+	bool write(uint32_t segment, uint32_t offset, const void* buff, size_t len) override;
+	bool read(uint32_t segment, uint32_t offset, void* buff, size_t len) override;
+	bool sync() override;
+	bool readCursor(void* buff, size_t len) override;
+	bool writeCursor(const void* buff, size_t len) override;
+
+private:
+	const static uint32_t NO_SEGMENT = UINT32_MAX;
+
+	std::string _prefix;
+	uint32_t _segments = 0;
+	uint32_t _segmentSize = 0;
+	bool _sync = false;												// Sync the files to the storage
+	FILE* _writeFile = NULL;										// The written segment, also used to read it
+	uint32_t _writeSegment = NO_SEGMENT;
+	FILE* _readFile = NULL;											// The last read segment, if it is not written
+	uint32_t _readSegment = NO_SEGMENT;
+	bool _unsynced = false;											// True, if _writeFile has data which is not synced
+
+	std::string _path(uint32_t segment) const;
+	// Close the file of the segment, if it is open.
+	void _close(uint32_t segment);
+	// Flush and optional sync the file.
+	bool _flush(FILE* file);
+};
+
+// SegmentStorage in RAM, e.g. for the records which wait for the MQTT connection if there is no file system.
+// The data is lost with a restart, sync() has nothing to do.
+template <uint32_t SEGMENTS, uint32_t SEGMENT_SIZE>
+class RamSegmentStorage : public SegmentStorage
+{
+public:
+	//**** SegmentStorage functions
+	uint32_t segments() const override { return SEGMENTS; }
+	uint32_t segmentSize() const override { return SEGMENT_SIZE; }
+	bool clearSegment(uint32_t segment) override
+	{
+		if (segment >= SEGMENTS)
+		{
+			return false;
+		}
+		_used[segment] = 0;
+		return true;
+	}
+	bool write(uint32_t segment, uint32_t offset, const void* buff, size_t len) override
+	{
+		if (segment >= SEGMENTS || offset > SEGMENT_SIZE || len > SEGMENT_SIZE - offset)
+		{
+			return false;
+		}
+		memcpy(&_data[segment][offset], buff, len);
+		if (offset + len > _used[segment])
+		{
+			_used[segment] = offset + len;
+		}
+		return true;
+	}
+	bool read(uint32_t segment, uint32_t offset, void* buff, size_t len) override
+	{
+		if (segment >= SEGMENTS || offset > _used[segment] || len > _used[segment] - offset)
+		{
+			return false;
+		}
+		memcpy(buff, &_data[segment][offset], len);
+		return true;
+	}
+	bool sync() override { return true; }
+	bool readCursor(void* buff, size_t len) override
+	{
+		if (_cursorLen == 0 || len > _cursorLen)
+		{
+			return false;
+		}
+		memcpy(buff, _cursor, len);
+		return true;
+	}
+	bool writeCursor(const void* buff, size_t len) override
+	{
+		if (len > sizeof(_cursor))
+		{
+			return false;
+		}
+		memcpy(_cursor, buff, len);
+		_cursorLen = len;
+		return true;
+	}
+
+private:
+	uint8_t _data[SEGMENTS][SEGMENT_SIZE];
+	uint32_t _used[SEGMENTS] = {};									// Written bytes of every segment
+	uint8_t _cursor[16];
+	size_t _cursorLen = 0;											// 0 if no cursor is written
+};
+
+#endif
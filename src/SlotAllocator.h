@@ -0,0 +1,66 @@
+#ifndef SLOT_ALLOCATOR_H
+#define SLOT_ALLOCATOR_H
+#include <stdint.h>
+#include <stddef.h>
+
+// Hand out the slots 0..SLOTS-1 with a free list. allocate() and release() run in constant time.
+// Not thread safe, allocate and release the slots from the same task.
+template <size_t SLOTS>
+class SlotAllocator
+{
+	static_assert(SLOTS > 0 && SLOTS < 127, "SLOTS must be 1..126");
+
+public:
+	const static int NO_SLOT = -1;
+
+	SlotAllocator()
+	{
+		for (size_t i = 0; i < SLOTS; i++)
+		{
+			_next[i] = i + 1 < SLOTS ? i + 1 : NO_SLOT;
+		}
+		_freeHead = 0;
+		_used = 0;
+	}
+
+	// Take a free slot. Returns NO_SLOT if all slots are used.
+	int allocate()
+	{
+		int slot = _freeHead;
+		if (slot != NO_SLOT)
+		{
+			_freeHead = _next[slot];
+			_next[slot] = USED;
+			_used++;
+		}
+		return slot;
+	}
+
+	// Give a slot back. Returns false and ignores the slot if it is not allocated.
+	bool release(int slot)
+	{
+		if (!isAllocated(slot))
+		{
+			return false;
+		}
+		_next[slot] = _freeHead;
+		_freeHead = slot;
+		_used--;
+		return true;
+	}
+
+	// True if the slot is allocated, false for free and invalid slots.
+	bool isAllocated(int slot) const { return slot >= 0 && slot < (int)SLOTS && _next[slot] == USED; }
+
+	// Number of allocated slots.
+	size_t used() const { return _used; }
+
+private:
+	const static int8_t USED = -2;
+
+	int8_t _next[SLOTS];							// Next free slot in the free list, USED if the slot is allocated
+	int8_t _freeHead;								// First free slot, NO_SLOT if all are used
+	size_t _used;									// Number of allocated slots
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SPSC_BYTE_RING_H
+#define SPSC_BYTE_RING_H
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// A fixed size ring buffer of entries with different lengths for exactly one producer and one consumer.
+// Every entry is stored in one piece with a length word before it, so the consumer can use it in place. An entry
+// which doesn´t fit before the end of the buffer starts at the begin, the rest of the buffer is skipped.
+// The producer calls reserve(), writes the entry and calls commit(), the consumer calls front() and drop().
+// All storage is part of the object, so no function allocates memory.
+template <size_t SIZE>
+class SpscByteRing
+{
+	static_assert(SIZE >= 64 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+public:
+	// The bytes of a entry with len bytes in the buffer.
+	constexpr static size_t entrySize(size_t len) { return sizeof(uint32_t) + ((len + 3) & ~(size_t)3); }
+
+	//**** producer functions
+	// Reserve len bytes for the next entry, 4 byte aligned. Returns NULL and counts a overflow if the ring is full.
+	// The entry is not visible until commit() is called.
+	uint8_t* reserve(size_t len)
+	{
+		size_t need = entrySize(len);
+		size_t head = _head.load(std::memory_order_relaxed);
+		size_t toEnd = SIZE - (head & MASK);
+		size_t skip = need > toEnd ? toEnd : 0;
+		if (need > SIZE || head + skip + need - _tail.load(std::memory_order_acquire) > SIZE)
+		{
+			_overflows.fetch_add(1, std::memory_order_relaxed);
+			return NULL;
+		}
+
+		if (skip > 0)
+		{
+			// The consumer goes on at the begin of the buffer.
+			_length(head) = WRAP;
+		}
+		_reservedHead = head + skip;
+		_reservedLen = len;
+		return &_buffer[(_reservedHead & MASK) + sizeof(uint32_t)];
+	}
+
+	// Add the reserved entry to the ring.
+	void commit()
+	{
+		_length(_reservedHead) = _reservedLen;
+		_head.store(_reservedHead + entrySize(_reservedLen), std::memory_order_release);
+
+		size_t pushed = _pushed.load(std::memory_order_relaxed) + 1;
+		_pushed.store(pushed, std::memory_order_release);
+		size_t used = pushed - _popped.load(std::memory_order_acquire);
+		if (used > _highWater.load(std::memory_order_relaxed))
+		{
+			_highWater.store(used, std::memory_order_relaxed);
+		}
+	}
+
+	//**** consumer functions
+	// The oldest entry without taking it, NULL if the ring is empty. The entry is valid until drop() is called.
+	uint8_t* front(size_t& len)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire))
+		{
+			return NULL;
+		}
+		if (_length(tail) == WRAP)
+		{
+			tail += SIZE - (tail & MASK);
+			_tail.store(tail, std::memory_order_release);
+		}
+		len = _length(tail);
+		return &_buffer[(tail & MASK) + sizeof(uint32_t)];
+	}
+
+	// Remove the oldest entry, e.g. after it is processed with front().
+	void drop()
+	{
+		size_t len;
+		if (front(len) != NULL)
+		{
+			_tail.store(_tail.load(std::memory_order_relaxed) + entrySize(len), std::memory_order_release);
+			_popped.store(_popped.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+	}
+
+	//**** status functions, can be called from both sides
+	bool empty() const { return size() == 0; }
+	// Number of entries in the ring.
+	size_t size() const { return _pushed.load(std::memory_order_acquire) - _popped.load(std::memory_order_acquire); }
+	constexpr size_t capacity() const { return SIZE; }
+	// Number of entries which are rejected by reserve() because the ring was full.
+	unsigned long overflows() const { return _overflows.load(std::memory_order_relaxed); }
+	// The maximum number of entries which was stored at the same time.
+	size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+	const static size_t MASK = SIZE - 1;
+	const static uint32_t WRAP = UINT32_MAX;		// Length of a skipped rest of the buffer
+
+	alignas(4) uint8_t _buffer[SIZE];
+	std::atomic<size_t> _head{0};					// Next byte to write, only changed by the producer
+	std::atomic<size_t> _tail{0};					// Next byte to read, only changed by the consumer
+	size_t _reservedHead = 0;						// The entry of reserve(), only used by the producer
+	size_t _reservedLen = 0;
+	std::atomic<size_t> _pushed{0};					// Committed entries, only changed by the producer
+	std::atomic<size_t> _popped{0};					// Dropped entries, only changed by the consumer
+	std::atomic<unsigned long> _overflows{0};		// Rejected entries, only changed by the producer
+	std::atomic<size_t> _highWater{0};				// Maximum number of entries, only changed by the producer
+
+	uint32_t& _length(size_t position) { return *(uint32_t*)&_buffer[position & MASK]; }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+#include <atomic>
+#include <stddef.h>
+
+// A fixed size ring buffer for exactly one producer and one consumer.
+// The producer (e.g. a ISR) calls push(), the consumer (e.g. the loop() function) calls pop().
+// All storage is part of the object, so push() and pop() never allocate memory and run in constant time.
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+	static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+	//**** producer functions
+	// Add a item to the queue. Returns false and counts a overflow if the queue is full.
+	// Always inlined, so a ISR in IRAM doesn´t call code in the flash.
+	__attribute__((always_inline)) inline bool push(const T& item)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		size_t used = head - _tail.load(std::memory_order_acquire);
+		if (used >= CAPACITY)
+		{
+			_overflows.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		_items[head & MASK] = item;
+		_head.store(head + 1, std::memory_order_release);
+
+		used++;
+		if (used > _highWater.load(std::memory_order_relaxed))
+		{
+			_highWater.store(used, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	//**** consumer functions
+	// Take the oldest item from the queue. Returns false if the queue is empty.
+	bool pop(T& item)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = _items[tail & MASK];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// The oldest item without taking it, NULL if the queue is empty. The item is valid until drop() is called.
+	T* front()
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire))
+		{
+			return NULL;
+		}
+		return &_items[tail & MASK];
+	}
+
+	// Remove the oldest item, e.g. after it is processed with front().
+	void drop()
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail != _head.load(std::memory_order_acquire))
+		{
+			_tail.store(tail + 1, std::memory_order_release);
+		}
+	}
+
+	//**** status functions, can be called from both sides
+	bool empty() const { return size() == 0; }
+	size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+	constexpr size_t capacity() const { return CAPACITY; }
+	// Number of items which are rejected by push() because the queue was full.
+	unsigned long overflows() const { return _overflows.load(std::memory_order_relaxed); }
+	// The maximum number of items which was stored at the same time.
+	size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+	const static size_t MASK = CAPACITY - 1;
+
+	T _items[CAPACITY];
+	std::atomic<size_t> _head{0};					// Next index to write, only changed by the producer
+	std::atomic<size_t> _tail{0};					// Next index to read, only changed by the consumer
+	std::atomic<unsigned long> _overflows{0};		// Rejected items, only changed by the producer
+	std::atomic<size_t> _highWater{0};				// Maximum fill level, only changed by the producer
+};
+
+#endif
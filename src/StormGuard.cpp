@@ -0,0 +1,47 @@
+#include "StormGuard.h"
+
+void StormGuard::begin(const Config& config){
+    _config = config;
+    _maxInterruptsPerWindow = (uint64_t)config.maxInterruptsPerSec * WINDOW_US / 1000000;
+    if(_maxInterruptsPerWindow == 0){
+        _maxInterruptsPerWindow = 1;
+    }
+    // A noisy input gives about one edge per four samples, so the limit is well below this and below the storm limit.
+    _maxSampledPerWindow = WINDOW_US / SAMPLE_PERIOD_US / 8;
+    if(_maxInterruptsPerWindow / 4 < _maxSampledPerWindow){
+        _maxSampledPerWindow = _maxInterruptsPerWindow / 4;
+    }
+    if(_maxSampledPerWindow == 0){
+        _maxSampledPerWindow = 1;
+    }
+    _windowInterrupts = 0;
+    _hasImpulse = false;
+    _sampling = false;
+}
+
+bool StormGuard::onSample(bool level, uint32_t nowUs){
+    bool rising = level && !_lastLevel;
+    _lastLevel = level;
+
+    // Count the edges like the interrupts, but a window with too many edges only restarts the holdoff.
+    if(nowUs - _windowStartUs >= WINDOW_US){
+        _windowStartUs = nowUs;
+        _windowInterrupts = 0;
+    }
+    if(rising && ++_windowInterrupts > _maxSampledPerWindow){
+        _quietSinceUs = nowUs;
+    }
+
+    return rising && _debounce(nowUs);
+}
+
+bool StormGuard::canRearm(uint32_t nowUs){
+    if(!_sampling || nowUs - _quietSinceUs < REARM_HOLDOFF_US){
+        return false;
+    }
+
+    _sampling = false;
+    _windowStartUs = nowUs;
+    _windowInterrupts = 0;
+    return true;
+}
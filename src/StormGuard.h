@@ -0,0 +1,113 @@
+#ifndef STORM_GUARD_H
+#define STORM_GUARD_H
+#include <stdint.h>
+#include "Hal.h"
+
+// Debounce the impulses of a interrupt and protect the CPU against a interrupt storm of a noisy or floating input.
+// In interrupt mode onInterrupt() is called by the ISR. If there are more interrupts than allowed, the interrupt must be
+// disabled and the pin is sampled periodic with onSample(), which has a bounded cost. If the sampled rate is normal again
+// for REARM_HOLDOFF_US, canRearm() returns true and the interrupt can be enabled again.
+// The functions are not thread-safe, but the ISR and the sampling never run at the same time.
+// The times are micro seconds which may wrap around, only their differences are used.
+class StormGuard
+{
+public:
+	// The result of onInterrupt().
+	enum Decision
+	{
+		COUNT,				// Count the impulse
+		IGNORE,				// A glitch, the impulse is too close to the last one
+		STORM				// Too many interrupts, switch to sampling
+	};
+
+	struct Config
+	{
+		uint32_t minSpacingUs;				// Impulses closer to the last counted impulse are glitches, 0 to disable the debouncing
+		uint32_t maxInterruptsPerSec;		// More interrupts per second are a storm, 0 to disable the storm detection
+	};
+
+	const static uint32_t DEFAULT_MAX_INTERRUPTS_PER_SEC = 5000;
+	// The interrupts are counted in windows of this time, so a storm is detected within WINDOW_US.
+	const static uint32_t WINDOW_US = 100000;
+	// The sampled rate must be low for this time before the interrupt is enabled again.
+	const static uint32_t REARM_HOLDOFF_US = 10000000;
+	// The period of onSample() calls.
+	const static uint32_t SAMPLE_PERIOD_US = 2000;
+
+	//**** user functions
+	// Set the configuration and start in interrupt mode.
+	void begin(const Config& config);
+	const Config& config() const { return _config; }
+
+	//**** interrupt mode
+	// Called by the ISR for every interrupt.
+	Decision IRAM_ATTR onInterrupt(uint32_t nowUs)
+	{
+		if (_config.maxInterruptsPerSec > 0)
+		{
+			if (nowUs - _windowStartUs >= WINDOW_US)
+			{
+				_windowStartUs = nowUs;
+				_windowInterrupts = 0;
+			}
+			if (++_windowInterrupts > _maxInterruptsPerWindow)
+			{
+				_startSampling(nowUs);
+				return STORM;
+			}
+		}
+		return _debounce(nowUs) ? COUNT : IGNORE;
+	}
+
+	//**** sampling mode
+	// Called periodic with the level of the pin. Returns true if a impulse is counted.
+	bool onSample(bool level, uint32_t nowUs);
+	// True if the interrupt can be enabled again, then the guard is in interrupt mode.
+	bool canRearm(uint32_t nowUs);
+	// True while the pin is sampled.
+	bool isSampling() const { return _sampling; }
+
+	//**** statistic
+	// Number of ignored impulses.
+	unsigned long glitches() const { return _glitches; }
+	// Number of detected interrupt storms.
+	unsigned long storms() const { return _storms; }
+
+private:
+	Config _config = {0, DEFAULT_MAX_INTERRUPTS_PER_SEC};
+	uint32_t _maxInterruptsPerWindow = DEFAULT_MAX_INTERRUPTS_PER_SEC / 10;
+	uint32_t _maxSampledPerWindow = 1;								// More sampled edges per window restart the holdoff
+	uint32_t _windowStartUs = 0;
+	uint32_t _windowInterrupts = 0;
+	bool _hasImpulse = false;										// True, if _lastImpulseUs is valid
+	uint32_t _lastImpulseUs = 0;									// Time of the last counted impulse
+	volatile bool _sampling = false;
+	bool _lastLevel = false;										// The last sampled level
+	uint32_t _quietSinceUs = 0;										// Start of the time with a normal sampled rate
+	volatile unsigned long _glitches = 0;
+	volatile unsigned long _storms = 0;
+
+	bool IRAM_ATTR _debounce(uint32_t nowUs)
+	{
+		if (_config.minSpacingUs > 0 && _hasImpulse && nowUs - _lastImpulseUs < _config.minSpacingUs)
+		{
+			_glitches++;
+			return false;
+		}
+		_lastImpulseUs = nowUs;
+		_hasImpulse = true;
+		return true;
+	}
+
+	void IRAM_ATTR _startSampling(uint32_t nowUs)
+	{
+		_storms++;
+		_sampling = true;
+		_lastLevel = true;
+		_windowStartUs = nowUs;
+		_windowInterrupts = 0;
+		_quietSinceUs = nowUs;
+	}
+};
+
+#endif
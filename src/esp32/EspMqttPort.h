@@ -0,0 +1,23 @@
+#ifndef ESP_MQTT_PORT_H
+#define ESP_MQTT_PORT_H
+#include <EspMQTTClient.h>
+#include "MqttPort.h"
+
+// MqttPort for the EspMQTTClient of the ESP32.
+class EspMqttPort : public MqttPort
+{
+public:
+	explicit EspMqttPort(EspMQTTClient& mqttClient) : _mqttClient(mqttClient) {}
+
+	bool isConnected() override { return _mqttClient.isConnected(); }
+	bool publish(const char* topic, const char* payload, bool retain = false) override { return _mqttClient.publish(topic, payload, retain); }
+	bool subscribe(const char* topic, message_handler_t handler) override
+	{
+		return _mqttClient.subscribe(topic, [handler](const String &message) { handler(message.c_str()); });
+	}
+
+private:
+	EspMQTTClient& _mqttClient;
+};
+
+#endif
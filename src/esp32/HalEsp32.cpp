@@ -0,0 +1,205 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <hal/cpu_hal.h>
+#include <esp_heap_caps.h>
+#include <sys/time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <MyDateTime.h>
+#include "Hal.h"
+
+void Hal::pinModeInputPulldown(uint8_t pin){
+    pinMode(pin, INPUT_PULLDOWN);
+}
+
+void Hal::pinModeInputPullup(uint8_t pin){
+    pinMode(pin, INPUT_PULLUP);
+}
+
+bool Hal::supportsInterrupt(uint8_t pin){
+    return (digitalPinToInterrupt(pin) != NOT_AN_INTERRUPT);
+}
+
+void Hal::attachRisingInterrupt(uint8_t pin, callback_isr_t isr){
+    attachInterrupt(digitalPinToInterrupt(pin), isr, RISING);
+}
+
+void Hal::attachFallingInterrupt(uint8_t pin, callback_isr_t isr){
+    attachInterrupt(digitalPinToInterrupt(pin), isr, FALLING);
+}
+
+void Hal::detachInterrupt(uint8_t pin){
+    ::detachInterrupt(digitalPinToInterrupt(pin));
+}
+
+void IRAM_ATTR Hal::disableInterruptFromIsr(uint8_t pin){
+    // gpio_intr_disable() is not in IRAM, the inline low level function is.
+    gpio_ll_intr_disable(&GPIO, (gpio_num_t)pin);
+}
+
+void Hal::enableInterrupt(uint8_t pin){
+    gpio_intr_enable((gpio_num_t)pin);
+}
+
+bool Hal::readPin(uint8_t pin){
+    return digitalRead(pin) == HIGH;
+}
+
+unsigned long Hal::millis(){
+    return ::millis();
+}
+
+int64_t IRAM_ATTR Hal::micros(){
+    // esp_timer_get_time() is in IRAM.
+    return esp_timer_get_time();
+}
+
+time_t Hal::utcTime(){
+    return DateTime.getTime();
+}
+
+int64_t Hal::utcTimeMs(){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+int64_t Hal::utcTimeUs(){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+uint32_t IRAM_ATTR Hal::cycleCount(){
+    return cpu_hal_get_cycle_count();
+}
+
+time_t Hal::bootTime(){
+    return DateTime.getBootTime();
+}
+
+void Hal::serialWriteLine(const char* buff, size_t len){
+    Serial.write((const uint8_t*)buff, len);
+    Serial.println();
+}
+
+// The task which waits in waitForEvent(), NULL until it waits the first time.
+static std::atomic<TaskHandle_t> eventTask(NULL);
+
+void Hal::notifyEvent(){
+    TaskHandle_t task = eventTask.load();
+    if(task != NULL){
+        xTaskNotifyGive(task);
+    }
+}
+
+void Hal::waitForEvent(unsigned long timeoutMs){
+    eventTask.store(xTaskGetCurrentTaskHandle());
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+}
+
+void Hal::restart(){
+    ESP.restart();
+}
+
+size_t Hal::freeHeap(){
+    return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+size_t Hal::largestFreeBlock(){
+    return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+OneShotTimer::~OneShotTimer(){
+    if(_handle != NULL){
+        esp_timer_stop((esp_timer_handle_t)_handle);
+        esp_timer_delete((esp_timer_handle_t)_handle);
+    }
+}
+
+bool OneShotTimer::begin(callback_timer_t callback, void* arg, const char* name){
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = callback;
+    timerArgs.arg = arg;
+    timerArgs.name = name;
+    esp_timer_handle_t handle;
+    if(esp_timer_create(&timerArgs, &handle) != ESP_OK){
+        return false;
+    }
+    _handle = handle;
+    return true;
+}
+
+void OneShotTimer::start(int64_t delayUs){
+    if(_handle != NULL){
+        esp_timer_stop((esp_timer_handle_t)_handle);
+        esp_timer_start_once((esp_timer_handle_t)_handle, delayUs > 0 ? delayUs : 0);
+    }
+}
+
+void OneShotTimer::stop(){
+    if(_handle != NULL){
+        esp_timer_stop((esp_timer_handle_t)_handle);
+    }
+}
+
+// The state of a NotifiedTask, the task runs until the NotifiedTask is destroyed.
+struct EspNotifiedTask
+{
+    NotifiedTask::callback_task_t callback;
+    void* arg;
+    TaskHandle_t task;
+};
+
+static void runNotifiedTask(void* arg){
+    EspNotifiedTask* notified = (EspNotifiedTask*)arg;
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        notified->callback(notified->arg);
+    }
+}
+
+NotifiedTask::~NotifiedTask(){
+    EspNotifiedTask* notified = (EspNotifiedTask*)_handle;
+    if(notified != NULL){
+        vTaskDelete(notified->task);
+        delete notified;
+    }
+}
+
+bool NotifiedTask::begin(callback_task_t callback, void* arg, const char* name){
+    // Above the counting task, so the ISR work is done before the next intervall is counted.
+    const uint32_t STACK_SIZE = 3072;
+    const UBaseType_t PRIORITY = 5;
+    EspNotifiedTask* notified = new EspNotifiedTask();
+    notified->callback = callback;
+    notified->arg = arg;
+    if(xTaskCreatePinnedToCore(runNotifiedTask, name, STACK_SIZE, notified, PRIORITY, &notified->task, tskNO_AFFINITY) != pdPASS){
+        delete notified;
+        return false;
+    }
+    _handle = notified;
+    return true;
+}
+
+void IRAM_ATTR NotifiedTask::notifyFromIsr(){
+    EspNotifiedTask* notified = (EspNotifiedTask*)_handle;
+    if(notified != NULL){
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(notified->task, &woken);
+        if(woken == pdTRUE){
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+void NotifiedTask::notify(){
+    EspNotifiedTask* notified = (EspNotifiedTask*)_handle;
+    if(notified != NULL){
+        xTaskNotifyGive(notified->task);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef WIRE_EXPANDER_BUS_H
+#define WIRE_EXPANDER_BUS_H
+#include <Wire.h>
+#include "ExpanderBus.h"
+
+// ExpanderBus for the I2C bus of the ESP32, e.g. for the MCP23017.
+class WireExpanderBus : public ExpanderBus
+{
+public:
+	explicit WireExpanderBus(TwoWire& wire) : _wire(wire) {}
+
+	bool writeRegisters(uint8_t device, uint8_t reg, const uint8_t* data, size_t len) override
+	{
+		_wire.beginTransmission(device);
+		_wire.write(reg);
+		_wire.write(data, len);
+		return _wire.endTransmission() == 0;
+	}
+
+	bool readRegisters(uint8_t device, uint8_t reg, uint8_t* data, size_t len) override
+	{
+		// Write the register address and read with a repeated start.
+		_wire.beginTransmission(device);
+		_wire.write(reg);
+		if (_wire.endTransmission(false) != 0 || _wire.requestFrom(device, (uint8_t)len) != len)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < len; i++)
+		{
+			data[i] = (uint8_t)_wire.read();
+		}
+		return true;
+	}
+
+private:
+	TwoWire& _wire;
+};
+
+#endif
@@ -1,11 +1,20 @@
-#include <array>
-#include <vector>
-#include <sstream>
 #include <Arduino.h>
+#include <LittleFS.h>
 #include <EspMQTTClient.h>
+#include <esp_system.h>
 #include <MyDateTime.h>
-#include "ImpulseMeter.h"
+#include "esp32/EspMqttPort.h"
+#if EXPANDER_BANKS > 0
+#include <Wire.h>
+#include "esp32/WireExpanderBus.h"
+#endif
+#include "MqttHandoff.h"
+#include "MeterNode.h"
+#include "CommandParser.h"
+#include "CounterConfigStore.h"
+#include "Journal.h"
 #include "Logger.h"
+#include "MeterTotals.h"
 
 using namespace std;
 
@@ -13,42 +22,61 @@ using namespace std;
 
 #define MQTT_DEBUG true
 
+#define PUBLISH_BATCHED false // If true, the intervalls of all counters with the same end time are published in one message to Impulses/MY_NAME
+
 #define LED_RED_PIN 32
 #define LED_GREEN_PIN 33
 #define LED_PERIOD 500 // 0,5 Sec.
 ulong _nextLedTime;
 int8_t _ledState;
 
-unsigned long impulsesOverAll;
-
-#define PUBLISH_READY_PERIOD 5 * 1000 // 5 Sec.
-ulong _nextPublishReadyTime;
-
-#define HEARTBEAT_PERIOD 60 * 1000 // 1 minute
-ulong _nextHeartbeatTime;
-
-void plotImpulses(ImpulseMeterStatus status);
-
-vector<string> split (const string &s, char delim) {
-    vector<string> result;
-    stringstream ss (s);
-    string item;
-
-    while (getline (ss, item, delim)) {
-        result.push_back (item);
-    }
-
-    return result;
-}
+#define MQTT_POLL_PERIOD 100UL // ms, the longest sleep of the network task, so the MQTT client can receive messages and keep the connection
+#define PIPELINE_STATS_PERIOD 60000UL // ms, publish the state of the pipeline to Pipeline/MY_NAME
+#define PIPELINE_TOPIC "Pipeline/" MY_NAME
+#define DEBUG_MQTT_TOPIC MY_NAME "/DebugMQTT"
+
+// The counting task updates the meters, writes the journal and formats the messages. It runs on the APP CPU
+// with a higher priority than the network task, which runs the MQTT client on the PRO CPU beside the WiFi stack.
+// Both are connected by the MqttHandoff, so a blocked MQTT client doesn´t delay the counting.
+#define COUNTING_TASK_CORE 1
+#define COUNTING_TASK_PRIORITY 3
+#define NETWORK_TASK_CORE 0
+#define NETWORK_TASK_PRIORITY 1
+#define TASK_STACK_SIZE 8192
+TaskHandle_t countingTask;
+TaskHandle_t networkTask;
+StallMeter countingStall;
+StallMeter networkStall;
+void countingTaskLoop(void* arg);
+void networkTaskLoop(void* arg);
+
+#define JOURNAL_SEGMENTS 8 // Segment files of the journal, the oldest is cleared when the journal is full
+#define JOURNAL_SEGMENT_SIZE (1024 * 64) // 1024 records of 64 Bytes per segment. Enough for some hours without MQTT connection.
+#define TOTALS_SLOTS 8 // Checkpoint slots of the totals, 176 Bytes per slot
+#define TOTALS_MIN_PERIOD_IN_SEC 900 // Max. one checkpoint every 15 minutes, about 35000 writes per year
 
 Logger logger;
-
-#define SPLIT_TAB(x) split(x,'\t')
-
-std::array<ImpulseMeter*,MAX_COUNTERS> impulseMeters;
+MeterNode meterNode;
+FileSegmentStorage journalStorage;
+Journal journal;
+FileJournalStorage totalsStorage;
+MeterTotals totals;
+FileJournalStorage counterConfigStorage;
+CounterConfigStore counterConfigStore;
+
+#if EXPANDER_BANKS > 0
+// The MCP23017 banks get the CounterIds after the GPIO counters, see EXPANDER_BANKS. They use the I2C pins of the
+// ESP32, so the counters 10 and 11 can´t be used. The interrupt outputs of all banks are connected to one line.
+#define EXPANDER_SDA_PIN 21
+#define EXPANDER_SCL_PIN 22
+#define EXPANDER_INTERRUPT_PIN 4
+#define EXPANDER_I2C_FREQUENCY 400000
+#define EXPANDER_FIRST_ADDRESS 0x20 // The address of the first bank, the other banks follow
+WireExpanderBus expanderBus(Wire);
+ExpanderBank expanderBanks[EXPANDER_BANKS];
+#endif
 
 //***************** Begin MQTT *********************************
-void PublishStatus();
 
 EspMQTTClient mqttClient(
   "PothornWelle",
@@ -58,97 +86,30 @@ EspMQTTClient mqttClient(
   "",             // Can be omitted if not needed
   MY_NAME         // Client name that uniquely identify your device
 );
-
-void restartHandler(const String &message){
-  ESP.restart();
-}
-
-int getInstalledCounters(){
-  int counters = 0;
-  for (size_t i = 0; i < MAX_COUNTERS; i++)
-  {
-    if(impulseMeters[i] != NULL){
-      counters++;
-    }
-  }
-
-  return counters;
-}
-
-void getStatusHandler(const String &message){
-  PublishStatus();
-}
+EspMqttPort mqttPort(mqttClient);
+MqttHandoff mqttHandoff;
+// The packet of the longest message: fixed header, topic length, topic and payload. The default of the client is
+// smaller, so the client would reject e.g. the batches and the metrics.
+#define MQTT_MAX_PACKET_SIZE (5 + 2 + MqttPort::MAX_TOPIC_LEN + MqttHandoff::MAX_PAYLOAD_LEN)
+static_assert(MqttHandoff::outboundSize(MeterNode::maxLoopMessages(), MeterNode::maxLoopLen()) <= MqttHandoff::OUTBOUND_BUFFER_SIZE,
+  "The outbound ring of the handoff must hold the messages of one loop of the MeterNode, build with a larger MQTT_OUTBOUND_BUFFER_SIZE");
+static_assert(CommandParser::MAX_INSTALL_COUNTER_LEN * MAX_COUNTERS <= MqttHandoff::MAX_PAYLOAD_LEN,
+  "A bulk InstallCounters message with all counters must fit into a received message, build with a larger MQTT_MAX_PAYLOAD_LEN");
 
 void DebugMqttHandler(const String &message){
-  try
-  {
-    bool enable;
-    istringstream(message.c_str()) >> enable;
-    mqttClient.enableDebuggingMessages(enable);
-  }
-  catch(const std::exception& e)
-  {
-    logger.printError("Failed to set MQTT debug on/off. Wrong message format: '%s'::  %s", message, e.what());
-  }
-}
-
-// Install a counter to get the impulses.
-// The message has a ID, SourceName and a intervall separated by TAB
-void installCounterHandler(const String &message){
-  try
-  {
-    vector<string> parameters = SPLIT_TAB(message.c_str());
-    uint32_t counterId;
-    istringstream(parameters[0]) >> counterId;
-    string sourceName = parameters[1];
-    uint32_t timerIntervallInSec;
-    istringstream(parameters[2]) >> timerIntervallInSec;
-    ImpulseMeter* existingImpulseMeter = impulseMeters[counterId];
-    if(existingImpulseMeter != NULL){
-      existingImpulseMeter->begin(counterId, timerIntervallInSec, sourceName.c_str(), plotImpulses, &logger);
-      logger.printMessage("Update counterId: %u SourceName: %s timerIntervall %u\n", counterId, sourceName.c_str(), timerIntervallInSec);
-    }else
-    {
-      ImpulseMeter* impulseMeter = new ImpulseMeter();
-      impulseMeter->begin(counterId, timerIntervallInSec, sourceName.c_str(), plotImpulses, &logger);
-      impulseMeters[counterId] = impulseMeter;
-      logger.printMessage("Add counterId: %u SourceName: %s timerIntervall %u\n", counterId, sourceName.c_str(), timerIntervallInSec);
-    }
-  }
-  catch(const std::exception& e)
-  {
-    logger.printError("Failed to install the counter: '%s'::  %s", message, e.what());
+  uint32_t enable;
+  if(CommandParser::parseUInt(message.c_str(), enable)){
+    mqttClient.enableDebuggingMessages(enable != 0);
+  }else{
+    logger.printError("Failed to set MQTT debug on/off. Wrong message format: '%s'", message.c_str());
   }
 }
 
 void setupMqttSubscriber(){
   if(mqttClient.isConnected()){
-    string myName = MY_NAME;
-    string topic = myName + "/InstallCounter";
-    mqttClient.subscribe(topic.c_str(), installCounterHandler);
-    topic = myName + "/Restart";
-    mqttClient.subscribe(topic.c_str(),restartHandler);
-    topic = myName + "/GetStatus";
-    mqttClient.subscribe(topic.c_str(),getStatusHandler);
-    topic = myName + "/DebugMQTT";
-    mqttClient.subscribe(topic.c_str(),DebugMqttHandler);
+    mqttClient.subscribe(DEBUG_MQTT_TOPIC, DebugMqttHandler);
   }
-}
-
-void PublishReady(){
-  string topic = "Ready/";
-  topic += MY_NAME;
-  mqttClient.publish(topic.c_str(),"", true);
-  _nextPublishReadyTime = millis() + PUBLISH_READY_PERIOD;
-}
-
-void PublishStatus(){
-  int counters = getInstalledCounters();
-  char buff[80];
-  snprintf(buff, 80, "%s\t%s\t%d\t%lu", FormatTime(DateTime.getTime()), FormatTime(DateTime.getBootTime()), counters, impulsesOverAll);
-  string topic = "Status/";
-  topic += MY_NAME;
-  mqttClient.publish(topic.c_str(), buff);
+  meterNode.setupMqttSubscriber();
 }
 
 //***************** End MQTT *********************************
@@ -166,18 +127,6 @@ const int pwmChannel = 0;
 const int pwmResolution = 8;
 #endif
 
-#define IMPULSE_METER_UPDATE_PERIOD 1 * 1000 // 1 Sec
-unsigned long _nextImpulseMeterUpdate;
-
-void plotImpulses(ImpulseMeterStatus status)
-{
-  char payload[40]; 
-  logger.printMessage("%s - Source: %s; Intervall in sec: %d; Time: %s; Impulses: %lu\n", DateTime.toISOString().c_str(), status.sourceName, status.timerIntervallInSec, FormatTime(status.utcTime), status.impulse);
-  snprintf(payload, sizeof(payload),"%s\t%lu", FormatTime(status.utcTime), status.impulse);
-  mqttClient.publish(status.sourceName, payload, false);
-  impulsesOverAll += status.impulse;
-}
-
 void setupMeter() {
 #if AUTO_TEST
   // configure LED PWM functionalitites
@@ -187,6 +136,70 @@ void setupMeter() {
   ledcWrite(pwmChannel, 125);
 #endif
 }
+
+// Open the journal in the LittleFS partition, so no intervall is lost while the MQTT connection is down.
+void setupJournal() {
+  // The journal of the older firmware was one file, which is written in place.
+  remove("/littlefs/journal.bin");
+  if(!journalStorage.begin("/littlefs/journal", JOURNAL_SEGMENTS, JOURNAL_SEGMENT_SIZE, true) || !journal.begin(&journalStorage)){
+    logger.printError("Failed to open the journal, the journal is not used.");
+    return;
+  }
+  meterNode.setJournal(&journal);
+}
+
+// Called by esp_restart(), e.g. after a OTA update. A brownout resets the chip without this handler,
+// then the impulses since the last checkpoint are lost. A restart by the MeterNode has written the checkpoint already.
+void storeTotalsBeforeRestart() {
+  if(!meterNode.isRestarting()){
+    totals.checkpoint(true);
+  }
+}
+
+// Restore the totals of the counters from the LittleFS partition.
+void setupTotals() {
+  if(!totalsStorage.begin("/littlefs/totals.bin", "/littlefs/totals.cur", true) || !totals.begin(&totalsStorage, TOTALS_SLOTS, TOTALS_MIN_PERIOD_IN_SEC)){
+    logger.printError("Failed to open the totals, the totals are not kept.");
+    return;
+  }
+  meterNode.setTotals(&totals);
+  esp_register_shutdown_handler(storeTotalsBeforeRestart);
+}
+
+// Install the stored counters, so the impulses are counted before the WiFi and MQTT connection is established.
+void setupCounterConfig() {
+  if(!counterConfigStorage.begin("/littlefs/counters.bin", "/littlefs/counters.cur", true) || !counterConfigStore.begin(&counterConfigStorage)){
+    logger.printError("Failed to open the counter configuration, the counters are installed by the controller.");
+    return;
+  }
+  meterNode.setConfigStore(&counterConfigStore);
+}
+
+// Configure the expander banks, before the stored counters are installed.
+void setupExpanders() {
+#if EXPANDER_BANKS > 0
+  ImpulseSource::reservePin(EXPANDER_SDA_PIN);
+  ImpulseSource::reservePin(EXPANDER_SCL_PIN);
+  ImpulseSource::reservePin(EXPANDER_INTERRUPT_PIN);
+  Wire.begin(EXPANDER_SDA_PIN, EXPANDER_SCL_PIN, EXPANDER_I2C_FREQUENCY);
+  for (uint8_t i = 0; i < EXPANDER_BANKS; i++)
+  {
+    if(!expanderBanks[i].begin(i, &expanderBus, EXPANDER_FIRST_ADDRESS + i, EXPANDER_INTERRUPT_PIN)){
+      logger.printError("Expander bank %u at address 0x%02x doesn´t answer, its counters can´t be used.\n", (unsigned int)i, (unsigned int)(EXPANDER_FIRST_ADDRESS + i));
+    }
+  }
+#endif
+}
+
+void setupStorage() {
+  if(!LittleFS.begin(true)){
+    logger.printError("Failed to mount LittleFS, the journal, the totals and the counter configuration are not used.");
+    return;
+  }
+  setupJournal();
+  setupTotals();
+  setupCounterConfig();
+}
 //***************** End ImpulseMeter *********************************
 
 void setupDateTime() {
@@ -210,17 +223,29 @@ void setup() {
 
   // put your setup code here, to run once:
   Serial.begin(115200);
-  logger.begin((char *)MY_NAME, &mqttClient);
-  
-  // Clear the array with the impulse meters.
-  impulseMeters.fill(NULL);
+  logger.begin((char *)MY_NAME, &mqttPort);
+  // The meters and the buffers are static, so the heap only changes by the libraries. Compare it with the N line of the metrics.
+  logger.printMessage("Heap before setup: free %u; largest free block %u\n", (unsigned int)Hal::freeHeap(), (unsigned int)Hal::largestFreeBlock());
+  mqttHandoff.begin(&mqttPort, &logger);
+  meterNode.begin(MY_NAME, &mqttHandoff, &logger);
+#if PUBLISH_BATCHED
+  meterNode.setPublishMode(MeterNode::PUBLISH_BATCH);
+#endif
+  setupExpanders();
+  setupStorage();
+  logger.printMessage("Heap after setup: free %u; largest free block %u\n", (unsigned int)Hal::freeHeap(), (unsigned int)Hal::largestFreeBlock());
   // Optionnal functionnalities of EspMQTTClient :
   mqttClient.enableDebuggingMessages(MQTT_DEBUG); // Enable/disable debugging messages sent to serial output
+  mqttClient.setMaxPacketSize(MQTT_MAX_PACKET_SIZE);
   mqttClient.enableHTTPWebUpdater(); // Enable the web updater. User and password default to values of MQTTUsername and MQTTPassword. These can be overrited with enableHTTPWebUpdater("user", "password").
   // If I change the topic form TestClient/lastwill to LastWill/ESP1 then the client can´t connect to the broker!?
   //string topic = "LastWill/";
   //topic += MY_NAME;
   //mqttClient.enableLastWillMessage("TestClient/lastwill", "I am going offline");  // You can activate the retain flag by setting the third parameter to true
+
+  // The counting task wakes up the network task, therefor the network task must exist first.
+  xTaskCreatePinnedToCore(networkTaskLoop, "Network", TASK_STACK_SIZE, NULL, NETWORK_TASK_PRIORITY, &networkTask, NETWORK_TASK_CORE);
+  xTaskCreatePinnedToCore(countingTaskLoop, "Counting", TASK_STACK_SIZE, NULL, COUNTING_TASK_PRIORITY, &countingTask, COUNTING_TASK_CORE);
 }
 
 // This function is called once everything is connected (Wifi and MQTT)
@@ -228,44 +253,65 @@ void setup() {
 void onConnectionEstablished() {
   setupDateTime();
   if(DateTime.isTimeValid() == false){
-    logger.printError("Date/Time is not valid, restart the board...");
-    ESP.restart();
+    // The intervalls are timed by the monotonic clock and get their end times when the SNTP client sets the time.
+    logger.printError("Date/Time is not valid, the intervalls get their time when it is set.");
+  }else{
+    logger.printMessage("Current UTC time: %s\n",DateTime.toISOString().c_str());
   }
-
-  logger.printMessage("Current UTC time: %s\n",DateTime.toISOString().c_str());
   setupMeter();
   setupMqttSubscriber();
-  PublishReady();
+  // Called by the network task, the counting task publishes the message.
+  meterNode.requestReady();
 
   // LED red off and LED green on
   digitalWrite (LED_RED_PIN, LOW);	
   digitalWrite (LED_GREEN_PIN, HIGH);	
 }
 
-void loop() {
-  if (_nextPublishReadyTime < millis() && getInstalledCounters() == 0){
-    // Publish Ready over MQTT, because no counter is installed.
-    PublishReady();
-  }
+void publishPipelineStats(){
+  MqttHandoff::Stats stats = mqttHandoff.stats();
+  char payload[160];
+  snprintf(payload, sizeof(payload), "%u\t%u\t%lu\t%lu\t%u\t%u\t%lu\t%lu\t%lu\t%lu\t%lu",
+    (unsigned int)stats.outboundDepth, (unsigned int)stats.outboundHighWater, stats.outboundOverflows, stats.maxPublishDelayMs,
+    (unsigned int)stats.inboundDepth, (unsigned int)stats.inboundHighWater, stats.inboundOverflows, countingStall.max(), networkStall.max(),
+    stats.outboundRejected, stats.inboundTooLong);
+  mqttClient.publish(PIPELINE_TOPIC, payload);
+}
 
-  if(_nextHeartbeatTime < millis()){
-    // Publish the status over MQTT as a heartbeat
-    PublishStatus();
-    _nextHeartbeatTime = millis() + HEARTBEAT_PERIOD;
-  }
-  
-  if (_nextImpulseMeterUpdate < millis())
-  {
-    for (size_t i = 0; i < MAX_COUNTERS; i++)
-    {
-      if(impulseMeters[i] != NULL){
-        impulseMeters[i]->update();
-      }
+void countingTaskLoop(void* /*arg*/) {
+  for(;;){
+    countingStall.start();
+    mqttHandoff.dispatch();
+    unsigned long waitMs = meterNode.loop();
+    countingStall.stop();
+    if(mqttHandoff.pending()){
+      xTaskNotifyGive(networkTask);
     }
-    
-    _nextImpulseMeterUpdate = millis() +  IMPULSE_METER_UPDATE_PERIOD;
+
+    // Sleep until a intervall is closed, a message is received or the next job is due.
+    Hal::waitForEvent(waitMs);
   }
+}
 
-  delay(100);
-  mqttClient.loop();
+void networkTaskLoop(void* /*arg*/) {
+  unsigned long nextPipelineStatsTime = millis() + PIPELINE_STATS_PERIOD;
+  for(;;){
+    networkStall.start();
+    mqttClient.loop();
+    mqttHandoff.forward();
+    logger.loop();
+    if((long)(millis() - nextPipelineStatsTime) >= 0){
+      publishPipelineStats();
+      nextPipelineStatsTime = millis() + PIPELINE_STATS_PERIOD;
+    }
+    networkStall.stop();
+
+    // The MQTT client has no events, therefor it is polled. The counting task wakes up this task for new messages.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_POLL_PERIOD));
+  }
 }
+
+void loop() {
+  // All work is done by the counting and the network task.
+  vTaskDelete(NULL);
+}
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Hal.h"
+
+namespace
+{
+    const int MAX_PINS = 40;
+    Hal::callback_isr_t isrs[MAX_PINS] = {};
+    std::atomic<bool> interruptEnabled[MAX_PINS];
+    std::atomic<bool> levels[MAX_PINS];
+    std::atomic<bool> fallingEdge[MAX_PINS];
+    // The ISRs run one after the other like on one CPU, also if the levels are simulated by some threads.
+    std::mutex isrMutex;
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    const time_t bootUtcTime = time(NULL);
+
+    // State of the simulated clock, see Hal::simulateClock().
+    std::atomic<bool> clockSimulated{false};
+    std::atomic<int64_t> simulatedMicros{0};                // Micro seconds since boot
+    std::atomic<int64_t> simulatedBootUtcUs{0};             // UTC at boot, changed by stepUtcTime()
+
+    // State of notifyEvent() and waitForEvent().
+    std::mutex eventMutex;
+    std::condition_variable eventChanged;
+    bool eventPending = false;
+
+    // The Linux timer is a thread which waits for the deadline or a new start.
+    struct LinuxTimer
+    {
+        OneShotTimer::callback_timer_t callback;
+        void* arg;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::chrono::steady_clock::time_point deadline;
+        int64_t deadlineUs;                                 // Deadline of the simulated clock
+        bool armed = false;
+        bool exit = false;
+        std::thread thread;
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!exit)
+            {
+                if (!armed)
+                {
+                    changed.wait(lock);
+                }
+                else
+                {
+                    changed.wait_until(lock, deadline);
+                    if (armed && std::chrono::steady_clock::now() >= deadline)
+                    {
+                        armed = false;
+                        lock.unlock();
+                        callback(arg);
+                        lock.lock();
+                    }
+                }
+            }
+        }
+    };
+
+    // The timers of the simulated clock have no thread, they are called by Hal::advanceClock().
+    // The list is never deleted, because static timers are destroyed after it at exit.
+    std::mutex simulatedTimersMutex;
+    std::vector<LinuxTimer*>& simulatedTimers = *new std::vector<LinuxTimer*>();
+}
+
+void Hal::pinModeInputPulldown(uint8_t /*pin*/){
+}
+
+void Hal::pinModeInputPullup(uint8_t pin){
+    // A open line is high.
+    if(pin < MAX_PINS){
+        levels[pin] = true;
+    }
+}
+
+bool Hal::supportsInterrupt(uint8_t pin){
+    return pin < MAX_PINS;
+}
+
+void Hal::attachRisingInterrupt(uint8_t pin, callback_isr_t isr){
+    if(pin < MAX_PINS){
+        isrs[pin] = isr;
+        fallingEdge[pin] = false;
+        interruptEnabled[pin] = true;
+    }
+}
+
+void Hal::attachFallingInterrupt(uint8_t pin, callback_isr_t isr){
+    if(pin < MAX_PINS){
+        isrs[pin] = isr;
+        fallingEdge[pin] = true;
+        interruptEnabled[pin] = true;
+    }
+}
+
+void Hal::detachInterrupt(uint8_t pin){
+    if(pin < MAX_PINS){
+        isrs[pin] = NULL;
+        interruptEnabled[pin] = false;
+    }
+}
+
+void Hal::disableInterruptFromIsr(uint8_t pin){
+    if(pin < MAX_PINS){
+        interruptEnabled[pin] = false;
+    }
+}
+
+void Hal::enableInterrupt(uint8_t pin){
+    if(pin < MAX_PINS && isrs[pin] != NULL){
+        interruptEnabled[pin] = true;
+    }
+}
+
+bool Hal::readPin(uint8_t pin){
+    return pin < MAX_PINS && levels[pin];
+}
+
+void Hal::simulatePinLevel(uint8_t pin, bool level){
+    if(pin < MAX_PINS){
+        std::lock_guard<std::mutex> lock(isrMutex);
+        bool wasHigh = levels[pin].exchange(level);
+        bool edge = fallingEdge[pin] ? !level && wasHigh : level && !wasHigh;
+        if(edge && interruptEnabled[pin] && isrs[pin] != NULL){
+            isrs[pin]();
+        }
+    }
+}
+
+void Hal::simulateClock(time_t utcTime){
+    simulatedMicros = 0;
+    simulatedBootUtcUs = (int64_t)utcTime * 1000000;
+    clockSimulated = true;
+}
+
+void Hal::advanceClock(int64_t untilUs){
+    while (true)
+    {
+        // Take the timer with the earliest deadline, the first created timer wins if there are some.
+        LinuxTimer* due = NULL;
+        int64_t dueUs = untilUs;
+        {
+            std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+            for (LinuxTimer* timer : simulatedTimers)
+            {
+                std::lock_guard<std::mutex> timerLock(timer->mutex);
+                if(timer->armed && timer->deadlineUs <= dueUs && (due == NULL || timer->deadlineUs < dueUs)){
+                    due = timer;
+                    dueUs = timer->deadlineUs;
+                }
+            }
+            if(due == NULL){
+                break;
+            }
+
+            std::lock_guard<std::mutex> timerLock(due->mutex);
+            due->armed = false;
+            if(dueUs > simulatedMicros){
+                simulatedMicros = dueUs;
+            }
+        }
+        // The callback may start the timer again.
+        due->callback(due->arg);
+    }
+    if(untilUs > simulatedMicros){
+        simulatedMicros = untilUs;
+    }
+}
+
+void Hal::spendTime(int64_t us){
+    simulatedMicros += us > 0 ? us : 0;
+}
+
+void Hal::stepUtcTime(int64_t deltaSec){
+    simulatedBootUtcUs += deltaSec * 1000000;
+}
+
+unsigned long Hal::millis(){
+    if(clockSimulated){
+        return (unsigned long)(simulatedMicros / 1000);
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+int64_t Hal::micros(){
+    if(clockSimulated){
+        return simulatedMicros;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+time_t Hal::utcTime(){
+    return (time_t)(utcTimeUs() / 1000000);
+}
+
+int64_t Hal::utcTimeMs(){
+    return utcTimeUs() / 1000;
+}
+
+int64_t Hal::utcTimeUs(){
+    if(clockSimulated){
+        return simulatedBootUtcUs + simulatedMicros;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint32_t Hal::cycleCount(){
+    if(clockSimulated){
+        return (uint32_t)(simulatedMicros * 1000);
+    }
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+time_t Hal::bootTime(){
+    if(clockSimulated){
+        return (time_t)(simulatedBootUtcUs / 1000000);
+    }
+    return bootUtcTime;
+}
+
+void Hal::serialWriteLine(const char* buff, size_t len){
+    fwrite(buff, 1, len, stdout);
+    fputc('\n', stdout);
+}
+
+void Hal::notifyEvent(){
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        eventPending = true;
+    }
+    eventChanged.notify_all();
+}
+
+void Hal::waitForEvent(unsigned long timeoutMs){
+    std::unique_lock<std::mutex> lock(eventMutex);
+    eventChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs), []{ return eventPending; });
+    eventPending = false;
+}
+
+void Hal::restart(){
+    exit(0);
+}
+
+size_t Hal::freeHeap(){
+    return 0;
+}
+
+size_t Hal::largestFreeBlock(){
+    return 0;
+}
+
+OneShotTimer::~OneShotTimer(){
+    LinuxTimer* timer = (LinuxTimer*)_handle;
+    if(timer != NULL){
+        if(timer->thread.joinable()){
+            {
+                std::lock_guard<std::mutex> lock(timer->mutex);
+                timer->exit = true;
+            }
+            timer->changed.notify_all();
+            timer->thread.join();
+        }
+        else{
+            std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+            for (size_t i = 0; i < simulatedTimers.size(); i++)
+            {
+                if(simulatedTimers[i] == timer){
+                    simulatedTimers.erase(simulatedTimers.begin() + i);
+                    break;
+                }
+            }
+        }
+        delete timer;
+    }
+}
+
+bool OneShotTimer::begin(callback_timer_t callback, void* arg, const char* /*name*/){
+    LinuxTimer* timer = new LinuxTimer();
+    timer->callback = callback;
+    timer->arg = arg;
+    if(clockSimulated){
+        std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+        simulatedTimers.push_back(timer);
+    }
+    else{
+        timer->thread = std::thread(&LinuxTimer::run, timer);
+    }
+    _handle = timer;
+    return true;
+}
+
+void OneShotTimer::start(int64_t delayUs){
+    LinuxTimer* timer = (LinuxTimer*)_handle;
+    if(timer != NULL){
+        {
+            std::lock_guard<std::mutex> lock(timer->mutex);
+            timer->deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(delayUs > 0 ? delayUs : 0);
+            timer->deadlineUs = simulatedMicros + (delayUs > 0 ? delayUs : 0);
+            timer->armed = true;
+        }
+        timer->changed.notify_all();
+    }
+}
+
+void OneShotTimer::stop(){
+    LinuxTimer* timer = (LinuxTimer*)_handle;
+    if(timer != NULL){
+        {
+            std::lock_guard<std::mutex> lock(timer->mutex);
+            timer->armed = false;
+        }
+        timer->changed.notify_all();
+    }
+}
+
+NotifiedTask::~NotifiedTask(){
+    delete (OneShotTimer*)_handle;
+}
+
+bool NotifiedTask::begin(callback_task_t callback, void* arg, const char* name){
+    OneShotTimer* timer = new OneShotTimer();
+    if(!timer->begin(callback, arg, name)){
+        delete timer;
+        return false;
+    }
+    _handle = timer;
+    return true;
+}
+
+void NotifiedTask::notifyFromIsr(){
+    notify();
+}
+
+void NotifiedTask::notify(){
+    OneShotTimer* timer = (OneShotTimer*)_handle;
+    if(timer != NULL){
+        timer->start(0);
+    }
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include "LinuxMqttPort.h"
+
+bool LinuxMqttPort::publish(const char* topic, const char* payload, bool retain){
+    if(!_connected){
+        return false;
+    }
+
+    if(_echo){
+        printf("MQTT %s%s: %s\n", topic, retain ? " (retain)" : "", payload);
+    }
+    _published++;
+    return true;
+}
+
+bool LinuxMqttPort::subscribe(const char* topic, message_handler_t handler){
+    _handlers[topic] = handler;
+    return true;
+}
+
+bool LinuxMqttPort::deliver(const char* topic, const char* message){
+    auto handler = _handlers.find(topic);
+    if(handler == _handlers.end()){
+        return false;
+    }
+
+    handler->second(message);
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef LINUX_MQTT_PORT_H
+#define LINUX_MQTT_PORT_H
+#include <atomic>
+#include <map>
+#include <string>
+#include "MqttPort.h"
+
+// MqttPort for the native build. The published messages are written to stdout,
+// received messages are simulated with deliver().
+class LinuxMqttPort : public MqttPort
+{
+public:
+	bool isConnected() override { return _connected; }
+	bool publish(const char* topic, const char* payload, bool retain = false) override;
+	bool subscribe(const char* topic, message_handler_t handler) override;
+
+	// Simulate a connect or disconnect of the broker.
+	void setConnected(bool connected) { _connected = connected; }
+	// Write every published message to stdout if true.
+	void setEcho(bool echo) { _echo = echo; }
+	// Simulate a received message. Returns false if nobody subscribed the topic.
+	bool deliver(const char* topic, const char* message);
+	// Number of successful publish calls.
+	unsigned long published() const { return _published; }
+
+private:
+	std::atomic<bool> _connected{true};								// Changed by the simulation, read by the network task
+	bool _echo = true;
+	std::atomic<unsigned long> _published{0};
+	std::map<std::string, message_handler_t> _handlers;
+};
+
+#endif
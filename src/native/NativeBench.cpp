@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include "NativeBench.h"
+#include "Hal.h"
+#include "CommandParser.h"
+#include "GpioImpulseSource.h"
+#include "ImpulseMeter.h"
+#include "IntervallBatch.h"
+#include "IsoTimeFormatter.h"
+#include "Logger.h"
+#include "MqttHandoff.h"
+#include "SpscQueue.h"
+#include "LinuxMqttPort.h"
+
+namespace
+{
+    // Every benchmark is run this often, the fastest run is the result.
+    const int REPETITIONS = 5;
+    const int DEFAULT_TOLERANCE_PERCENT = 20;
+    // The pin of the benchmarked GpioImpulseSource.
+    const uint8_t BENCH_PIN = 4;
+
+    // Keep the compiler from removing the measured code.
+    volatile unsigned long sink;
+
+    typedef std::chrono::steady_clock Clock;
+
+    int64_t elapsedNs(Clock::time_point start){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    // A benchmark runs ops operations and returns the nanoseconds of the measured part.
+    struct Benchmark
+    {
+        const char* name;
+        unsigned long ops;
+        int64_t (*run)(unsigned long ops);
+    };
+
+    //**** benchmarks
+    // One impulse through the simulated interrupt: the rising edge calls the ISR, which counts the impulse.
+    // The storm detection is on with a limit which is never reached, the debouncing is off.
+    int64_t benchGpioIsr(unsigned long ops){
+        GpioImpulseSource source;
+        source.setStormGuard({0, 100000000});
+        source.begin(BENCH_PIN);
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            Hal::simulatePinLevel(BENCH_PIN, true);
+            Hal::simulatePinLevel(BENCH_PIN, false);
+        }
+        int64_t ns = elapsedNs(start);
+        sink = source.take();
+        source.end();
+        return ns;
+    }
+
+    // Push and pop of a closed intervall, like the intervall timer and update() of ImpulseMeter.
+    int64_t benchImpulseQueue(unsigned long ops){
+        struct Intervall
+        {
+            time_t utcTime;
+            unsigned long impulse;
+        };
+        SpscQueue<Intervall, 16> queue;
+        Intervall intervall = {0, 0};
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            queue.push({(time_t)i, i});
+            queue.pop(intervall);
+        }
+        int64_t ns = elapsedNs(start);
+        sink = intervall.impulse;
+        return ns;
+    }
+
+    // Format the end times of 60 second intervalls, so the cached hour changes every 60th call.
+    int64_t benchFormatTime(unsigned long ops){
+        IsoTimeFormatter formatter;
+        char buff[IsoTimeFormatter::BUFFER_SIZE];
+        time_t utcTime = 1609459200;
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            formatter.format(utcTime, buff);
+            utcTime += 60;
+        }
+        int64_t ns = elapsedNs(start);
+        sink = buff[18];
+        return ns;
+    }
+
+    int64_t benchRenderTime(unsigned long ops){
+        char buff[IsoTimeFormatter::BUFFER_SIZE];
+        time_t utcTime = 1609459200;
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            IsoTimeFormatter::render(utcTime, buff);
+            utcTime += 60;
+        }
+        int64_t ns = elapsedNs(start);
+        sink = buff[18];
+        return ns;
+    }
+
+    int64_t benchParseInstallCounter(unsigned long ops){
+        CounterConfig config;
+        unsigned long valid = 0;
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            valid += CommandParser::parseInstallCounter("12\tHaus/Heizung/Strom\t60\tGPIO", config) == CommandParser::OK;
+        }
+        int64_t ns = elapsedNs(start);
+        sink = valid;
+        return ns;
+    }
+
+    // A message with a line per counter, the result is per line.
+    int64_t benchParseInstallCounters(unsigned long ops){
+        std::string message;
+        for (int i = 0; i < MAX_COUNTERS; i++)
+        {
+            char line[48];
+            snprintf(line, sizeof(line), "%d\tHaus/Zaehler%02d\t60\n", i, i);
+            message += line;
+        }
+        CounterConfig configs[MAX_COUNTERS];
+        size_t count = 0;
+        size_t errorLine;
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops / MAX_COUNTERS; i++)
+        {
+            CommandParser::parseInstallCounters(message, configs, MAX_COUNTERS, count, errorLine);
+        }
+        int64_t ns = elapsedNs(start);
+        sink = count;
+        return ns;
+    }
+
+    // A message into the ring of the Logger. The ring is emptied by a new Logger outside of the measurement,
+    // because loop() writes to stdout.
+    int64_t benchLogger(unsigned long ops){
+        const unsigned long BATCH = 15;
+        int64_t ns = 0;
+        for (unsigned long done = 0; done < ops; done += BATCH)
+        {
+            Logger logger;
+            logger.begin();
+            Clock::time_point start = Clock::now();
+            for (unsigned long i = 0; i < BATCH; i++)
+            {
+                sink = logger.printMessage("Counter %u: %lu impulses at %s\n", 12u, done + i, "2021-01-01T00:00:00Z");
+            }
+            ns += elapsedNs(start);
+        }
+        return ns;
+    }
+
+    // A status message through the handoff to the (silent) port: publish() of the counting task and forward() of the network task.
+    int64_t benchPublishSingle(unsigned long ops){
+        LinuxMqttPort port;
+        port.setEcho(false);
+        MqttHandoff handoff;
+        handoff.begin(&port);
+        IsoTimeFormatter formatter;
+        char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+        char payload[64];
+        time_t utcTime = 1609459200;
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            snprintf(payload, sizeof(payload), "%s\t%lu", formatter.format(utcTime, timeBuff), i);
+            handoff.publish("Haus/Heizung/Strom", payload, false);
+            handoff.forward();
+            utcTime += 60;
+        }
+        int64_t ns = elapsedNs(start);
+        sink = port.published();
+        return ns;
+    }
+
+    // A intervall of a counter in the batch message, the flush of every 20 intervalls is included.
+    int64_t benchPublishBatch(unsigned long ops){
+        LinuxMqttPort port;
+        port.setEcho(false);
+        IntervallBatch batch;
+        batch.begin(&port, "Batch/Bench", 1024, 10000);
+        ImpulseMeterStatus status = {1609459200, 0, "Haus/Heizung/Strom", 60, 0, 0};
+        Clock::time_point start = Clock::now();
+        for (unsigned long i = 0; i < ops; i++)
+        {
+            status.impulse = i;
+            batch.add(status);
+            if(batch.records() >= (size_t)MAX_COUNTERS){
+                batch.flush();
+                status.utcTime += 60;
+            }
+        }
+        batch.flush();
+        int64_t ns = elapsedNs(start);
+        sink = port.published();
+        return ns;
+    }
+
+    const Benchmark benchmarks[] = {
+        {"gpio_isr_pulse", 200000, benchGpioIsr},
+        {"impulse_queue_push_pop", 2000000, benchImpulseQueue},
+        {"iso_time_format", 2000000, benchFormatTime},
+        {"iso_time_render", 2000000, benchRenderTime},
+        {"parse_install_counter", 1000000, benchParseInstallCounter},
+        {"parse_install_counters_line", 1000000, benchParseInstallCounters},
+        {"logger_print", 300000, benchLogger},
+        {"publish_single", 300000, benchPublishSingle},
+        {"publish_batch_record", 300000, benchPublishBatch},
+    };
+
+    // The fastest of REPETITIONS runs in ns per operation, after a warm up run.
+    double measure(const Benchmark& benchmark){
+        benchmark.run(benchmark.ops / 10);
+        int64_t best = INT64_MAX;
+        for (int i = 0; i < REPETITIONS; i++)
+        {
+            int64_t ns = benchmark.run(benchmark.ops);
+            if(ns < best){
+                best = ns;
+            }
+        }
+        return (double)best / benchmark.ops;
+    }
+
+    bool readBaseline(const char* path, std::map<std::string, double>& baseline){
+        FILE* file = fopen(path, "r");
+        if(file == NULL){
+            return false;
+        }
+
+        char line[128];
+        while (fgets(line, sizeof(line), file) != NULL)
+        {
+            if(line[0] == '#'){
+                continue;
+            }
+            char* tab = strchr(line, '\t');
+            if(tab == NULL){
+                continue;
+            }
+            *tab = 0;
+            baseline[line] = atof(tab + 1);
+        }
+        fclose(file);
+        return true;
+    }
+}
+
+int runBenchmarks(int argc, char* argv[]){
+    const char* baselinePath = argc > 0 ? argv[0] : NULL;
+    bool update = argc > 1 && strcmp(argv[1], "UPDATE") == 0;
+    int tolerancePercent = argc > 1 && !update ? atoi(argv[1]) : DEFAULT_TOLERANCE_PERCENT;
+
+    std::map<std::string, double> baseline;
+    if(baselinePath != NULL && !update && !readBaseline(baselinePath, baseline)){
+        fprintf(stderr, "Failed to read the baseline %s\n", baselinePath);
+        return 1;
+    }
+
+    FILE* baselineFile = NULL;
+    if(update){
+        baselineFile = fopen(baselinePath, "w");
+        if(baselineFile == NULL){
+            fprintf(stderr, "Failed to write the baseline %s\n", baselinePath);
+            return 1;
+        }
+        fprintf(baselineFile, "# name\tns per operation\n");
+    }
+
+    int regressions = 0;
+    double isrNs = 0;
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        double ns = measure(benchmark);
+        if(strcmp(benchmark.name, "gpio_isr_pulse") == 0){
+            isrNs = ns;
+        }
+
+        auto expected = baseline.find(benchmark.name);
+        const char* verdict = "NEW";
+        if(update){
+            fprintf(baselineFile, "%s\t%.1f\n", benchmark.name, ns);
+            verdict = "UPDATED";
+        }else if(expected != baseline.end()){
+            bool slower = ns > expected->second * (100 + tolerancePercent) / 100;
+            regressions += slower;
+            verdict = slower ? "REGRESSION" : "OK";
+        }
+        if(expected != baseline.end()){
+            printf("BENCH\t%s\t%.1f\t%.1f\t%s\n", benchmark.name, ns, expected->second, verdict);
+        }else{
+            printf("BENCH\t%s\t%.1f\t-\t%s\n", benchmark.name, ns, verdict);
+        }
+    }
+    if(baselineFile != NULL){
+        fclose(baselineFile);
+    }
+
+    // The ISRs of all counters run one after the other, so the ISR path limits the sum of the impulses of the node.
+    // A single counter is also limited by the storm detection.
+    unsigned long perNode = isrNs > 0 ? (unsigned long)(1e9 / isrNs) : 0;
+    unsigned long perCounter = perNode < StormGuard::DEFAULT_MAX_INTERRUPTS_PER_SEC ? perNode : StormGuard::DEFAULT_MAX_INTERRUPTS_PER_SEC;
+    printf("# max. impulses per second: per node %lu, per counter %lu (storm limit %u)\n", perNode, perCounter, (unsigned int)StormGuard::DEFAULT_MAX_INTERRUPTS_PER_SEC);
+    if(regressions > 0){
+        printf("# %d regressions over %d%%\n", regressions, tolerancePercent);
+        return 2;
+    }
+    return 0;
+}
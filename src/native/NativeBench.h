@@ -0,0 +1,15 @@
+#ifndef NATIVE_BENCH_H
+#define NATIVE_BENCH_H
+
+// Measure the cost of the hot paths on the host: the ISR path of one impulse, the impulse queue, the time formatting,
+// the parsing of the InstallCounter messages, the Logger and the publish paths.
+// Every result is written as one TAB separated line to stdout:
+//   BENCH  <name>  <ns per operation>  <baseline ns or ->  <OK|NEW|REGRESSION|UPDATED>
+// followed by the theoretical max. impulse rate per counter and per node as comment line ("#").
+// Arguments: [baseline file] [tolerance in % (default 20)|UPDATE]
+// The baseline file has the format "<name> TAB <ns per operation>" per line, lines with "#" are comments.
+// With UPDATE the results are written into the baseline file. Returns 2 if a result is slower than the baseline
+// plus the tolerance, so a script can stop the rollout.
+int runBenchmarks(int argc, char* argv[]);
+
+#endif
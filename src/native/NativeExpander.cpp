@@ -0,0 +1,259 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <queue>
+#include <random>
+#include <vector>
+#include "NativeExpander.h"
+#include "ExpanderBank.h"
+#include "ExpanderImpulseSource.h"
+#include "Hal.h"
+
+namespace
+{
+    const uint8_t INTERRUPT_PIN = 4;
+    const uint8_t FIRST_ADDRESS = 0x20;
+    const int64_t TAKE_PERIOD_US = 60 * 1000000LL;
+
+    // A level change of a input.
+    struct Edge
+    {
+        int64_t timeUs;
+        uint8_t bank;
+        uint8_t channel;
+        bool level;
+
+        bool operator>(const Edge& other) const { return timeUs > other.timeUs; }
+    };
+
+    // A MCP23017 with interrupt on change against the last level: the first change sets INTF and captures the port
+    // into INTCAP, until a read of INTCAP or GPIO removes the interrupt. Later changes don´t set a flag until then.
+    struct SimulatedExpander
+    {
+        uint8_t regs[0x16] = {};
+        uint16_t port = 0;
+        uint16_t flags = 0;
+        uint16_t captured = 0;
+        bool pending = false;
+
+        void setLevel(uint8_t channel, bool level){
+            uint16_t bit = 1 << channel;
+            port = level ? port | bit : port & ~bit;
+            uint16_t enabled = regs[ExpanderBank::REG_GPINTENA] | regs[ExpanderBank::REG_GPINTENA + 1] << 8;
+            if(!pending && (enabled & bit) != 0){
+                pending = true;
+                flags = bit;
+                captured = port;
+            }
+        }
+
+        uint8_t read(uint8_t reg){
+            switch (reg)
+            {
+            case ExpanderBank::REG_INTFA: return flags & 0xFF;
+            case ExpanderBank::REG_INTFA + 1: return flags >> 8;
+            case ExpanderBank::REG_INTCAPA: _clear(); return captured & 0xFF;
+            case ExpanderBank::REG_INTCAPA + 1: _clear(); return captured >> 8;
+            case ExpanderBank::REG_GPIOA: _clear(); return port & 0xFF;
+            case ExpanderBank::REG_GPIOA + 1: _clear(); return port >> 8;
+            default: return reg < sizeof(regs) ? regs[reg] : 0;
+            }
+        }
+
+        // Reading INTCAP or GPIO removes the interrupt and its flags, INTCAP keeps the levels until the next interrupt.
+        void _clear(){
+            pending = false;
+            flags = 0;
+        }
+    };
+
+    // The bus with the expanders and the impulses of their inputs. A read takes the bus latency of the simulated clock
+    // and applies the edges until its end, so the expanders change while the bus is busy.
+    class SimulatedBus : public ExpanderBus
+    {
+    public:
+        SimulatedBus(int banks, int64_t latencyUs, int64_t minLevelUs, double impulsesPerSec, int64_t startUs)
+            : _banks(banks), _latencyUs(latencyUs), _minLevelUs(minLevelUs), _meanPauseUs(1000000.0 / impulsesPerSec), _random(1)
+        {
+            for (int bank = 0; bank < _banks; bank++)
+            {
+                for (uint8_t channel = 0; channel < ExpanderBank::CHANNELS; channel++)
+                {
+                    _edges.push({_nextRise(startUs), (uint8_t)bank, channel, true});
+                }
+            }
+        }
+
+        bool writeRegisters(uint8_t device, uint8_t reg, const uint8_t* data, size_t len) override {
+            SimulatedExpander* expander = _expander(device);
+            if(expander == NULL || reg + len > sizeof(expander->regs)){
+                return false;
+            }
+            for (size_t i = 0; i < len; i++)
+            {
+                expander->regs[reg + i] = data[i];
+            }
+            return true;
+        }
+
+        bool readRegisters(uint8_t device, uint8_t reg, uint8_t* data, size_t len) override {
+            SimulatedExpander* expander = _expander(device);
+            if(expander == NULL){
+                return false;
+            }
+            Hal::spendTime(_latencyUs);
+            applyUntil(Hal::micros());
+            for (size_t i = 0; i < len; i++)
+            {
+                data[i] = expander->read(reg + i);
+            }
+            _updateLine();
+            return true;
+        }
+
+        // Apply the edges until the time, a falling edge of the shared line calls the ISR of the banks.
+        void applyUntil(int64_t untilUs){
+            while (!_edges.empty() && _edges.top().timeUs <= untilUs)
+            {
+                Edge edge = _edges.top();
+                _edges.pop();
+                _expanders[edge.bank].setLevel(edge.channel, edge.level);
+                if(edge.level){
+                    _impulses[edge.bank * ExpanderBank::CHANNELS + edge.channel]++;
+                    _edges.push({edge.timeUs + _minLevelUs + (int64_t)(_uniform() * _minLevelUs), edge.bank, edge.channel, false});
+                }else{
+                    _edges.push({_nextRise(edge.timeUs), edge.bank, edge.channel, true});
+                }
+                _updateLine();
+            }
+        }
+
+        int64_t nextEdgeUs() const { return _edges.top().timeUs; }
+        // The rising edges of a channel of all banks until now.
+        unsigned long impulses(int channel) const { return _impulses[channel]; }
+
+    private:
+        int _banks;
+        int64_t _latencyUs;
+        int64_t _minLevelUs;
+        double _meanPauseUs;
+        std::mt19937_64 _random;
+        SimulatedExpander _expanders[ExpanderBank::MAX_BANKS];
+        unsigned long _impulses[ExpanderBank::MAX_BANKS * ExpanderBank::CHANNELS] = {};
+        std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge>> _edges;
+
+        SimulatedExpander* _expander(uint8_t device){
+            return device >= FIRST_ADDRESS && device < FIRST_ADDRESS + _banks ? &_expanders[device - FIRST_ADDRESS] : NULL;
+        }
+
+        // The open drain outputs of all expanders on one line with a pull up.
+        void _updateLine(){
+            bool pending = false;
+            for (int i = 0; i < _banks; i++)
+            {
+                pending = pending || _expanders[i].pending;
+            }
+            Hal::simulatePinLevel(INTERRUPT_PIN, !pending);
+        }
+
+        double _uniform(){
+            return (_random() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        int64_t _nextRise(int64_t timeUs){
+            return timeUs + _minLevelUs + (int64_t)(-log(1.0 - _uniform()) * _meanPauseUs);
+        }
+    };
+}
+
+bool simulateExpander(int64_t latencyUs, int minLevelMs, double impulsesPerSec, int banks, int seconds, ExpanderSimulation& result){
+    result = {};
+    if(latencyUs < 0 || minLevelMs < 1 || impulsesPerSec <= 0 || banks < 1 || banks > ExpanderBank::MAX_BANKS || seconds < 1){
+        return false;
+    }
+
+    int64_t startUs = Hal::micros();
+    unsigned long interrupts = ExpanderBank::interrupts();
+    SimulatedBus bus(banks, latencyUs, (int64_t)minLevelMs * 1000, impulsesPerSec, startUs);
+    ExpanderBank* expanderBanks = new ExpanderBank[banks];
+    int channels = banks * ExpanderBank::CHANNELS;
+    std::vector<ImpulseSource*> sources(channels, NULL);
+    std::vector<unsigned long> counted(channels);
+    bool begun = true;
+    for (int i = 0; i < banks && begun; i++)
+    {
+        begun = expanderBanks[i].begin(i, &bus, FIRST_ADDRESS + i, INTERRUPT_PIN);
+    }
+    for (int i = 0; i < channels && begun; i++)
+    {
+        sources[i] = ImpulseSource::create(EXPANDER_SOURCE);
+        begun = sources[i]->begin(ExpanderBank::pin(i));
+    }
+
+    // The impulses are taken every minute like the intervalls of the meters.
+    int64_t endUs = startUs + (int64_t)seconds * 1000000;
+    int64_t nextTakeUs = startUs + TAKE_PERIOD_US;
+    while (begun && Hal::micros() < endUs)
+    {
+        int64_t untilUs = bus.nextEdgeUs() < nextTakeUs ? bus.nextEdgeUs() : nextTakeUs;
+        untilUs = untilUs < endUs ? untilUs : endUs;
+        Hal::advanceClock(untilUs);
+        // The clock may be later than untilUs after the reads.
+        bus.applyUntil(Hal::micros());
+        if(Hal::micros() >= nextTakeUs){
+            for (int i = 0; i < channels; i++)
+            {
+                counted[i] += sources[i]->take();
+            }
+            nextTakeUs += TAKE_PERIOD_US;
+        }
+    }
+    if(begun){
+        // The last edges are read after the latency.
+        Hal::advanceClock(endUs + banks * latencyUs + ExpanderBank::RETRY_DELAY_US);
+    }
+
+    for (int i = 0; i < channels && sources[i] != NULL; i++)
+    {
+        counted[i] += sources[i]->take();
+        result.impulses += bus.impulses(i);
+        result.counted += counted[i];
+        result.lost += bus.impulses(i) > counted[i] ? bus.impulses(i) - counted[i] : 0;
+        result.doubled += counted[i] > bus.impulses(i) ? counted[i] - bus.impulses(i) : 0;
+    }
+    for (ImpulseSource* source : sources)
+    {
+        delete source;
+    }
+    for (int i = 0; i < banks; i++)
+    {
+        result.reads += expanderBanks[i].reads();
+        result.failedReads += expanderBanks[i].failedReads();
+    }
+    delete[] expanderBanks;
+    result.interrupts = ExpanderBank::interrupts() - interrupts;
+    return begun;
+}
+
+int runExpander(int argc, char* argv[]){
+    int64_t latencyUs = argc > 0 ? atoll(argv[0]) : 250;
+    int minLevelMs = argc > 1 ? atoi(argv[1]) : 30;
+    double impulsesPerSec = argc > 2 ? atof(argv[2]) : 2;
+    int banks = argc > 3 ? atoi(argv[3]) : 2;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3600;
+
+    Hal::simulateClock(1609459200);
+    ExpanderSimulation result;
+    if(!simulateExpander(latencyUs, minLevelMs, impulsesPerSec, banks, seconds, result)){
+        fprintf(stderr, "Usage: expander [bus latency per read in us] [min. impulse and pause in ms] [impulses per sec and channel] [banks 1..%d] [seconds]\n", ExpanderBank::MAX_BANKS);
+        return 1;
+    }
+
+    bool fastBus = banks * latencyUs < (int64_t)minLevelMs * 1000;
+    printf("Expander: %d banks; %d channels; %lu impulses; %lu counted; lost %lu; double %lu\n", banks, banks * ExpanderBank::CHANNELS,
+        result.impulses, result.counted, result.lost, result.doubled);
+    printf("Bus: %lu interrupts; %lu reads; %lu failed; %.2f reads per interrupt; %.2f impulses per interrupt; reads of all banks %lld us, %s than the min. impulse\n",
+        result.interrupts, result.reads, result.failedReads, (double)result.reads / result.interrupts, (double)result.counted / result.interrupts,
+        (long long)(banks * latencyUs), fastBus ? "shorter" : "NOT shorter");
+    return fastBus && (result.lost > 0 || result.doubled > 0) ? 2 : 0;
+}
@@ -0,0 +1,31 @@
+#ifndef NATIVE_EXPANDER_H
+#define NATIVE_EXPANDER_H
+#include <stdint.h>
+
+// The result of simulateExpander().
+struct ExpanderSimulation
+{
+	unsigned long impulses;				// The rising edges of all channels
+	unsigned long counted;				// The impulses which are taken from the sources
+	unsigned long lost;
+	unsigned long doubled;
+	unsigned long reads;				// The reads of the banks
+	unsigned long failedReads;
+	unsigned long interrupts;			// The falling edges of the interrupt line
+};
+
+// Count the inputs of simulated MCP23017 expanders on a simulated bus from the current time of the simulated clock on.
+// Every channel of the banks gets random impulses with a min. high and low time, the expanders raise the shared interrupt
+// line and capture the levels like the MCP23017, and every read of the bus takes the bus latency. The impulses are taken
+// every minute by ExpanderImpulseSources with the virtual pins. The banks and sources are removed at the end.
+// Returns false if the arguments are wrong or a bank or source can´t begin.
+bool simulateExpander(int64_t latencyUs, int minLevelMs, double impulsesPerSec, int banks, int seconds, ExpanderSimulation& result);
+
+// Run simulateExpander() with a simulated clock and print the result. The edge decoding and the counting with a bus,
+// which reads all banks faster than the min. impulse, are checked by test/test_native.
+// Arguments: [bus latency per read in us (250)] [min. impulse and pause in ms (30)] [impulses per sec and channel (2)] [banks (2)] [seconds (3600)]
+// Returns 2 if a impulse is lost or counted twice, while the reads of all banks are shorter than the min. impulse.
+// With longer reads lost impulses are only reported.
+int runExpander(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,202 @@
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+#include "NativeHeap.h"
+#include "Hal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "MqttHandoff.h"
+
+namespace
+{
+    std::atomic<unsigned long> allocations{0};
+    std::atomic<size_t> bytesInUse{0};
+
+    void* allocate(size_t size){
+        void* memory = malloc(size > 0 ? size : 1);
+        if(memory == NULL){
+            throw std::bad_alloc();
+        }
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytesInUse.fetch_add(malloc_usable_size(memory), std::memory_order_relaxed);
+        return memory;
+    }
+
+    void release(void* memory){
+        if(memory != NULL){
+            bytesInUse.fetch_sub(malloc_usable_size(memory), std::memory_order_relaxed);
+            free(memory);
+        }
+    }
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* memory) noexcept { release(memory); }
+void operator delete[](void* memory) noexcept { release(memory); }
+void operator delete(void* memory, size_t /*size*/) noexcept { release(memory); }
+void operator delete[](void* memory, size_t /*size*/) noexcept { release(memory); }
+
+unsigned long heapAllocations(){
+    return allocations.load(std::memory_order_relaxed);
+}
+
+size_t heapBytesInUse(){
+    return bytesInUse.load(std::memory_order_relaxed);
+}
+
+namespace
+{
+    const char* NODE_NAME = "HEAP";
+    const int INTERVALL_IN_SEC = 60;
+
+    // The broker, which only counts the messages.
+    class CountingPort : public MqttPort
+    {
+    public:
+        bool isConnected() override { return true; }
+        bool publish(const char* /*topic*/, const char* /*payload*/, bool /*retain*/ = false) override { published++; return true; }
+        bool subscribe(const char* /*topic*/, message_handler_t /*handler*/) override { return true; }
+
+        unsigned long published = 0;
+    };
+
+    struct HeapState
+    {
+        unsigned long allocations;
+        size_t bytesInUse;
+    };
+
+    HeapState heapState(){
+        return {heapAllocations(), heapBytesInUse()};
+    }
+
+    // The log lines of the node are not printed, Logger::loop() writes them to /dev/null.
+    class QuietStdout
+    {
+    public:
+        QuietStdout(){
+            fflush(stdout);
+            _saved = dup(STDOUT_FILENO);
+            int devNull = open("/dev/null", O_WRONLY);
+            dup2(devNull, STDOUT_FILENO);
+            close(devNull);
+        }
+        ~QuietStdout(){
+            fflush(stdout);
+            dup2(_saved, STDOUT_FILENO);
+            close(_saved);
+        }
+
+    private:
+        int _saved;
+    };
+
+    // Run the counting and the network task with the simulated clock, every counter gets impulsesPerMinute impulses.
+    void run(MeterNode& node, MqttHandoff& handoff, Logger& logger, int counters, int seconds, int impulsesPerMinute, const char* installMessage){
+        int64_t startUs = Hal::micros();
+        for (int second = 1; second <= seconds; second++)
+        {
+            bool impulse = (second % 60) * impulsesPerMinute / 60 != (second % 60 + 59) * impulsesPerMinute / 60;
+            for (int i = 0; i < counters && impulse; i++)
+            {
+                Hal::simulatePinLevel(gpioPins[i], true);
+                Hal::simulatePinLevel(gpioPins[i], false);
+            }
+            Hal::advanceClock(startUs + (int64_t)second * 1000000);
+            if(second % 600 == 0){
+                // The controller installs the same counters again, e.g. after a restart of the controller.
+                node.installCounters(installMessage);
+                node.requestReady();
+            }
+            handoff.dispatch();
+            node.loop();
+            handoff.forward();
+            logger.loop();
+        }
+    }
+}
+
+int runHeap(int argc, char* argv[]){
+    int counters = argc > 0 ? atoi(argv[0]) : MAX_GPIO_COUNTERS;
+    int hours = argc > 1 ? atoi(argv[1]) : 2;
+    int impulsesPerMinute = argc > 2 ? atoi(argv[2]) : 30;
+    if(counters < 1 || counters > MAX_GPIO_COUNTERS || counters > METER_POOL_SIZE || hours < 1 || impulsesPerMinute < 1 || impulsesPerMinute > 60){
+        fprintf(stderr, "Usage: heap [counters 1..%d] [simulated hours per phase] [impulses per minute and counter 1..60]\n", MAX_GPIO_COUNTERS);
+        return 1;
+    }
+
+    HeapState before = heapState();
+    Hal::simulateClock(1609459200);
+    // Static like the objects of main.cpp, so they don´t use the heap.
+    static CountingPort port;
+    static MqttHandoff handoff;
+    static Logger logger;
+    static MeterNode node;
+    char installMessage[MAX_GPIO_COUNTERS * 32];
+    size_t len = 0;
+    for (int i = 0; i < counters; i++)
+    {
+        len += snprintf(installMessage + len, sizeof(installMessage) - len, "%d\tHeap/Counter%02d\t%d\n", i, i, INTERVALL_IN_SEC);
+    }
+
+    HeapState setup;
+    {
+        QuietStdout quiet;
+        logger.begin((char*)NODE_NAME, &port);
+        handoff.begin(&port);
+        node.begin(NODE_NAME, &handoff, &logger);
+        node.setupMqttSubscriber();
+        node.setMetricsPeriod(60);
+        node.installCounters(installMessage);
+        char message[32];
+        for (int i = 0; i < counters; i++)
+        {
+            snprintf(message, sizeof(message), "%d\t10", i);
+            node.liveRateMessage(message);
+            snprintf(message, sizeof(message), "%d\t900\t3600R", i);
+            node.rollupMessage(message);
+        }
+        node.stormGuardMessage("0\t100\t1000");
+        run(node, handoff, logger, counters, 120, impulsesPerMinute, installMessage);
+        setup = heapState();
+    }
+    printf("Heap: before %u bytes; after the setup %u bytes in %lu allocations; MeterNode %u bytes with %d meters of %u bytes\n",
+        (unsigned int)before.bytesInUse, (unsigned int)setup.bytesInUse, setup.allocations - before.allocations,
+        (unsigned int)sizeof(MeterNode), METER_POOL_SIZE, (unsigned int)sizeof(ImpulseMeter));
+
+    const char* modes[] = {"SINGLE", "BATCH"};
+    const char* encodings[] = {"TEXT", "PACKED"};
+    bool ok = true;
+    for (const char* mode : modes)
+    {
+        for (const char* encoding : encodings)
+        {
+            HeapState start, end;
+            unsigned long published = port.published;
+            {
+                QuietStdout quiet;
+                // Switching the mode is a configuration, only the time after it is the steady state.
+                node.publishModeMessage(mode);
+                node.encodingMessage(encoding);
+                run(node, handoff, logger, counters, 2 * INTERVALL_IN_SEC, impulsesPerMinute, installMessage);
+                start = heapState();
+                run(node, handoff, logger, counters, hours * 3600, impulsesPerMinute, installMessage);
+                end = heapState();
+            }
+            unsigned long steadyAllocations = end.allocations - start.allocations;
+            printf("%s %s\t%lu allocations; %ld bytes; %lu messages\n", mode, encoding, steadyAllocations, (long)(end.bytesInUse - start.bytesInUse), port.published - published);
+            ok = ok && steadyAllocations == 0;
+        }
+    }
+
+    HeapState after = heapState();
+    printf("Heap: at the end %u bytes; %d counters installed; %lu impulses; %lu log messages dropped\n",
+        (unsigned int)after.bytesInUse, node.getInstalledCounters(), node.impulsesOverAll(), logger.dropped());
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,20 @@
+#ifndef NATIVE_HEAP_H
+#define NATIVE_HEAP_H
+#include <stddef.h>
+
+// The allocations since the start and the bytes in use of the whole program, also of the unit tests.
+unsigned long heapAllocations();
+size_t heapBytesInUse();
+
+// Check that the steady state of the MeterNode allocates no heap memory. The native build replaces the global
+// operator new and delete, so every allocation of the program is counted with its size.
+// A node with a simulated clock installs the counters with live rates, rollups and a StormGuard and counts impulses on
+// all of them. Then it runs for some simulated hours in every publish mode and encoding, with the status, the metrics,
+// the ready message and the same InstallCounters message again. The allocations of these phases must be 0.
+// The heap in use is reported before the node is created, after the counters are installed and at the end.
+// Arguments: [counters (20)] [simulated hours per phase (2)] [impulses per minute and counter (30)]
+// The steady state of a node is also checked by test/test_native.
+// Returns 2 if a phase allocated memory.
+int runHeap(int argc, char* argv[]);
+
+#endif
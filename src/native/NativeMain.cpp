@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Hal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "Journal.h"
+#include "MqttHandoff.h"
+#include "LinuxMqttPort.h"
+#include "NativeBench.h"
+#include "NativeExpander.h"
+#include "NativeHeap.h"
+#include "NativeReplay.h"
+#include "NativeWear.h"
+#include "NativeWire.h"
+
+// Entry point of the native build. Installs counters over the simulated MQTT broker,
+// generates impulses on their pins and runs the counting and the network task like the ESP32 does.
+// If a journal is given, the MQTT connection is lost in the middle third of the runtime. The journal has the files <journal>.0 ... .7 and <journal>.ack.
+// If a glitch rate is given, the pin of counter 0 gets a glitch train with this rate in the middle third of the runtime.
+// Usage: program [counters] [impulses per second and counter] [runtime in sec] [SINGLE|BATCH] [journal prefix|-] [live rate change in %] [glitches per second]
+//        program bench [baseline file] [tolerance in %|UPDATE]
+//        program replay <trace file|SYNTH> [intervall in sec] [update period in sec] [counters] [days] [impulses per hour] [clock steps] [unsynced sec]
+//        program wear [years] [min. checkpoint period in sec] [slots] [update period in sec] [restart period in days] [free blocks] [erase cycles]
+//        program wire [packed payload ...]
+//        program expander [bus latency per read in us] [min. impulse and pause in ms] [impulses per sec and channel] [banks] [seconds]
+//        program heap [counters] [simulated hours per phase] [impulses per minute and counter]
+
+#define MY_NAME "NATIVE"
+
+static_assert(MqttHandoff::outboundSize(MeterNode::maxLoopMessages(), MeterNode::maxLoopLen()) <= MqttHandoff::OUTBOUND_BUFFER_SIZE,
+    "The outbound ring of the handoff must hold the messages of one loop of the MeterNode");
+
+// The unit tests in test/test_native have their own main().
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char* argv[]){
+    if(argc > 1 && strcmp(argv[1], "bench") == 0){
+        return runBenchmarks(argc - 2, argv + 2);
+    }
+    if(argc > 1 && strcmp(argv[1], "replay") == 0){
+        return runReplay(argc - 2, argv + 2);
+    }
+    if(argc > 1 && strcmp(argv[1], "wear") == 0){
+        return runWear(argc - 2, argv + 2);
+    }
+    if(argc > 1 && strcmp(argv[1], "expander") == 0){
+        return runExpander(argc - 2, argv + 2);
+    }
+    if(argc > 1 && strcmp(argv[1], "heap") == 0){
+        return runHeap(argc - 2, argv + 2);
+    }
+    if(argc > 1 && strcmp(argv[1], "wire") == 0){
+        return runWire(argc - 2, argv + 2);
+    }
+
+    int counters = argc > 1 ? atoi(argv[1]) : 4;
+    int impulsesPerSec = argc > 2 ? atoi(argv[2]) : 100;
+    int runtimeInSec = argc > 3 ? atoi(argv[3]) : 30;
+    const char* publishMode = argc > 4 ? argv[4] : "SINGLE";
+    const char* journalPath = argc > 5 && strcmp(argv[5], "-") != 0 ? argv[5] : NULL;
+    int liveRateChange = argc > 6 ? atoi(argv[6]) : 0;
+    int glitchesPerSec = argc > 7 ? atoi(argv[7]) : 0;
+    if(counters < 1 || counters > MAX_GPIO_COUNTERS || impulsesPerSec < 1 || runtimeInSec < 1){
+        fprintf(stderr, "Usage: %s [counters 1..%d] [impulses per second] [runtime in sec] [SINGLE|BATCH] [journal prefix|-] [live rate change in %%] [glitches per second]\n", argv[0], MAX_GPIO_COUNTERS);
+        return 1;
+    }
+
+    LinuxMqttPort mqttPort;
+    MqttHandoff mqttHandoff;
+    Logger logger;
+    MeterNode meterNode;
+    logger.begin((char *)MY_NAME, &mqttPort);
+    mqttHandoff.begin(&mqttPort, &logger);
+    meterNode.begin(MY_NAME, &mqttHandoff, &logger);
+    meterNode.setupMqttSubscriber();
+    meterNode.publishModeMessage(publishMode);
+
+    FileSegmentStorage journalStorage;
+    Journal journal;
+    if(journalPath != NULL){
+        if(!journalStorage.begin(journalPath, 8, 1024 * sizeof(Journal::Record), false) || !journal.begin(&journalStorage)){
+            fprintf(stderr, "Failed to open the journal %s\n", journalPath);
+            return 1;
+        }
+        printf("Journal: %u records pending\n", journal.pending());
+        meterNode.setJournal(&journal);
+    }
+
+    std::string installMessage;
+    for (int i = 0; i < counters; i++)
+    {
+        char line[48];
+        snprintf(line, sizeof(line), "%d\tNative/Counter%02d\t10\n", i, i);
+        installMessage += line;
+    }
+    std::string topic = std::string(MY_NAME) + "/InstallCounters";
+    mqttPort.deliver(topic.c_str(), installMessage.c_str());
+    // Install the counters before the impulses are generated, the simulated ISR table has no locks.
+    mqttHandoff.dispatch();
+    if(liveRateChange > 0){
+        topic = std::string(MY_NAME) + "/LiveRate";
+        for (int i = 0; i < counters; i++)
+        {
+            std::string message = std::to_string(i) + "\t" + std::to_string(liveRateChange);
+            mqttPort.deliver(topic.c_str(), message.c_str());
+        }
+        mqttHandoff.dispatch();
+    }
+
+    std::atomic<bool> running(true);
+    std::atomic<unsigned long> generated(0);
+    std::thread generator([&]() {
+        auto next = std::chrono::steady_clock::now();
+        const auto halfPeriod = std::chrono::microseconds(500000 / impulsesPerSec);
+        while (running)
+        {
+            for (int i = 0; i < counters; i++)
+            {
+                Hal::simulatePinLevel(gpioPins[i], true);
+            }
+            generated += counters;
+            next += halfPeriod;
+            std::this_thread::sleep_until(next);
+            for (int i = 0; i < counters; i++)
+            {
+                Hal::simulatePinLevel(gpioPins[i], false);
+            }
+            next += halfPeriod;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    // Toggle the pin of counter 0 like a floating input in the middle third of the runtime.
+    std::atomic<unsigned long> glitches(0);
+    std::thread glitchGenerator([&]() {
+        if(glitchesPerSec <= 0){
+            return;
+        }
+        const auto third = std::chrono::seconds(runtimeInSec) / 3;
+        auto next = std::chrono::steady_clock::now() + third;
+        const auto end = next + third;
+        const auto halfPeriod = std::chrono::microseconds(500000 / glitchesPerSec);
+        std::this_thread::sleep_until(next);
+        while (running && std::chrono::steady_clock::now() < end)
+        {
+            Hal::simulatePinLevel(gpioPins[0], true);
+            glitches++;
+            next += halfPeriod;
+            std::this_thread::sleep_until(next);
+            Hal::simulatePinLevel(gpioPins[0], false);
+            next += halfPeriod;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    // The network task publishes the messages of the counting task, which is the main thread.
+    std::thread network([&]() {
+        while (running)
+        {
+            mqttHandoff.forward();
+            logger.loop();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+
+    unsigned long startTime = Hal::millis();
+    unsigned long endTime = startTime + runtimeInSec * 1000UL;
+    while (Hal::millis() < endTime)
+    {
+        if(journalPath != NULL){
+            unsigned long third = (endTime - startTime) / 3;
+            mqttPort.setConnected(Hal::millis() < startTime + third || Hal::millis() >= startTime + 2 * third);
+        }
+        mqttHandoff.dispatch();
+        unsigned long waitMs = meterNode.loop();
+        // The simulated MQTT connection changes without event, therefor wake up at least every 100 ms.
+        Hal::waitForEvent(waitMs < 100 ? waitMs : 100);
+    }
+
+    running = false;
+    generator.join();
+    glitchGenerator.join();
+    network.join();
+    meterNode.publishMetrics();
+    mqttHandoff.forward();
+    journal.storeCursor(true);
+    logger.loop();
+    MqttHandoff::Stats stats = mqttHandoff.stats();
+    printf("Generated impulses: %lu; Glitches: %lu; Published impulses: %lu; MQTT messages: %lu\n", generated.load(), glitches.load(), meterNode.impulsesOverAll(), mqttPort.published());
+    printf("Handoff: depth %zu; high water %zu; overflows %lu; rejected %lu; max publish delay %lu ms\n", stats.outboundDepth, stats.outboundHighWater, stats.outboundOverflows, stats.outboundRejected, stats.maxPublishDelayMs);
+    return 0;
+}
+#endif
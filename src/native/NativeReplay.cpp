@@ -0,0 +1,458 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "NativeReplay.h"
+#include "Hal.h"
+#include "ImpulseMeter.h"
+#include "IsoTimeFormatter.h"
+#include "Logger.h"
+#include "Rollup.h"
+
+namespace
+{
+    const char BINARY_MAGIC[8] = {'P', 'U', 'L', 'S', 'E', 'T', 'R', '1'};
+    const int32_t STEP_EVENT = -1;
+    // Start of the synthetic trace, not at a intervall boundary.
+    const int64_t SYNTH_START_MS = 1609459200000LL + 7 * 60000 + 30000;
+    const int64_t SYNTH_GRID_MS = 100;
+    const int64_t SYNTH_STEPS_SEC[] = {3600, -3600, 7, -7};
+    const int MAX_DIFF_LINES = 20;
+    // The rollups of every counter, the sums of the levels must match the counted impulses.
+    const Rollup::LevelConfig ROLLUP_LEVELS[] = {{900, false}, {3600, false}, {86400, false}};
+    const size_t ROLLUP_LEVEL_COUNT = sizeof(ROLLUP_LEVELS) / sizeof(ROLLUP_LEVELS[0]);
+
+    // A impulse or a clock step, also the record of the binary format.
+    struct TraceEvent
+    {
+        int64_t timeMs;
+        int32_t counterId;
+        int32_t stepSec;
+    };
+
+    // Deliver the events of a trace one after the other.
+    class TraceReader
+    {
+    public:
+        virtual ~TraceReader() {}
+        virtual bool next(TraceEvent& event) = 0;
+    };
+
+    class FileTraceReader : public TraceReader
+    {
+    public:
+        ~FileTraceReader() { if(_file != NULL) fclose(_file); }
+
+        bool open(const char* path){
+            _file = fopen(path, "rb");
+            if(_file == NULL){
+                return false;
+            }
+            char magic[sizeof(BINARY_MAGIC)];
+            _binary = fread(magic, 1, sizeof(magic), _file) == sizeof(magic) && memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+            if(!_binary){
+                rewind(_file);
+            }
+            return true;
+        }
+
+        bool next(TraceEvent& event) override {
+            if(_binary){
+                return fread(&event, sizeof(event), 1, _file) == 1;
+            }
+
+            char line[80];
+            while (fgets(line, sizeof(line), _file) != NULL)
+            {
+                char* field;
+                if(line[0] == '#' || (field = strchr(line, ',')) == NULL){
+                    continue;
+                }
+                event.timeMs = strtoll(line, NULL, 10);
+                field++;
+                if(strncmp(field, "STEP,", 5) == 0){
+                    event.counterId = STEP_EVENT;
+                    event.stepSec = atoi(field + 5);
+                }
+                else{
+                    event.counterId = atoi(field);
+                    event.stepSec = 0;
+                }
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        FILE* _file = NULL;
+        bool _binary = false;
+    };
+
+    // Random impulses with a exponential distributed distance and evenly spread clock steps. Always the same trace for the same arguments.
+    class SyntheticTraceReader : public TraceReader
+    {
+    public:
+        SyntheticTraceReader(int counters, int days, int impulsesPerHour, int steps)
+            : _counters(counters), _steps(steps), _meanDistanceMs(3600000.0 / impulsesPerHour), _random(1)
+        {
+            _endMs = SYNTH_START_MS + (int64_t)days * 24 * 3600000;
+            for (int i = 0; i < _counters; i++)
+            {
+                _nextMs[i] = _nextImpulse(SYNTH_START_MS);
+            }
+        }
+
+        bool next(TraceEvent& event) override {
+            int64_t stepMs = _step < _steps ? SYNTH_START_MS + (_endMs - SYNTH_START_MS) / (_steps + 1) * (_step + 1) : INT64_MAX;
+            int counter = 0;
+            for (int i = 1; i < _counters; i++)
+            {
+                if(_nextMs[i] < _nextMs[counter]){
+                    counter = i;
+                }
+            }
+
+            if(stepMs <= _nextMs[counter] && stepMs < _endMs){
+                event = {stepMs, STEP_EVENT, (int32_t)SYNTH_STEPS_SEC[_step % 4]};
+                _step++;
+                return true;
+            }
+            if(_nextMs[counter] >= _endMs){
+                return false;
+            }
+            event = {_nextMs[counter], counter, 0};
+            _nextMs[counter] = _nextImpulse(_nextMs[counter]);
+            return true;
+        }
+
+    private:
+        int _counters;
+        int _steps;
+        int _step = 0;
+        double _meanDistanceMs;
+        int64_t _endMs;
+        int64_t _nextMs[MAX_COUNTERS];
+        std::mt19937_64 _random;
+
+        int64_t _nextImpulse(int64_t timeMs){
+            double uniform = (_random() >> 11) * (1.0 / 9007199254740992.0);
+            int64_t distanceMs = (int64_t)(-log(1.0 - uniform) * _meanDistanceMs);
+            return (timeMs + distanceMs) / SYNTH_GRID_MS * SYNTH_GRID_MS + SYNTH_GRID_MS;
+        }
+    };
+
+    // The fed impulses of a counter which are not yet in a closed intervall and the result of the checks.
+    struct CounterCheck
+    {
+        std::vector<int64_t> openMonotonicUs;   // Monotonic time when the impulse was fed
+        int64_t lastEndUs;                      // Monotonic end of the last closed intervall
+        time_t lastUtcTime;                     // End time of the last closed intervall
+        unsigned long fed;
+        unsigned long counted;
+        unsigned long intervalls;
+        unsigned long wrongIntervalls;      // Intervalls with more or less impulses than fed in their time
+        unsigned long misplaced;            // Impulses which are counted in a later intervall
+        unsigned long wrongTimes;           // End times which don´t match the UTC time of the node or are not increasing
+        unsigned long restamped;            // Intervalls closed before the UTC time was known
+        unsigned long acrossSteps;          // Intervalls with a clock step, which have the end time of the UTC time before the step
+        Rollup rollup;
+        unsigned long rollupImpulse[Rollup::MAX_LEVELS];     // The impulses of the closed level intervalls
+        unsigned long rollupIntervalls;
+        unsigned long misalignedRollups;    // Level intervalls which don´t end at a multiple of their period
+    };
+
+    // A change of the UTC time of the node, the first is the boot.
+    struct OffsetChange
+    {
+        int64_t monotonicUs;
+        int64_t offsetUs;                   // UTC - monotonic time after the change
+    };
+
+    CounterCheck checks[MAX_COUNTERS];
+    ImpulseMeter* meters[MAX_COUNTERS];
+    std::vector<OffsetChange> offsets;
+    int64_t nextUpdateUs;
+    int diffLines = 0;
+
+    // The offset of the node at the monotonic time, a change at the same time is already applied.
+    size_t offsetIndex(int64_t monotonicUs){
+        size_t index = 0;
+        while (index + 1 < offsets.size() && offsets[index + 1].monotonicUs <= monotonicUs)
+        {
+            index++;
+        }
+        return index;
+    }
+
+    time_t toUtcTime(int64_t monotonicUs, int64_t offsetUs){
+        return (time_t)((monotonicUs + offsetUs + 500000) / 1000000);
+    }
+
+    // The intervall must have the impulses which are fed before its end on the monotonic clock, so a clock step
+    // can´t move them. The end time must be the UTC time of the node at the end, intervalls closed before the UTC
+    // time was known get the UTC time of the sync.
+    void onIntervallElapsed(ImpulseMeterStatus status){
+        int counterId = 0;
+        while (counterId < MAX_COUNTERS && (meters[counterId] == NULL || meters[counterId]->sourceName() != status.sourceName))
+        {
+            counterId++;
+        }
+        if(counterId == MAX_COUNTERS){
+            return;
+        }
+
+        CounterCheck& check = checks[counterId];
+        int64_t endUs = status.monotonicEndUs;
+        unsigned long expected = 0;
+        unsigned long misplaced = 0;
+        size_t kept = 0;
+        for (int64_t monotonicUs : check.openMonotonicUs)
+        {
+            if(monotonicUs >= endUs){
+                check.openMonotonicUs[kept++] = monotonicUs;
+                continue;
+            }
+            expected++;
+            misplaced += monotonicUs < check.lastEndUs;
+        }
+        check.openMonotonicUs.resize(kept);
+        check.intervalls++;
+        check.counted += status.impulse;
+
+        const ClockAnchor& clock = ImpulseMeter::clock();
+        size_t index = offsetIndex(endUs);
+        bool timeOk = toUtcTime(endUs, offsets[index].offsetUs) == status.utcTime;
+        if(endUs < clock.anchoredUs()){
+            check.restamped++;
+            timeOk = toUtcTime(endUs, offsets[offsetIndex(clock.anchoredUs())].offsetUs) == status.utcTime;
+        }else if(!timeOk && index > 0 && offsets[index].monotonicUs >= check.lastEndUs
+            && toUtcTime(endUs, offsets[index - 1].offsetUs) == status.utcTime){
+            // The end was calculated before the step.
+            check.acrossSteps++;
+            timeOk = true;
+        }
+        if(!timeOk || status.utcTime <= check.lastUtcTime){
+            check.wrongTimes++;
+            if(diffLines++ < MAX_DIFF_LINES){
+                char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+                char nodeBuff[IsoTimeFormatter::BUFFER_SIZE];
+                printf("DIFF\t%d\t%s\twrong end time\tUTC of the node %s\n",
+                    counterId, IsoTimeFormatter::render(status.utcTime, timeBuff), IsoTimeFormatter::render(toUtcTime(endUs, offsets[index].offsetUs), nodeBuff));
+            }
+        }
+        check.lastEndUs = endUs;
+        check.lastUtcTime = status.utcTime;
+
+        Rollup::Record closed[Rollup::MAX_CLOSED];
+        size_t closedCount = check.rollup.add(status.utcTime, status.impulse, closed);
+        for (size_t i = 0; i < closedCount; i++)
+        {
+            check.rollupImpulse[closed[i].level] += closed[i].impulse;
+            check.rollupIntervalls++;
+            check.misalignedRollups += closed[i].utcTime % check.rollup.levelConfig(closed[i].level).periodInSec != 0;
+        }
+
+        if(misplaced > 0 || status.impulse != expected){
+            check.misplaced += misplaced;
+            check.wrongIntervalls += status.impulse != expected;
+            if(diffLines++ < MAX_DIFF_LINES){
+                char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+                printf("DIFF\t%d\t%s\texpected %lu\tcounted %lu\tfrom earlier intervalls %lu\n",
+                    counterId, IsoTimeFormatter::render(status.utcTime, timeBuff), expected, status.impulse, misplaced);
+            }
+        }
+    }
+
+    void updateMeters(){
+        for (int i = 0; i < MAX_COUNTERS; i++)
+        {
+            if(meters[i] != NULL){
+                meters[i]->update();
+            }
+        }
+    }
+
+    // Move the clock and take the closed intervalls every update period, like the counting task does.
+    void advanceTo(int64_t untilUs, int64_t updatePeriodUs){
+        while (Hal::micros() < untilUs)
+        {
+            Hal::advanceClock(nextUpdateUs < untilUs ? nextUpdateUs : untilUs);
+            if(Hal::micros() >= nextUpdateUs){
+                updateMeters();
+                nextUpdateUs += updatePeriodUs;
+            }
+        }
+    }
+
+    // Set the UTC time of a node which started without it, like the first NTP sync.
+    void syncClock(int64_t syncUs, int64_t bootMs, int64_t updatePeriodUs){
+        advanceTo(syncUs, updatePeriodUs);
+        Hal::stepUtcTime(bootMs / 1000);
+        offsets.push_back({Hal::micros(), bootMs * 1000});
+    }
+}
+
+int runReplay(int argc, char* argv[]){
+    if(argc < 1){
+        fprintf(stderr, "Usage: replay <trace file|SYNTH> [intervall in sec] [update period in sec] [counters] [days] [impulses per hour] [clock steps] [unsynced sec]\n");
+        return 1;
+    }
+    unsigned int intervallInSec = argc > 1 ? atoi(argv[1]) : 60;
+    int updatePeriodInSec = argc > 2 ? atoi(argv[2]) : 1;
+    int counters = argc > 3 ? atoi(argv[3]) : MAX_GPIO_COUNTERS;
+    int days = argc > 4 ? atoi(argv[4]) : 30;
+    int impulsesPerHour = argc > 5 ? atoi(argv[5]) : 500;
+    int steps = argc > 6 ? atoi(argv[6]) : 0;
+    int unsyncedSec = argc > 7 ? atoi(argv[7]) : 0;
+    if(updatePeriodInSec < 1 || counters < 1 || counters > MAX_GPIO_COUNTERS || days < 1 || impulsesPerHour < 1 || steps < 0 || unsyncedSec < 0){
+        fprintf(stderr, "Wrong replay arguments\n");
+        return 1;
+    }
+
+    TraceReader* reader;
+    if(strcmp(argv[0], "SYNTH") == 0){
+        reader = new SyntheticTraceReader(counters, days, impulsesPerHour, steps);
+    }else{
+        FileTraceReader* fileReader = new FileTraceReader();
+        if(!fileReader->open(argv[0])){
+            fprintf(stderr, "Failed to open the trace %s\n", argv[0]);
+            delete fileReader;
+            return 1;
+        }
+        reader = fileReader;
+    }
+
+    TraceEvent event;
+    if(!reader->next(event)){
+        fprintf(stderr, "The trace is empty\n");
+        delete reader;
+        return 1;
+    }
+
+    int64_t bootMs = event.timeMs / 1000 * 1000 - 1000;
+    // Without the sync the node starts at 1970 and the time is set after unsyncedSec.
+    time_t bootUtcTime = unsyncedSec > 0 ? 0 : (time_t)(bootMs / 1000);
+    Hal::simulateClock(bootUtcTime);
+    offsets.push_back({0, (int64_t)bootUtcTime * 1000000});
+    int64_t syncUs = (int64_t)unsyncedSec * 1000000;
+    Logger logger;
+    logger.begin();
+    int64_t updatePeriodUs = (int64_t)updatePeriodInSec * 1000000;
+    nextUpdateUs = updatePeriodUs;
+    auto wallStart = std::chrono::steady_clock::now();
+
+    unsigned long events = 0;
+    unsigned long clockSteps = 0;
+    int64_t lastMs = event.timeMs;
+    int result = 0;
+    do
+    {
+        if(event.timeMs < lastMs){
+            fprintf(stderr, "The trace is not sorted at event %lu\n", events + 1);
+            result = 1;
+            break;
+        }
+        lastMs = event.timeMs;
+        events++;
+        if(syncUs > 0 && (event.timeMs - bootMs) * 1000 >= syncUs){
+            syncClock(syncUs, bootMs, updatePeriodUs);
+            syncUs = 0;
+        }
+        advanceTo((event.timeMs - bootMs) * 1000, updatePeriodUs);
+
+        if(event.counterId == STEP_EVENT){
+            Hal::stepUtcTime(event.stepSec);
+            offsets.push_back({Hal::micros(), offsets.back().offsetUs + (int64_t)event.stepSec * 1000000});
+            clockSteps++;
+            continue;
+        }
+        if(event.counterId < 0 || event.counterId >= MAX_GPIO_COUNTERS){
+            fprintf(stderr, "Wrong CounterId %d at event %lu\n", (int)event.counterId, events);
+            result = 1;
+            break;
+        }
+
+        if(meters[event.counterId] == NULL){
+            char sourceName[32];
+            snprintf(sourceName, sizeof(sourceName), "Replay/Counter%02d", (int)event.counterId);
+            meters[event.counterId] = new ImpulseMeter();
+            meters[event.counterId]->begin(event.counterId, intervallInSec, sourceName, GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+            // The trace has the impulses after debouncing.
+            meters[event.counterId]->setStormGuard({0, 0});
+            checks[event.counterId].rollup.begin(ROLLUP_LEVELS, ROLLUP_LEVEL_COUNT, meters[event.counterId]->timerIntervallInSec());
+        }
+        checks[event.counterId].openMonotonicUs.push_back(Hal::micros());
+        checks[event.counterId].fed++;
+        uint8_t pin = meters[event.counterId]->pin();
+        Hal::simulatePinLevel(pin, true);
+        Hal::simulatePinLevel(pin, false);
+    } while (reader->next(event));
+    delete reader;
+
+    if(syncUs > 0){
+        syncClock(syncUs, bootMs, updatePeriodUs);
+    }
+    // Close the last intervalls.
+    advanceTo((lastMs - bootMs) * 1000 + ((int64_t)intervallInSec * 2 + 2) * 1000000, updatePeriodUs);
+    updateMeters();
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double simulatedDays = (lastMs - bootMs) / 86400000.0;
+
+    unsigned long fed = 0, counted = 0, intervalls = 0, lost = 0, doubled = 0, wrongIntervalls = 0, misplaced = 0, wrongTimes = 0, restamped = 0, acrossSteps = 0;
+    unsigned long overflows = 0, skipped = 0, late = 0, rollupIntervalls = 0, wrongRollups = 0;
+    for (int i = 0; i < MAX_COUNTERS; i++)
+    {
+        if(meters[i] == NULL){
+            continue;
+        }
+        const CounterCheck& check = checks[i];
+        if(check.fed != check.counted || check.wrongIntervalls > 0 || check.wrongTimes > 0){
+            printf("COUNTER\t%d\tfed %lu\tcounted %lu\tintervalls %lu\twrong intervalls %lu\tmisplaced %lu\twrong end times %lu\tqueue overflows %lu\n",
+                i, check.fed, check.counted, check.intervalls, check.wrongIntervalls, check.misplaced, check.wrongTimes, meters[i]->queueOverflows());
+        }
+        fed += check.fed;
+        counted += check.counted;
+        lost += check.fed > check.counted ? check.fed - check.counted : 0;
+        doubled += check.counted > check.fed ? check.counted - check.fed : 0;
+        intervalls += check.intervalls;
+        wrongIntervalls += check.wrongIntervalls;
+        misplaced += check.misplaced;
+        wrongTimes += check.wrongTimes;
+        restamped += check.restamped;
+        acrossSteps += check.acrossSteps;
+        // Every level must have all counted impulses in its closed and open intervalls.
+        for (size_t level = 0; level < check.rollup.levels(); level++)
+        {
+            wrongRollups += check.rollupImpulse[level] + check.rollup.openImpulse(level) != check.counted;
+        }
+        rollupIntervalls += check.rollupIntervalls;
+        wrongRollups += check.misalignedRollups;
+        overflows += meters[i]->queueOverflows();
+        skipped += meters[i]->skippedIntervalls();
+        late += meters[i]->lateIntervalls();
+    }
+    printf("Replay: %lu events; %lu impulses; %lu counted; %lu intervalls; %lu clock steps\n", events, fed, counted, intervalls, clockSteps);
+    printf("Checks: lost %lu; double %lu; wrong intervalls %lu; misplaced %lu; wrong end times %lu; queue overflows %lu; skipped intervalls %lu; late intervalls %lu\n",
+        lost, doubled, wrongIntervalls, misplaced, wrongTimes, overflows, skipped, late);
+    const ClockAnchor& clock = ImpulseMeter::clock();
+    printf("Clock: anchored after %.1f s; %lu steps detected; %lu intervalls stamped after the sync; %lu end times from before a step\n",
+        clock.anchoredUs() / 1000000.0, clock.steps(), restamped, acrossSteps);
+    printf("Rollups: %lu level intervalls; %lu wrong levels or intervalls\n", rollupIntervalls, wrongRollups);
+    printf("Time: %.1f simulated days in %.2f s\n", simulatedDays, wallSec);
+
+    for (int i = 0; i < MAX_COUNTERS; i++)
+    {
+        delete meters[i];
+        meters[i] = NULL;
+    }
+    if(clock.steps() != clockSteps){
+        printf("STEPS\t%lu injected\t%lu detected\n", clockSteps, clock.steps());
+    }
+    if(result == 0 && (lost > 0 || doubled > 0 || wrongIntervalls > 0 || wrongTimes > 0 || wrongRollups > 0 || clock.steps() != clockSteps)){
+        result = 2;
+    }
+    return result;
+}
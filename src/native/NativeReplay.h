@@ -0,0 +1,23 @@
+#ifndef NATIVE_REPLAY_H
+#define NATIVE_REPLAY_H
+
+// Replay a pulse trace with a simulated clock through the real ImpulseMeter and GpioImpulseSource code, far faster than real time.
+// Every closed intervall is checked against the fed impulses: no impulse may be lost or counted twice, and every impulse
+// must be in the intervall of its monotonic time, also around a clock step. The end time of a intervall must be the UTC time
+// of the node at its end and must increase. A intervall which was open at a clock step has the end time from before the step,
+// these are counted separately. The detected clock steps must match the steps of the trace, so they must be more than a second apart.
+// The intervalls are also summed into 15 minute, hourly and daily rollups, which must have all counted impulses.
+// Arguments: <trace file|SYNTH> [intervall in sec (60)] [update period in sec (1)] [counters (20)] [days (30)] [impulses per hour (500)] [clock steps (0)] [unsynced sec (0)]
+// The arguments four to seven are only used by SYNTH, which generates a trace with random impulses on a 100 ms grid, so some
+// impulses are exactly at the intervall end. A long update period lets the intervall queue overflow.
+// With unsynced sec the node starts with the time of 1970 and gets the UTC time after unsynced sec, like without a NTP sync at the
+// boot. The intervalls before must get the UTC time of their end after the sync.
+// Trace file formats, the events must be sorted by time:
+//   CSV: one event per line, "<UTC time in ms>,<CounterId>" for a impulse or "<UTC time in ms>,STEP,<seconds>" for a clock step.
+//        Lines with "#" are comments.
+//   Binary: the 8 bytes "PULSETR1", then records of int64 time in ms, int32 CounterId (-1 for a step) and int32 step seconds, little endian.
+// The time of a event is the true time, a clock step changes only the UTC time of the node.
+// Returns 2 if a impulse is lost, counted twice or in the wrong intervall, or if a rollup is wrong.
+int runReplay(int argc, char* argv[]);
+
+#endif
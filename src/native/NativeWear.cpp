@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "NativeWear.h"
+#include "Hal.h"
+#include "MeterTotals.h"
+
+namespace
+{
+    const time_t WEAR_START = 1609459200;                   // 2021-01-01T00:00:00Z
+    const int64_t SEC_PER_YEAR = 365LL * 24 * 3600;
+    const int ERASES_PER_CHECKPOINT = 2;                     // Data block and metadata pair of LittleFS
+    const uint32_t BLOCK_SIZE = 4096;
+
+    // Storage in memory, which counts the writes per slot.
+    class CountingStorage : public JournalStorage
+    {
+    public:
+        void begin(uint32_t slotSize){
+            _slotSize = slotSize;
+        }
+
+        bool readData(uint32_t offset, void* buff, size_t len) override {
+            if(offset + len > _data.size()){
+                return false;
+            }
+            memcpy(buff, &_data[offset], len);
+            return true;
+        }
+
+        bool writeData(uint32_t offset, const void* buff, size_t len) override {
+            if(offset + len > _data.size()){
+                _data.resize(offset + len, 0);
+            }
+            memcpy(&_data[offset], buff, len);
+            uint32_t slot = offset / _slotSize;
+            if(slot >= _slotWrites.size()){
+                _slotWrites.resize(slot + 1, 0);
+            }
+            _slotWrites[slot]++;
+            _bytes += len;
+            return true;
+        }
+
+        bool readCursor(void* /*buff*/, size_t /*len*/) override { return false; }
+        bool writeCursor(const void* /*buff*/, size_t /*len*/) override { return false; }
+
+        const std::vector<unsigned long>& slotWrites() const { return _slotWrites; }
+        unsigned long long bytes() const { return _bytes; }
+
+    private:
+        std::vector<uint8_t> _data;
+        std::vector<unsigned long> _slotWrites;
+        unsigned long long _bytes = 0;
+        uint32_t _slotSize = 1;
+    };
+}
+
+int runWear(int argc, char* argv[]){
+    int years = argc > 0 ? atoi(argv[0]) : 10;
+    uint32_t minPeriodInSec = argc > 1 ? atoi(argv[1]) : MeterTotals::DEFAULT_MIN_PERIOD_IN_SEC;
+    uint32_t slots = argc > 2 ? atoi(argv[2]) : MeterTotals::DEFAULT_SLOTS;
+    int updatePeriodInSec = argc > 3 ? atoi(argv[3]) : 10;
+    int restartPeriodInDays = argc > 4 ? atoi(argv[4]) : 7;
+    long freeBlocks = argc > 5 ? atol(argv[5]) : 200;
+    long eraseCycles = argc > 6 ? atol(argv[6]) : 100000;
+    if(years < 1 || slots < 1 || updatePeriodInSec < 1 || restartPeriodInDays < 1 || freeBlocks < 1 || eraseCycles < 1){
+        fprintf(stderr, "Usage: wear [years] [min. checkpoint period in sec] [slots] [update period in sec] [restart period in days] [free blocks] [erase cycles]\n");
+        return 1;
+    }
+
+    Hal::simulateClock(WEAR_START);
+    CountingStorage storage;
+    storage.begin(sizeof(MeterTotals::Checkpoint));
+    MeterTotals* totals = new MeterTotals();
+    totals->begin(&storage, slots, minPeriodInSec);
+
+    uint64_t expected[MAX_COUNTERS] = {0};
+    unsigned long restarts = 0;
+    unsigned long wrongRestores = 0;
+    unsigned long failedWrites = 0;
+    unsigned long writes = 0;
+    const int64_t endUs = (int64_t)years * SEC_PER_YEAR * 1000000;
+    const int64_t restartPeriodUs = (int64_t)restartPeriodInDays * 24 * 3600 * 1000000;
+    int64_t nextRestartUs = restartPeriodUs;
+    unsigned long update = 0;
+    for (int64_t nowUs = 0; nowUs < endUs; nowUs += (int64_t)updatePeriodInSec * 1000000)
+    {
+        Hal::advanceClock(nowUs);
+        update++;
+        for (int i = 0; i < MAX_COUNTERS; i++)
+        {
+            // Different impulse rates, some counters are idle most of the time.
+            unsigned long impulse = (update + i) % (i + 1) == 0 ? i + 1 : 0;
+            totals->add(i, impulse);
+            expected[i] += impulse;
+        }
+        if(!totals->checkpoint(false)){
+            failedWrites++;
+        }
+
+        if(nowUs >= nextRestartUs){
+            nextRestartUs += restartPeriodUs;
+            if(!totals->checkpoint(true)){
+                failedWrites++;
+            }
+            writes += totals->writes();
+            delete totals;
+            totals = new MeterTotals();
+            totals->begin(&storage, slots, minPeriodInSec);
+            restarts++;
+            for (int i = 0; i < MAX_COUNTERS; i++)
+            {
+                if(totals->total(i) != expected[i]){
+                    wrongRestores++;
+                    printf("Wrong restore after %lu restarts: counter %d has %llu instead of %llu\n", restarts, i,
+                        (unsigned long long)totals->total(i), (unsigned long long)expected[i]);
+                    break;
+                }
+            }
+        }
+    }
+    writes += totals->writes();
+    delete totals;
+
+    const std::vector<unsigned long>& slotWrites = storage.slotWrites();
+    unsigned long maxSlotWrites = 0;
+    printf("Slot writes:");
+    for (size_t i = 0; i < slotWrites.size(); i++)
+    {
+        printf(" %lu", slotWrites[i]);
+        if(slotWrites[i] > maxSlotWrites){
+            maxSlotWrites = slotWrites[i];
+        }
+    }
+    printf("\n");
+    double writesPerYear = (double)writes / years;
+    double erasesPerBlockAndYear = writesPerYear * ERASES_PER_CHECKPOINT / freeBlocks;
+    double lifetimeYears = erasesPerBlockAndYear > 0 ? eraseCycles / erasesPerBlockAndYear : 0;
+    printf("Years: %d; Checkpoints: %lu (%.0f per year); Bytes: %llu; Restarts: %lu; Wrong restores: %lu; Failed writes: %lu\n",
+        years, writes, writesPerYear, storage.bytes(), restarts, wrongRestores, failedWrites);
+    printf("LittleFS: %.1f erases per block and year over %ld blocks (%lu KB); max. %lu writes of one slot; estimated lifetime %.0f years at %ld cycles\n",
+        erasesPerBlockAndYear, freeBlocks, (unsigned long)(freeBlocks * BLOCK_SIZE / 1024), maxSlotWrites, lifetimeYears, eraseCycles);
+    bool failed = wrongRestores > 0 || (lifetimeYears > 0 && lifetimeYears < years);
+    printf("Wear: %s\n", failed ? "FAILED" : "OK");
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,15 @@
+#ifndef NATIVE_WEAR_H
+#define NATIVE_WEAR_H
+
+// Model the flash wear of the MeterTotals checkpoints over many years with a simulated clock.
+// The real MeterTotals code writes into a storage in memory, which counts the writes of every slot. Every update adds
+// impulses of all counters and asks for a checkpoint, like MeterNode does after the closed intervalls. The node restarts
+// in the given period, then the checkpoint is forced and restored and the restored totals must match.
+// LittleFS writes a synced file in copy on write blocks: every checkpoint programs a new data block and commits the
+// metadata pair, so the model counts two block erases per checkpoint, spread by the wear leveling over the free blocks.
+// Arguments: [years (10)] [min. checkpoint period in sec (900)] [slots (8)] [update period in sec (10)] [restart period in days (7)]
+//            [free LittleFS blocks of 4096 bytes (200)] [erase cycles of a block (100000)]
+// Returns 2 if a restored total is wrong or the estimated lifetime of the flash is shorter than the simulated years.
+int runWear(int argc, char* argv[]);
+
+#endif
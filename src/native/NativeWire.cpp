@@ -0,0 +1,126 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "NativeWire.h"
+#include "IntervallBatch.h"
+#include "IsoTimeFormatter.h"
+#include "PackedFormat.h"
+
+namespace
+{
+    // Compare a day of BATCH payloads of 20 counters with 60 second intervalls in both encodings.
+    void compareDay(){
+        const int counters = MAX_COUNTERS;
+        const int intervalls = 24 * 60;
+        std::vector<std::string> textPayloads;
+        std::vector<std::string> packedPayloads;
+        IsoTimeFormatter formatter;
+        PackedEncoder encoder;
+        char sourceNames[MAX_COUNTERS][32];
+        for (int i = 0; i < counters; i++)
+        {
+            snprintf(sourceNames[i], sizeof(sourceNames[i]), "House/Meter%02d", i);
+        }
+        unsigned long seed = 1;
+        for (int n = 0; n < intervalls; n++)
+        {
+            time_t utcTime = 1609459200 + (n + 1) * 60;
+            char text[IntervallBatch::MAX_PAYLOAD_SIZE];
+            size_t len = strlen(formatter.format(utcTime, text));
+            encoder.begin(PackedEncoder::TYPE_INTERVALLS, utcTime);
+            for (int i = 0; i < counters; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                ImpulseMeterStatus status = {utcTime, (seed >> 16) % 500, sourceNames[i], 60, (uint8_t)i, 0};
+                len += snprintf(text + len, sizeof(text) - len, "\n%s\t%u\t%lu", status.sourceName, status.timerIntervallInSec, status.impulse);
+                encoder.addIntervall(status);
+            }
+            textPayloads.push_back(text);
+            encoder.encode(text, sizeof(text));
+            packedPayloads.push_back(text);
+        }
+
+        size_t textBytes = 0;
+        size_t packedBytes = 0;
+        unsigned long long textSum = 0;
+        unsigned long long packedSum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& payload : textPayloads)
+        {
+            textBytes += payload.size();
+            // Like a consumer: the time and then the lines with SourceName, intervall and impulses.
+            struct tm tm = {};
+            sscanf(payload.c_str(), "%d-%d-%dT%d:%d:%dZ", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+            const char* line = strchr(payload.c_str(), '\n');
+            while (line != NULL)
+            {
+                char sourceName[32];
+                unsigned int intervall;
+                unsigned long impulse;
+                if(sscanf(line + 1, "%31[^\t]\t%u\t%lu", sourceName, &intervall, &impulse) == 3){
+                    textSum += impulse;
+                }
+                line = strchr(line + 1, '\n');
+            }
+        }
+        auto textNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        PackedDecoder decoder;
+        for (const std::string& payload : packedPayloads)
+        {
+            packedBytes += payload.size();
+            PackedDecoder::Intervall intervall;
+            decoder.begin(payload.c_str());
+            while (decoder.next(intervall))
+            {
+                packedSum += intervall.impulse;
+            }
+        }
+        auto packedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        printf("# Day of %d counters: TEXT %zu bytes, %lld ns per message; PACKED %zu bytes (%.0f%%), %lld ns per message; impulses %s\n",
+            counters, textBytes, (long long)(textNs / intervalls), packedBytes, 100.0 * packedBytes / textBytes,
+            (long long)(packedNs / intervalls), textSum == packedSum ? "equal" : "DIFFERENT");
+    }
+
+    bool printPayload(const char* text){
+        PackedDecoder decoder;
+        if(!decoder.begin(text)){
+            printf("%s: not a packed message\n", text);
+            return false;
+        }
+        char timeBuff[IsoTimeFormatter::BUFFER_SIZE];
+        printf("%s: type %d, base time %s\n", text, decoder.type(), IsoTimeFormatter::render(decoder.baseTime(), timeBuff));
+        PackedDecoder::Intervall intervall;
+        uint64_t value;
+        while (decoder.type() == PackedEncoder::TYPE_INTERVALLS ? decoder.next(intervall) : decoder.next(value))
+        {
+            if(decoder.type() == PackedEncoder::TYPE_INTERVALLS){
+                printf("  %u\t%s\t%" PRIu32 "\t%lu\n", (unsigned int)intervall.counterId, IsoTimeFormatter::render(intervall.utcTime, timeBuff), intervall.timerIntervallInSec, intervall.impulse);
+            }else{
+                printf("  %" PRIu64 "\n", value);
+            }
+        }
+        if(decoder.error()){
+            printf("  broken message\n");
+        }
+        return !decoder.error();
+    }
+}
+
+int runWire(int argc, char* argv[]){
+    if(argc > 0){
+        bool ok = true;
+        for (int i = 0; i < argc; i++)
+        {
+            ok = printPayload(argv[i]) && ok;
+        }
+        return ok ? 0 : 2;
+    }
+
+    compareDay();
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+// The host reference of the packed encoding, the golden vectors are checked by test/test_native. Without arguments
+// the payload bytes and the parse time of a day of batches are compared with the text encoding.
+// With arguments every argument is decoded as payload and printed, e.g. to check a captured MQTT message.
+// Returns 2 if a payload can´t be decoded.
+int runWire(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef FAKE_PCNT_UNIT_H
+#define FAKE_PCNT_UNIT_H
+#include <atomic>
+#include <stdint.h>
+#include "PcntAccumulator.h"
+
+// A PCNT unit of the ESP32 on the host. The 16 bit counter counts up to the high limit, then the hardware resets it
+// to 0 and raises the limit interrupt. The interrupt is handled later with handleInterrupts(), like the ISR runs some
+// cycles after the reset.
+class FakePcntUnit
+{
+public:
+	FakePcntUnit(int16_t highLimit, PcntAccumulator& accumulator) : _highLimit(highLimit), _accumulator(accumulator) {}
+
+	// Count the impulses, the interrupts are handled at once if handle is true.
+	void count(uint32_t impulses, bool handle = true)
+	{
+		uint64_t counter = (uint64_t)_counter.load(std::memory_order_relaxed) + impulses;
+		_pending.fetch_add((uint32_t)(counter / _highLimit), std::memory_order_relaxed);
+		_counter.store((int16_t)(counter % _highLimit), std::memory_order_release);
+		if (handle)
+		{
+			handleInterrupts();
+		}
+	}
+
+	// Run the ISR for the pending limit interrupts.
+	void handleInterrupts()
+	{
+		while (_pending.load(std::memory_order_relaxed) > 0)
+		{
+			_pending.fetch_sub(1, std::memory_order_relaxed);
+			_accumulator.onLimit();
+		}
+	}
+
+	// The counter register, like pcnt_get_counter_value().
+	int16_t read() const { return _counter.load(std::memory_order_acquire); }
+	uint32_t pendingInterrupts() const { return _pending.load(std::memory_order_relaxed); }
+
+private:
+	const int16_t _highLimit;
+	PcntAccumulator& _accumulator;
+	std::atomic<int16_t> _counter{0};
+	std::atomic<uint32_t> _pending{0};
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef TESTS_H
+#define TESTS_H
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MqttPort.h"
+
+// The groups of the native test suite, run with: pio test -e native
+// Every group is in its own file, test_main.cpp runs them on the simulated clock.
+void runImpulseMeterTests();
+void runLoggerTests();
+void runSchedulerTests();
+void runStormGuardTests();
+void runSpscQueueTests();
+void runMpscQueueTests();
+void runPcntAccumulatorTests();
+void runJournalTests();
+void runMqttHandoffTests();
+void runIsoTimeTests();
+void runClockAnchorTests();
+void runExpanderBankTests();
+void runPackedFormatTests();
+void runMeterTotalsTests();
+void runReportPolicyTests();
+void runRateEstimatorTests();
+void runHeapTests();
+void runRollupTests();
+void runCommandParserTests();
+
+// The start of the simulated clock, the UTC time is known from the boot on.
+const time_t TEST_BOOT_TIME = 1609459200;	// 2021-01-01T00:00:00Z
+
+// MqttPort which keeps the published messages for the checks.
+class RecordingMqttPort : public MqttPort
+{
+public:
+	struct Message
+	{
+		std::string topic;
+		std::string payload;
+		bool retain;
+	};
+
+	bool isConnected() override { return connected; }
+	bool publish(const char* topic, const char* payload, bool retain = false) override
+	{
+		if (!connected)
+		{
+			return false;
+		}
+		if (accepted == 0 && rejected > 0)
+		{
+			rejected--;
+			return false;
+		}
+		accepted -= accepted > 0 && accepted != SIZE_MAX;
+		messages.push_back({topic, payload, retain});
+		return true;
+	}
+	bool subscribe(const char* topic, message_handler_t handler) override
+	{
+		subscriptions.push_back({topic, handler});
+		return true;
+	}
+
+	// Call the handlers of the topic like the client for a received message.
+	void receive(const std::string& topic, const char* message)
+	{
+		for (const std::pair<std::string, message_handler_t>& subscription : subscriptions)
+		{
+			if (subscription.first == topic)
+			{
+				subscription.second(message);
+			}
+		}
+	}
+
+	// The messages of the topic.
+	std::vector<std::string> payloads(const std::string& topic) const
+	{
+		std::vector<std::string> found;
+		for (const Message& message : messages)
+		{
+			if (message.topic == topic)
+			{
+				found.push_back(message.payload);
+			}
+		}
+		return found;
+	}
+
+	bool connected = true;
+	size_t accepted = SIZE_MAX;		// Number of messages which are accepted, then the broker rejects the next publishes
+	size_t rejected = SIZE_MAX;		// Number of rejected publishes, then the broker accepts them again
+	std::vector<Message> messages;
+	std::vector<std::pair<std::string, message_handler_t>> subscriptions;
+};
+
+#endif
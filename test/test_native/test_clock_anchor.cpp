@@ -0,0 +1,53 @@
+#include <unity.h>
+#include "ClockAnchor.h"
+#include "Tests.h"
+
+namespace
+{
+    const int64_t BOOT_UTC_US = (int64_t)TEST_BOOT_TIME * 1000000;
+
+    void test_first_valid_time_anchors(){
+        ClockAnchor clock;
+        TEST_ASSERT_EQUAL(ClockAnchor::NONE, clock.update(1000000, 1000000));
+        TEST_ASSERT_FALSE(clock.isAnchored());
+        TEST_ASSERT_EQUAL(ClockAnchor::ANCHORED, clock.update(5000000, BOOT_UTC_US));
+        TEST_ASSERT_TRUE(clock.isAnchored());
+        TEST_ASSERT_EQUAL_INT64(5000000, clock.anchoredUs());
+        TEST_ASSERT_EQUAL_INT64(BOOT_UTC_US + 1000000, clock.toUtcUs(6000000));
+        TEST_ASSERT_EQUAL_INT64(6000000, clock.toMonotonicUs(BOOT_UTC_US + 1000000));
+        TEST_ASSERT_EQUAL(ClockAnchor::NONE, clock.update(6000000, BOOT_UTC_US + 1000000));
+    }
+
+    // A difference below MAX_SLEW_US is followed, only the part above the jitter is counted as slew.
+    void test_small_differences_are_slewed(){
+        ClockAnchor clock;
+        clock.update(0, BOOT_UTC_US);
+        TEST_ASSERT_EQUAL(ClockAnchor::SLEWED, clock.update(1000000, BOOT_UTC_US + 1000000 + ClockAnchor::JITTER_US - 1));
+        TEST_ASSERT_EQUAL_INT64(0, clock.slewedUs());
+        TEST_ASSERT_EQUAL(ClockAnchor::SLEWED, clock.update(2000000, BOOT_UTC_US + 2000000 - 500000));
+        TEST_ASSERT_EQUAL_INT64(500000 + ClockAnchor::JITTER_US - 1, clock.slewedUs());
+        TEST_ASSERT_EQUAL_INT64(BOOT_UTC_US + 2500000, clock.toUtcUs(3000000));
+        TEST_ASSERT_EQUAL(0, clock.steps());
+    }
+
+    void test_large_differences_are_steps(){
+        ClockAnchor clock;
+        clock.update(0, BOOT_UTC_US);
+        TEST_ASSERT_EQUAL(ClockAnchor::STEPPED, clock.update(1000000, BOOT_UTC_US + 1000000 + ClockAnchor::MAX_SLEW_US));
+        TEST_ASSERT_EQUAL(1, clock.steps());
+        TEST_ASSERT_EQUAL_INT64(ClockAnchor::MAX_SLEW_US, clock.lastStepUs());
+        TEST_ASSERT_EQUAL(ClockAnchor::STEPPED, clock.update(2000000, BOOT_UTC_US - 3600000000LL));
+        TEST_ASSERT_EQUAL(2, clock.steps());
+        TEST_ASSERT_EQUAL_INT64(-3600000000LL - 2000000 - ClockAnchor::MAX_SLEW_US, clock.lastStepUs());
+        TEST_ASSERT_EQUAL_INT64(BOOT_UTC_US - 3600000000LL, clock.toUtcUs(2000000));
+        // The mapping stays anchored at the first valid time.
+        TEST_ASSERT_EQUAL_INT64(0, clock.anchoredUs());
+        TEST_ASSERT_EQUAL_INT64(0, clock.slewedUs());
+    }
+}
+
+void runClockAnchorTests(){
+    RUN_TEST(test_first_valid_time_anchors);
+    RUN_TEST(test_small_differences_are_slewed);
+    RUN_TEST(test_large_differences_are_steps);
+}
@@ -0,0 +1,218 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "CommandParser.h"
+#include "CounterConfigStore.h"
+#include "Hal.h"
+#include "JournalStorage.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "MqttHandoff.h"
+#include "Tests.h"
+
+namespace
+{
+    void test_install_counter_is_parsed(){
+        CounterConfig config;
+        TEST_ASSERT_EQUAL(CommandParser::OK, CommandParser::parseInstallCounter("12\tHaus/Strom\t60\tGPIO\tCHANGE\t3600\r", config));
+        TEST_ASSERT_EQUAL(12, config.counterId);
+        TEST_ASSERT_EQUAL_STRING("Haus/Strom", config.sourceName);
+        TEST_ASSERT_EQUAL(60, config.timerIntervallInSec);
+        TEST_ASSERT_EQUAL(GPIO_INTERRUPT_SOURCE, config.sourceType);
+        TEST_ASSERT_EQUAL(ReportPolicy::REPORT_ON_CHANGE, config.report.mode);
+        TEST_ASSERT_EQUAL(3600, config.report.maxSilenceInSec);
+
+        TEST_ASSERT_EQUAL(CommandParser::BAD_COUNTER_ID, CommandParser::parseInstallCounter("99\tHaus/Strom\t60", config));
+        TEST_ASSERT_EQUAL(CommandParser::BAD_SOURCE_NAME, CommandParser::parseInstallCounter("1\tHaus/#\t60", config));
+        TEST_ASSERT_EQUAL(CommandParser::MISSING_FIELD, CommandParser::parseInstallCounter("1\tHaus/Strom", config));
+    }
+
+    void test_bulk_reports_the_wrong_line(){
+        CounterConfig configs[MAX_COUNTERS];
+        size_t count;
+        size_t errorLine;
+        const char* message = "0\tm0\t10\n\n1\tm1\t10\n0\tm2\t10";
+        TEST_ASSERT_EQUAL(CommandParser::DUPLICATE_COUNTER_ID, CommandParser::parseInstallCounters(message, configs, MAX_COUNTERS, count, errorLine));
+        TEST_ASSERT_EQUAL(4, errorLine);
+
+        TEST_ASSERT_EQUAL(CommandParser::OK, CommandParser::parseInstallCounters("0\tm0\t10\n\n1\tm1\t10\n", configs, MAX_COUNTERS, count, errorLine));
+        TEST_ASSERT_EQUAL(2, count);
+        TEST_ASSERT_EQUAL(1, configs[1].counterId);
+        // The empty lines are counted for the line of a config.
+        TEST_ASSERT_EQUAL(1, CommandParser::installCounterLine(message, 0));
+        TEST_ASSERT_EQUAL(3, CommandParser::installCounterLine(message, 1));
+    }
+
+    // The cost of a line of a bulk message with a line for every counter.
+    // A bulk InstallCounters message with the longest line for all counters is accepted and fits into a received message.
+    void test_longest_bulk_fits_into_a_message(){
+        std::string message;
+        char line[2 * CommandParser::MAX_INSTALL_COUNTER_LEN];
+        for (int i = 0; i < MAX_COUNTERS; i++)
+        {
+            int len = snprintf(line, sizeof(line), "%010d\tLongest/Source/Name/Counter%04d\t0000000060\t%s\tDEADBAND\t4294967295%%\t%010u\r\n",
+                i, i, i < MAX_GPIO_COUNTERS ? "GPIO" : "EXPANDER", ReportPolicy::MAX_SILENCE_IN_SEC);
+            TEST_ASSERT_TRUE(len <= (int)CommandParser::MAX_INSTALL_COUNTER_LEN);
+            message += line;
+        }
+        CounterConfig configs[MAX_COUNTERS];
+        size_t count;
+        size_t errorLine;
+        TEST_ASSERT_EQUAL(CommandParser::OK, CommandParser::parseInstallCounters(message, configs, MAX_COUNTERS, count, errorLine));
+        TEST_ASSERT_EQUAL(MAX_COUNTERS, count);
+        TEST_ASSERT_EQUAL(CounterConfig::MAX_SOURCE_NAME_LEN, strlen(configs[0].sourceName));
+        TEST_ASSERT_TRUE(message.size() <= MqttHandoff::MAX_PAYLOAD_LEN);
+    }
+
+    void test_parse_benchmark(){
+        const int RUNS = 20000;
+        std::string message;
+        for (int i = 0; i < MAX_COUNTERS; i++)
+        {
+            char line[48];
+            snprintf(line, sizeof(line), "%d\tHaus/Zaehler%02d\t60\tGPIO\n", i, i);
+            message += line;
+        }
+        CounterConfig configs[MAX_COUNTERS];
+        size_t count = 0;
+        size_t errorLine;
+        size_t parsed = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < RUNS; i++)
+        {
+            CommandParser::parseInstallCounters(message, configs, MAX_COUNTERS, count, errorLine);
+            parsed += count;
+        }
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        char text[64];
+        snprintf(text, sizeof(text), "InstallCounter line: %.1f ns", (double)ns / parsed);
+        TEST_MESSAGE(text);
+        TEST_ASSERT_EQUAL(RUNS * MAX_COUNTERS, parsed);
+        // A loose limit, the tests also run with sanitizers.
+        TEST_ASSERT_LESS_THAN(20000, ns / parsed);
+    }
+
+    // A bulk message with a line which can´t be installed changes no counter, also not the lines before.
+    // The MeterNode of the install tests, the counters stay installed.
+    Logger logger;
+    MeterNode node;
+    RecordingMqttPort port;
+
+    void test_failed_bulk_install_rolls_back(){
+        logger.begin();
+        node.begin("TEST", &port, &logger);
+        node.installCounter("0\tm0\t10");
+        TEST_ASSERT_EQUAL(1, node.getInstalledCounters());
+
+        // The native build has no PCNT, so the last line fails after the first two are installed.
+        node.installCounters("0\tm0\t60\n\n1\tm1\t10\n2\tm2\t10\tPCNT");
+        std::vector<std::string> results = port.payloads("InstallResult/TEST");
+        TEST_ASSERT_EQUAL(1, results.size());
+        TEST_ASSERT_EQUAL_STRING("ERROR\t4\tCounter can´t be installed", results[0].c_str());
+        TEST_ASSERT_EQUAL(1, node.getInstalledCounters());
+
+        // Counter 0 counts again, counter 1 is removed.
+        Hal::advanceClock(Hal::micros() + 61000000);
+        node.loop();
+        TEST_ASSERT_TRUE(port.payloads("m0").size() > 0);
+        TEST_ASSERT_EQUAL(0, port.payloads("m1").size());
+
+        node.installCounters("1\tm1\t10\n0\tm0\t10");
+        results = port.payloads("InstallResult/TEST");
+        TEST_ASSERT_EQUAL(2, results.size());
+        TEST_ASSERT_EQUAL_STRING("OK\t2\t0", results[1].c_str());
+        TEST_ASSERT_EQUAL(2, node.getInstalledCounters());
+
+        // A update which can´t count keeps the previous source.
+        node.installCounter("1\tm1\t10\tPCNT");
+        TEST_ASSERT_EQUAL(2, node.getInstalledCounters());
+        Hal::advanceClock(Hal::micros() + 11000000);
+        node.loop();
+        TEST_ASSERT_TRUE(port.payloads("m1").size() > 0);
+    }
+
+    // The LiveRate and Rollup messages are stored with the counters.
+    void test_config_store_keeps_live_rate_and_rollups(){
+        const char* DATA_PATH = "/tmp/test_native_counters.bin";
+        const char* CURSOR_PATH = "/tmp/test_native_counters.cur";
+        remove(DATA_PATH);
+        remove(CURSOR_PATH);
+        FileJournalStorage storage;
+        static CounterConfigStore store;
+        TEST_ASSERT_TRUE(storage.begin(DATA_PATH, CURSOR_PATH, false));
+        TEST_ASSERT_TRUE(store.begin(&storage));
+
+        // The counters 0 and 1 are installed by test_failed_bulk_install_rolls_back.
+        node.setConfigStore(&store);
+        node.liveRateMessage("1\t20");
+        node.rollupMessage("1\t60\t120R");
+        TEST_ASSERT_EQUAL(2, store.writes());
+        // A unchanged configuration is not written again.
+        node.installCounter("0\tm0\t10");
+        TEST_ASSERT_EQUAL(2, store.writes());
+        node.setConfigStore(NULL);
+
+        static CounterConfigStore stored;
+        TEST_ASSERT_TRUE(stored.begin(&storage));
+        TEST_ASSERT_EQUAL(2, stored.count());
+        const CounterConfigStore::Entry& entry = stored.entry(1);
+        TEST_ASSERT_EQUAL(1, entry.counter.counterId);
+        TEST_ASSERT_EQUAL(20, entry.liveRateChangePercent);
+        TEST_ASSERT_EQUAL(2, entry.rollupLevels);
+        TEST_ASSERT_EQUAL(60, entry.rollups[0].periodInSec);
+        TEST_ASSERT_FALSE(entry.rollups[0].retain);
+        TEST_ASSERT_EQUAL(120, entry.rollups[1].periodInSec);
+        TEST_ASSERT_TRUE(entry.rollups[1].retain);
+        TEST_ASSERT_EQUAL(0, stored.entry(0).rollupLevels);
+        storage.end();
+    }
+
+    // The PublishMode and Encoding messages with a wrong or an additional field don´t change the node.
+    void test_publish_mode_and_encoding_reject_garbage(){
+        node.encodingMessage("PACKED\t1");
+        TEST_ASSERT_EQUAL_STRING("PACKED\t1", port.payloads("Encoding/TEST").back().c_str());
+        const char* wrongEncodings[] = {"TEXT garbage", "TEXT\t1x", "PACKED\t1\t2", "PACKED\t0", ""};
+        size_t published = port.payloads("Encoding/TEST").size();
+        for (const char* message : wrongEncodings)
+        {
+            node.encodingMessage(message);
+            TEST_ASSERT_EQUAL_MESSAGE(published, port.payloads("Encoding/TEST").size(), message);
+        }
+        node.encodingMessage("TEXT");
+        TEST_ASSERT_EQUAL_STRING("TEXT", port.payloads("Encoding/TEST").back().c_str());
+
+        // The counters 0 and 1 publish every 10 s to m0 and m1, in BATCH mode both are published to Impulses/TEST.
+        node.publishModeMessage("BATCH\t1000\t512");
+        const char* wrongModes[] = {"SINGLE garbage", "SINGLE\t-1", "SINGLE\t1000\t512x", "SINGLE\t0\t0\t0", ""};
+        for (const char* message : wrongModes)
+        {
+            node.publishModeMessage(message);
+        }
+        size_t singles = port.payloads("m0").size();
+        size_t batches = port.payloads("Impulses/TEST").size();
+        Hal::advanceClock(Hal::micros() + 11000000);
+        node.loop();
+        Hal::advanceClock(Hal::micros() + 2000000);
+        node.loop();
+        TEST_ASSERT_EQUAL(singles, port.payloads("m0").size());
+        TEST_ASSERT_TRUE(port.payloads("Impulses/TEST").size() > batches);
+
+        node.publishModeMessage("SINGLE");
+        Hal::advanceClock(Hal::micros() + 11000000);
+        node.loop();
+        TEST_ASSERT_TRUE(port.payloads("m0").size() > singles);
+    }
+}
+
+void runCommandParserTests(){
+    RUN_TEST(test_install_counter_is_parsed);
+    RUN_TEST(test_bulk_reports_the_wrong_line);
+    RUN_TEST(test_longest_bulk_fits_into_a_message);
+    RUN_TEST(test_parse_benchmark);
+    RUN_TEST(test_failed_bulk_install_rolls_back);
+    RUN_TEST(test_config_store_keeps_live_rate_and_rollups);
+    RUN_TEST(test_publish_mode_and_encoding_reject_garbage);
+}
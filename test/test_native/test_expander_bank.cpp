@@ -0,0 +1,68 @@
+#include <unity.h>
+#include "ExpanderBank.h"
+#include "native/NativeExpander.h"
+#include "Tests.h"
+
+namespace
+{
+    // The edge decoding of a read, the expected edges are derived by hand from the MCP23017 data sheet.
+    struct DecodeVector
+    {
+        const char* name;
+        uint16_t lastLevels;
+        uint16_t flags;
+        uint16_t captured;
+        uint16_t levels;
+        uint16_t atCapture;
+        uint16_t afterCapture;
+    };
+
+    const DecodeVector DECODE_VECTORS[] = {
+        {"idle", 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
+        {"rise", 0x0000, 0x0001, 0x0001, 0x0001, 0x0001, 0x0000},
+        {"rise and fall before the read", 0x0000, 0x0001, 0x0001, 0x0000, 0x0001, 0x0000},
+        {"fall", 0x0001, 0x0001, 0x0000, 0x0000, 0x0000, 0x0000},
+        {"fall and rise before the read", 0x0001, 0x0001, 0x0000, 0x0001, 0x0000, 0x0001},
+        {"glitch shorter than the capture", 0x0000, 0x0001, 0x0000, 0x0000, 0x0001, 0x0000},
+        {"other channel after the capture", 0x0000, 0x0001, 0x0001, 0x8001, 0x0001, 0x8000},
+        {"stale capture of other channels", 0x00F0, 0x0100, 0x0100, 0x01F0, 0x0100, 0x0000},
+        {"all channels", 0x0000, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x0000},
+        {"no interrupt, levels changed", 0x0000, 0x0000, 0x1234, 0x0003, 0x0000, 0x0003},
+    };
+
+    void test_edges_are_decoded(){
+        for (const DecodeVector& vector : DECODE_VECTORS)
+        {
+            ExpanderBank::Edges edges = ExpanderBank::decode(vector.lastLevels, vector.flags, vector.captured, vector.levels);
+            TEST_ASSERT_EQUAL_HEX16_MESSAGE(vector.atCapture, edges.atCapture, vector.name);
+            TEST_ASSERT_EQUAL_HEX16_MESSAGE(vector.afterCapture, edges.afterCapture, vector.name);
+        }
+    }
+
+    // The reads of all banks are shorter than the min. impulse, so every impulse is counted once.
+    void test_fast_bus_counts_all_impulses(){
+        ExpanderSimulation result;
+        TEST_ASSERT_TRUE(simulateExpander(250, 30, 2, 2, 300, result));
+        TEST_ASSERT_TRUE(result.impulses > 0);
+        TEST_ASSERT_EQUAL(result.impulses, result.counted);
+        TEST_ASSERT_EQUAL(0, result.lost);
+        TEST_ASSERT_EQUAL(0, result.doubled);
+        TEST_ASSERT_EQUAL(0, result.failedReads);
+    }
+
+    // Short impulses on four banks, the interrupt line stays low while the banks are read.
+    void test_short_impulses_on_all_banks(){
+        ExpanderSimulation result;
+        TEST_ASSERT_TRUE(simulateExpander(200, 5, 20, 4, 20, result));
+        TEST_ASSERT_EQUAL(result.impulses, result.counted);
+        TEST_ASSERT_EQUAL(0, result.lost);
+        TEST_ASSERT_EQUAL(0, result.doubled);
+        TEST_ASSERT_TRUE(result.interrupts > 0 && result.interrupts < result.reads);
+    }
+}
+
+void runExpanderBankTests(){
+    RUN_TEST(test_edges_are_decoded);
+    RUN_TEST(test_fast_bus_counts_all_impulses);
+    RUN_TEST(test_short_impulses_on_all_banks);
+}
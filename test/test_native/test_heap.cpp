@@ -0,0 +1,108 @@
+#include <unity.h>
+#include <stdio.h>
+#include "Hal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "MqttHandoff.h"
+#include "native/NativeHeap.h"
+#include "Tests.h"
+
+namespace
+{
+    // The counters of the node, the counters below are used by the report policy and command parser tests.
+    const int FIRST_COUNTER_ID = 8;
+    const int COUNTERS = 8;
+    const int INTERVALL_IN_SEC = 60;
+
+    // The broker, which only counts the messages.
+    class CountingPort : public MqttPort
+    {
+    public:
+        bool isConnected() override { return true; }
+        bool publish(const char* /*topic*/, const char* /*payload*/, bool /*retain*/ = false) override { published++; return true; }
+        bool subscribe(const char* /*topic*/, message_handler_t /*handler*/) override { return true; }
+
+        unsigned long published = 0;
+    };
+
+    // Static like the objects of main.cpp, so they don´t use the heap.
+    CountingPort port;
+    MqttHandoff handoff;
+    Logger logger;
+    MeterNode node;
+    char nodeName[] = "HEAP";
+    char installMessage[COUNTERS * 32];
+
+    // Run the counting and the network task with the simulated clock, every counter gets 30 impulses per minute.
+    void run(int seconds){
+        int64_t startUs = Hal::micros();
+        for (int second = 1; second <= seconds; second++)
+        {
+            for (int i = 0; i < COUNTERS && second % 2 == 0; i++)
+            {
+                Hal::simulatePinLevel(gpioPins[FIRST_COUNTER_ID + i], true);
+                Hal::simulatePinLevel(gpioPins[FIRST_COUNTER_ID + i], false);
+            }
+            Hal::advanceClock(startUs + (int64_t)second * 1000000);
+            if(second % 600 == 0){
+                // The controller installs the same counters again, e.g. after a restart of the controller.
+                node.installCounters(installMessage);
+                node.requestReady();
+            }
+            handoff.dispatch();
+            node.loop();
+            handoff.forward();
+        }
+    }
+
+    // The node with live rates, rollups, a StormGuard, the status and the metrics allocates nothing after the setup,
+    // in every publish mode and encoding.
+    void test_steady_state_allocates_nothing(){
+        size_t len = 0;
+        for (int i = FIRST_COUNTER_ID; i < FIRST_COUNTER_ID + COUNTERS; i++)
+        {
+            len += snprintf(installMessage + len, sizeof(installMessage) - len, "%d\tHeap/Counter%02d\t%d\n", i, i, INTERVALL_IN_SEC);
+        }
+        logger.begin(nodeName, &port);
+        handoff.begin(&port);
+        node.begin(nodeName, &handoff, &logger);
+        node.setupMqttSubscriber();
+        node.setMetricsPeriod(60);
+        node.installCounters(installMessage);
+        TEST_ASSERT_EQUAL(COUNTERS, node.getInstalledCounters());
+        char message[32];
+        for (int i = FIRST_COUNTER_ID; i < FIRST_COUNTER_ID + COUNTERS; i++)
+        {
+            snprintf(message, sizeof(message), "%d\t10", i);
+            node.liveRateMessage(message);
+            snprintf(message, sizeof(message), "%d\t900\t3600R", i);
+            node.rollupMessage(message);
+        }
+        snprintf(message, sizeof(message), "%d\t100\t1000", FIRST_COUNTER_ID);
+        node.stormGuardMessage(message);
+        run(2 * INTERVALL_IN_SEC);
+
+        const char* modes[] = {"SINGLE", "BATCH"};
+        const char* encodings[] = {"TEXT", "PACKED"};
+        for (const char* mode : modes)
+        {
+            for (const char* encoding : encodings)
+            {
+                // Switching the mode is a configuration, only the time after it is the steady state.
+                node.publishModeMessage(mode);
+                node.encodingMessage(encoding);
+                run(2 * INTERVALL_IN_SEC);
+                unsigned long allocations = heapAllocations();
+                unsigned long published = port.published;
+                run(1800);
+                snprintf(message, sizeof(message), "%s %s", mode, encoding);
+                TEST_ASSERT_EQUAL_MESSAGE(0, heapAllocations() - allocations, message);
+                TEST_ASSERT_TRUE(port.published > published);
+            }
+        }
+    }
+}
+
+void runHeapTests(){
+    RUN_TEST(test_steady_state_allocates_nothing);
+}
@@ -0,0 +1,220 @@
+#include <unity.h>
+#include <vector>
+#include "Hal.h"
+#include "ImpulseMeter.h"
+#include "Logger.h"
+#include "Tests.h"
+
+namespace
+{
+    Logger logger;
+    std::vector<ImpulseMeterStatus> closed;
+
+    void onIntervallElapsed(ImpulseMeterStatus status){
+        closed.push_back(status);
+    }
+
+    // A rising and a falling edge, the impulses are 100 ms apart.
+    void pulse(uint8_t pin){
+        Hal::simulatePinLevel(pin, true);
+        Hal::advanceClock(Hal::micros() + 50000);
+        Hal::simulatePinLevel(pin, false);
+        Hal::advanceClock(Hal::micros() + 50000);
+    }
+
+    // Move the simulated clock to the UTC time.
+    void advanceToUtc(time_t utcTime){
+        Hal::advanceClock(Hal::micros() + ((int64_t)utcTime * 1000000 - Hal::utcTimeUs()));
+    }
+
+    // The next multiple of the intervall after now.
+    time_t nextEnd(unsigned int intervallInSec){
+        time_t now = Hal::utcTime();
+        return now - now % intervallInSec + intervallInSec;
+    }
+
+    void test_intervall_has_impulses_of_its_time(){
+        ImpulseMeter meter;
+        closed.clear();
+        meter.begin(0, 60, "meter0", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        TEST_ASSERT_TRUE(meter.isInstalled());
+
+        time_t end = nextEnd(60);
+        for (int i = 0; i < 5; i++)
+        {
+            pulse(meter.pin());
+        }
+        advanceToUtc(end + 1);
+        for (int i = 0; i < 3; i++)
+        {
+            pulse(meter.pin());
+        }
+        advanceToUtc(end + 61);
+        TEST_ASSERT_EQUAL(2, meter.update());
+
+        TEST_ASSERT_EQUAL(2, closed.size());
+        TEST_ASSERT_EQUAL(5, closed[0].impulse);
+        TEST_ASSERT_EQUAL(end, closed[0].utcTime);
+        TEST_ASSERT_EQUAL(3, closed[1].impulse);
+        TEST_ASSERT_EQUAL(end + 60, closed[1].utcTime);
+        TEST_ASSERT_EQUAL(0, closed[1].counterId);
+        TEST_ASSERT_EQUAL_STRING("meter0", closed[1].sourceName);
+        TEST_ASSERT_EQUAL(0, meter.queueOverflows());
+    }
+
+    void test_empty_intervalls_are_closed(){
+        ImpulseMeter meter;
+        closed.clear();
+        meter.begin(1, 10, "meter1", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+
+        time_t end = nextEnd(10);
+        advanceToUtc(end + 30);
+        TEST_ASSERT_EQUAL(4, meter.update());
+        for (size_t i = 0; i < closed.size(); i++)
+        {
+            TEST_ASSERT_EQUAL(0, closed[i].impulse);
+            TEST_ASSERT_EQUAL(end + 10 * (time_t)i, closed[i].utcTime);
+        }
+    }
+
+    void test_intervall_is_rounded(){
+        ImpulseMeter meter;
+        meter.begin(2, 45, "meter2", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        TEST_ASSERT_EQUAL(40, meter.timerIntervallInSec());
+        ImpulseMeter minutes;
+        minutes.begin(3, 150, "meter3", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        TEST_ASSERT_EQUAL(120, minutes.timerIntervallInSec());
+        ImpulseMeter shortest;
+        shortest.begin(4, 1, "meter4", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        TEST_ASSERT_EQUAL(10, shortest.timerIntervallInSec());
+    }
+
+    // A new intervall of the same source is rounded and the current intervall ends on the new grid.
+    void test_new_intervall_is_realigned(){
+        ImpulseMeter meter;
+        closed.clear();
+        meter.begin(6, 600, "meter6", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        meter.begin(6, 25, "meter6", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        TEST_ASSERT_EQUAL(20, meter.timerIntervallInSec());
+
+        time_t end = nextEnd(20);
+        pulse(meter.pin());
+        advanceToUtc(end + 1);
+        TEST_ASSERT_EQUAL(1, meter.update());
+        TEST_ASSERT_EQUAL(1, closed[0].impulse);
+        TEST_ASSERT_EQUAL(end, closed[0].utcTime);
+        TEST_ASSERT_EQUAL(20, closed[0].timerIntervallInSec);
+    }
+
+    // The intervalls are timed by the monotonic clock: a step of the UTC time moves the following ends to the new grid,
+    // the end times never repeat and no impulse is lost.
+    void test_clock_step_keeps_impulses(){
+        ImpulseMeter meter;
+        closed.clear();
+        meter.begin(7, 60, "meter7", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+        unsigned long steps = ImpulseMeter::clock().steps();
+
+        time_t end = nextEnd(60);
+        advanceToUtc(end - 30);
+        pulse(meter.pin());
+        Hal::stepUtcTime(3600);
+        pulse(meter.pin());
+        // The end of the open intervall was calculated before the step.
+        advanceToUtc(end + 3600 + 1);
+        TEST_ASSERT_EQUAL(steps + 1, ImpulseMeter::clock().steps());
+        TEST_ASSERT_EQUAL_INT64(3600000000LL, ImpulseMeter::clock().lastStepUs());
+        advanceToUtc(end + 3660 + 1);
+        TEST_ASSERT_EQUAL(2, meter.update());
+        TEST_ASSERT_EQUAL(end, closed[0].utcTime);
+        TEST_ASSERT_EQUAL(2, closed[0].impulse);
+        TEST_ASSERT_EQUAL(end + 3660, closed[1].utcTime);
+        TEST_ASSERT_EQUAL(0, closed[1].impulse);
+
+        // After a step back the next intervall is longer, until the UTC time reaches its end. The end times never repeat.
+        advanceToUtc(end + 3690);
+        pulse(meter.pin());
+        Hal::stepUtcTime(-3600);
+        advanceToUtc(end + 3720 + 1);
+        TEST_ASSERT_EQUAL(steps + 2, ImpulseMeter::clock().steps());
+        TEST_ASSERT_EQUAL(1, meter.update());
+        TEST_ASSERT_EQUAL(end + 3720, closed[2].utcTime);
+        TEST_ASSERT_EQUAL(1, closed[2].impulse);
+        pulse(meter.pin());
+        advanceToUtc(end + 3780 + 1);
+        TEST_ASSERT_EQUAL(1, meter.update());
+        TEST_ASSERT_EQUAL(end + 3780, closed[3].utcTime);
+        TEST_ASSERT_EQUAL(1, closed[3].impulse);
+        TEST_ASSERT_EQUAL_INT64(3660000000LL, closed[3].monotonicEndUs - closed[2].monotonicEndUs);
+    }
+
+    // A source which counts a impulse at every take() while it is running, like a interrupt right after the take.
+    class RunningSource : public ImpulseSource
+    {
+    public:
+        bool begin(uint8_t pin) override { this->pin = pin; running = true; return true; }
+        void end() override { running = false; }
+        unsigned long take() override
+        {
+            unsigned long impulse = counted;
+            counted = running ? 1 : 0;
+            total += counted;
+            return impulse;
+        }
+        ImpulseSourceType type() const override { return GPIO_INTERRUPT_SOURCE; }
+
+        uint8_t pin = 0;
+        bool running = false;
+        unsigned long counted = 0;
+        static unsigned long total;									// Counted impulses of all sources
+    };
+    unsigned long RunningSource::total = 0;
+
+    // The replaced source is stopped before its impulses are taken, so every counted impulse is in the intervall.
+    // A new CounterId moves the meter to the pin of the counter.
+    void test_replaced_source_keeps_impulses(){
+        ImpulseMeter meter;
+        closed.clear();
+        RunningSource::total = 0;
+        RunningSource* first = new RunningSource();
+        meter.begin(6, 60, "meter6", first, onIntervallElapsed, &logger);
+        first->counted = 5;
+        RunningSource::total += 5;
+
+        RunningSource* second = new RunningSource();
+        meter.begin(7, 60, "meter7", second, onIntervallElapsed, &logger);
+        TEST_ASSERT_EQUAL(counterPin(7), meter.pin());
+        TEST_ASSERT_EQUAL(counterPin(7), second->pin);
+        second->counted = 2;
+        RunningSource::total += 2;
+        advanceToUtc(nextEnd(60) + 1);
+        TEST_ASSERT_EQUAL(1, meter.update());
+        TEST_ASSERT_EQUAL(7, closed[0].counterId);
+        // Only the impulse after the last take() belongs to the next intervall.
+        TEST_ASSERT_EQUAL(RunningSource::total - second->counted, closed[0].impulse);
+    }
+
+    void test_removed_meter_stops_counting(){
+        closed.clear();
+        uint8_t pin;
+        {
+            ImpulseMeter meter;
+            meter.begin(5, 10, "meter5", GPIO_INTERRUPT_SOURCE, onIntervallElapsed, &logger);
+            pin = meter.pin();
+        }
+        // No ISR and no intervall timer may use the destroyed meter.
+        pulse(pin);
+        advanceToUtc(nextEnd(10) + 10);
+        TEST_ASSERT_EQUAL(0, closed.size());
+    }
+}
+
+void runImpulseMeterTests(){
+    logger.begin();
+    RUN_TEST(test_intervall_has_impulses_of_its_time);
+    RUN_TEST(test_empty_intervalls_are_closed);
+    RUN_TEST(test_intervall_is_rounded);
+    RUN_TEST(test_new_intervall_is_realigned);
+    RUN_TEST(test_clock_step_keeps_impulses);
+    RUN_TEST(test_replaced_source_keeps_impulses);
+    RUN_TEST(test_removed_meter_stops_counting);
+}
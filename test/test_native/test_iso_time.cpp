@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include "IsoTimeFormatter.h"
+#include "Tests.h"
+
+namespace
+{
+    // The checked range: 1900-01-01 to 2400-12-31, with the non leap years 1900, 2100, 2200 and 2300,
+    // the leap year 2000 and the end of the 32 bit time_t in 2038.
+    const int64_t FIRST_DAY = -25567;
+    const int64_t LAST_DAY = 157419;
+
+    // The expected text from gmtime_r().
+    void expectedTime(time_t utcTime, char* buff){
+        struct tm tm;
+        gmtime_r(&utcTime, &tm);
+        strftime(buff, IsoTimeFormatter::BUFFER_SIZE, "%Y-%m-%dT%H:%M:%SZ", &tm);
+    }
+
+    void test_every_day_matches_gmtime(){
+        IsoTimeFormatter formatter;
+        char expected[IsoTimeFormatter::BUFFER_SIZE];
+        char rendered[IsoTimeFormatter::BUFFER_SIZE];
+        char formatted[IsoTimeFormatter::BUFFER_SIZE];
+        unsigned long errors = 0;
+        for (int64_t day = FIRST_DAY; day <= LAST_DAY; day++)
+        {
+            // The first and the last second of the day and a time which moves through the day.
+            const int64_t seconds[] = {0, (day - FIRST_DAY) * 3607 % 86400, 86399};
+            for (int64_t second : seconds)
+            {
+                time_t utcTime = (time_t)(day * 86400 + second);
+                expectedTime(utcTime, expected);
+                IsoTimeFormatter::render(utcTime, rendered);
+                formatter.format(utcTime, formatted);
+                if (strcmp(expected, rendered) != 0 || strcmp(expected, formatted) != 0)
+                {
+                    if (errors++ == 0)
+                    {
+                        TEST_ASSERT_EQUAL_STRING(expected, rendered);
+                        TEST_ASSERT_EQUAL_STRING(expected, formatted);
+                    }
+                }
+            }
+        }
+        TEST_ASSERT_EQUAL(0, errors);
+    }
+
+    void test_seconds_around_2038(){
+        IsoTimeFormatter formatter;
+        char expected[IsoTimeFormatter::BUFFER_SIZE];
+        char buff[IsoTimeFormatter::BUFFER_SIZE];
+        TEST_ASSERT_EQUAL_STRING("2038-01-19T03:14:07Z", IsoTimeFormatter::render((time_t)INT32_MAX, buff));
+        TEST_ASSERT_EQUAL_STRING("2038-01-19T03:14:08Z", IsoTimeFormatter::render((time_t)INT32_MAX + 1, buff));
+        TEST_ASSERT_EQUAL_STRING("2106-02-07T06:28:15Z", IsoTimeFormatter::render((time_t)UINT32_MAX, buff));
+        for (int64_t utcTime = (int64_t)INT32_MAX - 7200; utcTime <= (int64_t)INT32_MAX + 7200; utcTime++)
+        {
+            expectedTime((time_t)utcTime, expected);
+            TEST_ASSERT_EQUAL_STRING(expected, formatter.format((time_t)utcTime, buff));
+        }
+    }
+
+    // The cost of format() for the ends of 60 second intervalls, so the cached hour changes every 60th call, and of render().
+    void test_format_benchmark(){
+        const unsigned long RUNS = 1000000;
+        IsoTimeFormatter formatter;
+        char buff[IsoTimeFormatter::BUFFER_SIZE];
+        unsigned long check = 0;
+
+        time_t utcTime = TEST_BOOT_TIME;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < RUNS; i++)
+        {
+            check += formatter.format(utcTime, buff)[18];
+            utcTime += 60;
+        }
+        int64_t formatNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        utcTime = TEST_BOOT_TIME;
+        start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < RUNS; i++)
+        {
+            check += IsoTimeFormatter::render(utcTime, buff)[18];
+            utcTime += 60;
+        }
+        int64_t renderNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        char text[80];
+        snprintf(text, sizeof(text), "format: %.1f ns; render: %.1f ns", (double)formatNs / RUNS, (double)renderNs / RUNS);
+        TEST_MESSAGE(text);
+        TEST_ASSERT_TRUE(check > 0);
+        // A loose limit, the tests also run with sanitizers.
+        TEST_ASSERT_LESS_THAN(5000, formatNs / RUNS);
+        TEST_ASSERT_LESS_THAN(5000, renderNs / RUNS);
+    }
+}
+
+void runIsoTimeTests(){
+    RUN_TEST(test_every_day_matches_gmtime);
+    RUN_TEST(test_seconds_around_2038);
+    RUN_TEST(test_format_benchmark);
+}
@@ -0,0 +1,291 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string>
+#include "Hal.h"
+#include "Journal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "SegmentStorage.h"
+#include "Tests.h"
+
+namespace
+{
+    const char* PREFIX = "/tmp/test_native_journal";
+    const uint32_t SEGMENTS = 3;
+    const uint32_t RECORDS_PER_SEGMENT = 4;
+
+    // Count the syncs of the storage.
+    class CountingSegmentStorage : public FileSegmentStorage
+    {
+    public:
+        bool sync() override { syncs++; return FileSegmentStorage::sync(); }
+        unsigned long syncs = 0;
+    };
+
+    void removeFiles(){
+        for (uint32_t i = 0; i < SEGMENTS; i++)
+        {
+            remove((std::string(PREFIX) + "." + std::to_string(i)).c_str());
+        }
+        remove((std::string(PREFIX) + ".ack").c_str());
+    }
+
+    bool open(FileSegmentStorage& storage, Journal& journal){
+        return storage.begin(PREFIX, SEGMENTS, RECORDS_PER_SEGMENT * sizeof(Journal::Record), false) && journal.begin(&storage);
+    }
+
+    ImpulseMeterStatus status(uint8_t counterId, time_t utcTime, unsigned long impulse){
+        static const char* names[] = {"meter0", "meter1", "meter2", "meter3"};
+        ImpulseMeterStatus status = {};
+        status.utcTime = utcTime;
+        status.impulse = impulse;
+        status.sourceName = names[counterId % 4];
+        status.timerIntervallInSec = 10;
+        status.counterId = counterId;
+        return status;
+    }
+
+    void test_records_are_read_back(){
+        removeFiles();
+        FileSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        TEST_ASSERT_EQUAL(0, journal.pending());
+        TEST_ASSERT_EQUAL((SEGMENTS - 1) * RECORDS_PER_SEGMENT, journal.capacity());
+        for (unsigned long i = 0; i < 6; i++)
+        {
+            TEST_ASSERT_TRUE(journal.append(status(i % 4, TEST_BOOT_TIME + 10 * i, 100 + i)));
+        }
+        TEST_ASSERT_EQUAL(6, journal.pending());
+
+        Journal::Record record;
+        for (uint32_t seq = journal.ackSeq(); seq < journal.headSeq(); seq++)
+        {
+            TEST_ASSERT_TRUE(journal.read(seq, record));
+            ImpulseMeterStatus read = Journal::toStatus(record);
+            unsigned long i = seq - 1;
+            TEST_ASSERT_EQUAL(100 + i, read.impulse);
+            TEST_ASSERT_EQUAL(TEST_BOOT_TIME + 10 * i, read.utcTime);
+            TEST_ASSERT_EQUAL(i % 4, read.counterId);
+            TEST_ASSERT_EQUAL_STRING(status(i % 4, 0, 0).sourceName, read.sourceName);
+        }
+        journal.ack(4);
+        TEST_ASSERT_EQUAL(3, journal.pending());
+        TEST_ASSERT_FALSE(journal.read(3, record));
+        TEST_ASSERT_FALSE(journal.read(journal.headSeq(), record));
+    }
+
+    void test_crash_keeps_the_records(){
+        removeFiles();
+        {
+            FileSegmentStorage storage;
+            Journal journal;
+            TEST_ASSERT_TRUE(open(storage, journal));
+            for (unsigned long i = 0; i < 7; i++)
+            {
+                journal.append(status(0, TEST_BOOT_TIME + 10 * i, i));
+            }
+            journal.ack(3);
+            journal.storeCursor(true);
+            // Acked after the last stored cursor, so published again after the crash.
+            journal.ack(6);
+        }
+
+        FileSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        TEST_ASSERT_EQUAL(8, journal.headSeq());
+        TEST_ASSERT_EQUAL(3, journal.ackSeq());
+        // The head segment is appended after the restart.
+        TEST_ASSERT_TRUE(journal.append(status(1, TEST_BOOT_TIME + 70, 7)));
+        Journal::Record record;
+        TEST_ASSERT_TRUE(journal.read(8, record));
+        TEST_ASSERT_EQUAL(7, record.impulse);
+        TEST_ASSERT_TRUE(journal.read(7, record));
+        TEST_ASSERT_EQUAL(6, record.impulse);
+    }
+
+    void test_torn_record_ends_the_head(){
+        removeFiles();
+        {
+            FileSegmentStorage storage;
+            Journal journal;
+            TEST_ASSERT_TRUE(open(storage, journal));
+            for (unsigned long i = 0; i < 6; i++)
+            {
+                journal.append(status(0, TEST_BOOT_TIME + 10 * i, i));
+            }
+        }
+        // The power failed while the 6th record was written.
+        FILE* file = fopen((std::string(PREFIX) + ".1").c_str(), "r+b");
+        TEST_ASSERT_NOT_NULL(file);
+        fseek(file, sizeof(Journal::Record) + 20, SEEK_SET);
+        fputc(0x55, file);
+        fclose(file);
+
+        FileSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        TEST_ASSERT_EQUAL(6, journal.headSeq());
+        TEST_ASSERT_EQUAL(1, journal.ackSeq());
+        TEST_ASSERT_TRUE(journal.append(status(0, TEST_BOOT_TIME + 60, 60)));
+        Journal::Record record;
+        TEST_ASSERT_TRUE(journal.read(6, record));
+        TEST_ASSERT_EQUAL(60, record.impulse);
+    }
+
+    void test_full_ring_clears_the_oldest_segment(){
+        removeFiles();
+        {
+            FileSegmentStorage storage;
+            Journal journal;
+            TEST_ASSERT_TRUE(open(storage, journal));
+            for (unsigned long i = 0; i < 21; i++)
+            {
+                TEST_ASSERT_TRUE(journal.append(status(0, TEST_BOOT_TIME + 10 * i, i)));
+            }
+            // The head is the first record of its segment, the 2 segments before it are kept.
+            TEST_ASSERT_EQUAL(22, journal.headSeq());
+            TEST_ASSERT_EQUAL(13, journal.ackSeq());
+            TEST_ASSERT_EQUAL(12, journal.lost());
+            Journal::Record record;
+            TEST_ASSERT_TRUE(journal.read(13, record));
+            TEST_ASSERT_EQUAL(12, record.impulse);
+        }
+
+        FileSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        TEST_ASSERT_EQUAL(22, journal.headSeq());
+        TEST_ASSERT_EQUAL(13, journal.ackSeq());
+    }
+
+    void test_appends_share_a_sync(){
+        removeFiles();
+        CountingSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        for (unsigned long i = 0; i < 3; i++)
+        {
+            journal.append(status(0, TEST_BOOT_TIME + 10 * i, i));
+        }
+        unsigned long syncs = storage.syncs;
+        journal.sync(false);
+        TEST_ASSERT_EQUAL(syncs, storage.syncs);
+
+        Hal::advanceClock(Hal::micros() + 10000000);
+        journal.sync(false);
+        TEST_ASSERT_EQUAL(syncs + 1, storage.syncs);
+        journal.sync(true);
+        TEST_ASSERT_EQUAL(syncs + 1, storage.syncs);
+        journal.append(status(0, TEST_BOOT_TIME + 30, 3));
+        journal.storeCursor(true);
+        TEST_ASSERT_EQUAL(syncs + 2, storage.syncs);
+    }
+
+    // A batch which is rejected by the broker must be published again, but no record may be published twice.
+    void test_rejected_batch_is_replayed_once(){
+        removeFiles();
+        FileSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        static Logger logger;
+        static MeterNode node;
+        RecordingMqttPort port;
+        logger.begin();
+        node.begin("TEST", &port, &logger);
+        node.setJournal(&journal);
+        node.setPublishMode(MeterNode::PUBLISH_BATCH, 0);
+        node.loop();
+
+        // Three intervall ends with two counters each, every end time is a batch.
+        for (unsigned long i = 0; i < 6; i++)
+        {
+            journal.append(status(i % 2, TEST_BOOT_TIME + 10 * (i / 2), i));
+        }
+        // The second batch is rejected once.
+        port.accepted = 1;
+        port.rejected = 1;
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        TEST_ASSERT_EQUAL(1, port.payloads("Impulses/TEST").size());
+        TEST_ASSERT_EQUAL(3, journal.ackSeq());
+
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        std::vector<std::string> batches = port.payloads("Impulses/TEST");
+        TEST_ASSERT_EQUAL(3, batches.size());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:00Z\nmeter0\t10\t0\nmeter1\t10\t1", batches[0].c_str());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:10Z\nmeter0\t10\t2\nmeter1\t10\t3", batches[1].c_str());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:20Z\nmeter0\t10\t4\nmeter1\t10\t5", batches[2].c_str());
+        TEST_ASSERT_EQUAL(0, journal.pending());
+        node.setJournal(NULL);
+    }
+
+    // The batch is kept over the updates until its flush deadline, the journal is acked after it is published.
+    void test_batch_is_published_at_its_deadline(){
+        removeFiles();
+        FileSegmentStorage storage;
+        Journal journal;
+        TEST_ASSERT_TRUE(open(storage, journal));
+        static Logger logger;
+        static MeterNode node;
+        RecordingMqttPort port;
+        logger.begin();
+        node.begin("DEADLINE", &port, &logger);
+        node.setJournal(&journal);
+        node.setPublishMode(MeterNode::PUBLISH_BATCH, 5000);
+        node.loop();
+
+        // The records of the same end time are collected in one batch, also if they are added in different updates.
+        journal.append(status(0, TEST_BOOT_TIME, 1));
+        for (int second = 1; second <= 4; second++)
+        {
+            if(second == 2){
+                journal.append(status(1, TEST_BOOT_TIME, 2));
+            }
+            Hal::advanceClock(Hal::micros() + 1000000);
+            node.loop();
+            TEST_ASSERT_EQUAL(0, port.payloads("Impulses/DEADLINE").size());
+            TEST_ASSERT_EQUAL(1, journal.ackSeq());
+        }
+        Hal::advanceClock(Hal::micros() + 2000000);
+        node.loop();
+        std::vector<std::string> batches = port.payloads("Impulses/DEADLINE");
+        TEST_ASSERT_EQUAL(1, batches.size());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:00Z\nmeter0\t10\t1\nmeter1\t10\t2", batches[0].c_str());
+        TEST_ASSERT_EQUAL(3, journal.ackSeq());
+
+        // A record with a other end time publishes the batch before the deadline.
+        journal.append(status(0, TEST_BOOT_TIME + 10, 3));
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        journal.append(status(0, TEST_BOOT_TIME + 20, 4));
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        batches = port.payloads("Impulses/DEADLINE");
+        TEST_ASSERT_EQUAL(2, batches.size());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:10Z\nmeter0\t10\t3", batches[1].c_str());
+        TEST_ASSERT_EQUAL(4, journal.ackSeq());
+
+        // A change of the publish mode publishes the open batch.
+        node.setPublishMode(MeterNode::PUBLISH_SINGLE);
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        TEST_ASSERT_EQUAL(3, port.payloads("Impulses/DEADLINE").size());
+        TEST_ASSERT_EQUAL(5, journal.ackSeq());
+        TEST_ASSERT_EQUAL(0, journal.pending());
+        node.setJournal(NULL);
+    }
+}
+
+void runJournalTests(){
+    RUN_TEST(test_records_are_read_back);
+    RUN_TEST(test_crash_keeps_the_records);
+    RUN_TEST(test_torn_record_ends_the_head);
+    RUN_TEST(test_full_ring_clears_the_oldest_segment);
+    RUN_TEST(test_appends_share_a_sync);
+    RUN_TEST(test_rejected_batch_is_replayed_once);
+    RUN_TEST(test_batch_is_published_at_its_deadline);
+    removeFiles();
+}
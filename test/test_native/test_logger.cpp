@@ -0,0 +1,106 @@
+#include <unity.h>
+#include <string.h>
+#include "Logger.h"
+#include "Tests.h"
+
+namespace
+{
+    char name[] = "TEST";
+
+    void test_messages_are_published_by_level(){
+        Logger logger;
+        RecordingMqttPort port;
+        logger.begin(name, &port);
+        logger.printMessage("first %d", 1);
+        logger.printMessage("second\n");
+        logger.printError("failed %s", "now");
+        logger.printMessage("third");
+        TEST_ASSERT_EQUAL(0, port.messages.size());
+
+        logger.loop();
+        TEST_ASSERT_EQUAL(3, port.messages.size());
+        TEST_ASSERT_EQUAL_STRING("Info/TEST", port.messages[0].topic.c_str());
+        TEST_ASSERT_EQUAL_STRING("first 1\nsecond", port.messages[0].payload.c_str());
+        TEST_ASSERT_EQUAL_STRING("Error/TEST", port.messages[1].topic.c_str());
+        TEST_ASSERT_EQUAL_STRING("failed now", port.messages[1].payload.c_str());
+        TEST_ASSERT_EQUAL_STRING("third", port.messages[2].payload.c_str());
+    }
+
+    void test_debug_is_removed_at_compile_time(){
+        Logger logger;
+        RecordingMqttPort port;
+        logger.begin(name, &port);
+        size_t len = logger.printDebug("debug");
+        logger.loop();
+        TEST_ASSERT_EQUAL(LOGGER_MIN_LEVEL > LOG_LEVEL_DEBUG ? 0 : 1, port.messages.size());
+        TEST_ASSERT_EQUAL(LOGGER_MIN_LEVEL > LOG_LEVEL_DEBUG ? 0 : 5, len);
+    }
+
+    void test_debug_macro_skips_the_arguments(){
+        Logger logger;
+        RecordingMqttPort port;
+        logger.begin(name, &port);
+        int calls = 0;
+        LOGGER_DEBUG(&logger, "debug %d", ++calls);
+        TEST_ASSERT_EQUAL(LOGGER_MIN_LEVEL > LOG_LEVEL_DEBUG ? 0 : 1, calls);
+    }
+
+    void test_long_message_is_truncated(){
+        Logger logger;
+        RecordingMqttPort port;
+        logger.begin(name, &port);
+        char text[Logger::MAX_MESSAGE_LEN * 2];
+        memset(text, 'x', sizeof(text) - 1);
+        text[sizeof(text) - 1] = 0;
+        TEST_ASSERT_EQUAL(Logger::MAX_MESSAGE_LEN, logger.printMessage("%s", text));
+        TEST_ASSERT_EQUAL(1, logger.truncated());
+        logger.loop();
+        TEST_ASSERT_EQUAL(Logger::MAX_MESSAGE_LEN, port.messages[0].payload.size());
+    }
+
+    void test_full_ring_drops_and_counts(){
+        Logger logger;
+        RecordingMqttPort port;
+        logger.begin(name, &port);
+        size_t accepted = 0;
+        for (int i = 0; i < 100; i++)
+        {
+            accepted += logger.printMessage("message %d", i) > 0;
+        }
+        TEST_ASSERT_EQUAL(100 - accepted, logger.dropped());
+        TEST_ASSERT_GREATER_THAN(0, logger.dropped());
+
+        logger.loop();
+        size_t lines = 0;
+        for (const RecordingMqttPort::Message& message : port.messages)
+        {
+            lines++;
+            for (char c : message.payload)
+            {
+                lines += c == '\n';
+            }
+        }
+        TEST_ASSERT_EQUAL(accepted, lines);
+    }
+
+    void test_disconnected_writes_only_serial(){
+        Logger logger;
+        RecordingMqttPort port;
+        port.connected = false;
+        logger.begin(name, &port);
+        logger.printError("lost");
+        logger.loop();
+        port.connected = true;
+        logger.loop();
+        TEST_ASSERT_EQUAL(0, port.messages.size());
+    }
+}
+
+void runLoggerTests(){
+    RUN_TEST(test_messages_are_published_by_level);
+    RUN_TEST(test_debug_is_removed_at_compile_time);
+    RUN_TEST(test_debug_macro_skips_the_arguments);
+    RUN_TEST(test_long_message_is_truncated);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_disconnected_writes_only_serial);
+}
@@ -0,0 +1,37 @@
+#include <unity.h>
+#include "Hal.h"
+#include "Tests.h"
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+int main(){
+    // All timers are created after this, so they run deterministic in advanceClock().
+    Hal::simulateClock(TEST_BOOT_TIME);
+
+    UNITY_BEGIN();
+    runImpulseMeterTests();
+    runLoggerTests();
+    runSchedulerTests();
+    runStormGuardTests();
+    runSpscQueueTests();
+    runMpscQueueTests();
+    runPcntAccumulatorTests();
+    runJournalTests();
+    runMqttHandoffTests();
+    runIsoTimeTests();
+    runClockAnchorTests();
+    runExpanderBankTests();
+    runPackedFormatTests();
+    runMeterTotalsTests();
+    runRollupTests();
+    runReportPolicyTests();
+    runRateEstimatorTests();
+    runHeapTests();
+    // Installs counters of the MeterNode, which stay until the end.
+    runCommandParserTests();
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#include <unity.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "Hal.h"
+#include "MeterTotals.h"
+#include "Tests.h"
+
+namespace
+{
+    // Storage in memory, which counts the writes per slot.
+    class CountingStorage : public JournalStorage
+    {
+    public:
+        bool readData(uint32_t offset, void* buff, size_t len) override {
+            if(offset + len > data.size()){
+                return false;
+            }
+            memcpy(buff, &data[offset], len);
+            return true;
+        }
+
+        bool writeData(uint32_t offset, const void* buff, size_t len) override {
+            if(offset + len > data.size()){
+                data.resize(offset + len, 0);
+            }
+            memcpy(&data[offset], buff, len);
+            uint32_t slot = offset / sizeof(MeterTotals::Checkpoint);
+            if(slot >= slotWrites.size()){
+                slotWrites.resize(slot + 1, 0);
+            }
+            slotWrites[slot]++;
+            return true;
+        }
+
+        bool readCursor(void* /*buff*/, size_t /*len*/) override { return false; }
+        bool writeCursor(const void* /*buff*/, size_t /*len*/) override { return false; }
+
+        std::vector<uint8_t> data;
+        std::vector<unsigned long> slotWrites;
+    };
+
+    // Four weeks of updates every minute with a restart every week: the restored totals are right and the checkpoints
+    // are spread over the slots. LittleFS erases a data block and the metadata pair per checkpoint, with the wear
+    // leveling over 200 free blocks of 100000 cycles the flash must last at least 10 years.
+    void test_checkpoints_survive_restarts(){
+        const int DAYS = 28;
+        const int UPDATE_PERIOD_IN_SEC = 60;
+        const int RESTART_PERIOD_IN_DAYS = 7;
+        const double FREE_BLOCKS = 200;
+        const double ERASE_CYCLES = 100000;
+        static CountingStorage storage;
+        static MeterTotals totals;
+        TEST_ASSERT_TRUE(totals.begin(&storage, MeterTotals::DEFAULT_SLOTS, MeterTotals::DEFAULT_MIN_PERIOD_IN_SEC));
+
+        uint64_t expected[MAX_COUNTERS] = {0};
+        unsigned long writes = 0;
+        int64_t startUs = Hal::micros();
+        const int updates = DAYS * 24 * 3600 / UPDATE_PERIOD_IN_SEC;
+        for (int update = 1; update <= updates; update++)
+        {
+            Hal::advanceClock(startUs + (int64_t)update * UPDATE_PERIOD_IN_SEC * 1000000);
+            for (int i = 0; i < MAX_COUNTERS; i++)
+            {
+                // Different impulse rates, some counters are idle most of the time.
+                unsigned long impulse = (update + i) % (i + 1) == 0 ? i + 1 : 0;
+                totals.add(i, impulse);
+                expected[i] += impulse;
+            }
+            TEST_ASSERT_TRUE(totals.checkpoint(false));
+
+            if(update % (RESTART_PERIOD_IN_DAYS * 24 * 3600 / UPDATE_PERIOD_IN_SEC) == 0){
+                TEST_ASSERT_TRUE(totals.checkpoint(true));
+                // A second forced checkpoint without new impulses, e.g. by the shutdown handler, writes nothing.
+                unsigned long written = totals.writes();
+                TEST_ASSERT_TRUE(totals.checkpoint(true));
+                TEST_ASSERT_EQUAL(written, totals.writes());
+                writes += totals.writes();
+                TEST_ASSERT_TRUE(totals.begin(&storage, MeterTotals::DEFAULT_SLOTS, MeterTotals::DEFAULT_MIN_PERIOD_IN_SEC));
+                TEST_ASSERT_EQUAL(Hal::utcTime(), totals.restoredTime());
+                for (int i = 0; i < MAX_COUNTERS; i++)
+                {
+                    TEST_ASSERT_EQUAL_UINT64(expected[i], totals.total(i));
+                }
+            }
+        }
+        writes += totals.writes();
+
+        TEST_ASSERT_EQUAL(MeterTotals::DEFAULT_SLOTS, storage.slotWrites.size());
+        unsigned long minSlotWrites = writes;
+        unsigned long maxSlotWrites = 0;
+        unsigned long slotWrites = 0;
+        for (unsigned long written : storage.slotWrites)
+        {
+            minSlotWrites = written < minSlotWrites ? written : minSlotWrites;
+            maxSlotWrites = written > maxSlotWrites ? written : maxSlotWrites;
+            slotWrites += written;
+        }
+        TEST_ASSERT_EQUAL(writes, slotWrites);
+        TEST_ASSERT_LESS_OR_EQUAL(1, maxSlotWrites - minSlotWrites);
+        // At most one checkpoint per min. period and one per restart.
+        TEST_ASSERT_LESS_OR_EQUAL(DAYS * 24 * 4 + DAYS / RESTART_PERIOD_IN_DAYS, writes);
+        double erasesPerBlockAndYear = writes * 365.0 / DAYS * 2 / FREE_BLOCKS;
+        TEST_ASSERT_TRUE(ERASE_CYCLES / erasesPerBlockAndYear >= 10);
+    }
+
+    // A checkpoint which was torn by a power fail is skipped, the previous one is restored.
+    void test_broken_checkpoint_restores_the_previous(){
+        static CountingStorage storage;
+        static MeterTotals totals;
+        TEST_ASSERT_TRUE(totals.begin(&storage, 4, 0));
+        totals.add(3, 10);
+        TEST_ASSERT_TRUE(totals.checkpoint(true));
+        totals.add(3, 5);
+        TEST_ASSERT_TRUE(totals.checkpoint(true));
+        // The second checkpoint has seq 2 and is in slot 2.
+        storage.data[2 * sizeof(MeterTotals::Checkpoint) + offsetof(MeterTotals::Checkpoint, totals)] ^= 0x01;
+
+        TEST_ASSERT_TRUE(totals.begin(&storage, 4, 0));
+        TEST_ASSERT_EQUAL_UINT64(10, totals.total(3));
+        TEST_ASSERT_EQUAL_UINT64(10, totals.restoredOverAll());
+        // The next checkpoint overwrites the broken one.
+        totals.add(3, 1);
+        TEST_ASSERT_TRUE(totals.checkpoint(true));
+        TEST_ASSERT_EQUAL(2, storage.slotWrites[2]);
+    }
+}
+
+void runMeterTotalsTests(){
+    RUN_TEST(test_checkpoints_survive_restarts);
+    RUN_TEST(test_broken_checkpoint_restores_the_previous);
+}
@@ -0,0 +1,127 @@
+#include <unity.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "MpscQueue.h"
+#include "Tests.h"
+
+namespace
+{
+    void test_empty_queue(){
+        MpscQueue<int, 4> queue;
+        int item = -1;
+        TEST_ASSERT_TRUE(queue.empty());
+        TEST_ASSERT_FALSE(queue.pop(item));
+        TEST_ASSERT_EQUAL(-1, item);
+        TEST_ASSERT_EQUAL(0, queue.size());
+    }
+
+    void test_full_queue_rejects_and_counts(){
+        MpscQueue<int, 4> queue;
+        for (int i = 0; i < 4; i++)
+        {
+            TEST_ASSERT_TRUE(queue.push(i));
+        }
+        TEST_ASSERT_FALSE(queue.push(4));
+        TEST_ASSERT_FALSE(queue.push(5));
+        TEST_ASSERT_EQUAL(2, queue.overflows());
+        TEST_ASSERT_EQUAL(4, queue.size());
+        TEST_ASSERT_EQUAL(4, queue.highWater());
+
+        int item;
+        for (int i = 0; i < 4; i++)
+        {
+            TEST_ASSERT_TRUE(queue.pop(item));
+            TEST_ASSERT_EQUAL(i, item);
+        }
+        TEST_ASSERT_TRUE(queue.push(6));
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL(6, item);
+        TEST_ASSERT_EQUAL(2, queue.overflows());
+    }
+
+    void test_wraparound_keeps_the_order(){
+        MpscQueue<uint32_t, 8> queue;
+        uint32_t next = 0;
+        uint32_t expected = 0;
+        for (int round = 0; round < 1000; round++)
+        {
+            size_t fill = round % 8 + 1;
+            for (size_t i = 0; i < fill; i++)
+            {
+                TEST_ASSERT_TRUE(queue.push(next++));
+            }
+            TEST_ASSERT_EQUAL(fill, queue.size());
+            uint32_t item;
+            while (queue.pop(item))
+            {
+                TEST_ASSERT_EQUAL(expected, item);
+                expected++;
+            }
+        }
+        TEST_ASSERT_EQUAL(next, expected);
+        TEST_ASSERT_EQUAL(0, queue.overflows());
+        TEST_ASSERT_EQUAL(8, queue.highWater());
+    }
+
+    // Four producer threads like the tasks which write log messages. The consumer must get every item once
+    // and the items of each producer in order.
+    void test_many_producers_keep_every_item(){
+        const uint32_t PRODUCERS = 4;
+        const uint32_t ITEMS = 500000;
+        static MpscQueue<uint64_t, 16> queue;
+        std::vector<std::thread> producers;
+        for (uint32_t producer = 0; producer < PRODUCERS; producer++)
+        {
+            producers.emplace_back([producer]{
+                for (uint32_t i = 1; i <= ITEMS; i++)
+                {
+                    // The item has the producer and a check value, so a torn read is detected.
+                    uint64_t item = (uint64_t)i << 32 | producer << 24 | (~i & 0xFFFFFF);
+                    while (!queue.push(item))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        uint32_t expected[PRODUCERS] = {1, 1, 1, 1};
+        unsigned long errors = 0;
+        uint32_t received = 0;
+        while (received < PRODUCERS * ITEMS)
+        {
+            uint64_t item;
+            if (!queue.pop(item))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t value = (uint32_t)(item >> 32);
+            uint32_t producer = (uint32_t)item >> 24;
+            if (producer >= PRODUCERS)
+            {
+                errors++;
+                break;
+            }
+            errors += value != expected[producer] || ((uint32_t)item & 0xFFFFFF) != (~value & 0xFFFFFF);
+            expected[producer] = value + 1;
+            received++;
+        }
+        for (std::thread& producer : producers)
+        {
+            producer.join();
+        }
+
+        TEST_ASSERT_EQUAL(0, errors);
+        TEST_ASSERT_TRUE(queue.empty());
+        TEST_ASSERT_LESS_OR_EQUAL(16, queue.highWater());
+    }
+}
+
+void runMpscQueueTests(){
+    RUN_TEST(test_empty_queue);
+    RUN_TEST(test_full_queue_rejects_and_counts);
+    RUN_TEST(test_wraparound_keeps_the_order);
+    RUN_TEST(test_many_producers_keep_every_item);
+}
@@ -0,0 +1,257 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include "Hal.h"
+#include "Journal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "MqttHandoff.h"
+#include "SpscByteRing.h"
+#include "Tests.h"
+
+namespace
+{
+    // Write a entry with the value in every byte, the length is taken from the value.
+    bool pushEntry(SpscByteRing<256>& ring, uint8_t value){
+        size_t len = value % 50 + 1;
+        uint8_t* entry = ring.reserve(len);
+        if (entry == NULL)
+        {
+            return false;
+        }
+        memset(entry, value, len);
+        ring.commit();
+        return true;
+    }
+
+    bool checkEntry(const uint8_t* entry, size_t len, uint8_t value){
+        if (len != value % 50 + 1u)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < len; i++)
+        {
+            if (entry[i] != value)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void test_byte_ring_wraps_around(){
+        SpscByteRing<256> ring;
+        uint8_t next = 0;
+        uint8_t expected = 0;
+        for (int round = 0; round < 1000; round++)
+        {
+            // Fill the ring until it is full, the entries have different lengths.
+            while (pushEntry(ring, next))
+            {
+                next++;
+            }
+            // A full ring holds at least two of the longest entries, also after the skipped rest of the buffer.
+            TEST_ASSERT_TRUE(ring.size() >= 2);
+            for (int i = 0; i <= round % 2; i++)
+            {
+                size_t len;
+                uint8_t* entry = ring.front(len);
+                TEST_ASSERT_NOT_NULL(entry);
+                TEST_ASSERT_TRUE(checkEntry(entry, len, expected));
+                ring.drop();
+                expected++;
+            }
+        }
+        size_t len;
+        uint8_t* entry;
+        while ((entry = ring.front(len)) != NULL)
+        {
+            TEST_ASSERT_TRUE(checkEntry(entry, len, expected));
+            ring.drop();
+            expected++;
+        }
+        TEST_ASSERT_EQUAL(next, expected);
+        TEST_ASSERT_TRUE(ring.empty());
+        TEST_ASSERT_EQUAL(1000, ring.overflows());
+        TEST_ASSERT_NULL(ring.reserve(256));
+    }
+
+    void test_byte_ring_two_threads(){
+        const uint32_t ENTRIES = 500000;
+        static SpscByteRing<1024> ring;
+        std::thread producer([]{
+            for (uint32_t i = 0; i < ENTRIES; i++)
+            {
+                size_t len = i % 61 + sizeof(uint32_t) + 1;
+                uint8_t* entry;
+                while ((entry = ring.reserve(len)) == NULL)
+                {
+                    std::this_thread::yield();
+                }
+                memcpy(entry, &i, sizeof(i));
+                memset(entry + sizeof(i), (uint8_t)i, len - sizeof(i));
+                ring.commit();
+            }
+        });
+
+        unsigned long errors = 0;
+        for (uint32_t expected = 0; expected < ENTRIES;)
+        {
+            size_t len;
+            uint8_t* entry = ring.front(len);
+            if (entry == NULL)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t value;
+            memcpy(&value, entry, sizeof(value));
+            errors += value != expected || len != expected % 61 + sizeof(uint32_t) + 1 || entry[len - 1] != (uint8_t)expected;
+            ring.drop();
+            expected++;
+        }
+        producer.join();
+        TEST_ASSERT_EQUAL(0, errors);
+        TEST_ASSERT_TRUE(ring.empty());
+    }
+
+    // The messages of one loop() of the MeterNode fit into the ring, also if the network task is not running.
+    void test_handoff_holds_the_messages_of_a_loop(){
+        static MqttHandoff handoff;
+        RecordingMqttPort port;
+        handoff.begin(&port);
+        size_t messages = MeterNode::maxLoopMessages();
+        size_t len = MeterNode::maxLoopLen() / messages;
+        std::string topic(len / 3 < MqttPort::MAX_TOPIC_LEN ? len / 3 : MqttPort::MAX_TOPIC_LEN, 't');
+        std::string payload(len - topic.size(), 'p');
+        for (size_t i = 0; i < messages; i++)
+        {
+            TEST_ASSERT_TRUE(handoff.publish(topic.c_str(), payload.c_str()));
+        }
+        TEST_ASSERT_EQUAL(0, handoff.stats().outboundOverflows);
+        handoff.forward();
+        TEST_ASSERT_EQUAL(messages, port.messages.size());
+        TEST_ASSERT_EQUAL_STRING(payload.c_str(), port.messages.back().payload.c_str());
+    }
+
+    void test_handoff_keeps_messages_until_connected(){
+        static MqttHandoff handoff;
+        RecordingMqttPort port;
+        handoff.begin(&port);
+        TEST_ASSERT_TRUE(handoff.publish("topic", "first"));
+        uint32_t ticket = handoff.lastTicket();
+        TEST_ASSERT_EQUAL(MqttPort::PENDING, handoff.delivery(ticket));
+
+        port.connected = false;
+        handoff.forward();
+        TEST_ASSERT_EQUAL(MqttPort::PENDING, handoff.delivery(ticket));
+        TEST_ASSERT_FALSE(handoff.publish("topic", "second"));
+
+        port.connected = true;
+        handoff.forward();
+        TEST_ASSERT_EQUAL(MqttPort::DELIVERED, handoff.delivery(ticket));
+        TEST_ASSERT_EQUAL(1, port.messages.size());
+        TEST_ASSERT_EQUAL(0, handoff.stats().outboundRejected);
+    }
+
+    void test_handoff_drops_rejected_messages(){
+        static MqttHandoff handoff;
+        RecordingMqttPort port;
+        handoff.begin(&port);
+        port.accepted = 1;
+        port.rejected = 1;
+        uint32_t tickets[3];
+        for (int i = 0; i < 3; i++)
+        {
+            TEST_ASSERT_TRUE(handoff.publish("topic", std::to_string(i).c_str()));
+            tickets[i] = handoff.lastTicket();
+        }
+        handoff.forward();
+        TEST_ASSERT_EQUAL(MqttPort::DELIVERED, handoff.delivery(tickets[0]));
+        TEST_ASSERT_EQUAL(MqttPort::REJECTED, handoff.delivery(tickets[1]));
+        TEST_ASSERT_EQUAL(MqttPort::DELIVERED, handoff.delivery(tickets[2]));
+        TEST_ASSERT_EQUAL(2, port.messages.size());
+        TEST_ASSERT_EQUAL(1, handoff.stats().outboundRejected);
+        TEST_ASSERT_FALSE(handoff.pending());
+    }
+
+    // A received message longer than MAX_PAYLOAD_LEN is dropped and counted, not truncated, the longest one is dispatched.
+    void test_handoff_drops_too_long_received_messages(){
+        static MqttHandoff handoff;
+        static Logger logger;
+        RecordingMqttPort port;
+        logger.begin();
+        handoff.begin(&port, &logger);
+        std::vector<std::string> received;
+        TEST_ASSERT_TRUE(handoff.subscribe("command", [&received](const char* message) { received.push_back(message); }));
+        std::string longest(MqttHandoff::MAX_PAYLOAD_LEN, 'm');
+        port.receive("command", (longest + "x").c_str());
+        port.receive("command", longest.c_str());
+        handoff.dispatch();
+        TEST_ASSERT_EQUAL(1, received.size());
+        TEST_ASSERT_EQUAL(longest.size(), received[0].size());
+        TEST_ASSERT_EQUAL(1, handoff.stats().inboundTooLong);
+        TEST_ASSERT_EQUAL(0, handoff.stats().inboundOverflows);
+    }
+
+    // The journal is acked when the network task delivered the records, not when they are queued.
+    void test_journal_is_acked_after_delivery(){
+        static RamSegmentStorage<3, 4 * sizeof(Journal::Record)> storage;
+        static Journal journal;
+        static MqttHandoff handoff;
+        static Logger logger;
+        static MeterNode node;
+        RecordingMqttPort port;
+        TEST_ASSERT_TRUE(journal.begin(&storage));
+        handoff.begin(&port);
+        logger.begin();
+        node.begin("TEST", &handoff, &logger);
+        node.setJournal(&journal);
+        node.loop();
+        handoff.forward();
+        for (unsigned long i = 0; i < 3; i++)
+        {
+            ImpulseMeterStatus status = {};
+            status.utcTime = TEST_BOOT_TIME + 10 * i;
+            status.impulse = i;
+            status.sourceName = "meter0";
+            status.timerIntervallInSec = 10;
+            journal.append(status);
+        }
+
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        TEST_ASSERT_EQUAL(1, journal.ackSeq());
+        TEST_ASSERT_TRUE(handoff.pending());
+
+        // The second record is rejected, so it is published again with the third one.
+        port.accepted = 1;
+        port.rejected = 1;
+        handoff.forward();
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        TEST_ASSERT_EQUAL(2, journal.ackSeq());
+        handoff.forward();
+        Hal::advanceClock(Hal::micros() + 1000000);
+        node.loop();
+        TEST_ASSERT_EQUAL(4, journal.ackSeq());
+
+        std::vector<std::string> payloads = port.payloads("meter0");
+        TEST_ASSERT_EQUAL(4, payloads.size());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:10Z\t1", payloads[2].c_str());
+        TEST_ASSERT_EQUAL_STRING("2021-01-01T00:00:20Z\t2", payloads[3].c_str());
+        node.setJournal(NULL);
+    }
+}
+
+void runMqttHandoffTests(){
+    RUN_TEST(test_byte_ring_wraps_around);
+    RUN_TEST(test_byte_ring_two_threads);
+    RUN_TEST(test_handoff_holds_the_messages_of_a_loop);
+    RUN_TEST(test_handoff_keeps_messages_until_connected);
+    RUN_TEST(test_handoff_drops_rejected_messages);
+    RUN_TEST(test_handoff_drops_too_long_received_messages);
+    RUN_TEST(test_journal_is_acked_after_delivery);
+}
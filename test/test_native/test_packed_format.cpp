@@ -0,0 +1,143 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "IntervallBatch.h"
+#include "PackedFormat.h"
+#include "Tests.h"
+
+namespace
+{
+    // The golden vectors, the expected texts are computed independently from the layout in PackedFormat.h.
+    // They are the contract with the consumers, a change of the layout must change PackedEncoder::VERSION.
+    struct IntervallVector
+    {
+        const char* name;
+        time_t baseTime;
+        std::vector<ImpulseMeterStatus> records;
+        const char* expected;
+    };
+
+    struct ValueVector
+    {
+        const char* name;
+        PackedEncoder::Type type;
+        time_t baseTime;
+        std::vector<uint64_t> values;
+        const char* expected;
+    };
+
+    ImpulseMeterStatus record(uint8_t counterId, time_t utcTime, unsigned int intervall, unsigned long impulse){
+        return {utcTime, impulse, "Wire/Counter", intervall, counterId, 0};
+    }
+
+    const IntervallVector INTERVALL_VECTORS[] = {
+        {"single", 1609459260, {record(3, 1609459260, 60, 42)}, "AQG8zLn/BQMAPFQ="},
+        {"batch", 1609459260, {record(0, 1609459260, 60, 100), record(1, 1609459260, 60, 105), record(2, 1609459260, 60, 0)},
+            "AQG8zLn/BQAAPMgBAQA80gECADwA"},
+        {"journal", 1609459320, {record(MAX_COUNTERS, 1609459320, 10, 7)}, "AQH4zLn/Bf8BAAoO"},
+        {"deltas", 1609459800, {record(1, 1609459800, 600, 1000), record(1, 1609460400, 600, 990), record(1, 1609459200, 600, 1200)},
+            "AQHY0Ln/BQEA2ATQDwGwCdgEEwHfEtgEpAM="},
+    };
+
+    const ValueVector VALUE_VECTORS[] = {
+        {"status", PackedEncoder::TYPE_STATUS, 1609462800, {1609459200, 3, 12345, 1000000, 987655, 1609455600}, "AQKQ6Ln/BYDMuf8FA7lgwIQ9h6Q88K+5/wU="},
+        {"totals", PackedEncoder::TYPE_TOTALS, 1609462800, {0, 5000000000ULL, 7, 0}, "AQOQ6Ln/BQCA5JfQEgcA"},
+    };
+
+    void test_intervalls_match_golden_vectors(){
+        for (const IntervallVector& vector : INTERVALL_VECTORS)
+        {
+            PackedEncoder encoder;
+            char text[IntervallBatch::MAX_PAYLOAD_SIZE];
+            encoder.begin(PackedEncoder::TYPE_INTERVALLS, vector.baseTime);
+            for (const ImpulseMeterStatus& status : vector.records)
+            {
+                encoder.addIntervall(status);
+            }
+            TEST_ASSERT_TRUE_MESSAGE(encoder.encode(text, sizeof(text)) > 0, vector.name);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(vector.expected, text, vector.name);
+
+            PackedDecoder decoder;
+            PackedDecoder::Intervall intervall;
+            size_t count = 0;
+            TEST_ASSERT_TRUE_MESSAGE(decoder.begin(vector.expected), vector.name);
+            TEST_ASSERT_EQUAL_MESSAGE(PackedEncoder::TYPE_INTERVALLS, decoder.type(), vector.name);
+            TEST_ASSERT_EQUAL_MESSAGE(vector.baseTime, decoder.baseTime(), vector.name);
+            while (decoder.next(intervall))
+            {
+                TEST_ASSERT_LESS_THAN_MESSAGE(vector.records.size(), count, vector.name);
+                const ImpulseMeterStatus& status = vector.records[count++];
+                uint8_t counterId = status.counterId < MAX_COUNTERS ? status.counterId : PackedEncoder::UNKNOWN_COUNTER_ID;
+                TEST_ASSERT_EQUAL_MESSAGE(counterId, intervall.counterId, vector.name);
+                TEST_ASSERT_EQUAL_MESSAGE(status.utcTime, intervall.utcTime, vector.name);
+                TEST_ASSERT_EQUAL_MESSAGE(status.timerIntervallInSec, intervall.timerIntervallInSec, vector.name);
+                TEST_ASSERT_EQUAL_MESSAGE(status.impulse, intervall.impulse, vector.name);
+            }
+            TEST_ASSERT_FALSE_MESSAGE(decoder.error(), vector.name);
+            TEST_ASSERT_EQUAL_MESSAGE(vector.records.size(), count, vector.name);
+        }
+    }
+
+    void test_values_match_golden_vectors(){
+        for (const ValueVector& vector : VALUE_VECTORS)
+        {
+            PackedEncoder encoder;
+            char text[IntervallBatch::MAX_PAYLOAD_SIZE];
+            encoder.begin(vector.type, vector.baseTime);
+            for (uint64_t value : vector.values)
+            {
+                encoder.addValue(value);
+            }
+            TEST_ASSERT_TRUE_MESSAGE(encoder.encode(text, sizeof(text)) > 0, vector.name);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(vector.expected, text, vector.name);
+
+            PackedDecoder decoder;
+            uint64_t value;
+            size_t count = 0;
+            TEST_ASSERT_TRUE_MESSAGE(decoder.begin(vector.expected), vector.name);
+            TEST_ASSERT_EQUAL_MESSAGE(vector.type, decoder.type(), vector.name);
+            TEST_ASSERT_EQUAL_MESSAGE(vector.baseTime, decoder.baseTime(), vector.name);
+            while (decoder.next(value))
+            {
+                TEST_ASSERT_LESS_THAN_MESSAGE(vector.values.size(), count, vector.name);
+                TEST_ASSERT_EQUAL_UINT64_MESSAGE(vector.values[count++], value, vector.name);
+            }
+            TEST_ASSERT_FALSE_MESSAGE(decoder.error(), vector.name);
+            TEST_ASSERT_EQUAL_MESSAGE(vector.values.size(), count, vector.name);
+        }
+    }
+
+    // The CounterIds on the wire don´t depend on the build, e.g. a node with ExpanderBanks has more counters.
+    void test_counter_ids_of_other_builds_are_decoded(){
+        PackedDecoder decoder;
+        PackedDecoder::Intervall intervall;
+        TEST_ASSERT_TRUE(decoder.begin("AQH4zLn/BWQACg4="));
+        TEST_ASSERT_TRUE(decoder.next(intervall));
+        TEST_ASSERT_EQUAL(100, intervall.counterId);
+        TEST_ASSERT_EQUAL(7, intervall.impulse);
+        TEST_ASSERT_FALSE(decoder.next(intervall));
+        TEST_ASSERT_FALSE(decoder.error());
+    }
+
+    // Broken payloads must be rejected, not decoded into wrong numbers.
+    void test_broken_payloads_are_rejected(){
+        const char* broken[] = {"", "AQG8zLn/BQMAPF", "AQG8zLn/BQMAPF=Q", "AgG8zLn/BQMAPFQ=", "AQG8zLn/BQMAPA==", "AQG8zLn/BQ!APFQ=", "AQH4zLn/BYACAAoO"};
+        for (const char* text : broken)
+        {
+            PackedDecoder decoder;
+            PackedDecoder::Intervall intervall;
+            bool decoded = decoder.begin(text);
+            while (decoded && decoder.next(intervall))
+            {
+            }
+            TEST_ASSERT_TRUE_MESSAGE(!decoded || decoder.error(), text);
+        }
+    }
+}
+
+void runPackedFormatTests(){
+    RUN_TEST(test_intervalls_match_golden_vectors);
+    RUN_TEST(test_values_match_golden_vectors);
+    RUN_TEST(test_counter_ids_of_other_builds_are_decoded);
+    RUN_TEST(test_broken_payloads_are_rejected);
+}
@@ -0,0 +1,151 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "FakePcntUnit.h"
+#include "PcntAccumulator.h"
+#include "Tests.h"
+
+namespace
+{
+    // The limit of the PcntImpulseSource, the max. of the 16 bit counter.
+    const int16_t LIMIT = 32767;
+
+    void test_counter_wraps_at_the_limit(){
+        PcntAccumulator accumulator(LIMIT);
+        FakePcntUnit unit(LIMIT, accumulator);
+        auto read = [&unit]() { return unit.read(); };
+
+        unit.count(LIMIT - 1);
+        TEST_ASSERT_EQUAL(LIMIT - 1, unit.read());
+        TEST_ASSERT_EQUAL(LIMIT - 1, accumulator.take(read));
+        unit.count(1);
+        TEST_ASSERT_EQUAL(0, unit.read());
+        TEST_ASSERT_EQUAL(LIMIT, accumulator.total(read));
+        TEST_ASSERT_EQUAL(1, accumulator.take(read));
+        unit.count(LIMIT + 10);
+        TEST_ASSERT_EQUAL(2 * LIMIT + 10, accumulator.total(read));
+        TEST_ASSERT_EQUAL(LIMIT + 10, accumulator.take(read));
+        TEST_ASSERT_EQUAL(0, accumulator.take(read));
+    }
+
+    void test_pending_interrupt_is_counted_once(){
+        PcntAccumulator accumulator(LIMIT);
+        FakePcntUnit unit(LIMIT, accumulator);
+        auto read = [&unit]() { return unit.read(); };
+
+        unit.count(LIMIT - 2);
+        TEST_ASSERT_EQUAL(LIMIT - 2, accumulator.take(read));
+        // The hardware reset the counter, but the ISR didn´t run yet.
+        unit.count(5, false);
+        TEST_ASSERT_EQUAL(1, unit.pendingInterrupts());
+        TEST_ASSERT_EQUAL(3, unit.read());
+        TEST_ASSERT_EQUAL(5, accumulator.take(read));
+        TEST_ASSERT_EQUAL(0, accumulator.take(read));
+        unit.handleInterrupts();
+        TEST_ASSERT_EQUAL(0, accumulator.take(read));
+        unit.count(7);
+        TEST_ASSERT_EQUAL(7, accumulator.take(read));
+    }
+
+    void test_interrupt_during_the_read_is_seen(){
+        PcntAccumulator accumulator(LIMIT);
+        FakePcntUnit unit(LIMIT, accumulator);
+        unit.count(LIMIT - 1);
+        TEST_ASSERT_EQUAL(LIMIT - 1, accumulator.take([&unit]() { return unit.read(); }));
+
+        // The counter wraps and the ISR runs between the reads of the limit events and of the counter.
+        int reads = 0;
+        unsigned long impulse = accumulator.take([&unit, &reads]() {
+            if (reads++ == 0)
+            {
+                unit.count(LIMIT + 3);
+            }
+            return unit.read();
+        });
+        TEST_ASSERT_EQUAL(2, reads);
+        TEST_ASSERT_EQUAL(LIMIT + 3, impulse);
+    }
+
+    void test_total_is_not_cut_at_32_bit(){
+        PcntAccumulator accumulator(LIMIT);
+        FakePcntUnit unit(LIMIT, accumulator);
+        auto read = [&unit]() { return unit.read(); };
+        uint64_t expected = 0;
+        unsigned long taken = 0;
+        // Take the impulses in steps shorter than the limit, like the intervalls do.
+        for (int i = 0; i < 200000; i++)
+        {
+            uint32_t impulses = LIMIT - 1 - i % 1000;
+            unit.count(impulses, i % 3 != 0);
+            expected += impulses;
+            taken += accumulator.take(read);
+            unit.handleInterrupts();
+        }
+        TEST_ASSERT_GREATER_THAN(UINT32_MAX, expected);
+        TEST_ASSERT_EQUAL_UINT64(expected, accumulator.total(read));
+        TEST_ASSERT_EQUAL((unsigned long)expected, taken);
+    }
+
+    // The hardware counts in a own thread and runs the ISR some time after the reset, the counting task takes the
+    // impulses at the same time. Every impulse must be taken once.
+    void test_take_races_the_counter(){
+        const uint64_t IMPULSES = 200ULL * LIMIT;
+        PcntAccumulator accumulator(LIMIT);
+        FakePcntUnit unit(LIMIT, accumulator);
+        std::atomic<uint64_t> takenTotal{0};
+        std::atomic<bool> done{false};
+
+        std::thread hardware([&]{
+            uint64_t counted = 0;
+            uint32_t step = 1;
+            while (counted < IMPULSES)
+            {
+                uint32_t impulses = (uint32_t)std::min<uint64_t>(step, IMPULSES - counted);
+                unit.count(impulses, false);
+                counted += impulses;
+                if (step % 3 != 0)
+                {
+                    std::this_thread::yield();
+                }
+                unit.handleInterrupts();
+                step = step % 997 + 1;
+                // take() must run at least once while the counter runs to the limit, like the intervall timer does.
+                while (counted - takenTotal.load() > LIMIT / 2)
+                {
+                    std::this_thread::yield();
+                }
+            }
+            done = true;
+        });
+
+        unsigned long errors = 0;
+        uint64_t taken = 0;
+        uint64_t lastTotal = 0;
+        auto read = [&unit]() { return unit.read(); };
+        while (!done.load() || taken < IMPULSES)
+        {
+            taken += accumulator.take(read);
+            uint64_t total = accumulator.total(read);
+            errors += total < lastTotal || total < taken;
+            lastTotal = total;
+            takenTotal = taken;
+            if (done.load() && taken > IMPULSES)
+            {
+                break;
+            }
+        }
+        hardware.join();
+
+        TEST_ASSERT_EQUAL(0, errors);
+        TEST_ASSERT_EQUAL_UINT64(IMPULSES, taken);
+        TEST_ASSERT_EQUAL(0, accumulator.take(read));
+    }
+}
+
+void runPcntAccumulatorTests(){
+    RUN_TEST(test_counter_wraps_at_the_limit);
+    RUN_TEST(test_pending_interrupt_is_counted_once);
+    RUN_TEST(test_interrupt_during_the_read_is_seen);
+    RUN_TEST(test_total_is_not_cut_at_32_bit);
+    RUN_TEST(test_take_races_the_counter);
+}
@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Hal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "RateEstimator.h"
+#include "Tests.h"
+
+namespace
+{
+    const uint32_t SECOND_US = 1000000;
+    const uint32_t STOPPED_US = 15 * 60 * SECOND_US + 1;
+
+    // Add impulses every periodUs after the last one, returns the time of the last impulse.
+    uint32_t addPulses(RateEstimator& estimator, PulseTimestamp& pulse, uint32_t periodUs, int count){
+        for (int i = 0; i < count; i++)
+        {
+            pulse.timeUs += periodUs;
+            pulse.sequence++;
+            estimator.add(pulse);
+        }
+        return pulse.timeUs;
+    }
+
+    // One impulse per second is 3600 impulses per hour, also across the wrap around of the time stamps.
+    void test_steady_rate(){
+        RateEstimator estimator;
+        estimator.reset();
+        TEST_ASSERT_EQUAL_FLOAT(0, estimator.rate(0));
+        PulseTimestamp pulse = {0xFFFFFFFF - 5 * SECOND_US, 0};
+        estimator.add(pulse);
+        TEST_ASSERT_EQUAL_FLOAT(0, estimator.rate(pulse.timeUs));
+        uint32_t lastUs = addPulses(estimator, pulse, SECOND_US, 10);
+        TEST_ASSERT_EQUAL_FLOAT(3600, estimator.rate(lastUs + SECOND_US / 2));
+        TEST_ASSERT_EQUAL_FLOAT(3600, estimator.minRate());
+        TEST_ASSERT_EQUAL_FLOAT(3600, estimator.maxRate());
+
+        // Lost time stamps don´t change the rate, the sequence has the impulses between them.
+        pulse.sequence += 2;
+        addPulses(estimator, pulse, 3 * SECOND_US, 1);
+        TEST_ASSERT_EQUAL_FLOAT(3600, estimator.rate(pulse.timeUs));
+        // The same impulse again is ignored.
+        estimator.add(pulse);
+        TEST_ASSERT_EQUAL_FLOAT(3600, estimator.rate(pulse.timeUs));
+    }
+
+    // The smoothed rate follows a change of the period, the min. and max. rate have the rates between the impulses.
+    void test_rate_change(){
+        RateEstimator estimator;
+        estimator.reset();
+        PulseTimestamp pulse = {0, 0};
+        estimator.add(pulse);
+        addPulses(estimator, pulse, SECOND_US, 10);
+        estimator.startIntervall();
+        uint32_t lastUs = addPulses(estimator, pulse, SECOND_US / 2, 1);
+        // The smoothed period moves by a quarter of the change.
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 3600.0 * 1000000 / 875000, estimator.rate(lastUs));
+        lastUs = addPulses(estimator, pulse, SECOND_US / 2, 30);
+        TEST_ASSERT_FLOAT_WITHIN(1, 7200, estimator.rate(lastUs));
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 3600.0 * 1000000 / 875000, estimator.minRate());
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 7200, estimator.maxRate());
+
+        // The next impulse is late, the rate falls with the time since the last impulse.
+        TEST_ASSERT_FLOAT_WITHIN(1, 7200, estimator.rate(lastUs + SECOND_US / 2));
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 1800, estimator.rate(lastUs + 2 * SECOND_US));
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 1800, estimator.minRate());
+    }
+
+    // The rate of a stopped meter is 0, the next impulses start the rate again without the pause.
+    void test_stopped_meter(){
+        RateEstimator estimator;
+        estimator.reset();
+        PulseTimestamp pulse = {0, 0};
+        estimator.add(pulse);
+        uint32_t lastUs = addPulses(estimator, pulse, SECOND_US, 10);
+        TEST_ASSERT_TRUE(estimator.rate(lastUs + STOPPED_US - 2) > 0);
+        TEST_ASSERT_EQUAL_FLOAT(0, estimator.rate(lastUs + STOPPED_US));
+        TEST_ASSERT_EQUAL_FLOAT(0, estimator.minRate());
+        TEST_ASSERT_EQUAL_FLOAT(3600, estimator.maxRate());
+
+        estimator.startIntervall();
+        lastUs = addPulses(estimator, pulse, STOPPED_US, 1);
+        TEST_ASSERT_EQUAL_FLOAT(0, estimator.rate(lastUs));
+        lastUs = addPulses(estimator, pulse, SECOND_US / 2, 1);
+        TEST_ASSERT_EQUAL_FLOAT(7200, estimator.rate(lastUs));
+    }
+
+    // The node with a live rate on counter 16, the counters below are used by the other node tests.
+    const int COUNTER_ID = 16;
+    const int CHANGE_PERCENT = 10;
+
+    RecordingMqttPort port;
+    Logger logger;
+    MeterNode node;
+    char nodeName[] = "RATE";
+
+    // Run the node with the simulated clock and a impulse every periodMs, no impulses for period 0.
+    void run(int seconds, int periodMs){
+        int64_t startUs = Hal::micros();
+        for (int ms = 100; ms <= seconds * 1000; ms += 100)
+        {
+            if(periodMs > 0 && ms % periodMs == 0){
+                Hal::simulatePinLevel(gpioPins[COUNTER_ID], true);
+                Hal::simulatePinLevel(gpioPins[COUNTER_ID], false);
+            }
+            Hal::advanceClock(startUs + (int64_t)ms * 1000);
+            node.loop();
+        }
+    }
+
+    // The published rates, the min. and max. rate after them are ignored.
+    std::vector<float> publishedRates(size_t from){
+        std::vector<float> rates;
+        for (size_t i = from; i < port.messages.size(); i++)
+        {
+            if(port.messages[i].topic == "Rate/Rate/Counter16"){
+                rates.push_back(strtof(port.messages[i].payload.c_str(), NULL));
+            }
+        }
+        return rates;
+    }
+
+    // The node publishes the rate only on a change of more than liveRateChangePercent and when the meter stops.
+    void test_node_publishes_live_rate_on_change(){
+        char message[48];
+        logger.begin(nodeName, &port);
+        node.begin(nodeName, &port, &logger);
+        snprintf(message, sizeof(message), "%d\tRate/Counter16\t60", COUNTER_ID);
+        node.installCounters(message);
+        snprintf(message, sizeof(message), "%d\t%d", COUNTER_ID, CHANGE_PERCENT);
+        node.liveRateMessage(message);
+
+        // A steady rate is published once.
+        run(60, 1000);
+        std::vector<float> rates = publishedRates(0);
+        TEST_ASSERT_TRUE(rates.size() >= 1);
+        size_t steady = port.messages.size();
+        run(120, 1000);
+        TEST_ASSERT_EQUAL(0, publishedRates(steady).size());
+        rates = publishedRates(0);
+        TEST_ASSERT_FLOAT_WITHIN(3600 * CHANGE_PERCENT / 100, 3600, rates.back());
+
+        // The doubled rate is published while the smoothed rate follows it, every publish is a change of more than 10%.
+        size_t change = port.messages.size();
+        run(60, 500);
+        rates = publishedRates(change);
+        TEST_ASSERT_TRUE(rates.size() >= 2);
+        float published = 3600;
+        for (float rate : rates)
+        {
+            TEST_ASSERT_TRUE((rate - published) * 100 > published * CHANGE_PERCENT);
+            published = rate;
+        }
+        TEST_ASSERT_FLOAT_WITHIN(7200 * CHANGE_PERCENT / 100, 7200, rates.back());
+
+        // The rate of the stopped meter falls and is published as 0 after 15 minutes.
+        size_t stop = port.messages.size();
+        run(15 * 60 - 1, 0);
+        rates = publishedRates(stop);
+        TEST_ASSERT_TRUE(rates.size() >= 2);
+        TEST_ASSERT_TRUE(rates.back() > 0 && rates.back() < 10);
+        run(2, 0);
+        rates = publishedRates(stop);
+        TEST_ASSERT_EQUAL_FLOAT(0, rates.back());
+        size_t stopped = port.messages.size();
+        run(60, 0);
+        TEST_ASSERT_EQUAL(0, publishedRates(stopped).size());
+    }
+}
+
+void runRateEstimatorTests(){
+    RUN_TEST(test_steady_rate);
+    RUN_TEST(test_rate_change);
+    RUN_TEST(test_stopped_meter);
+    RUN_TEST(test_node_publishes_live_rate_on_change);
+}
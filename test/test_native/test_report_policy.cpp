@@ -0,0 +1,231 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include "Hal.h"
+#include "Logger.h"
+#include "MeterNode.h"
+#include "PackedFormat.h"
+#include "ReportPolicy.h"
+#include "Tests.h"
+
+namespace
+{
+    const int INTERVALL_IN_SEC = 60;
+    // The counters of the node, the counters 0 and 1 are used by the command parser tests.
+    const int FIRST_COUNTER_ID = 2;
+
+    struct PolicyCase
+    {
+        const char* name;
+        const char* message;										// The policy fields of the InstallCounter message
+        ReportPolicy::Config config;
+    };
+
+    const PolicyCase POLICY_CASES[] = {
+        {"ALWAYS", "ALWAYS", {ReportPolicy::REPORT_ALWAYS, false, 0, 0}},
+        {"CHANGE", "CHANGE", {ReportPolicy::REPORT_ON_CHANGE, false, 0, 0}},
+        {"CHANGE 600", "CHANGE\t600", {ReportPolicy::REPORT_ON_CHANGE, false, 0, 600}},
+        {"DEADBAND 5", "DEADBAND\t5", {ReportPolicy::REPORT_DEADBAND, false, 5, 0}},
+        {"DEADBAND 10% 900", "DEADBAND\t10%\t900", {ReportPolicy::REPORT_DEADBAND, true, 10, 900}},
+        {"HEARTBEAT 3600", "HEARTBEAT\t3600", {ReportPolicy::REPORT_HEARTBEAT, false, 0, 3600}},
+    };
+    const size_t POLICY_CASE_COUNT = sizeof(POLICY_CASES) / sizeof(POLICY_CASES[0]);
+
+    // The impulses of the intervall: parts of 30 intervalls which are idle, steady, noisy or rising, at most 60.
+    unsigned long profile(size_t intervall, std::mt19937& random){
+        size_t step = intervall % 30;
+        switch (intervall / 30 % 4)
+        {
+        case 0:     return 0;
+        case 1:     return 30;
+        case 2:     return 30 + random() % 9;
+        default:    return step * 2;
+        }
+    }
+
+    bool coalescable(const ReportPolicy::Config& config, unsigned long impulse, unsigned long reference){
+        unsigned long difference = impulse > reference ? impulse - reference : reference - impulse;
+        switch (config.mode)
+        {
+        case ReportPolicy::REPORT_ON_CHANGE:    return difference == 0;
+        case ReportPolicy::REPORT_DEADBAND:     return config.relative ? difference * 100 <= reference * config.threshold : difference <= config.threshold;
+        case ReportPolicy::REPORT_HEARTBEAT:    return true;
+        default:                                return false;
+        }
+    }
+
+    // The records of a counter must follow each other without gaps and end at a intervall end.
+    struct RecordCheck
+    {
+        time_t lastEnd = 0;
+        unsigned long records = 0;
+        unsigned long impulses = 0;
+        time_t longestRecord = 0;
+        bool gapless = true;
+
+        void add(time_t utcTime, uint32_t timerIntervallInSec, unsigned long impulse){
+            time_t start = utcTime - timerIntervallInSec;
+            if((lastEnd != 0 && start != lastEnd) || utcTime % INTERVALL_IN_SEC != 0 || timerIntervallInSec == 0){
+                gapless = false;
+            }
+            if(timerIntervallInSec > longestRecord){
+                longestRecord = timerIntervallInSec;
+            }
+            lastEnd = utcTime;
+            records++;
+            impulses += impulse;
+        }
+    };
+
+    // A day of intervalls: the published and the flushed records have all impulses, follow each other without gaps,
+    // coalesce only intervalls within the deadband and keep the max. silence.
+    void test_policies_conserve_impulses(){
+        for (const PolicyCase& policyCase : POLICY_CASES)
+        {
+            std::mt19937 random(1);
+            ReportPolicy policy;
+            policy.begin(policyCase.config);
+            RecordCheck check;
+            check.lastEnd = TEST_BOOT_TIME;
+            const size_t intervalls = 24 * 3600 / INTERVALL_IN_SEC;
+            unsigned long impulses = 0;
+            unsigned long reference = 0;
+            bool inDeadband = true;
+            ImpulseMeterStatus record;
+            for (size_t i = 0; i < intervalls; i++)
+            {
+                ImpulseMeterStatus status = {};
+                status.sourceName = policyCase.name;
+                status.timerIntervallInSec = INTERVALL_IN_SEC;
+                status.utcTime = TEST_BOOT_TIME + (time_t)(i + 1) * INTERVALL_IN_SEC;
+                status.impulse = profile(i, random);
+                impulses += status.impulse;
+                if(policy.add(status, record)){
+                    check.add(record.utcTime, record.timerIntervallInSec, record.impulse);
+                    reference = status.impulse;
+                }else if(!coalescable(policyCase.config, status.impulse, reference)){
+                    inDeadband = false;
+                }
+            }
+            bool flushed = policy.flush(record);
+            if(flushed){
+                check.add(record.utcTime, record.timerIntervallInSec, record.impulse);
+            }
+
+            TEST_ASSERT_TRUE_MESSAGE(check.gapless, policyCase.name);
+            TEST_ASSERT_EQUAL_MESSAGE(TEST_BOOT_TIME + (time_t)intervalls * INTERVALL_IN_SEC, check.lastEnd, policyCase.name);
+            TEST_ASSERT_EQUAL_MESSAGE(impulses, check.impulses, policyCase.name);
+            TEST_ASSERT_TRUE_MESSAGE(inDeadband, policyCase.name);
+            // The flushed record also has coalesced intervalls.
+            TEST_ASSERT_EQUAL_MESSAGE(intervalls, check.records + policy.coalesced() - (flushed ? 1 : 0), policyCase.name);
+            if(policyCase.config.maxSilenceInSec > 0){
+                TEST_ASSERT_LESS_THAN_MESSAGE((time_t)policyCase.config.maxSilenceInSec + INTERVALL_IN_SEC, check.longestRecord, policyCase.name);
+            }
+        }
+    }
+
+    // The broker, which decodes the packed batches of the node.
+    class DecodingPort : public MqttPort
+    {
+    public:
+        bool isConnected() override { return true; }
+        bool publish(const char* topic, const char* payload, bool /*retain*/ = false) override {
+            if(strcmp(topic, "Impulses/REPORT") != 0){
+                return true;
+            }
+            PackedDecoder decoder;
+            PackedDecoder::Intervall intervall;
+            if(!decoder.begin(payload) || decoder.type() != PackedEncoder::TYPE_INTERVALLS){
+                broken++;
+                return true;
+            }
+            while (decoder.next(intervall))
+            {
+                size_t i = intervall.counterId - FIRST_COUNTER_ID;
+                if(intervall.counterId >= FIRST_COUNTER_ID && i < POLICY_CASE_COUNT){
+                    RecordCheck& check = checks[i];
+                    // The first intervall starts when the counter is installed.
+                    if(check.records == 0){
+                        check.lastEnd = intervall.utcTime - intervall.timerIntervallInSec;
+                    }
+                    check.add(intervall.utcTime, intervall.timerIntervallInSec, intervall.impulse);
+                }
+            }
+            if(decoder.error()){
+                broken++;
+            }
+            return true;
+        }
+        bool subscribe(const char* /*topic*/, message_handler_t /*handler*/) override { return true; }
+
+        RecordCheck checks[POLICY_CASE_COUNT];
+        unsigned long broken = 0;
+    };
+
+    DecodingPort port;
+    Logger logger;
+    MeterNode node;
+
+    // Run the node with the simulated clock for seconds, without impulses if random is NULL.
+    unsigned long run(int seconds, std::mt19937* random){
+        int64_t startUs = Hal::micros();
+        unsigned long impulses = 0;
+        unsigned long perMinute = 0;
+        for (int second = 1; second <= seconds; second++)
+        {
+            time_t now = Hal::utcTime();
+            if(random != NULL && (second == 1 || now % 60 == 0)){
+                perMinute = profile((size_t)(now / 60), *random);
+            }
+            bool impulse = random != NULL && (now % 60) * perMinute / 60 != (now % 60 + 1) * perMinute / 60;
+            for (size_t i = 0; i < POLICY_CASE_COUNT && impulse; i++)
+            {
+                Hal::simulatePinLevel(gpioPins[FIRST_COUNTER_ID + i], true);
+                Hal::simulatePinLevel(gpioPins[FIRST_COUNTER_ID + i], false);
+            }
+            impulses += impulse ? 1 : 0;
+            Hal::advanceClock(startUs + (int64_t)second * 1000000);
+            node.loop();
+        }
+        return impulses;
+    }
+
+    // One counter per policy counts the profile, the decoded packed batches have all counted impulses after flushReports().
+    void test_node_publishes_all_impulses(){
+        char installMessage[POLICY_CASE_COUNT * 48];
+        size_t len = 0;
+        for (size_t i = 0; i < POLICY_CASE_COUNT; i++)
+        {
+            len += snprintf(installMessage + len, sizeof(installMessage) - len, "%u\tReport/Counter%u\t%d\tGPIO\t%s\n",
+                (unsigned int)(FIRST_COUNTER_ID + i), (unsigned int)i, INTERVALL_IN_SEC, POLICY_CASES[i].message);
+        }
+        logger.begin();
+        node.begin("REPORT", &port, &logger);
+        node.setEncoding(MeterNode::ENCODING_PACKED);
+        node.setPublishMode(MeterNode::PUBLISH_BATCH);
+        node.installCounters(installMessage);
+        TEST_ASSERT_EQUAL(POLICY_CASE_COUNT, node.getInstalledCounters());
+
+        std::mt19937 random(1);
+        unsigned long impulses = run(3 * 3600 + 1800, &random);
+        // Close the last intervalls, then publish the coalesced ones like before a restart.
+        run(2 * INTERVALL_IN_SEC, NULL);
+        node.flushReports();
+        run(2, NULL);
+
+        TEST_ASSERT_EQUAL(0, port.broken);
+        TEST_ASSERT_TRUE(impulses > 0);
+        for (size_t i = 0; i < POLICY_CASE_COUNT; i++)
+        {
+            const RecordCheck& check = port.checks[i];
+            TEST_ASSERT_TRUE_MESSAGE(check.gapless, POLICY_CASES[i].name);
+            TEST_ASSERT_EQUAL_MESSAGE(impulses, check.impulses, POLICY_CASES[i].name);
+        }
+    }
+}
+
+void runReportPolicyTests(){
+    RUN_TEST(test_policies_conserve_impulses);
+    RUN_TEST(test_node_publishes_all_impulses);
+}
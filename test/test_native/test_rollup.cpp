@@ -0,0 +1,101 @@
+#include <unity.h>
+#include <random>
+#include "Rollup.h"
+#include "Tests.h"
+
+namespace
+{
+    const Rollup::LevelConfig LEVELS[] = {{900, false}, {3600, false}, {86400, true}};
+    const size_t LEVEL_COUNT = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+    // Two days of 10 second intervalls: every level has all impulses and its intervalls end at a multiple of the period.
+    void test_levels_conserve_impulses(){
+        Rollup rollup;
+        TEST_ASSERT_TRUE(rollup.begin(LEVELS, LEVEL_COUNT, 10));
+        std::mt19937 random(1);
+        unsigned long impulses = 0;
+        unsigned long levelImpulses[LEVEL_COUNT] = {};
+        size_t levelIntervalls[LEVEL_COUNT] = {};
+        Rollup::Record closed[Rollup::MAX_CLOSED];
+        // Starts in the middle of a day, so the first intervalls of the levels are shorter.
+        for (time_t utcTime = TEST_BOOT_TIME + 43210; utcTime <= TEST_BOOT_TIME + 2 * 86400 + 43200; utcTime += 10)
+        {
+            unsigned long impulse = random() % 20;
+            impulses += impulse;
+            size_t count = rollup.add(utcTime, impulse, closed);
+            TEST_ASSERT_LESS_OR_EQUAL(LEVEL_COUNT, count);
+            for (size_t i = 0; i < count; i++)
+            {
+                uint32_t period = LEVELS[closed[i].level].periodInSec;
+                TEST_ASSERT_EQUAL(0, closed[i].utcTime % period);
+                TEST_ASSERT_EQUAL(Rollup::levelEnd(utcTime, period), closed[i].utcTime);
+                levelImpulses[closed[i].level] += closed[i].impulse;
+                levelIntervalls[closed[i].level]++;
+            }
+        }
+
+        for (size_t level = 0; level < LEVEL_COUNT; level++)
+        {
+            TEST_ASSERT_EQUAL(impulses, levelImpulses[level] + rollup.openImpulse(level));
+        }
+        TEST_ASSERT_EQUAL(2 * 96, levelIntervalls[0]);
+        TEST_ASSERT_EQUAL(2 * 24, levelIntervalls[1]);
+        TEST_ASSERT_EQUAL(2, levelIntervalls[2]);
+        TEST_ASSERT_EQUAL(0, rollup.openImpulse(0));
+    }
+
+    // A missing last base intervall and a clock step close the open level intervall with its own end.
+    void test_gaps_close_the_open_intervall(){
+        const Rollup::LevelConfig levels[] = {{900, false}};
+        Rollup rollup;
+        TEST_ASSERT_TRUE(rollup.begin(levels, 1, 60));
+        Rollup::Record closed[Rollup::MAX_CLOSED];
+        time_t start = TEST_BOOT_TIME;
+        for (time_t utcTime = start + 60; utcTime < start + 900; utcTime += 60)
+        {
+            TEST_ASSERT_EQUAL(0, rollup.add(utcTime, 1, closed));
+        }
+        TEST_ASSERT_EQUAL(14, rollup.openImpulse(0));
+
+        // The intervall which ends at start + 900 is missing.
+        TEST_ASSERT_EQUAL(1, rollup.add(start + 960, 2, closed));
+        TEST_ASSERT_EQUAL(start + 900, closed[0].utcTime);
+        TEST_ASSERT_EQUAL(14, closed[0].impulse);
+        TEST_ASSERT_EQUAL(2, rollup.openImpulse(0));
+
+        // The clock was set back by an hour.
+        TEST_ASSERT_EQUAL(1, rollup.add(start + 960 - 3600, 3, closed));
+        TEST_ASSERT_EQUAL(start + 1800, closed[0].utcTime);
+        TEST_ASSERT_EQUAL(2, closed[0].impulse);
+
+        // The last base intervall of the level intervall after the step.
+        TEST_ASSERT_EQUAL(1, rollup.add(start - 1800, 4, closed));
+        TEST_ASSERT_EQUAL(start - 1800, closed[0].utcTime);
+        TEST_ASSERT_EQUAL(7, closed[0].impulse);
+    }
+
+    void test_bad_periods_remove_the_levels(){
+        Rollup rollup;
+        const Rollup::LevelConfig notMultiple[] = {{900, false}, {1000, false}};
+        TEST_ASSERT_FALSE(rollup.begin(notMultiple, 2, 60));
+        TEST_ASSERT_EQUAL(0, rollup.levels());
+        const Rollup::LevelConfig tooShort[] = {{60, false}};
+        TEST_ASSERT_FALSE(rollup.begin(tooShort, 1, 60));
+        const Rollup::LevelConfig tooLong[] = {{Rollup::MAX_PERIOD_IN_SEC + 60, false}};
+        TEST_ASSERT_FALSE(rollup.begin(tooLong, 1, 60));
+        TEST_ASSERT_FALSE(rollup.begin(LEVELS, Rollup::MAX_LEVELS + 1, 60));
+
+        // A new base intervall must fit into all levels.
+        TEST_ASSERT_TRUE(rollup.begin(LEVELS, LEVEL_COUNT, 60));
+        TEST_ASSERT_EQUAL(LEVEL_COUNT, rollup.levels());
+        TEST_ASSERT_TRUE(rollup.setBaseIntervall(300));
+        TEST_ASSERT_FALSE(rollup.setBaseIntervall(7));
+        TEST_ASSERT_EQUAL(0, rollup.levels());
+    }
+}
+
+void runRollupTests(){
+    RUN_TEST(test_levels_conserve_impulses);
+    RUN_TEST(test_gaps_close_the_open_intervall);
+    RUN_TEST(test_bad_periods_remove_the_levels);
+}
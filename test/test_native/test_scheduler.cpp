@@ -0,0 +1,148 @@
+#include <unity.h>
+#include <string>
+#include "Scheduler.h"
+#include "Tests.h"
+
+namespace
+{
+    // The runs of the jobs, every job adds its name.
+    std::string runs;
+
+    struct NamedJob
+    {
+        char name;
+        Scheduler* scheduler;
+        int triggers;							// The job to trigger while it runs, Scheduler::NO_JOB for none
+    };
+
+    void onJob(void* arg){
+        NamedJob* job = (NamedJob*)arg;
+        runs += job->name;
+        if(job->triggers != Scheduler::NO_JOB){
+            job->scheduler->trigger(job->triggers);
+        }
+    }
+
+    // The due jobs run in the order in which they were added, not in the order of the triggers.
+    void test_jobs_run_in_order(){
+        Scheduler scheduler;
+        NamedJob a = {'a', &scheduler, Scheduler::NO_JOB};
+        NamedJob b = {'b', &scheduler, Scheduler::NO_JOB};
+        NamedJob c = {'c', &scheduler, Scheduler::NO_JOB};
+        int idA = scheduler.add(onJob, &a, 0, 0);
+        scheduler.add(onJob, &b, 100, 0, 100);
+        int idC = scheduler.add(onJob, &c, 0, 0);
+        runs.clear();
+        scheduler.trigger(idC);
+        scheduler.trigger(idA);
+        TEST_ASSERT_EQUAL(100, scheduler.run(0));
+        TEST_ASSERT_EQUAL_STRING("ac", runs.c_str());
+
+        runs.clear();
+        scheduler.trigger(idC);
+        TEST_ASSERT_EQUAL(100, scheduler.run(100));
+        TEST_ASSERT_EQUAL_STRING("bc", runs.c_str());
+        // Nothing is due or triggered.
+        runs.clear();
+        TEST_ASSERT_EQUAL(1, scheduler.run(199));
+        TEST_ASSERT_EQUAL_STRING("", runs.c_str());
+    }
+
+    // A periodic job runs at its deadline, also a late one and across the wrap around of millis().
+    void test_job_runs_at_its_deadline(){
+        Scheduler scheduler;
+        NamedJob a = {'a', &scheduler, Scheduler::NO_JOB};
+        unsigned long start = (unsigned long)-1500;
+        scheduler.add(onJob, &a, 1000, start, 500);
+        runs.clear();
+        TEST_ASSERT_EQUAL(1, scheduler.run(start + 499));
+        TEST_ASSERT_EQUAL_STRING("", runs.c_str());
+        TEST_ASSERT_EQUAL(1000, scheduler.run(start + 500));
+        TEST_ASSERT_EQUAL_STRING("a", runs.c_str());
+        // Late by 200 ms after the wrap around, the next run is a period after it.
+        TEST_ASSERT_EQUAL(1000, scheduler.run(start + 1700));
+        TEST_ASSERT_EQUAL_STRING("aa", runs.c_str());
+        TEST_ASSERT_EQUAL(1, scheduler.run(start + 2699));
+        TEST_ASSERT_EQUAL_STRING("aa", runs.c_str());
+
+        Scheduler empty;
+        TEST_ASSERT_EQUAL(Scheduler::NO_DEADLINE, empty.run(0));
+    }
+
+    // The update job of the node runs periodic and is triggered by a closed intervall: the event runs it at once and
+    // moves the next periodic run a period after it. A event while a job runs is not lost.
+    void test_intervall_event_reschedules_the_update(){
+        Scheduler scheduler;
+        NamedJob update = {'u', &scheduler, Scheduler::NO_JOB};
+        NamedJob publish = {'p', &scheduler, Scheduler::NO_JOB};
+        int updateJob = scheduler.add(onJob, &update, 1000, 0);
+        int publishJob = scheduler.add(onJob, &publish, 0, 0);
+        runs.clear();
+        TEST_ASSERT_EQUAL(1000, scheduler.run(0));
+        TEST_ASSERT_EQUAL_STRING("u", runs.c_str());
+
+        scheduler.trigger(updateJob);
+        TEST_ASSERT_EQUAL(1000, scheduler.run(300));
+        TEST_ASSERT_EQUAL_STRING("uu", runs.c_str());
+        TEST_ASSERT_EQUAL(1, scheduler.run(1299));
+        TEST_ASSERT_EQUAL(1000, scheduler.run(1300));
+        TEST_ASSERT_EQUAL_STRING("uuu", runs.c_str());
+
+        // The update triggers the publish job while it runs, the trigger is kept for the next run().
+        update.triggers = publishJob;
+        scheduler.trigger(updateJob);
+        TEST_ASSERT_EQUAL(0, scheduler.run(1400));
+        TEST_ASSERT_EQUAL_STRING("uuuu", runs.c_str());
+        update.triggers = Scheduler::NO_JOB;
+        TEST_ASSERT_EQUAL(999, scheduler.run(1401));
+        TEST_ASSERT_EQUAL_STRING("uuuup", runs.c_str());
+    }
+
+    void test_job_is_rescheduled(){
+        Scheduler scheduler;
+        NamedJob a = {'a', &scheduler, Scheduler::NO_JOB};
+        int id = scheduler.add(onJob, &a, 1000, 0);
+        runs.clear();
+        scheduler.run(0);
+        scheduler.postpone(id, 500, 2000);
+        TEST_ASSERT_EQUAL(1500, scheduler.run(1000));
+        TEST_ASSERT_EQUAL(500, scheduler.run(2000));
+        TEST_ASSERT_EQUAL(1, runs.size());
+        TEST_ASSERT_EQUAL(1000, scheduler.run(2500));
+        TEST_ASSERT_EQUAL(2, runs.size());
+        // The first run of a new period is a period after the change, period 0 only runs by a trigger.
+        scheduler.setPeriod(id, 100, 2500);
+        TEST_ASSERT_EQUAL(100, scheduler.run(2500));
+        TEST_ASSERT_EQUAL(2, runs.size());
+        scheduler.setPeriod(id, 0, 2600);
+        TEST_ASSERT_EQUAL(Scheduler::NO_DEADLINE, scheduler.run(5000));
+        TEST_ASSERT_EQUAL(2, runs.size());
+        scheduler.trigger(id);
+        scheduler.run(5000);
+        TEST_ASSERT_EQUAL(3, runs.size());
+    }
+
+    void test_max_jobs(){
+        Scheduler scheduler;
+        NamedJob a = {'a', &scheduler, Scheduler::NO_JOB};
+        for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+        {
+            TEST_ASSERT_EQUAL(i, scheduler.add(onJob, &a, 0, 0));
+        }
+        TEST_ASSERT_EQUAL(Scheduler::NO_JOB, scheduler.add(onJob, &a, 0, 0));
+        runs.clear();
+        scheduler.trigger(Scheduler::MAX_JOBS - 1);
+        scheduler.trigger(Scheduler::MAX_JOBS);
+        scheduler.trigger(Scheduler::NO_JOB);
+        scheduler.run(0);
+        TEST_ASSERT_EQUAL_STRING("a", runs.c_str());
+    }
+}
+
+void runSchedulerTests(){
+    RUN_TEST(test_jobs_run_in_order);
+    RUN_TEST(test_job_runs_at_its_deadline);
+    RUN_TEST(test_intervall_event_reschedules_the_update);
+    RUN_TEST(test_job_is_rescheduled);
+    RUN_TEST(test_max_jobs);
+}
@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <stdint.h>
+#include <thread>
+#include "ObjectPool.h"
+#include "SpscQueue.h"
+#include "SlotAllocator.h"
+#include "Tests.h"
+
+namespace
+{
+    void test_empty_queue(){
+        SpscQueue<int, 4> queue;
+        int item = -1;
+        TEST_ASSERT_TRUE(queue.empty());
+        TEST_ASSERT_FALSE(queue.pop(item));
+        TEST_ASSERT_EQUAL(-1, item);
+        TEST_ASSERT_NULL(queue.front());
+        queue.drop();
+        TEST_ASSERT_EQUAL(0, queue.size());
+    }
+
+    void test_full_queue_rejects_and_counts(){
+        SpscQueue<int, 4> queue;
+        for (int i = 0; i < 4; i++)
+        {
+            TEST_ASSERT_TRUE(queue.push(i));
+        }
+        TEST_ASSERT_FALSE(queue.push(4));
+        TEST_ASSERT_FALSE(queue.push(5));
+        TEST_ASSERT_EQUAL(2, queue.overflows());
+        TEST_ASSERT_EQUAL(4, queue.size());
+        TEST_ASSERT_EQUAL(4, queue.highWater());
+
+        // The rejected items don´t replace the stored ones.
+        int item;
+        for (int i = 0; i < 4; i++)
+        {
+            TEST_ASSERT_TRUE(queue.pop(item));
+            TEST_ASSERT_EQUAL(i, item);
+        }
+        TEST_ASSERT_TRUE(queue.push(6));
+        TEST_ASSERT_EQUAL(2, queue.overflows());
+    }
+
+    void test_wraparound_keeps_the_order(){
+        SpscQueue<uint32_t, 8> queue;
+        uint32_t next = 0;
+        uint32_t expected = 0;
+        // Fill levels of 1..8 move the indices many times around the ring.
+        for (int round = 0; round < 1000; round++)
+        {
+            size_t fill = round % 8 + 1;
+            for (size_t i = 0; i < fill; i++)
+            {
+                TEST_ASSERT_TRUE(queue.push(next++));
+            }
+            TEST_ASSERT_EQUAL(fill, queue.size());
+            uint32_t* front = queue.front();
+            TEST_ASSERT_NOT_NULL(front);
+            TEST_ASSERT_EQUAL(expected, *front);
+            queue.drop();
+            expected++;
+            uint32_t item;
+            while (queue.pop(item))
+            {
+                TEST_ASSERT_EQUAL(expected, item);
+                expected++;
+            }
+        }
+        TEST_ASSERT_EQUAL(next, expected);
+        TEST_ASSERT_EQUAL(0, queue.overflows());
+        TEST_ASSERT_EQUAL(8, queue.highWater());
+    }
+
+    // A producer and a consumer thread like the ISR and the loop(). The consumer must get every item once and in order.
+    void test_two_threads_keep_every_item(){
+        const uint32_t ITEMS = 2000000;
+        static SpscQueue<uint64_t, 16> queue;
+        unsigned long rejected = 0;
+        std::thread producer([&rejected]{
+            for (uint32_t i = 1; i <= ITEMS; i++)
+            {
+                // The item has a check value, so a torn read is detected.
+                uint64_t item = (uint64_t)i << 32 | (uint32_t)~i;
+                while (!queue.push(item))
+                {
+                    rejected++;
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        uint32_t expected = 1;
+        unsigned long errors = 0;
+        while (expected <= ITEMS)
+        {
+            uint64_t item;
+            if (!queue.pop(item))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t value = (uint32_t)(item >> 32);
+            errors += value != expected || (uint32_t)item != (uint32_t)~value;
+            expected = value + 1;
+        }
+        producer.join();
+
+        TEST_ASSERT_EQUAL(0, errors);
+        TEST_ASSERT_TRUE(queue.empty());
+        TEST_ASSERT_EQUAL(rejected, queue.overflows());
+        TEST_ASSERT_LESS_OR_EQUAL(16, queue.highWater());
+    }
+
+    void test_slots_are_handed_out_once(){
+        SlotAllocator<4> slots;
+        bool taken[4] = {};
+        for (int i = 0; i < 4; i++)
+        {
+            int slot = slots.allocate();
+            TEST_ASSERT_TRUE(slot >= 0 && slot < 4);
+            TEST_ASSERT_FALSE(taken[slot]);
+            taken[slot] = true;
+        }
+        TEST_ASSERT_EQUAL(SlotAllocator<4>::NO_SLOT, slots.allocate());
+        TEST_ASSERT_EQUAL(4, slots.used());
+
+        slots.release(2);
+        TEST_ASSERT_EQUAL(3, slots.used());
+        TEST_ASSERT_EQUAL(2, slots.allocate());
+        TEST_ASSERT_EQUAL(SlotAllocator<4>::NO_SLOT, slots.allocate());
+    }
+
+    void test_release_ignores_free_and_invalid_slots(){
+        SlotAllocator<4> slots;
+        int slot = slots.allocate();
+        slots.release(slot);
+        // A second release must not put the slot twice into the free list.
+        slots.release(slot);
+        slots.release(-1);
+        slots.release(SlotAllocator<4>::NO_SLOT);
+        slots.release(4);
+        TEST_ASSERT_EQUAL(0, slots.used());
+
+        bool taken[4] = {};
+        for (int i = 0; i < 4; i++)
+        {
+            int next = slots.allocate();
+            TEST_ASSERT_TRUE(next >= 0 && next < 4);
+            TEST_ASSERT_FALSE(taken[next]);
+            taken[next] = true;
+        }
+        TEST_ASSERT_EQUAL(SlotAllocator<4>::NO_SLOT, slots.allocate());
+        TEST_ASSERT_TRUE(slots.isAllocated(0));
+        TEST_ASSERT_FALSE(slots.isAllocated(-1));
+        TEST_ASSERT_FALSE(slots.isAllocated(4));
+    }
+
+    // Counts the destructor calls of the pooled objects.
+    struct Pooled
+    {
+        static int destructed;
+        int value = 7;
+        ~Pooled() { destructed++; }
+    };
+    int Pooled::destructed = 0;
+
+    void test_pool_destroys_only_its_created_objects(){
+        ObjectPool<Pooled, 2> pool;
+        ObjectPool<Pooled, 2> other;
+        Pooled* first = pool.create();
+        Pooled* second = pool.create();
+        TEST_ASSERT_NOT_NULL(first);
+        TEST_ASSERT_NOT_NULL(second);
+        TEST_ASSERT_EQUAL(7, second->value);
+        TEST_ASSERT_NULL(pool.create());
+
+        Pooled::destructed = 0;
+        Pooled local;
+        TEST_ASSERT_FALSE(pool.destroy(NULL));
+        TEST_ASSERT_FALSE(pool.destroy(&local));
+        TEST_ASSERT_FALSE(other.destroy(first));
+        TEST_ASSERT_EQUAL(0, Pooled::destructed);
+
+        TEST_ASSERT_TRUE(pool.destroy(first));
+        // A double destroy doesn´t call the destructor again and doesn´t free the slot twice.
+        TEST_ASSERT_FALSE(pool.destroy(first));
+        TEST_ASSERT_EQUAL(1, Pooled::destructed);
+        TEST_ASSERT_EQUAL(1, pool.used());
+        TEST_ASSERT_NOT_NULL(pool.create());
+        TEST_ASSERT_NULL(pool.create());
+    }
+}
+
+void runSpscQueueTests(){
+    RUN_TEST(test_empty_queue);
+    RUN_TEST(test_full_queue_rejects_and_counts);
+    RUN_TEST(test_wraparound_keeps_the_order);
+    RUN_TEST(test_two_threads_keep_every_item);
+    RUN_TEST(test_slots_are_handed_out_once);
+    RUN_TEST(test_release_ignores_free_and_invalid_slots);
+    RUN_TEST(test_pool_destroys_only_its_created_objects);
+}
@@ -0,0 +1,112 @@
+#include <unity.h>
+#include "StormGuard.h"
+#include "Tests.h"
+
+namespace
+{
+    const uint32_t MIN_SPACING_US = 20000;
+
+    // Every impulse has a train of glitches after it, only the impulses are counted.
+    void test_glitch_trains_are_ignored(){
+        StormGuard guard;
+        guard.begin({MIN_SPACING_US, 0});
+        unsigned long counted = 0;
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            uint32_t impulseUs = 1000000 + i * 100000;
+            counted += guard.onInterrupt(impulseUs) == StormGuard::COUNT;
+            for (uint32_t glitch = 1; glitch <= 5; glitch++)
+            {
+                TEST_ASSERT_EQUAL(StormGuard::IGNORE, guard.onInterrupt(impulseUs + glitch * 1000));
+            }
+        }
+        TEST_ASSERT_EQUAL(100, counted);
+        TEST_ASSERT_EQUAL(500, guard.glitches());
+        TEST_ASSERT_EQUAL(0, guard.storms());
+    }
+
+    // Bounces up to the min. spacing after the counted impulse are ignored, they don´t extend the dead time.
+    // The times wrap around in the middle of the bounces.
+    void test_bounces_at_the_debounce_edge(){
+        StormGuard guard;
+        guard.begin({MIN_SPACING_US, 0});
+        uint32_t impulseUs = 0xFFFFFFFF - 10000;
+        TEST_ASSERT_EQUAL(StormGuard::COUNT, guard.onInterrupt(impulseUs));
+        for (uint32_t bounceUs = 500; bounceUs < MIN_SPACING_US; bounceUs += 500)
+        {
+            TEST_ASSERT_EQUAL(StormGuard::IGNORE, guard.onInterrupt(impulseUs + bounceUs));
+        }
+        TEST_ASSERT_EQUAL(StormGuard::IGNORE, guard.onInterrupt(impulseUs + MIN_SPACING_US - 1));
+        TEST_ASSERT_EQUAL(StormGuard::COUNT, guard.onInterrupt(impulseUs + MIN_SPACING_US));
+        TEST_ASSERT_EQUAL(StormGuard::IGNORE, guard.onInterrupt(impulseUs + 2 * MIN_SPACING_US - 1));
+        TEST_ASSERT_EQUAL(StormGuard::COUNT, guard.onInterrupt(impulseUs + 2 * MIN_SPACING_US));
+        TEST_ASSERT_EQUAL(MIN_SPACING_US / 500 - 1 + 2, guard.glitches());
+
+        // Without debouncing every interrupt is counted.
+        guard.begin({0, 0});
+        TEST_ASSERT_EQUAL(StormGuard::COUNT, guard.onInterrupt(impulseUs));
+        TEST_ASSERT_EQUAL(StormGuard::COUNT, guard.onInterrupt(impulseUs + 1));
+    }
+
+    // Feed samples of the pin every SAMPLE_PERIOD_US. The level is high for the first highSamples of every periodSamples.
+    // Returns the counted impulses, rearmUs is the time of the first rearm or 0.
+    unsigned long sample(StormGuard& guard, uint32_t& nowUs, uint32_t durationUs, uint32_t periodSamples, uint32_t highSamples, uint32_t& rearmUs){
+        unsigned long counted = 0;
+        for (uint32_t i = 0; i < durationUs / StormGuard::SAMPLE_PERIOD_US && guard.isSampling(); i++)
+        {
+            nowUs += StormGuard::SAMPLE_PERIOD_US;
+            counted += guard.onSample(i % periodSamples < highSamples, nowUs);
+            if(guard.canRearm(nowUs)){
+                rearmUs = nowUs;
+            }
+        }
+        return counted;
+    }
+
+    // A floating input gives 2000 interrupts per second: the guard switches to sampling within a window, stays there
+    // while the input is noisy and enables the interrupt again after REARM_HOLDOFF_US of normal impulses.
+    void test_storm_entry_and_exit(){
+        StormGuard guard;
+        guard.begin({0, 1000});
+        const uint32_t maxPerWindow = 1000 * StormGuard::WINDOW_US / 1000000;
+        uint32_t nowUs = 5000000;
+        unsigned long counted = 0;
+        StormGuard::Decision decision = StormGuard::COUNT;
+        uint32_t interrupts = 0;
+        while (decision != StormGuard::STORM && interrupts < 10 * maxPerWindow)
+        {
+            nowUs += 500;
+            decision = guard.onInterrupt(nowUs);
+            counted += decision == StormGuard::COUNT;
+            interrupts++;
+        }
+        TEST_ASSERT_EQUAL(StormGuard::STORM, decision);
+        TEST_ASSERT_EQUAL(maxPerWindow + 1, interrupts);
+        TEST_ASSERT_EQUAL(maxPerWindow, counted);
+        TEST_ASSERT_EQUAL(1, guard.storms());
+        TEST_ASSERT_TRUE(guard.isSampling());
+
+        // The noise toggles at every sample, the sampled rate is too high to rearm.
+        uint32_t rearmUs = 0;
+        sample(guard, nowUs, 3 * StormGuard::REARM_HOLDOFF_US, 2, 1, rearmUs);
+        TEST_ASSERT_EQUAL(0, rearmUs);
+        TEST_ASSERT_TRUE(guard.isSampling());
+
+        // Normal impulses every 100 ms are counted while sampling, until the interrupt is enabled again.
+        uint32_t quietUs = nowUs;
+        counted = sample(guard, nowUs, 2 * StormGuard::REARM_HOLDOFF_US, 50, 2, rearmUs);
+        TEST_ASSERT_FALSE(guard.isSampling());
+        TEST_ASSERT_TRUE(rearmUs - quietUs <= StormGuard::REARM_HOLDOFF_US);
+        // The holdoff started with the last noisy window.
+        TEST_ASSERT_TRUE(rearmUs - quietUs > StormGuard::REARM_HOLDOFF_US - 2 * StormGuard::WINDOW_US);
+        TEST_ASSERT_EQUAL((rearmUs - quietUs - StormGuard::SAMPLE_PERIOD_US) / 100000 + 1, counted);
+        TEST_ASSERT_EQUAL(StormGuard::COUNT, guard.onInterrupt(nowUs + 100000));
+        TEST_ASSERT_EQUAL(1, guard.storms());
+    }
+}
+
+void runStormGuardTests(){
+    RUN_TEST(test_glitch_trains_are_ignored);
+    RUN_TEST(test_bounces_at_the_debounce_edge);
+    RUN_TEST(test_storm_entry_and_exit);
+}